@@ -0,0 +1,165 @@
+#pragma once
+
+#include "constants.h"
+#include "pa_management.h"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+// Owns the output stream and, when adaptive, tunes its buffer size to the
+// machine. Every callback's render time is measured against the time its buffer
+// covers, and underflows reported by the device are counted. Every few seconds
+// the controller looks back: if there were misses (underflows, or callbacks close
+// to their deadline) a couple of times running, it backs off to a bigger buffer;
+// if every callback had lots of headroom for a good while, it tries a smaller one.
+// A size it had to back off from isn't tried again for a while.
+//
+// Switching opens a second stream with the new size next to the old one. Only one
+// callback renders at a time, so the generators are never rendered by two threads at
+// once. While the new stream is starting, the old one renders into a ring of frames
+// laid out by when they reach the DAC (outputBufferDacTime), and both streams play
+// from it: the new one picks up where its buffers fall, the old one renders far
+// enough ahead that the new one doesn't run dry, and the two crossfade over frames
+// both have yet to play. Once the old stream has faded out it hands rendering over
+// and finishes; the new one plays out what's left in the ring, in order, before it
+// renders straight into its own buffers.
+struct BufferSizeController
+{
+    static constexpr unsigned long MIN_FRAMES = 32;
+    static constexpr unsigned long MAX_FRAMES = 4096;
+
+    struct Stats
+    {
+        unsigned long framesPerBuffer{ 0 };
+        float         load{ 0.0f }; // render time over buffer time, worst of the last window
+        uint64_t      underflows{ 0 };
+        uint32_t      switches{ 0 };
+    };
+
+    static BufferSizeController& getInstance();
+
+    // Open the first stream, with the device's default buffer size. render is
+    // called as the stream callback, on the audio thread; it gets no userData. Every
+    // stream runs at sampleRate.
+    bool open(PaCallbackT render, double sampleRate = SAMPLE_RATE);
+
+    // Stop and close every stream.
+    void close();
+
+    // Call from the UI thread, once a frame. Evaluates the measurements and switches
+    // streams when it's time to.
+    void update();
+
+    void setAdaptive(bool adaptive) { m_adaptive = adaptive; }
+    bool isAdaptive() const         { return m_adaptive; }
+
+    // The stream that's currently rendering, for showing its info.
+    PaStream* getStream() const { return m_streams[m_current]; }
+
+    // False if there's no stream at all: opening failed, or a stream that stopped
+    // during a failed switch couldn't be started again.
+    bool isRunning() const { return m_streams[m_current] != nullptr; }
+
+    Stats getStats() const { return m_stats; }
+
+    double getSampleRate() const { return m_sample_rate; }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    // A window of measurements that's judged as a whole.
+    static constexpr auto WINDOW = std::chrono::seconds(2);
+
+    // Loads above this are misses; every callback below the other is headroom.
+    static constexpr float MISS_LOAD = 0.75f;
+    static constexpr float HEADROOM_LOAD = 0.3f;
+
+    static constexpr int MISS_WINDOWS_TO_GROW = 2;
+    static constexpr int HEADROOM_WINDOWS_TO_SHRINK = 5;
+
+    // After backing off from a size, don't try going below the new size for this long.
+    static constexpr auto BACKOFF_COOLDOWN = std::chrono::seconds(60);
+
+    // Give up on a new stream that hasn't taken over by now.
+    static constexpr auto HANDOFF_TIMEOUT = std::chrono::seconds(1);
+
+    // Enough for the streams' latencies to differ by a few of the biggest buffers.
+    static constexpr size_t HANDOFF_RING_FRAMES = 32768;
+    static constexpr int64_t CROSSFADE_FRAMES = 1024;
+
+    enum class Fade { None, In, Out };
+
+    BufferSizeController() = default;
+
+    static int streamCallback(const void* input, void* output, unsigned long frames,
+                              const PaStreamCallbackTimeInfo* timeInfo, PaStreamCallbackFlags flags, void* userData);
+
+    int  renderHandoff(int slot, uint32_t handoff, const void* input, float* output, unsigned long frames,
+                       const PaStreamCallbackTimeInfo* timeInfo, PaStreamCallbackFlags flags);
+    void playClaim(int slot, float* output, unsigned long frames, const PaStreamCallbackTimeInfo* timeInfo);
+    int  renderRing(int64_t from, int64_t to, const void* input, const PaStreamCallbackTimeInfo* timeInfo, PaStreamCallbackFlags flags);
+    void playRing(int slot, float* output, unsigned long frames, Fade fade);
+    void recordCallback(unsigned long frames, float load, PaStreamCallbackFlags flags);
+    void resetHandoffRing();
+
+    void evaluateWindow(Clock::time_point now);
+    void beginSwitch(unsigned long framesPerBuffer, Clock::time_point now);
+    void finishSwitch(Clock::time_point now);
+    PaStream* openStream(size_t slot, unsigned long framesPerBuffer);
+    bool      restartStream(size_t slot); // start a stream that completed again, as it was
+
+    PaCallbackT m_render{ nullptr };
+    double m_sample_rate{ SAMPLE_RATE };
+
+    // Two slots: the stream that's rendering, and (while switching) the one taking over.
+    std::array<PaStream*, 2> m_streams{};
+    size_t m_current{ 0 };
+    bool   m_switching{ false };
+    Clock::time_point m_switch_started;
+
+    // Which slot's callback may render (the owner), and which one wants to (the claimant),
+    // packed into one word so every change to the pair is a single compare-exchange.
+    static constexpr uint32_t packHandoff(int owner, int claimant) { return uint32_t(owner) | (uint32_t(claimant) << 8); }
+    static constexpr int getOwner(uint32_t handoff)    { return int(handoff & 0xff); }
+    static constexpr int getClaimant(uint32_t handoff) { return int(handoff >> 8); }
+    std::atomic<uint32_t> m_handoff{ 0 };
+
+    // By slot: whether the stream's callback thread has named itself for tracing. Set
+    // by openStream, before the stream starts, and then only by that callback.
+    std::array<bool, 2> m_thread_named{};
+
+    // The handoff ring. Only the owner writes frames, and publishes them through
+    // m_rendered (-1 while there's no ring: the owner renders straight to its output).
+    // Frame 0 reaches the DAC at m_ring_time.
+    alignas(32) std::array<float, HANDOFF_RING_FRAMES * 2> m_ring{};
+    std::atomic<int64_t> m_rendered{ -1 };
+    std::atomic<double>  m_ring_time{ 0.0 };
+    std::atomic<int64_t> m_claimant_need{ -1 }; // end of the claimant's next buffer, once it has a place in the ring
+    std::atomic<int64_t> m_fade_start{ -1 };    // where the crossfade starts, once the owner has chosen
+
+    // By slot, and only touched by that stream's callback once it has started (set by
+    // openStream before then): the frame its next buffer starts at, and whether it's the
+    // stream fading in.
+    std::array<int64_t, 2> m_ring_position{ -1, -1 };
+    std::array<bool, 2>    m_fading_in{};
+
+    // Written only by the rendering callback; running totals so the UI can take differences.
+    std::atomic<unsigned long> m_frames{ 0 };
+    std::atomic<uint64_t> m_callbacks{ 0 };
+    std::atomic<uint64_t> m_missed{ 0 };    // callbacks over MISS_LOAD
+    std::atomic<uint64_t> m_headroom{ 0 };  // callbacks under HEADROOM_LOAD
+    std::atomic<uint64_t> m_underflows{ 0 };
+    std::atomic<float>    m_max_load{ 0.0f }; // since the UI last reset it
+
+    // UI thread only.
+    bool m_adaptive{ false };
+    Clock::time_point m_window_start;
+    uint64_t m_window_callbacks{ 0 }, m_window_missed{ 0 }, m_window_headroom{ 0 }, m_window_underflows{ 0 };
+    int m_miss_windows{ 0 };
+    int m_headroom_windows{ 0 };
+    unsigned long m_floor_frames{ MIN_FRAMES };
+    Clock::time_point m_floor_expires;
+    Stats m_stats;
+};
@@ -4,8 +4,21 @@
 
 #include <array>
 #include <cassert>
+#include <cstddef>
+#include <cstdint>
 #include <optional>
 
+// MSVC's spelling; other compilers (the headless render check) get the same thing.
+#if !defined(_MSC_VER)
+#define __forceinline inline __attribute__((always_inline))
+#endif
+
+template<class Ts>
+void unused(Ts...)
+{ }
+
+constexpr bool isPowerOf2(int n) { return (n & (n - 1)) == 0; }
+
 // Math values
 #pragma warning(suppress: 4244) // suppress gcem MVSC warning re: possible loss of data
 static constexpr double const PI = gcem::acos(-1);
@@ -200,7 +213,6 @@ namespace Notes
 constexpr unsigned int CHANNEL_COUNT_MONO = 1;
 constexpr unsigned int CHANNEL_COUNT_STEREO = 2;
 constexpr unsigned int SAMPLE_RATE_44_1_KHZ = 44100; // 44.1 kHz
-constexpr double MAX_PHASE = static_cast<double>(UINT16_MAX);
 constexpr double ONE_OVER_PI = 1. / PI;
 constexpr double TWO_OVER_PI = 2. / PI;
 
@@ -208,10 +220,27 @@ constexpr double TWO_OVER_PI = 2. / PI;
 constexpr unsigned int CHANNEL_COUNT = CHANNEL_COUNT_MONO;
 constexpr unsigned int SAMPLE_RATE = SAMPLE_RATE_44_1_KHZ;
 
+// Control-rate values (envelopes, modulation) are recomputed once per block of this many
+// frames. The block size can be changed at runtime, up to the maximum.
+constexpr size_t CONTROL_BLOCK_SIZE = 32;
+constexpr size_t MAX_CONTROL_BLOCK_SIZE = 256;
+
+// Independent generators (layers, instruments) mixed into the output. The first renders
+// on the audio callback's thread; each of the others gets a worker thread of its own.
+constexpr size_t MAX_GENERATORS = 4;
+
+// Phase accumulators are 32-bit fixed point, and one full cycle is 2^32. The top
+// TABLE_BITS bits index the wave tables; the rest hold the fractional phase, which
+// keeps frequencies and phase modulation precise enough for clean FM sidebands.
+constexpr unsigned int TABLE_BITS = 16;
+constexpr unsigned int PHASE_FRACTION_BITS = 32 - TABLE_BITS;
+constexpr double PHASE_CYCLE = 4294967296.0; // 2^32
+constexpr double MAX_PHASE = static_cast<double>(1u << TABLE_BITS); // table entries per cycle
+
 // Constants derived from options
 constexpr double ONE_OVER_SAMPLE_RATE = 1. / SAMPLE_RATE;
 constexpr double ONE_OVER_MAX_PHASE = 1. / MAX_PHASE;
-constexpr double MAX_PHASE_OVER_SAMPLE_RATE = MAX_PHASE / SAMPLE_RATE;
+constexpr double PHASE_CYCLE_OVER_SAMPLE_RATE = PHASE_CYCLE / SAMPLE_RATE;
 constexpr double ONE_OVER_MAX_PHASE_X_TWO_PI = ONE_OVER_MAX_PHASE * TWO_PI;
 
 // Vocabulary types
@@ -220,17 +249,25 @@ struct Oscillator;
 using frequency_t  = float;
 using volume_t     = float;
 using pan_t        = float;
-using phase_t      = uint16_t;
+using phase_t      = uint32_t;
 using time_step_t  = size_t;
 using OscillatorId = uint8_t;
 
 // Wave tables: these need multiplying by amplitude at runtime.
-constexpr size_t TABLE_SIZE = UINT16_MAX;
+constexpr size_t TABLE_SIZE = size_t(1) << TABLE_BITS;
+
+// The wave tables are also the frames of one wavetable, in OscillatorType order
+// (sine, square, triangle, saw), which oscillators can scan across and morph between.
+constexpr size_t WAVETABLE_FRAMES = 4;
+
 struct WaveTables
 {
     // Call on startup to fill up the wave tables above.
     static void Initialize();
 
+    // Every frame, back to back, so neighbouring frames can be read together.
+    static std::array<std::array<float, TABLE_SIZE>, WAVETABLE_FRAMES>& getFrames();
+
     static std::array<float, TABLE_SIZE>& getSine();
     static std::array<float, TABLE_SIZE>& getSquare();
     static std::array<float, TABLE_SIZE>& getTriangle();
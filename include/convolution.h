@@ -0,0 +1,172 @@
+#pragma once
+
+#include "constants.h"
+#include "fft.h"
+
+#include <array>
+#include <atomic>
+#include <memory>
+#include <span>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Uniformly partitioned overlap-save convolution of one channel with one impulse
+// response. The response is cut into partitions of the block size, each zero-padded
+// to twice that and transformed once, up front. Every block of input is transformed
+// along with the block before it and goes into a frequency-domain delay line; the
+// output block is the inverse transform of the sum, over partitions, of each
+// partition's spectrum times the input spectrum that's as many blocks old.
+//
+// Setting up allocates; processing a block doesn't.
+struct UniformConvolver
+{
+    UniformConvolver(std::span<const float> impulse, size_t blockSize);
+
+    // Convolve the next blockSize frames of input into output.
+    void process(std::span<const float> input, std::span<float> output);
+
+    size_t getBlockSize() const { return m_block_size; }
+
+private:
+    size_t  m_block_size;
+    size_t  m_bins;
+    size_t  m_partitions;
+    RealFft m_fft;
+
+    // Partition p's spectrum is at p * m_bins.
+    std::vector<float> m_impulse_real;
+    std::vector<float> m_impulse_imaginary;
+
+    // Spectra of the last m_partitions input blocks; the newest is at m_newest * m_bins.
+    std::vector<float> m_delay_real;
+    std::vector<float> m_delay_imaginary;
+    size_t m_newest{ 0 };
+
+    std::vector<float> m_input;  // the last two input blocks
+    std::vector<float> m_output; // the inverse transform, whose second half is the output
+    std::vector<float> m_sum_real;
+    std::vector<float> m_sum_imaginary;
+};
+
+// Convolves the stereo output with one (mono or stereo) impulse response, with a
+// latency of HEAD_BLOCK frames. The response is split in two:
+//
+// - The head, its first TAIL_OFFSET frames, is convolved in blocks of HEAD_BLOCK on
+//   the audio thread.
+// - The tail, everything after that, is convolved in blocks of TAIL_BLOCK on a
+//   thread of its own. Every TAIL_BLOCK frames of input the audio thread hands it a
+//   block; the result isn't needed until TAIL_OFFSET - TAIL_BLOCK + HEAD_BLOCK frames
+//   later, so it has a little over a tail block's time to finish. With a buffer
+//   size bigger than that, the audio thread may have to wait for it.
+//
+// Big blocks make the long tail cheap; small ones keep the latency low. Swapping
+// responses is up to ConvolutionReverb.
+struct ImpulseResponseConvolver
+{
+    static constexpr size_t HEAD_BLOCK = 128;
+    static constexpr size_t TAIL_BLOCK = 2048;
+    static constexpr size_t TAIL_OFFSET = TAIL_BLOCK * 2;
+
+    // Responses longer than this are cut short.
+    static constexpr double MAX_SECONDS = 10.0;
+
+    // Load a response from a WAV file, resampled to SAMPLE_RATE (linearly) if it isn't
+    // already, and scaled to unit energy in its louder channel, so that long and
+    // short responses come out at about the same level. Returns null if the file
+    // can't be read.
+    static std::unique_ptr<ImpulseResponseConvolver> load(const std::string& path);
+
+    // Stops the tail thread.
+    ~ImpulseResponseConvolver();
+
+    // Add the convolved (interleaved stereo) input back into it, scaled by a gain
+    // that ramps by gainStep every frame. Call on the audio thread.
+    void process(std::span<float> inOut, float& gain, float gainStep);
+
+    double getSeconds() const { return double(m_frames) / SAMPLE_RATE; }
+    size_t getChannels() const { return m_channels; }
+
+    // Head blocks that had to wait for the tail thread.
+    uint64_t getLateBlocks() const { return m_late_blocks.load(std::memory_order_relaxed); }
+
+private:
+    // Tail blocks in flight between the threads; see processHeadBlock.
+    static constexpr size_t TAIL_SLOTS = 4;
+
+    ImpulseResponseConvolver() = default;
+
+    void processHeadBlock();
+    void runTail();
+
+    size_t m_frames{ 0 };   // of the response
+    size_t m_channels{ 0 }; // of the response
+
+    // One of each per output channel.
+    std::vector<std::unique_ptr<UniformConvolver>> m_heads;
+    std::vector<std::unique_ptr<UniformConvolver>> m_tails; // empty if the response is all head
+
+    // Audio thread: the head block being filled, and the wet block being played.
+    std::array<std::array<float, HEAD_BLOCK>, 2> m_head_input{};
+    std::array<std::array<float, HEAD_BLOCK>, 2> m_wet{};
+    size_t   m_head_fill{ 0 };
+    uint64_t m_head_blocks{ 0 }; // processed so far
+    size_t   m_tail_fill{ 0 };   // frames in the tail block being filled
+    uint64_t m_tail_blocks{ 0 }; // handed to the tail thread so far
+
+    // Tail block b's input and output are in slot b % TAIL_SLOTS, by channel.
+    std::array<std::array<std::vector<float>, 2>, TAIL_SLOTS> m_tail_input;
+    std::array<std::array<std::vector<float>, 2>, TAIL_SLOTS> m_tail_output;
+    std::atomic<uint64_t> m_tail_posted{ 0 }; // blocks handed over by the audio thread
+    std::atomic<uint64_t> m_tail_done{ 0 };   // blocks finished by the tail thread
+    std::atomic<uint64_t> m_late_blocks{ 0 };
+    std::atomic<bool> m_running{ false };
+    std::thread m_tail_thread;
+};
+
+// Convolution reverb on the master bus: the mixer runs its output through this
+// before clipping. The UI thread loads responses; the audio thread picks up a new
+// one between buffers and hands the old one back for the UI thread to free, so
+// neither ever waits for the other.
+struct ConvolutionReverb
+{
+    static ConvolutionReverb& getInstance();
+
+    ~ConvolutionReverb();
+
+    // Call on the UI thread. Returns false if the file can't be read; the current
+    // response keeps playing.
+    bool load(const std::string& path);
+
+    // Call on the UI thread. Stops convolving, once the audio thread notices.
+    void clear();
+
+    // Call on the UI thread, once a frame: frees responses the audio thread is done with.
+    void update();
+
+    // Safe from any thread. Changes ramp in over one buffer.
+    void  setWet(float wet) { m_wet.store(wet, std::memory_order_relaxed); }
+    float getWet() const    { return m_wet.load(std::memory_order_relaxed); }
+
+    // The response the UI last loaded (whether or not the audio thread has picked it
+    // up yet), or null. UI thread only.
+    const ImpulseResponseConvolver* getLoaded() const { return m_loaded; }
+
+    // Call on the audio thread.
+    void process(std::span<float> output);
+
+private:
+    ConvolutionReverb() = default;
+
+    std::atomic<float> m_wet{ 0.3f };
+    float m_processed_wet{ 0.0f }; // wet gain at the end of the last buffer; audio thread only
+
+    // Ownership moves UI -> m_pending -> audio thread (m_current) -> m_retired -> UI.
+    // The audio thread only swaps once the last retired response has been collected.
+    std::atomic<ImpulseResponseConvolver*> m_pending{ nullptr };
+    std::atomic<ImpulseResponseConvolver*> m_retired{ nullptr };
+    std::atomic<bool> m_clear_requested{ false };
+    ImpulseResponseConvolver* m_current{ nullptr };
+
+    const ImpulseResponseConvolver* m_loaded{ nullptr };
+};
@@ -0,0 +1,220 @@
+#pragma once
+
+#include "constants.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <utility>
+
+enum class EnvelopeCurve : uint8_t
+{
+    Linear,
+    Exponential
+};
+
+enum class EnvelopeStage : uint8_t
+{
+    Idle,
+    Attack,
+    Decay,
+    Sustain,
+    Release
+};
+
+// Reported once per voice when a segment that matters to the oscillator state
+// machine finishes. The oscillators use these to leave FadingIn and FadingOut*.
+enum class EnvelopeEvent : uint8_t
+{
+    None,
+    AttackEnded,
+    ReleaseEnded
+};
+
+struct EnvelopeSettings
+{
+    // The defaults roughly match the old fixed 256-sample fade in and out.
+    float         attack{ 0.006f };  // seconds
+    float         decay{ 0.0f };     // seconds
+    float         sustain{ 1.0f };   // level, out of 1.0
+    float         release{ 0.006f }; // seconds
+    EnvelopeCurve curve{ EnvelopeCurve::Linear };
+};
+
+// A bank of ADSR envelopes, one per voice, stored as structure-of-arrays.
+// Envelopes are evaluated once per control block rather than once per sample:
+// advance() computes, for every voice at once, the level at the end of the block
+// and a per-sample increment that ramps to it. Linear and exponential segments
+// share one branch-free update (target + (level - target) * coef + increment),
+// so the per-block loop over voices vectorizes. Segment changes only happen at
+// control block boundaries, in a short scalar pass over the voices that ended.
+template<size_t MAX_VOICES>
+struct Envelopes
+{
+    Envelopes()
+    {
+        for (size_t voice = 0; voice < MAX_VOICES; ++voice)
+            reset(voice);
+    }
+
+    // Start the attack from wherever the voice currently is, so retriggering
+    // a voice that's still releasing doesn't click.
+    void noteOn(size_t voice, EnvelopeSettings const& settings)
+    {
+        m_settings[voice] = settings;
+        startSegment(voice, EnvelopeStage::Attack, 1.0f, settings.attack);
+    }
+
+    void noteOff(size_t voice)
+    {
+        startSegment(voice, EnvelopeStage::Release, 0.0f, m_settings[voice].release);
+    }
+
+    void reset(size_t voice)
+    {
+        m_level[voice] = 0.0f;
+        m_start[voice] = 0.0f;
+        m_step[voice] = 0.0f;
+        m_events[voice] = EnvelopeEvent::None;
+        holdSegment(voice, EnvelopeStage::Idle, 0.0f);
+    }
+
+    // Changing settings only affects segments started from now on, with the
+    // exception of the sustain level: a sustaining voice glides to the new level.
+    void setSettings(size_t voice, EnvelopeSettings const& settings)
+    {
+        m_settings[voice] = settings;
+        if (m_stage[voice] == EnvelopeStage::Sustain)
+            startSegment(voice, EnvelopeStage::Decay, settings.sustain, settings.decay);
+    }
+
+    // Call whenever the control block length changes so full blocks can use the
+    // precomputed per-block exponential coefficient.
+    void setBlockLength(uint32_t frames)
+    {
+        m_block_length = frames;
+        for (size_t voice = 0; voice < MAX_VOICES; ++voice)
+            m_block_coef[voice] = std::pow(m_coef[voice], float(frames));
+    }
+
+    // Advance every voice by one control block of the given length. Afterwards,
+    // getRamp() describes the gain to apply across the block for each voice.
+    void advance(uint32_t frames)
+    {
+        const float framesF = float(frames);
+        const float invFrames = 1.0f / framesF;
+
+        // Only the (rare) short final block of a buffer needs a fresh pow().
+        if (frames != m_block_length)
+        {
+            for (size_t voice = 0; voice < MAX_VOICES; ++voice)
+                m_partial_coef[voice] = std::pow(m_coef[voice], framesF);
+        }
+        const auto& coefs = frames == m_block_length ? m_block_coef : m_partial_coef;
+
+        for (size_t voice = 0; voice < MAX_VOICES; ++voice)
+        {
+            const float start = m_level[voice];
+            const float target = m_target[voice];
+            const float next = target + (start - target) * coefs[voice] + m_increment[voice] * framesF;
+            m_samples_left[voice] -= int32_t(frames);
+            const float end = m_samples_left[voice] <= 0 ? target : next;
+            m_start[voice] = start;
+            m_step[voice] = (end - start) * invFrames;
+            m_level[voice] = end;
+        }
+
+        for (size_t voice = 0; voice < MAX_VOICES; ++voice)
+        {
+            if (m_samples_left[voice] <= 0)
+                enterNextStage(voice);
+        }
+    }
+
+    // The level at the start of the last advanced block, and the per-sample step.
+    __forceinline std::pair<float, float> getRamp(size_t voice) const { return { m_start[voice], m_step[voice] }; }
+
+    // Returns and clears the pending event for a voice.
+    EnvelopeEvent takeEvent(size_t voice)
+    {
+        return std::exchange(m_events[voice], EnvelopeEvent::None);
+    }
+
+    __forceinline EnvelopeStage getStage(size_t voice) const { return m_stage[voice]; }
+    __forceinline float         getLevel(size_t voice) const { return m_level[voice]; }
+
+private:
+    // Exponential segments get within e^-5 (~0.7%) of their target over the
+    // segment duration, then snap to it.
+    static constexpr float ExponentialTimeConstants{ 5.0f };
+
+    void startSegment(size_t voice, EnvelopeStage stage, float target, float seconds)
+    {
+        const int32_t samples = std::max(int32_t(seconds * SAMPLE_RATE), 1);
+        m_stage[voice] = stage;
+        m_target[voice] = target;
+        m_samples_left[voice] = samples;
+        if (m_settings[voice].curve == EnvelopeCurve::Exponential)
+        {
+            m_coef[voice] = std::exp(-ExponentialTimeConstants / float(samples));
+            m_increment[voice] = 0.0f;
+        }
+        else
+        {
+            m_coef[voice] = 1.0f;
+            m_increment[voice] = (target - m_level[voice]) / float(samples);
+        }
+        m_block_coef[voice] = std::pow(m_coef[voice], float(m_block_length));
+    }
+
+    // Hold a level indefinitely (idle and sustain).
+    void holdSegment(size_t voice, EnvelopeStage stage, float level)
+    {
+        m_stage[voice] = stage;
+        m_level[voice] = level;
+        m_target[voice] = level;
+        m_coef[voice] = 1.0f;
+        m_block_coef[voice] = 1.0f;
+        m_increment[voice] = 0.0f;
+        m_samples_left[voice] = INT32_MAX;
+    }
+
+    void enterNextStage(size_t voice)
+    {
+        switch (m_stage[voice])
+        {
+        case EnvelopeStage::Attack:
+            m_events[voice] = EnvelopeEvent::AttackEnded;
+            startSegment(voice, EnvelopeStage::Decay, m_settings[voice].sustain, m_settings[voice].decay);
+            break;
+        case EnvelopeStage::Decay:
+            holdSegment(voice, EnvelopeStage::Sustain, m_settings[voice].sustain);
+            break;
+        case EnvelopeStage::Release:
+            m_events[voice] = EnvelopeEvent::ReleaseEnded;
+            holdSegment(voice, EnvelopeStage::Idle, 0.0f);
+            break;
+        case EnvelopeStage::Sustain:
+        case EnvelopeStage::Idle:
+            m_samples_left[voice] = INT32_MAX;
+            break;
+        }
+    }
+
+    uint32_t m_block_length{ uint32_t(CONTROL_BLOCK_SIZE) };
+
+    alignas(32) std::array<float, MAX_VOICES>   m_level{};        // level at the end of the last block
+    alignas(32) std::array<float, MAX_VOICES>   m_start{};        // level at the start of the last block
+    alignas(32) std::array<float, MAX_VOICES>   m_step{};         // per-sample increment across the last block
+    alignas(32) std::array<float, MAX_VOICES>   m_target{};
+    alignas(32) std::array<float, MAX_VOICES>   m_coef{};         // per-sample exponential coefficient
+    alignas(32) std::array<float, MAX_VOICES>   m_block_coef{};   // m_coef ^ m_block_length
+    alignas(32) std::array<float, MAX_VOICES>   m_partial_coef{}; // m_coef ^ (short block length)
+    alignas(32) std::array<float, MAX_VOICES>   m_increment{};    // per-sample linear increment
+    alignas(32) std::array<int32_t, MAX_VOICES> m_samples_left{};
+
+    std::array<EnvelopeStage, MAX_VOICES>    m_stage{};
+    std::array<EnvelopeEvent, MAX_VOICES>    m_events{};
+    std::array<EnvelopeSettings, MAX_VOICES> m_settings{};
+};
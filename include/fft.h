@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstddef>
+#include <span>
+#include <vector>
+
+// A radix-2 FFT of real input (and its inverse), for analysis off the realtime thread. A real
+// transform of N points runs as a complex transform of N/2 points (even samples
+// as the real part, odd samples as the imaginary part) followed by a split step.
+// Data is kept as separate real and imaginary arrays so the butterflies run four
+// at a time with SSE. Everything is allocated up front; transforms don't allocate.
+struct RealFft
+{
+    // The size must be a power of two, at least 16.
+    explicit RealFft(size_t size);
+
+    // Transform size real values into size / 2 + 1 bins, from DC to Nyquist.
+    void forward(std::span<const float> input, std::span<float> real, std::span<float> imaginary);
+
+    // Transform size / 2 + 1 bins back into size real values, scaled so that
+    // inverse(forward(x)) is x again.
+    void inverse(std::span<const float> real, std::span<const float> imaginary, std::span<float> output);
+
+    size_t getSize() const { return m_size; }
+
+private:
+    void transformHalf(); // in place, on m_real and m_imaginary
+
+    size_t m_size;
+    size_t m_half;
+
+    std::vector<float>  m_real;
+    std::vector<float>  m_imaginary;
+    std::vector<size_t> m_bit_reverse;
+
+    // Per-stage twiddles, each stage's run contiguous so a butterfly group loads four at once.
+    std::vector<float> m_twiddle_real;
+    std::vector<float> m_twiddle_imaginary;
+
+    // Twiddles for the split step, e^(-2 pi i k / size).
+    std::vector<float> m_split_real;
+    std::vector<float> m_split_imaginary;
+};
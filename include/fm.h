@@ -0,0 +1,215 @@
+#pragma once
+
+#include "modulation.h"
+#include "oscillator.h"
+
+#include <algorithm>
+#include <array>
+#include <optional>
+#include <span>
+
+constexpr size_t MAX_FM_OPERATORS = 4;
+constexpr size_t MAX_FM_GROUPS = 4;
+
+// A DX-style algorithm: which operators modulate which, and which are heard.
+// Operator k may only be modulated by operators after it (k+1 and up), so the
+// operators can always be evaluated from last to first. The last operator can
+// additionally modulate itself through the group's feedback amount.
+struct FmAlgorithm
+{
+    const char* name;
+    std::array<uint8_t, MAX_FM_OPERATORS> modulators; // bitmask of operators modulating each operator
+    uint8_t carriers;                                 // bitmask of operators mixed into the output
+};
+
+// The classic four-operator layouts, from a single stack to fully additive.
+constexpr std::array<FmAlgorithm, 8> FM_ALGORITHMS =
+{{
+    { "4>3>2>1",       { 0b0010, 0b0100, 0b1000, 0b0000 }, 0b0001 },
+    { "(3+4)>2>1",     { 0b0010, 0b1100, 0b0000, 0b0000 }, 0b0001 },
+    { "(4+(3>2))>1",   { 0b1010, 0b0100, 0b0000, 0b0000 }, 0b0001 },
+    { "((4>3)+2)>1",   { 0b0110, 0b0000, 0b1000, 0b0000 }, 0b0001 },
+    { "2>1, 4>3",      { 0b0010, 0b0000, 0b1000, 0b0000 }, 0b0101 },
+    { "4>(1, 2, 3)",   { 0b1000, 0b1000, 0b1000, 0b0000 }, 0b0111 },
+    { "1, 2, 4>3",     { 0b0000, 0b0000, 0b1000, 0b0000 }, 0b0111 },
+    { "1, 2, 3, 4",    { 0b0000, 0b0000, 0b0000, 0b0000 }, 0b1111 },
+}};
+
+// An FM group binds oscillators from the bank to the operator slots of an
+// algorithm. Each operator keeps its oscillator's frequency, volume, envelope,
+// wave type, and modulation routes; a modulator's output level sets how far it
+// pushes the phase of the operators it modulates.
+struct FmGroupSettings
+{
+    bool                                                  enabled{ false };
+    uint8_t                                               algorithm{ 0 };
+    std::array<std::optional<OscillatorId>, MAX_FM_OPERATORS> operators{};
+    float                                                 depth{ 1.0f };    // phase offset, in cycles, of a full-scale modulator
+    float                                                 feedback{ 0.0f }; // self-modulation of the last operator, in cycles
+};
+
+// Renders FM groups at audio rate. Within a control block, every operator is
+// rendered for the whole block before moving on to the next operator
+// (operator-major order), so each operator's inner loop is a straight run over
+// contiguous buffers: sum the modulator outputs, offset the 32-bit phase, look up.
+template<size_t MAX_OSCILLATORS>
+struct FmEngine
+{
+    // Returns false if the group refers to an algorithm or oscillator that can't exist,
+    // or (when enabled) uses an oscillator twice, or one an enabled group already has:
+    // an operator is rendered, and its phase advanced, once per group slot it fills.
+    bool setGroup(size_t group, FmGroupSettings const& settings)
+    {
+        if (group >= MAX_FM_GROUPS || settings.algorithm >= FM_ALGORITHMS.size())
+            return false;
+
+        for (size_t op = 0; op < MAX_FM_OPERATORS; ++op)
+        {
+            const auto& id = settings.operators[op];
+            if (!id.has_value())
+                continue;
+            if (*id >= MAX_OSCILLATORS)
+                return false;
+            if (!settings.enabled)
+                continue;
+
+            for (size_t other = 0; other < op; ++other)
+            {
+                if (settings.operators[other] == id)
+                    return false;
+            }
+            for (size_t otherGroup = 0; otherGroup < MAX_FM_GROUPS; ++otherGroup)
+            {
+                if (otherGroup == group || !m_groups[otherGroup].enabled)
+                    continue;
+                const auto& others = m_groups[otherGroup].operators;
+                if (std::find(others.begin(), others.end(), id) != others.end())
+                    return false;
+            }
+        }
+
+        m_groups[group] = settings;
+        m_feedback_history[group] = {};
+
+        // Operators are rendered by their group instead of as plain oscillators.
+        m_is_operator = {};
+        for (auto const& groupSettings : m_groups)
+        {
+            if (!groupSettings.enabled)
+                continue;
+
+            for (auto const& op : groupSettings.operators)
+            {
+                if (op.has_value())
+                    m_is_operator[*op] = true;
+            }
+        }
+        return true;
+    }
+
+    __forceinline bool isOperator(OscillatorId id) const { return m_is_operator[id]; }
+
+    FmGroupSettings const& getGroup(size_t group) const { return m_groups[group]; }
+
+    // Mix every enabled group into the (interleaved stereo) output block.
+    void render(std::span<float> output, Oscillators<MAX_OSCILLATORS>& oscillators, ModulationMatrix<MAX_OSCILLATORS> const& modulation)
+    {
+        for (size_t group = 0; group < MAX_FM_GROUPS; ++group)
+        {
+            if (m_groups[group].enabled)
+                renderGroup(group, output, oscillators, modulation);
+        }
+    }
+
+private:
+    void renderGroup(size_t group, std::span<float> output, Oscillators<MAX_OSCILLATORS>& oscillators,
+                     ModulationMatrix<MAX_OSCILLATORS> const& modulation)
+    {
+        FmGroupSettings const& settings = m_groups[group];
+        FmAlgorithm const& algorithm = FM_ALGORITHMS[settings.algorithm];
+        auto& envelopes = oscillators.getEnvelopes();
+        const size_t frames = output.size() / 2;
+
+        for (size_t op = MAX_FM_OPERATORS; op-- > 0;)
+        {
+            float* const opOutput = m_operator_output[op].data();
+
+            // Gather this operator's phase modulation from operators already rendered.
+            float* const phaseInput = m_phase_input.data();
+            std::fill_n(phaseInput, frames, 0.0f);
+            for (size_t modulator = op + 1; modulator < MAX_FM_OPERATORS; ++modulator)
+            {
+                if ((algorithm.modulators[op] & (1u << modulator)) == 0)
+                    continue;
+
+                const float* const modulatorOutput = m_operator_output[modulator].data();
+                for (size_t frame = 0; frame < frames; ++frame)
+                    phaseInput[frame] += modulatorOutput[frame];
+            }
+
+            if (!settings.operators[op].has_value() || !oscillators.at(*settings.operators[op]).isActive())
+            {
+                std::fill_n(opOutput, frames, 0.0f);
+                continue;
+            }
+
+            const OscillatorId id = *settings.operators[op];
+            Oscillator& oscillator = oscillators.at(id);
+            auto [envelopeLevel, envelopeStep] = envelopes.getRamp(id);
+            ModulationRamps ramps = modulation.getRamps(id);
+
+            // An operator resting on a wavetable frame reads just that frame.
+            const bool morphing = !oscillator.isOnWavetableFrame() || ramps.movesWavetable();
+            const auto& table = WaveTables::getFrames()[size_t(oscillator.getWavetablePosition())];
+
+            // Only the last operator has feedback; it averages its last two
+            // outputs, which tames the worst of feedback's tendency to go noisy.
+            const bool isFeedbackOperator = op == MAX_FM_OPERATORS - 1;
+            const float feedback = isFeedbackOperator ? settings.feedback : 0.0f;
+            auto& history = m_feedback_history[group];
+
+            for (size_t frame = 0; frame < frames; ++frame)
+            {
+                const float cycles = phaseInput[frame] * settings.depth + (history[0] + history[1]) * 0.5f * feedback;
+
+                const phase_t offset = phase_t(int64_t(double(cycles) * PHASE_CYCLE));
+                const phase_t phase = oscillator.updatePhaseAccumulator(ramps.pitch) + offset;
+                const volume_t volume = oscillator.updateVolume() * envelopeLevel * ramps.volume;
+                const size_t index = phase >> PHASE_FRACTION_BITS;
+                const float value = (morphing ? getWavetableFrames(oscillator.updateWavetablePosition(ramps.position)).read(index)
+                                              : table[index]) * volume;
+                opOutput[frame] = value;
+                if (isFeedbackOperator)
+                {
+                    history[1] = history[0];
+                    history[0] = value;
+                }
+
+                envelopeLevel += envelopeStep;
+                ramps.volume  += ramps.volumeStep;
+                ramps.pitch   += ramps.pitchStep;
+                ramps.position += ramps.positionStep;
+            }
+
+            if ((algorithm.carriers & (1u << op)) == 0)
+                continue;
+
+            for (size_t frame = 0; frame < frames; ++frame)
+            {
+                const auto [leftPan, rightPan] = oscillator.updatePan();
+                output[frame * 2]     += opOutput[frame] * leftPan * ramps.leftPan;   // left channel
+                output[frame * 2 + 1] += opOutput[frame] * rightPan * ramps.rightPan; // right channel
+                ramps.leftPan  += ramps.leftPanStep;
+                ramps.rightPan += ramps.rightPanStep;
+            }
+        }
+    }
+
+    std::array<FmGroupSettings, MAX_FM_GROUPS> m_groups{};
+    std::array<std::array<float, 2>, MAX_FM_GROUPS> m_feedback_history{};
+    std::array<bool, MAX_OSCILLATORS> m_is_operator{};
+
+    // Scratch buffers for one control block.
+    alignas(32) std::array<std::array<float, MAX_CONTROL_BLOCK_SIZE>, MAX_FM_OPERATORS> m_operator_output{};
+    alignas(32) std::array<float, MAX_CONTROL_BLOCK_SIZE> m_phase_input{};
+};
@@ -1,66 +1,483 @@
 #pragma once
 
+#include <algorithm>
+#include <atomic>
+#include <limits>
+#include <memory>
 #include <span>
+#include <utility>
 
+#include "fm.h"
+#include "granular.h"
+#include "midi.h"
+#include "modulation.h"
 #include "oscillator.h"
-#include "util.h"
+#include "resynthesis.h"
+#include "sample_voice.h"
+#include "tracing.h"
+#include "triple_buffer.h"
+
+// For renderSamples callers with no events of their own to schedule.
+struct NoScheduledEvents
+{
+    void   dispatchDueEvents(uint64_t /*sampleTime*/) { }
+    size_t framesUntilNextEvent(uint64_t /*sampleTime*/) const { return std::numeric_limits<size_t>::max(); }
+};
+
+// Switching oscillator banks (presets) crossfades over this many frames.
+constexpr size_t OSCILLATOR_BANK_CROSSFADE_FRAMES = 1024;
+
+// What one oscillator is doing right now, as the realtime thread sees it.
+struct VoiceSnapshot
+{
+    OscillatorState state{ OscillatorState::Uninitialized };
+    OscillatorType  type{ OscillatorType::Sine };
+    EnvelopeStage   envelopeStage{ EnvelopeStage::Idle };
+    frequency_t     frequency{ 0 };
+    volume_t        volume{ 0 };        // mid-fade after a volume change, this is the current value
+    pan_t           pan{ 0 };
+    float           envelopeLevel{ 0 }; // at the end of the last control block
+    phase_t         phase{ 0 };         // the phase accumulator at phaseTime
+    uint64_t        phaseTime{ 0 };     // sample time of the last frame rendered
+};
+
+// Every voice of a generator, published after each control block for the UI to
+// read. This is how the UI sees what changes on the realtime side on its own:
+// fades, envelopes, MIDI voices, and oscillators finishing their release.
+template<size_t MAX_OSCILLATORS>
+struct GeneratorSnapshot
+{
+    uint64_t sampleTime{ 0 }; // frames rendered when the snapshot was taken
+    std::array<VoiceSnapshot, MAX_OSCILLATORS> voices{};
+    size_t grains{ 0 };       // granular grains playing
+    size_t partials{ 0 };     // resynthesis partials sounding
+};
 
 template<size_t MAX_OSCILLATORS = 8>
 struct Generator
 {
-    void writeSamples(std::span<float> outputView)
+    using OscillatorBank = Oscillators<MAX_OSCILLATORS>;
+
+    // Events are anything with dispatchDueEvents(sampleTime) and framesUntilNextEvent(sampleTime);
+    // they're applied between control blocks, and a block ends early wherever one is due.
+    // There's no saturation here; that's the mixer's stage (see GeneratorMixer).
+    template<class Events = NoScheduledEvents>
+    void renderSamples(std::span<float> outputView, Events&& events = {})
     {
+        Tracing::Span span("Generator::renderSamples");
+
         // Zero out the buffer before adding any sample values.
         for (float& sample : outputView)
             sample = 0.0f;
 
-        for (Oscillator& oscillator : m_oscillators)
+        // Render in control blocks so envelopes and modulation only need evaluating once per block.
+        // A block ends early if an event or MIDI event is due inside it, so it lands on its exact sample.
+        const size_t frameCount = outputView.size() / 2;
+        uint64_t sampleTime = m_sample_time.load(std::memory_order_relaxed);
+        for (size_t frame = 0; frame < frameCount;)
+        {
+            events.dispatchDueEvents(sampleTime);
+            m_midi.dispatchDueEvents(*m_oscillators);
+            const size_t blockFrames = std::min({ m_control_block_size, frameCount - frame,
+                                                  events.framesUntilNextEvent(sampleTime), m_midi.framesUntilNextEvent() });
+            renderControlBlock(outputView.subspan(frame * 2, blockFrames * 2));
+            m_midi.advance(blockFrames);
+            frame += blockFrames;
+            sampleTime += blockFrames;
+            publishSnapshot(sampleTime);
+        }
+        m_sample_time.store(sampleTime, std::memory_order_relaxed);
+    }
+
+    __forceinline OscillatorBank& getOscillators() { return *m_oscillators; }
+    __forceinline ModulationMatrix<MAX_OSCILLATORS>& getModulation() { return m_modulation; }
+    __forceinline FmEngine<MAX_OSCILLATORS>& getFm() { return m_fm; }
+    __forceinline GranularEngine& getGranular() { return m_granular; }
+    __forceinline ResynthesisPlayer& getResynthesis() { return m_resynthesis; }
+    __forceinline std::array<SampleVoice, MAX_SAMPLE_VOICES>& getSamples() { return m_samples; }
+    __forceinline MidiScheduler<MAX_OSCILLATORS>& getMidi() { return m_midi; }
+
+    // Set how many frames pass between evaluations of control-rate values.
+    // Returns false if the size is out of range.
+    bool setControlBlockSize(size_t frames)
+    {
+        if (frames == 0 || frames > MAX_CONTROL_BLOCK_SIZE)
+            return false;
+
+        m_control_block_size = frames;
+        m_oscillators->getEnvelopes().setBlockLength(uint32_t(frames));
+        if (m_previous_oscillators)
+            m_previous_oscillators->getEnvelopes().setBlockLength(uint32_t(frames));
+        return true;
+    }
+
+    size_t getControlBlockSize() const { return m_control_block_size; }
+
+    // Seeds the oscillators added from now on (see Oscillators::setSeed); build
+    // preset banks for this generator with the same seed.
+    void     setSeed(uint32_t seed) { m_seed = seed; m_oscillators->setSeed(seed); }
+    uint32_t getSeed() const        { return m_seed; }
+
+    static constexpr size_t getMaxOscillators() { return MAX_OSCILLATORS; }
+
+    // Swap in a complete bank of oscillators, built off the realtime thread, and
+    // crossfade to it from the current one. Notes the MIDI scheduler was playing
+    // are released in the old bank. Returns a bank that was dropped mid-crossfade,
+    // if any; like every bank that leaves the generator, it has to be freed on a
+    // non-realtime thread.
+    std::unique_ptr<OscillatorBank> installOscillators(std::unique_ptr<OscillatorBank> bank)
+    {
+        m_midi.releaseNotes(*m_oscillators);
+        bank->getEnvelopes().setBlockLength(uint32_t(m_control_block_size));
+        bank->setSeed(m_seed);
+
+        std::unique_ptr<OscillatorBank> dropped = std::move(m_previous_oscillators);
+        m_previous_oscillators = std::move(m_oscillators);
+        m_oscillators = std::move(bank);
+        m_crossfade_position = 0;
+        return dropped;
+    }
+
+    // A bank that finished crossfading out, if there is one. Free it off the realtime thread.
+    std::unique_ptr<OscillatorBank> takeRetiredOscillators() { return std::move(m_retired_oscillators); }
+
+    // Frames rendered so far. Safe to read from any thread; use it to time requests.
+    uint64_t getSampleTime() const { return m_sample_time.load(std::memory_order_relaxed); }
+
+    // The UI thread is the (one) reader: update() it, then read() the latest snapshot.
+    __forceinline TripleBuffer<GeneratorSnapshot<MAX_OSCILLATORS>>& getSnapshots() { return m_snapshots; }
+
+private:
+    // Only the current bank is captured; one fading out after a preset swap is on its way out.
+    void publishSnapshot(uint64_t sampleTime)
+    {
+        auto& snapshot = m_snapshots.getWriteBuffer();
+        snapshot.sampleTime = sampleTime;
+
+        auto& envelopes = m_oscillators->getEnvelopes();
+        for (OscillatorId id = 0; id < MAX_OSCILLATORS; ++id)
+        {
+            const Oscillator& oscillator = m_oscillators->at(id);
+            VoiceSnapshot& voice = snapshot.voices[id];
+            voice.state = oscillator.getState();
+            voice.type = oscillator.getType();
+            voice.envelopeStage = envelopes.getStage(id);
+            voice.frequency = oscillator.getFrequency();
+            voice.volume = oscillator.getVolume();
+            voice.pan = oscillator.getPan();
+            voice.envelopeLevel = envelopes.getLevel(id);
+            voice.phase = oscillator.getPhase();
+            voice.phaseTime = sampleTime - 1; // only published after a block, so never before the first frame
+        }
+        snapshot.grains = m_granular.getGrainCount();
+        snapshot.partials = m_resynthesis.getPartialCount();
+        m_snapshots.publish();
+    }
+
+    void renderControlBlock(std::span<float> output)
+    {
+        const uint32_t frames = uint32_t(output.size() / 2);
+        m_modulation.tick(frames);
+
+        if (m_previous_oscillators)
+            renderCrossfade(output);
+        else
+            renderOscillators(*m_oscillators, output);
+
+        for (auto& voice : m_samples)
+            voice.render(output);
+
+        m_granular.render(output);
+        m_resynthesis.render(output);
+    }
+
+    // Everything a bank contributes to a block: plain oscillators, then FM groups.
+    void renderOscillators(OscillatorBank& bank, std::span<float> output)
+    {
+        auto& envelopes = bank.getEnvelopes();
+        envelopes.advance(uint32_t(output.size() / 2));
+        findSyncWraps(bank, output.size() / 2);
+
+        for (OscillatorId id = 0; id < MAX_OSCILLATORS; ++id)
         {
-            if (!oscillator.isActive()) continue;
+            Oscillator& oscillator = bank.at(id);
+            if (!oscillator.isActive() || m_fm.isOperator(id)) continue;
+
+            // Write all samples in the block for a given oscillator at once.
+            const auto [envelopeLevel, envelopeStep] = envelopes.getRamp(id);
+            const ModulationRamps& modulation = m_modulation.getRamps(id);
+            if (isNoise(oscillator.getType()))
+            {
+                generateNoiseValues(output, oscillator, envelopeLevel, envelopeStep, modulation);
+                continue;
+            }
 
-            // Write all samples for a given oscillator at once.
-            switch (oscillator.getType())
+            const bool unison = oscillator.getUnison().voices > 1;
+            if (followsSyncMaster(bank, oscillator) && !unison)
             {
-                case OscillatorType::Sine:
-                    generateOscillatorValues(outputView, oscillator, WaveTables::getSine());
-                    continue;
-                case OscillatorType::Square:
-                    generateOscillatorValues(outputView, oscillator, WaveTables::getSquare());
-                    continue;
-                case OscillatorType::Triangle:
-                    generateOscillatorValues(outputView, oscillator, WaveTables::getTriangle());
-                    continue;
-                case OscillatorType::Saw:
-                    generateOscillatorValues(outputView, oscillator, WaveTables::getSaw());
-                    continue;
-                default:
-                    assert(false); // Unknown oscillator type!
-                    break;
+                generateSyncedValues(output, oscillator, m_sync_wraps[oscillator.getSyncMaster()], envelopeLevel, envelopeStep, modulation);
+                continue;
             }
+
+            if (!oscillator.isOnWavetableFrame() || modulation.movesWavetable())
+            {
+                if (unison)
+                    generateMorphingUnisonValues(output, oscillator, envelopeLevel, envelopeStep, modulation);
+                else
+                    generateMorphingValues(output, oscillator, envelopeLevel, envelopeStep, modulation);
+                continue;
+            }
+
+            const auto& table = WaveTables::getFrames()[size_t(oscillator.getWavetablePosition())];
+            if (unison)
+                generateUnisonValues(output, oscillator, table, envelopeLevel, envelopeStep, modulation);
+            else
+                generateOscillatorValues(output, oscillator, table, envelopeLevel, envelopeStep, modulation);
         }
-        
-        // Hard clipping - useful for saving ears during testing.
-        for (float& sample : outputView)
+
+        m_fm.render(output, bank, m_modulation);
+
+        // Only now that the block is rendered may finished envelopes retire their oscillators.
+        bank.handleEnvelopeEvents();
+    }
+
+    // Render the incoming and outgoing banks side by side and mix them with
+    // complementary linear ramps. Once the ramp is done, the old bank retires.
+    void renderCrossfade(std::span<float> output)
+    {
+        const std::span<float> incoming = std::span(m_crossfade_incoming).first(output.size());
+        const std::span<float> outgoing = std::span(m_crossfade_outgoing).first(output.size());
+        std::fill(incoming.begin(), incoming.end(), 0.0f);
+        std::fill(outgoing.begin(), outgoing.end(), 0.0f);
+        renderOscillators(*m_oscillators, incoming);
+        renderOscillators(*m_previous_oscillators, outgoing);
+
+        constexpr float fadeStep = 1.0f / float(OSCILLATOR_BANK_CROSSFADE_FRAMES);
+        float fade = std::min(float(m_crossfade_position) * fadeStep, 1.0f);
+        for (size_t index = 0; index < output.size(); index += 2)
         {
-            sample = std::min(sample, 1.0f);
-            sample = std::max(sample, -1.0f);
+            output[index]     += incoming[index] * fade + outgoing[index] * (1.0f - fade);
+            output[index + 1] += incoming[index + 1] * fade + outgoing[index + 1] * (1.0f - fade);
+            fade = std::min(fade + fadeStep, 1.0f);
         }
+
+        // Hold on to the old bank (silently) if the last one to retire hasn't been collected yet.
+        m_crossfade_position += output.size() / 2;
+        if (m_crossfade_position >= OSCILLATOR_BANK_CROSSFADE_FRAMES && !m_retired_oscillators)
+            m_retired_oscillators = std::move(m_previous_oscillators);
     }
 
-    __forceinline Oscillators<MAX_OSCILLATORS>& getOscillators() { return m_oscillators; }
+    void generateOscillatorValues(std::span<float>& output, Oscillator& oscillator, const std::array<float, TABLE_SIZE>& table,
+                                  float envelopeLevel, float envelopeStep, ModulationRamps modulation)
+    {
+        for (size_t index = 0; index < output.size(); index += 2)
+        {
+            const auto [leftPan, rightPan] = oscillator.updatePan();
+            const size_t phase = oscillator.updatePhase(modulation.pitch);
+            const volume_t volume = oscillator.updateVolume() * envelopeLevel * modulation.volume;
+            output[index]     += table[phase] * volume * leftPan * modulation.leftPan;   // left channel
+            output[index + 1] += table[phase] * volume * rightPan * modulation.rightPan; // right channel
 
-private:
-    void generateOscillatorValues(std::span<float>& output, Oscillator& oscillator, const std::array<float, TABLE_SIZE>& table)
+            envelopeLevel       += envelopeStep;
+            modulation.volume   += modulation.volumeStep;
+            modulation.leftPan  += modulation.leftPanStep;
+            modulation.rightPan += modulation.rightPanStep;
+            modulation.pitch    += modulation.pitchStep;
+        }
+    }
+
+    // Noise is generated for the whole block first, then shaped like any other voice.
+    // Pitch doesn't apply; neither do unison, sync, or the wavetable.
+    void generateNoiseValues(std::span<float>& output, Oscillator& oscillator,
+                             float envelopeLevel, float envelopeStep, ModulationRamps modulation)
+    {
+        const std::span<float> noise = std::span(m_noise).first(output.size() / 2);
+        oscillator.generateNoise(noise);
+        for (size_t index = 0, frame = 0; index < output.size(); index += 2, ++frame)
+        {
+            const auto [leftPan, rightPan] = oscillator.updatePan();
+            const volume_t volume = oscillator.updateVolume() * envelopeLevel * modulation.volume;
+            output[index]     += noise[frame] * volume * leftPan * modulation.leftPan;   // left channel
+            output[index + 1] += noise[frame] * volume * rightPan * modulation.rightPan; // right channel
+
+            envelopeLevel       += envelopeStep;
+            modulation.volume   += modulation.volumeStep;
+            modulation.leftPan  += modulation.leftPanStep;
+            modulation.rightPan += modulation.rightPanStep;
+        }
+    }
+
+    // Whether an oscillator is synced to a master that's free-running itself.
+    // Oscillators::setSyncMaster won't chain sync or sync to noise, but a master can
+    // still change type to noise afterwards; its followers play free until it changes
+    // back. FM operators are skipped before this is asked, so they ignore sync while
+    // in a group.
+    static __forceinline bool followsSyncMaster(OscillatorBank& bank, const Oscillator& oscillator)
+    {
+        const OscillatorId master = oscillator.getSyncMaster();
+        return master != NO_SYNC_MASTER && bank.at(master).getSyncMaster() == NO_SYNC_MASTER &&
+               !isNoise(bank.at(master).getType());
+    }
+
+    // Where each oscillator that others are synced to wraps in this block. Done once
+    // per master, up front, however many oscillators follow it.
+    void findSyncWraps(OscillatorBank& bank, size_t frames)
+    {
+        std::array<bool, MAX_OSCILLATORS> isMaster{};
+        for (auto it = bank.cbegin(); it != bank.cend(); ++it)
+        {
+            if (it->isActive() && followsSyncMaster(bank, *it))
+                isMaster[it->getSyncMaster()] = true;
+        }
+
+        for (OscillatorId id = 0; id < MAX_OSCILLATORS; ++id)
+        {
+            if (!isMaster[id])
+                continue;
+
+            const std::span<float> wraps = std::span(m_sync_wraps[id]).first(frames);
+            const Oscillator& master = bank.at(id);
+            const ModulationRamps& modulation = m_modulation.getRamps(id);
+            if (master.isActive())
+                master.findWraps(wraps, modulation.pitch, modulation.pitchStep);
+            else
+                std::fill(wraps.begin(), wraps.end(), -1.0f);
+        }
+    }
+
+    // A synced oscillator restarts its cycle wherever its master's wraps, at the exact
+    // moment between samples. The jump that leaves in the wave is smoothed with a
+    // polyBLEP over the samples either side of it. At the start of a block the sample
+    // before is already written out, so only the half after is corrected there.
+    // Unison voices aren't synced; they fall back to the plain paths.
+    void generateSyncedValues(std::span<float>& output, Oscillator& oscillator, const std::array<float, MAX_CONTROL_BLOCK_SIZE>& wraps,
+                              float envelopeLevel, float envelopeStep, ModulationRamps modulation)
+    {
+        float previousLeftGain = 0.0f;
+        float previousRightGain = 0.0f;
+        for (size_t index = 0, frame = 0; index < output.size(); index += 2, ++frame)
+        {
+            const auto [leftPan, rightPan] = oscillator.updatePan();
+            const WavetableFrames frames = getWavetableFrames(oscillator.updateWavetablePosition(modulation.position));
+            const float sinceWrap = wraps[frame];
+            phase_t resetFrom = 0;
+            float value = frames.read(oscillator.updateSyncedPhase(sinceWrap, resetFrom, modulation.pitch));
+            const volume_t volume = oscillator.updateVolume() * envelopeLevel * modulation.volume;
+            const float leftGain = volume * leftPan * modulation.leftPan;
+            const float rightGain = volume * rightPan * modulation.rightPan;
+
+            if (sinceWrap >= 0.0f)
+            {
+                const float halfJump = (frames.read(0) - frames.read(resetFrom >> PHASE_FRACTION_BITS)) * 0.5f;
+                value += halfJump * (sinceWrap * (2.0f - sinceWrap) - 1.0f);
+                if (index > 0)
+                {
+                    const float before = halfJump * sinceWrap * sinceWrap;
+                    output[index - 2] += before * previousLeftGain;
+                    output[index - 1] += before * previousRightGain;
+                }
+            }
+            output[index]     += value * leftGain;  // left channel
+            output[index + 1] += value * rightGain; // right channel
+            previousLeftGain = leftGain;
+            previousRightGain = rightGain;
+
+            envelopeLevel       += envelopeStep;
+            modulation.volume   += modulation.volumeStep;
+            modulation.leftPan  += modulation.leftPanStep;
+            modulation.rightPan += modulation.rightPanStep;
+            modulation.pitch    += modulation.pitchStep;
+            modulation.position += modulation.positionStep;
+        }
+    }
+
+    // An oscillator between wavetable frames, or moving across them, reads two
+    // neighbouring frames per sample and mixes them.
+    void generateMorphingValues(std::span<float>& output, Oscillator& oscillator,
+                                float envelopeLevel, float envelopeStep, ModulationRamps modulation)
     {
         for (size_t index = 0; index < output.size(); index += 2)
         {
             const auto [leftPan, rightPan] = oscillator.updatePan();
-            const phase_t phase = oscillator.updatePhase();
-            const volume_t volume = oscillator.updateVolume();
-            output[index]     += table[phase] * volume * leftPan;  // left channel
-            output[index + 1] += table[phase] * volume * rightPan; // right channel
+            const WavetableFrames frames = getWavetableFrames(oscillator.updateWavetablePosition(modulation.position));
+            const float value = frames.read(oscillator.updatePhase(modulation.pitch));
+            const volume_t volume = oscillator.updateVolume() * envelopeLevel * modulation.volume;
+            output[index]     += value * volume * leftPan * modulation.leftPan;   // left channel
+            output[index + 1] += value * volume * rightPan * modulation.rightPan; // right channel
+
+            envelopeLevel       += envelopeStep;
+            modulation.volume   += modulation.volumeStep;
+            modulation.leftPan  += modulation.leftPanStep;
+            modulation.rightPan += modulation.rightPanStep;
+            modulation.pitch    += modulation.pitchStep;
+            modulation.position += modulation.positionStep;
         }
     }
 
-    Oscillators<MAX_OSCILLATORS> m_oscillators;
+    // All unison voices of an oscillator are rendered together, lane by lane, and share
+    // the oscillator's volume, envelope, pan, and modulation.
+    void generateUnisonValues(std::span<float>& output, Oscillator& oscillator, const std::array<float, TABLE_SIZE>& table,
+                              float envelopeLevel, float envelopeStep, ModulationRamps modulation)
+    {
+        for (size_t index = 0; index < output.size(); index += 2)
+        {
+            const auto [leftPan, rightPan] = oscillator.updatePan();
+            const auto [left, right] = oscillator.updateUnison(table, modulation.pitch);
+            const volume_t volume = oscillator.updateVolume() * envelopeLevel * modulation.volume;
+            output[index]     += left * volume * leftPan * modulation.leftPan;    // left channel
+            output[index + 1] += right * volume * rightPan * modulation.rightPan; // right channel
+
+            envelopeLevel       += envelopeStep;
+            modulation.volume   += modulation.volumeStep;
+            modulation.leftPan  += modulation.leftPanStep;
+            modulation.rightPan += modulation.rightPanStep;
+            modulation.pitch    += modulation.pitchStep;
+        }
+    }
+
+    void generateMorphingUnisonValues(std::span<float>& output, Oscillator& oscillator,
+                                      float envelopeLevel, float envelopeStep, ModulationRamps modulation)
+    {
+        for (size_t index = 0; index < output.size(); index += 2)
+        {
+            const auto [leftPan, rightPan] = oscillator.updatePan();
+            const WavetableFrames frames = getWavetableFrames(oscillator.updateWavetablePosition(modulation.position));
+            const auto [left, right] = oscillator.updateUnison(frames, modulation.pitch);
+            const volume_t volume = oscillator.updateVolume() * envelopeLevel * modulation.volume;
+            output[index]     += left * volume * leftPan * modulation.leftPan;    // left channel
+            output[index + 1] += right * volume * rightPan * modulation.rightPan; // right channel
+
+            envelopeLevel       += envelopeStep;
+            modulation.volume   += modulation.volumeStep;
+            modulation.leftPan  += modulation.leftPanStep;
+            modulation.rightPan += modulation.rightPanStep;
+            modulation.pitch    += modulation.pitchStep;
+            modulation.position += modulation.positionStep;
+        }
+    }
+
+    // Banks are swapped by pointer; see installOscillators.
+    std::unique_ptr<OscillatorBank> m_oscillators{ std::make_unique<OscillatorBank>() };
+    std::unique_ptr<OscillatorBank> m_previous_oscillators;
+    std::unique_ptr<OscillatorBank> m_retired_oscillators;
+    size_t m_crossfade_position{ 0 };
+    uint32_t m_seed{ 0 };
+    alignas(32) std::array<float, MAX_CONTROL_BLOCK_SIZE * 2> m_crossfade_incoming{};
+    alignas(32) std::array<float, MAX_CONTROL_BLOCK_SIZE * 2> m_crossfade_outgoing{};
+
+    // Noise scratch for one oscillator and one control block.
+    alignas(32) std::array<float, MAX_CONTROL_BLOCK_SIZE> m_noise{};
+
+    // Hard sync scratch for one control block; see findSyncWraps.
+    alignas(32) std::array<std::array<float, MAX_CONTROL_BLOCK_SIZE>, MAX_OSCILLATORS> m_sync_wraps{};
+
+    ModulationMatrix<MAX_OSCILLATORS> m_modulation;
+    FmEngine<MAX_OSCILLATORS> m_fm;
+    GranularEngine m_granular;
+    ResynthesisPlayer m_resynthesis;
+    std::array<SampleVoice, MAX_SAMPLE_VOICES> m_samples{};
+    MidiScheduler<MAX_OSCILLATORS> m_midi;
+    size_t m_control_block_size{ CONTROL_BLOCK_SIZE };
+    std::atomic<uint64_t> m_sample_time{ 0 };
+    TripleBuffer<GeneratorSnapshot<MAX_OSCILLATORS>> m_snapshots;
 };
@@ -0,0 +1,82 @@
+#pragma once
+
+#include "constants.h"
+#include "saturation.h"
+
+#include <array>
+#include <atomic>
+#include <span>
+#include <thread>
+#include <vector>
+
+// Mixes every generator into the audio output. The audio callback renders the
+// first generator itself while one worker thread per remaining generator renders
+// the others in parallel; then the callback sums them with per-generator gain and
+// runs the sum through the master bus reverb (see ConvolutionReverb) and the
+// saturation stage (see Saturator).
+// A generator is only ever rendered on its own thread, so it keeps talking to the
+// UI through its own queues exactly as if it were alone.
+struct GeneratorMixer
+{
+    static GeneratorMixer& getInstance();
+
+    // Start and stop the worker threads. Call these while the audio stream isn't
+    // running; with no workers, the callback renders every generator itself.
+    void start();
+    void stop();
+
+    // Call on the audio callback's thread.
+    void writeSamples(std::span<float> output);
+
+    // Safe from any thread. Changes ramp in over one buffer.
+    void  setGain(size_t generator, float gain) { m_generators[generator].gain.store(gain, std::memory_order_relaxed); }
+    float getGain(size_t generator) const       { return m_generators[generator].gain.load(std::memory_order_relaxed); }
+
+    // The one saturation stage: everything played goes through it, and the offline
+    // renderer copies its settings. Safe from any thread; the callback picks new
+    // settings up when it next mixes. Returns false, changing nothing, for invalid
+    // settings (see SaturationSettings::isValid).
+    bool setSaturation(SaturationSettings settings)
+    {
+        if (!settings.isValid())
+            return false;
+        m_saturation.store(settings, std::memory_order_relaxed);
+        return true;
+    }
+    SaturationSettings getSaturation() const        { return m_saturation.load(std::memory_order_relaxed); }
+
+    // Time spent rendering the generator, as a (smoothed) fraction of the time the audio covers.
+    float getLoad(size_t generator) const { return m_generators[generator].load.load(std::memory_order_relaxed); }
+
+private:
+    // A callback buffer bigger than this is rendered in pieces.
+    static constexpr size_t MAX_MIX_FRAMES = 2048;
+
+    // Worker threads check this many times for the next buffer before going to sleep.
+    static constexpr int WORKER_SPIN_COUNT = 4096;
+
+    // Cache-line aligned so workers don't contend over each other's state.
+    struct alignas(64) GeneratorState
+    {
+        alignas(32) std::array<float, MAX_MIX_FRAMES * 2> buffer{};
+        std::atomic<float> gain{ 1.0f };
+        float              mixedGain{ 1.0f }; // gain at the end of the last mix; callback thread only
+        std::atomic<float> load{ 0.0f };
+    };
+
+    void run(size_t generator, uint32_t epoch);
+    void renderGenerator(size_t generator, size_t frames);
+    void mix(std::span<float> output);
+
+    std::array<GeneratorState, MAX_GENERATORS> m_generators;
+
+    std::atomic<SaturationSettings> m_saturation{};
+    Saturator m_saturator; // callback thread only
+
+    std::vector<std::thread> m_workers;
+    std::atomic<bool>     m_running{ false };
+    std::atomic<uint32_t> m_epoch{ 0 };   // bumped once per piece of output to wake the workers
+    std::atomic<size_t>   m_pending{ 0 }; // workers still rendering the current piece
+    std::atomic<size_t>   m_sleeping{ 0 }; // workers waiting on m_epoch, which only then needs a notify
+    size_t                m_frames{ 0 };  // size of the current piece, published by m_epoch
+};
@@ -0,0 +1,241 @@
+#pragma once
+
+#include "constants.h"
+#include "oscillator.h"
+#include "sample_voice.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <span>
+
+// Grains playing at once, across every cloud of a generator. Spawning past this drops the grain.
+constexpr size_t MAX_GRAINS = 512;
+constexpr size_t MAX_GRAIN_CLOUDS = 4;
+
+// Window tables have this many steps, plus a trailing zero so reads can interpolate off the end.
+constexpr size_t GRAIN_WINDOW_SIZE = 1024;
+
+enum class GrainWindow : uint8_t
+{
+    Hann,
+    Triangle,
+    Tukey, // flat in the middle, with Hann tapers over the outer quarters
+    Count
+};
+
+enum class GrainSource : uint8_t
+{
+    Wavetable,
+    Sample
+};
+
+// A cloud spawns grains at a steady rate, each a short windowed snippet of its
+// source with its own random offset in position, pitch, and pan.
+struct GrainCloudSettings
+{
+    bool        enabled{ false };
+    GrainSource source{ GrainSource::Wavetable };
+    GrainWindow window{ GrainWindow::Hann };
+
+    // Wavetable grains play the wavetable at this position and frequency.
+    float       wavetablePosition{ 0.0f }; // in frames
+    frequency_t frequency{ 220.0f };
+
+    // Sample grains read the resident head of a loaded file (see SampleStreamer),
+    // starting around a position in it, at a playback rate.
+    const SampleFile* sampleFile{ nullptr };
+    float       position{ 0.0f };       // out of 1.0 of the head
+    float       positionSpread{ 0.1f }; // random offset either way, out of 1.0 of the head
+    float       rate{ 1.0f };
+
+    float       density{ 20.0f };      // grains per second
+    float       grainLength{ 0.08f };  // seconds
+    float       pitchSpread{ 0.0f };   // random detune either way, in cents
+    float       panSpread{ 0.5f };     // out of 1.0
+    volume_t    volume{ 0.3f };        // of each grain
+};
+
+// Renders grain clouds. Grains live in a fixed pool, packed at the front of it: a
+// new grain goes on the end, and a finished one is replaced by the last, so both
+// are O(1) and rendering walks a dense array. Nothing is allocated after construction.
+// Spawn times are worked out once per block for each cloud, to the frame.
+struct GranularEngine
+{
+    GranularEngine()
+    {
+        for (size_t index = 0; index < GRAIN_WINDOW_SIZE; ++index)
+        {
+            const double x = double(index) / GRAIN_WINDOW_SIZE;
+            const double taper = std::min(x, 1.0 - x) * 4.0; // reaches 1 a quarter of the way in
+            m_windows[size_t(GrainWindow::Hann)][index] = float(0.5 - 0.5 * std::cos(TWO_PI * x));
+            m_windows[size_t(GrainWindow::Triangle)][index] = float(1.0 - std::abs(2.0 * x - 1.0));
+            m_windows[size_t(GrainWindow::Tukey)][index] = taper >= 1.0 ? 1.0f : float(0.5 - 0.5 * std::cos(PI * taper));
+        }
+    }
+
+    // Returns false if the settings can't be played: a bad window, or a sample cloud with no sample.
+    bool setCloud(size_t cloud, GrainCloudSettings const& settings)
+    {
+        if (cloud >= MAX_GRAIN_CLOUDS || settings.window >= GrainWindow::Count || settings.density < 0.0f ||
+            settings.grainLength <= 0.0f)
+            return false;
+        if (settings.source == GrainSource::Sample && (settings.sampleFile == nullptr || settings.sampleFile->head.empty()))
+            return false;
+
+        m_clouds[cloud] = settings;
+        m_clouds[cloud].wavetablePosition = std::clamp(settings.wavetablePosition, 0.0f, float(WAVETABLE_FRAMES - 1));
+        m_clouds[cloud].grainLength = std::min(settings.grainLength, 1.0f);
+        return true;
+    }
+
+    GrainCloudSettings const& getCloud(size_t cloud) const { return m_clouds[cloud]; }
+    size_t getGrainCount() const { return m_grain_count; }
+
+    // Mix every grain into the (interleaved stereo) output block.
+    void render(std::span<float> output)
+    {
+        const size_t frames = output.size() / 2;
+        for (size_t cloud = 0; cloud < MAX_GRAIN_CLOUDS; ++cloud)
+        {
+            if (m_clouds[cloud].enabled && m_clouds[cloud].density > 0.0f)
+                scheduleGrains(cloud, frames);
+        }
+
+        for (size_t index = 0; index < m_grain_count;)
+        {
+            if (renderGrain(m_grains[index], output))
+                ++index;
+            else
+                m_grains[index] = m_grains[--m_grain_count];
+        }
+    }
+
+private:
+    struct Grain
+    {
+        uint32_t delay{ 0 };        // frames to wait, in the block it was spawned in
+        float    window{ 0.0f };     // position in the window table
+        float    windowStep{ 0.0f };
+        const float* windowTable{ nullptr };
+        float    gainLeft{ 0.0f };
+        float    gainRight{ 0.0f };
+
+        // Wavetable grains.
+        WavetableFrames frames{};
+        phase_t  phase{ 0 };
+        phase_t  phaseStep{ 0 };
+
+        // Sample grains; a null sample means a wavetable grain.
+        const SampleFrame* sample{ nullptr };
+        size_t   sampleFrames{ 0 };
+        float    position{ 0.0f };   // in source frames
+        float    increment{ 0.0f };
+    };
+
+    // Spawn every grain due in the next block, each at its exact frame.
+    void scheduleGrains(size_t cloud, size_t frames)
+    {
+        const float interval = float(SAMPLE_RATE) / m_clouds[cloud].density;
+        float& untilNext = m_until_next_grain[cloud];
+        untilNext = std::min(untilNext, interval); // after the density goes up, don't wait out the old interval
+        for (; untilNext < float(frames); untilNext += interval)
+            spawnGrain(m_clouds[cloud], uint32_t(untilNext));
+        untilNext -= float(frames);
+    }
+
+    void spawnGrain(GrainCloudSettings const& settings, uint32_t delay)
+    {
+        if (m_grain_count == MAX_GRAINS)
+            return;
+
+        Grain& grain = m_grains[m_grain_count++];
+        grain.delay = delay;
+        grain.window = 0.0f;
+        grain.windowStep = float(GRAIN_WINDOW_SIZE) / (settings.grainLength * float(SAMPLE_RATE));
+        grain.windowTable = m_windows[size_t(settings.window)].data();
+
+        const float pan = (nextRandom() * 2.0f - 1.0f) * settings.panSpread;
+        grain.gainLeft = settings.volume * (pan > 0.0f ? 1.0f - pan : 1.0f);
+        grain.gainRight = settings.volume * (pan < 0.0f ? 1.0f + pan : 1.0f);
+
+        const float pitch = std::exp2((nextRandom() * 2.0f - 1.0f) * settings.pitchSpread / 1200.0f);
+        if (settings.source == GrainSource::Sample)
+        {
+            const SampleFile& file = *settings.sampleFile;
+            const float offset = settings.position + (nextRandom() * 2.0f - 1.0f) * settings.positionSpread;
+            grain.sample = file.head.data();
+            grain.sampleFrames = file.head.size();
+            grain.position = std::clamp(offset, 0.0f, 1.0f) * float(file.head.size() - 1);
+            grain.increment = settings.rate * pitch * float(double(file.sampleRate) * ONE_OVER_SAMPLE_RATE);
+        }
+        else
+        {
+            grain.sample = nullptr;
+            grain.frames = getWavetableFrames(settings.wavetablePosition);
+            grain.phase = phase_t(nextRandom() * float(PHASE_CYCLE));
+            grain.phaseStep = hz_to_delta(settings.frequency * pitch);
+        }
+    }
+
+    // Returns false once the grain has finished.
+    bool renderGrain(Grain& grain, std::span<float> output)
+    {
+        const size_t start = size_t(grain.delay) * 2;
+        grain.delay = 0;
+        for (size_t index = start; index < output.size(); index += 2)
+        {
+            if (grain.window >= float(GRAIN_WINDOW_SIZE))
+                return false;
+
+            const size_t windowIndex = size_t(grain.window);
+            const float windowT = grain.window - float(windowIndex);
+            const float a = grain.windowTable[windowIndex];
+            const float window = a + (grain.windowTable[windowIndex + 1] - a) * windowT;
+            grain.window += grain.windowStep;
+
+            float left;
+            float right;
+            if (grain.sample != nullptr)
+            {
+                // Past the end of the head there's nothing to read; the rest of the grain is silent.
+                const size_t frame = size_t(grain.position);
+                const float t = grain.position - float(frame);
+                const SampleFrame from = frame < grain.sampleFrames ? grain.sample[frame] : SampleFrame{};
+                const SampleFrame to = frame + 1 < grain.sampleFrames ? grain.sample[frame + 1] : SampleFrame{};
+                left = from.left + (to.left - from.left) * t;
+                right = from.right + (to.right - from.right) * t;
+                grain.position += grain.increment;
+            }
+            else
+            {
+                left = right = grain.frames.read(grain.phase >> PHASE_FRACTION_BITS);
+                grain.phase += grain.phaseStep;
+            }
+
+            output[index]     += left * window * grain.gainLeft;   // left channel
+            output[index + 1] += right * window * grain.gainRight; // right channel
+        }
+        return grain.window < float(GRAIN_WINDOW_SIZE);
+    }
+
+    // In [0, 1). A fixed-seed generator, so offline renders repeat exactly.
+    float nextRandom()
+    {
+        // splitmix32
+        uint32_t z = (m_random_seed += 0x9E3779B9u);
+        z = (z ^ (z >> 16)) * 0x85EBCA6Bu;
+        z = (z ^ (z >> 13)) * 0xC2B2AE35u;
+        return float((z ^ (z >> 16)) >> 8) * (1.0f / 16777216.0f);
+    }
+
+    std::array<GrainCloudSettings, MAX_GRAIN_CLOUDS> m_clouds{};
+    std::array<float, MAX_GRAIN_CLOUDS> m_until_next_grain{}; // frames from the start of the next block
+
+    // The first m_grain_count grains are playing.
+    std::array<Grain, MAX_GRAINS> m_grains{};
+    size_t m_grain_count{ 0 };
+    uint32_t m_random_seed{ 0 };
+
+    std::array<std::array<float, GRAIN_WINDOW_SIZE + 1>, size_t(GrainWindow::Count)> m_windows{};
+};
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+
+// Every SIMD kernel keeps a plain scalar version next to it: the reference the SIMD
+// one has to match. Which of them runs can be picked at runtime, so the render check
+// (see render_check.h) puts every variant through the same goldens.
+enum class KernelVariant : uint8_t
+{
+    Sse,    // what ships
+    Scalar, // the reference
+    Count
+};
+
+namespace Kernels
+{
+    inline std::atomic<KernelVariant> g_variant{ KernelVariant::Sse };
+
+    // Safe from any thread; each kernel picks it up the next time it runs.
+    inline void setVariant(KernelVariant variant) { g_variant.store(variant, std::memory_order_relaxed); }
+    inline KernelVariant getVariant()             { return g_variant.load(std::memory_order_relaxed); }
+    inline bool useScalar()                       { return getVariant() == KernelVariant::Scalar; }
+
+    inline const char* getName(KernelVariant variant)
+    {
+        return variant == KernelVariant::Scalar ? "scalar" : "sse";
+    }
+
+    inline std::optional<KernelVariant> parseVariant(std::string_view name)
+    {
+        for (uint8_t variant = 0; variant < uint8_t(KernelVariant::Count); ++variant)
+        {
+            if (name == getName(KernelVariant(variant)))
+                return KernelVariant(variant);
+        }
+        return std::nullopt;
+    }
+}
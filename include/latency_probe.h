@@ -0,0 +1,92 @@
+#pragma once
+
+#include "constants.h"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Measures how long a control change takes to be heard. Each request is stamped
+// when it's built (in EventBuilder), again when its generator takes it off the
+// queue and applies it, and finally with the DAC time of the exact frame where it
+// takes effect, from the timing the audio device gives the callback. Only
+// requests meant to apply at once are measured; timed requests wait on purpose.
+//
+// The stages are:
+//     queue  built -> applied by the generator
+//     apply  applied -> the callback that rendered it hands its buffer over
+//     dac    handed over -> the changed frame reaches the DAC
+//     total  built -> the changed frame reaches the DAC
+struct LatencyProbe
+{
+    enum Stage
+    {
+        Queue,
+        Apply,
+        Dac,
+        Total,
+        STAGE_COUNT
+    };
+
+    // The most recent measurements kept per stage.
+    static constexpr size_t HISTORY = 1024;
+
+    // Requests applied in a single callback past this many aren't measured.
+    static constexpr size_t MAX_PENDING = 32;
+
+    struct Percentiles
+    {
+        float p50{ 0.0f }, p90{ 0.0f }, p99{ 0.0f }, max{ 0.0f }; // milliseconds
+        size_t count{ 0 };
+    };
+
+    using Clock = std::chrono::steady_clock;
+
+    static LatencyProbe& getInstance();
+
+    static const char* getStageName(Stage stage);
+
+    // Call on a generator's rendering thread when it applies a request.
+    void requestApplied(size_t generator, Clock::time_point created, uint64_t sampleTime);
+
+    // Call on the audio callback's thread, before and after rendering. dacDelay is
+    // outputBufferDacTime - currentTime from the callback's timing info.
+    void beginBuffer(Clock::time_point callbackTime);
+    void endBuffer(double dacDelaySeconds);
+
+    // Safe from any thread. Percentiles of the recent history of one stage.
+    Percentiles getPercentiles(Stage stage) const;
+
+    // Write the recent history as CSV, one measurement per line. Call off the realtime thread.
+    bool writeCsv(const std::string& path) const;
+
+private:
+    LatencyProbe() = default;
+
+    std::vector<float> copyHistory(Stage stage) const;
+
+    struct Pending
+    {
+        Clock::time_point created;
+        Clock::time_point applied;
+        uint64_t sampleTime{ 0 };
+    };
+
+    // Requests applied during the current buffer. Each generator's list is only
+    // touched by its rendering thread, and by the callback once the mixer has joined it.
+    struct GeneratorPending
+    {
+        std::array<Pending, MAX_PENDING> requests{};
+        size_t count{ 0 };
+        uint64_t bufferStart{ 0 }; // the generator's sample time when the buffer began
+    };
+    std::array<GeneratorPending, MAX_GENERATORS> m_pending{};
+    Clock::time_point m_callback_time;
+
+    // Milliseconds. Written by the callback only; readers may see a mix of old and new.
+    std::array<std::array<std::atomic<float>, HISTORY>, STAGE_COUNT> m_history{};
+    std::atomic<uint64_t> m_measured{ 0 };
+};
@@ -0,0 +1,248 @@
+#pragma once
+
+#include "constants.h"
+#include "oscillator.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <string>
+#include <vector>
+
+enum class MidiEventType : uint8_t
+{
+    NoteOff,
+    NoteOn,
+    ControlChange
+};
+
+// One channel event, already converted from ticks to an absolute sample time.
+struct MidiEvent
+{
+    uint64_t      sampleTime{ 0 };
+    MidiEventType type{ MidiEventType::NoteOff };
+    uint8_t       channel{ 0 };
+    uint8_t       data1{ 0 }; // note or controller number
+    uint8_t       data2{ 0 }; // velocity or controller value
+};
+
+// Every event of a file, merged across tracks and sorted by time. The array is
+// built once when the file is loaded and never changes afterwards, so the realtime
+// thread can walk it without any synchronization.
+struct MidiSequence
+{
+    std::vector<MidiEvent> events;
+    uint64_t               lengthSamples{ 0 }; // time of the last track's end, or the last event if later
+};
+
+// Load a Standard MIDI File (format 0 or 1). Note on/off and control change events
+// are kept; tempo changes are folded into the sample times. The sequence lasts until
+// the end of its longest track, which can be well after its last event. Returns nothing if the
+// file can't be read or isn't a MIDI file.
+std::optional<MidiSequence> LoadMidiFile(const std::string& path);
+
+// How the scheduler voices the notes of a sequence.
+struct MidiSettings
+{
+    OscillatorType   type{ OscillatorType::Saw };
+    EnvelopeSettings envelope{ 0.005f, 0.2f, 0.6f, 0.15f, EnvelopeCurve::Exponential };
+    volume_t         gain{ 0.25f }; // volume of a full-velocity note at full channel volume
+};
+
+// Plays a MidiSequence on the realtime thread by allocating oscillators straight
+// from the bank - no UI requests involved. The generator asks how many frames
+// remain until the next event and ends its control block there, so every event
+// lands on its exact sample. Oscillators started here belong to the scheduler
+// until their note ends; the UI doesn't know about them.
+template<size_t MAX_OSCILLATORS>
+struct MidiScheduler
+{
+    static constexpr size_t NoEventPending = std::numeric_limits<size_t>::max();
+
+    void play(const MidiSequence* sequence, MidiSettings const& settings, Oscillators<MAX_OSCILLATORS>& oscillators)
+    {
+        stop(oscillators);
+        m_sequence = sequence;
+        m_settings = settings;
+        m_next_event = 0;
+        m_time = 0;
+        m_channel_volume.fill(100);
+        m_channel_pan.fill(64);
+    }
+
+    // Release every sounding note and forget the sequence.
+    void stop(Oscillators<MAX_OSCILLATORS>& oscillators)
+    {
+        releaseNotes(oscillators);
+        m_sequence = nullptr;
+    }
+
+    // Release every sounding note, but keep playing the sequence.
+    void releaseNotes(Oscillators<MAX_OSCILLATORS>& oscillators)
+    {
+        for (OscillatorId id = 0; id < MAX_OSCILLATORS; ++id)
+            releaseVoice(id, oscillators);
+    }
+
+    __forceinline bool isPlaying() const { return m_sequence != nullptr; }
+
+    // Frames from now until the next event is due (zero if it's due now). Past the
+    // last event, the end of the sequence counts as one.
+    size_t framesUntilNextEvent() const
+    {
+        if (m_sequence == nullptr)
+            return NoEventPending;
+
+        const auto& events = m_sequence->events;
+        const uint64_t eventTime = m_next_event < events.size() ? events[m_next_event].sampleTime : m_sequence->lengthSamples;
+        return eventTime > m_time ? size_t(eventTime - m_time) : 0;
+    }
+
+    // Apply every event due at the current time.
+    void dispatchDueEvents(Oscillators<MAX_OSCILLATORS>& oscillators)
+    {
+        if (m_sequence == nullptr)
+            return;
+
+        const auto& events = m_sequence->events;
+        while (m_next_event < events.size() && events[m_next_event].sampleTime <= m_time)
+            handleEvent(events[m_next_event++], oscillators);
+
+        // The sequence is over; the last notes finish their releases on their own.
+        if (m_next_event == events.size() && m_time >= m_sequence->lengthSamples)
+            stop(oscillators);
+    }
+
+    __forceinline void advance(size_t frames) { m_time += frames; }
+
+    __forceinline uint64_t getTime() const { return m_time; }
+
+private:
+    static constexpr uint8_t ControllerVolume{ 7 };
+    static constexpr uint8_t ControllerPan{ 10 };
+    static constexpr uint8_t ControllerAllNotesOff{ 123 };
+    static constexpr uint16_t NoNote{ 0xFFFF };
+
+    static __forceinline uint16_t noteKey(uint8_t channel, uint8_t note) { return uint16_t(channel << 8 | note); }
+
+    static __forceinline frequency_t noteFrequency(uint8_t note)
+    {
+        return frequency_t(Notes::A_4 * std::exp2((int(note) - 69) / 12.0));
+    }
+
+    __forceinline volume_t noteVolume(uint8_t channel, uint8_t velocity) const
+    {
+        return m_settings.gain * (velocity / 127.0f) * (m_channel_volume[channel] / 127.0f);
+    }
+
+    __forceinline pan_t channelPan(uint8_t channel) const
+    {
+        return std::clamp((int(m_channel_pan[channel]) - 64) / 63.0f, -1.0f, 1.0f);
+    }
+
+    void handleEvent(MidiEvent const& event, Oscillators<MAX_OSCILLATORS>& oscillators)
+    {
+        switch (event.type)
+        {
+        case MidiEventType::NoteOn:
+        {
+            // A note that's already sounding restarts, rather than stacking a second
+            // voice the note off would leave behind.
+            releaseNote(noteKey(event.channel, event.data1), oscillators);
+
+            OscillatorSettings settings(m_settings.type, noteFrequency(event.data1), noteVolume(event.channel, event.data2));
+            settings.pan = channelPan(event.channel);
+            settings.envelope = m_settings.envelope;
+            const auto id = oscillators.addOscillator(settings);
+            if (id.has_value())
+            {
+                m_voice_note[*id] = noteKey(event.channel, event.data1);
+                m_voice_velocity[*id] = event.data2;
+            }
+            break; // if the bank is full, the note is dropped
+        }
+        case MidiEventType::NoteOff:
+            releaseNote(noteKey(event.channel, event.data1), oscillators);
+            break;
+        case MidiEventType::ControlChange:
+            handleControlChange(event, oscillators);
+            break;
+        }
+    }
+
+    void handleControlChange(MidiEvent const& event, Oscillators<MAX_OSCILLATORS>& oscillators)
+    {
+        switch (event.data1)
+        {
+        case ControllerVolume:
+            m_channel_volume[event.channel] = event.data2;
+            break;
+        case ControllerPan:
+            m_channel_pan[event.channel] = event.data2;
+            break;
+        case ControllerAllNotesOff:
+            for (OscillatorId id = 0; id < MAX_OSCILLATORS; ++id)
+            {
+                if (m_voice_note[id] != NoNote && (m_voice_note[id] >> 8) == event.channel)
+                    releaseVoice(id, oscillators);
+            }
+            return;
+        default:
+            return;
+        }
+
+        // Sounding notes on the channel follow volume and pan changes.
+        for (OscillatorId id = 0; id < MAX_OSCILLATORS; ++id)
+        {
+            if (m_voice_note[id] == NoNote || (m_voice_note[id] >> 8) != event.channel)
+                continue;
+
+            oscillators.setVolume(id, noteVolume(event.channel, m_voice_velocity[id]));
+            oscillators.setPan(id, channelPan(event.channel));
+        }
+    }
+
+    // A note only ever has one voice; see NoteOn.
+    void releaseNote(uint16_t key, Oscillators<MAX_OSCILLATORS>& oscillators)
+    {
+        for (OscillatorId id = 0; id < MAX_OSCILLATORS; ++id)
+        {
+            if (m_voice_note[id] == key)
+            {
+                releaseVoice(id, oscillators);
+                return;
+            }
+        }
+    }
+
+    void releaseVoice(OscillatorId id, Oscillators<MAX_OSCILLATORS>& oscillators)
+    {
+        if (m_voice_note[id] == NoNote)
+            return;
+
+        oscillators.removeOscillator(id);
+        m_voice_note[id] = NoNote;
+    }
+
+    const MidiSequence* m_sequence{ nullptr };
+    MidiSettings        m_settings{};
+    size_t              m_next_event{ 0 };
+    uint64_t            m_time{ 0 }; // samples since the sequence started
+
+    std::array<uint8_t, 16> m_channel_volume{};
+    std::array<uint8_t, 16> m_channel_pan{};
+
+    // Which note each oscillator is sounding for the scheduler, if any.
+    std::array<uint16_t, MAX_OSCILLATORS> m_voice_note = makeNoNotes();
+    std::array<uint8_t, MAX_OSCILLATORS>  m_voice_velocity{};
+
+    static constexpr std::array<uint16_t, MAX_OSCILLATORS> makeNoNotes()
+    {
+        std::array<uint16_t, MAX_OSCILLATORS> notes{};
+        notes.fill(NoNote);
+        return notes;
+    }
+};
@@ -0,0 +1,191 @@
+#pragma once
+
+#include "constants.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+enum class LfoShape : uint8_t
+{
+    Sine,
+    Triangle,
+    Square,
+    Saw
+};
+
+// Parameters of an oscillator that the modulation matrix can drive.
+enum class ModulationDestination : uint8_t
+{
+    Volume,    // depth 1.0 swings the volume between 0x and 2x
+    Pan,       // depth 1.0 swings the balance fully left and right
+    Frequency, // depth is in octaves
+    Wavetable, // depth is in wavetable frames
+    Count
+};
+
+struct LfoSettings
+{
+    LfoShape shape{ LfoShape::Sine };
+    float    rate{ 1.0f }; // Hz
+};
+
+// A single routing from an LFO to one parameter of one oscillator.
+struct ModulationRoute
+{
+    bool                  enabled{ false };
+    uint8_t               lfo{ 0 };
+    OscillatorId          oscillator{ 0 };
+    ModulationDestination destination{ ModulationDestination::Volume };
+    float                 depth{ 0.0f };
+};
+
+// Linear ramps across one control block, one per modulated parameter. The
+// generator applies these per sample on top of the oscillator's own settings.
+struct ModulationRamps
+{
+    float volume{ 1.0f };
+    float volumeStep{ 0.0f };
+    float leftPan{ 1.0f };
+    float leftPanStep{ 0.0f };
+    float rightPan{ 1.0f };
+    float rightPanStep{ 0.0f };
+    float pitch{ 1.0f }; // frequency ratio
+    float pitchStep{ 0.0f };
+    float position{ 0.0f }; // wavetable frames, added to the oscillator's position
+    float positionStep{ 0.0f };
+
+    bool movesWavetable() const { return position != 0.0f || positionStep != 0.0f; }
+};
+
+constexpr size_t MAX_LFOS = 8;
+constexpr size_t MAX_MODULATION_ROUTES = 256;
+
+// How far the frequency routes to an oscillator can move it in total, either way.
+constexpr float MAX_PITCH_OCTAVES = 32.0f;
+
+// LFOs and the matrix routing them to oscillator parameters. This runs on the
+// realtime thread at control rate: tick() is called once per control block, and
+// the values it produces are linearly interpolated across the following block
+// by the generator, so the per-sample cost doesn't depend on the route count.
+template<size_t MAX_OSCILLATORS>
+struct ModulationMatrix
+{
+    ModulationMatrix()
+    {
+        for (size_t lfo = 0; lfo < MAX_LFOS; ++lfo)
+            setLfo(lfo, LfoSettings());
+    }
+
+    bool setLfo(size_t lfo, LfoSettings const& settings)
+    {
+        if (lfo >= MAX_LFOS)
+            return false;
+
+        m_lfo_settings[lfo] = settings;
+        m_lfo_increment[lfo] = float(settings.rate * ONE_OVER_SAMPLE_RATE);
+        return true;
+    }
+
+    // Returns false if the route refers to an LFO or oscillator that can't exist, or
+    // its depth isn't a number.
+    bool setRoute(size_t route, ModulationRoute const& settings)
+    {
+        if (route >= MAX_MODULATION_ROUTES || settings.lfo >= MAX_LFOS || settings.oscillator >= MAX_OSCILLATORS ||
+            settings.destination >= ModulationDestination::Count || !std::isfinite(settings.depth))
+            return false;
+
+        m_routes[route] = settings;
+        m_route_source[route] = settings.lfo;
+        m_route_target[route] = uint16_t(size_t(settings.destination) * MAX_OSCILLATORS + settings.oscillator);
+        // Disabled routes stay in the loop with no depth; it's cheaper than branching.
+        m_route_depth[route] = settings.enabled ? settings.depth : 0.0f;
+        m_route_count = std::max(m_route_count, route + 1);
+        return true;
+    }
+
+    // Advance the LFOs by one control block and recompute every modulated value.
+    void tick(uint32_t frames)
+    {
+        for (size_t lfo = 0; lfo < MAX_LFOS; ++lfo)
+        {
+            float phase = m_lfo_phase[lfo] + m_lfo_increment[lfo] * float(frames);
+            phase -= std::floor(phase);
+            m_lfo_phase[lfo] = phase;
+            m_lfo_value[lfo] = evaluateLfo(m_lfo_settings[lfo].shape, phase);
+        }
+
+        std::fill(m_amount.begin(), m_amount.end(), 0.0f);
+        for (size_t route = 0; route < m_route_count; ++route)
+            m_amount[m_route_target[route]] += m_lfo_value[m_route_source[route]] * m_route_depth[route];
+
+        const float invFrames = 1.0f / float(frames);
+        for (size_t osc = 0; osc < MAX_OSCILLATORS; ++osc)
+        {
+            const float volume = std::max(1.0f + amount(ModulationDestination::Volume, osc), 0.0f);
+            const float balance = std::clamp(amount(ModulationDestination::Pan, osc), -1.0f, 1.0f);
+            const float leftPan = balance > 0.0f ? 1.0f - balance : 1.0f;
+            const float rightPan = balance < 0.0f ? 1.0f + balance : 1.0f;
+            // Routes add up; past this many octaves, every step is a whole cycle anyway.
+            const float octaves = std::clamp(amount(ModulationDestination::Frequency, osc), -MAX_PITCH_OCTAVES, MAX_PITCH_OCTAVES);
+            const float pitch = std::exp2(octaves);
+            const float position = amount(ModulationDestination::Wavetable, osc);
+
+            ModulationRamps& ramps = m_ramps[osc];
+            ramps.volumeStep = (volume - m_previous[osc].volume) * invFrames;
+            ramps.leftPanStep = (leftPan - m_previous[osc].leftPan) * invFrames;
+            ramps.rightPanStep = (rightPan - m_previous[osc].rightPan) * invFrames;
+            ramps.pitchStep = (pitch - m_previous[osc].pitch) * invFrames;
+            ramps.positionStep = (position - m_previous[osc].position) * invFrames;
+            ramps.volume = m_previous[osc].volume;
+            ramps.leftPan = m_previous[osc].leftPan;
+            ramps.rightPan = m_previous[osc].rightPan;
+            ramps.pitch = m_previous[osc].pitch;
+            ramps.position = m_previous[osc].position;
+
+            m_previous[osc] = { volume, 0.0f, leftPan, 0.0f, rightPan, 0.0f, pitch, 0.0f, position, 0.0f };
+        }
+    }
+
+    __forceinline ModulationRamps const& getRamps(OscillatorId id) const { return m_ramps[id]; }
+
+    LfoSettings const&     getLfo(size_t lfo)     const { return m_lfo_settings[lfo]; }
+    ModulationRoute const& getRoute(size_t route) const { return m_routes[route]; }
+
+private:
+    __forceinline float amount(ModulationDestination destination, size_t osc) const
+    {
+        return m_amount[size_t(destination) * MAX_OSCILLATORS + osc];
+    }
+
+    static float evaluateLfo(LfoShape shape, float phase)
+    {
+        switch (shape)
+        {
+        case LfoShape::Sine:     return float(std::sin(phase * TWO_PI));
+        case LfoShape::Triangle: return 1.0f - 4.0f * std::abs(phase - 0.5f);
+        case LfoShape::Square:   return phase < 0.5f ? 1.0f : -1.0f;
+        case LfoShape::Saw:      return 2.0f * phase - 1.0f;
+        }
+        return 0.0f;
+    }
+
+    // LFO state, one lane per LFO.
+    alignas(32) std::array<float, MAX_LFOS> m_lfo_phase{}; // in [0, 1)
+    alignas(32) std::array<float, MAX_LFOS> m_lfo_increment{};
+    alignas(32) std::array<float, MAX_LFOS> m_lfo_value{};
+    std::array<LfoSettings, MAX_LFOS> m_lfo_settings{};
+
+    // Routes, as flat arrays so the accumulation loop is a tight gather/scatter.
+    size_t m_route_count{ 0 }; // one past the highest route ever set
+    std::array<uint8_t, MAX_MODULATION_ROUTES>  m_route_source{};
+    std::array<uint16_t, MAX_MODULATION_ROUTES> m_route_target{};
+    std::array<float, MAX_MODULATION_ROUTES>    m_route_depth{};
+    std::array<ModulationRoute, MAX_MODULATION_ROUTES> m_routes{};
+
+    // Summed modulation per destination, laid out destination-major.
+    alignas(32) std::array<float, size_t(ModulationDestination::Count) * MAX_OSCILLATORS> m_amount{};
+
+    std::array<ModulationRamps, MAX_OSCILLATORS> m_previous{};
+    std::array<ModulationRamps, MAX_OSCILLATORS> m_ramps{};
+};
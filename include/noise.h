@@ -0,0 +1,105 @@
+#pragma once
+
+#include "constants.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <span>
+
+// Noise for the noise oscillator types. White noise comes from several xoshiro128+
+// generators run side by side, one per lane: each step of the lane loop is the same
+// few shifts, xors and adds on every lane, so it maps onto integer SIMD, and the
+// lanes' outputs become consecutive samples. Pink and brown noise filter the white.
+//
+// Everything is seeded from a number, so offline renders repeat exactly.
+struct NoiseSource
+{
+    static constexpr size_t LANES = 8;
+
+    NoiseSource() { seed(0); }
+
+    void seed(uint32_t seed)
+    {
+        // splitmix32 spreads the seed over the whole state; xoshiro's state must not be all zero.
+        uint32_t z = seed * 0x9E3779B9u;
+        const auto next = [&z]() {
+            uint32_t x = (z += 0x9E3779B9u);
+            x = (x ^ (x >> 16)) * 0x85EBCA6Bu;
+            x = (x ^ (x >> 13)) * 0xC2B2AE35u;
+            return (x ^ (x >> 16)) | 1u;
+        };
+        for (size_t lane = 0; lane < LANES; ++lane)
+        {
+            m_s0[lane] = next();
+            m_s1[lane] = next();
+            m_s2[lane] = next();
+            m_s3[lane] = next();
+        }
+        m_pink = {};
+        m_brown = 0.0f;
+    }
+
+    // Flat spectrum, in [-1, 1).
+    void generateWhite(std::span<float> output)
+    {
+        alignas(32) std::array<float, LANES> values;
+        for (size_t start = 0; start < output.size(); start += LANES)
+        {
+            for (size_t lane = 0; lane < LANES; ++lane)
+            {
+                const uint32_t result = m_s0[lane] + m_s3[lane];
+                const uint32_t t = m_s1[lane] << 9;
+                m_s2[lane] ^= m_s0[lane];
+                m_s3[lane] ^= m_s1[lane];
+                m_s1[lane] ^= m_s2[lane];
+                m_s0[lane] ^= m_s3[lane];
+                m_s2[lane] ^= t;
+                m_s3[lane] = (m_s3[lane] << 11) | (m_s3[lane] >> 21);
+
+                // The top 24 bits are the good ones, and exactly what a float holds.
+                values[lane] = float(result >> 8) * (2.0f / 16777216.0f) - 1.0f;
+            }
+
+            const size_t count = std::min(LANES, output.size() - start);
+            for (size_t lane = 0; lane < count; ++lane)
+                output[start + lane] = values[lane];
+        }
+    }
+
+    // -3 dB per octave: Paul Kellet's economy filter, three one-pole lowpasses
+    // spread across the band, within half a dB of true pink above 50 Hz or so.
+    void generatePink(std::span<float> output)
+    {
+        generateWhite(output);
+        for (float& sample : output)
+        {
+            const float white = sample;
+            m_pink[0] = 0.99765f * m_pink[0] + white * 0.0990460f;
+            m_pink[1] = 0.96300f * m_pink[1] + white * 0.2965164f;
+            m_pink[2] = 0.57000f * m_pink[2] + white * 1.0526913f;
+            sample = (m_pink[0] + m_pink[1] + m_pink[2] + white * 0.1848f) * 0.13f; // peaks about as high as white
+        }
+    }
+
+    // -6 dB per octave: integrated white noise, leaking slowly back to zero so it can't wander off.
+    void generateBrown(std::span<float> output)
+    {
+        generateWhite(output);
+        for (float& sample : output)
+        {
+            m_brown = (m_brown + 0.02f * sample) * (1.0f / 1.02f);
+            sample = m_brown * 3.5f;
+        }
+    }
+
+private:
+    // xoshiro128+ state, one lane per generator.
+    alignas(32) std::array<uint32_t, LANES> m_s0{};
+    alignas(32) std::array<uint32_t, LANES> m_s1{};
+    alignas(32) std::array<uint32_t, LANES> m_s2{};
+    alignas(32) std::array<uint32_t, LANES> m_s3{};
+
+    std::array<float, 3> m_pink{};
+    float m_brown{ 0.0f };
+};
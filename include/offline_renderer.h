@@ -0,0 +1,18 @@
+#pragma once
+
+#include "midi.h"
+
+#include <string>
+
+// Rendering without an audio device. The generator is driven exactly as the
+// realtime callback drives it, just as fast as the CPU allows, and the result is
+// written to a wav file.
+namespace OfflineRenderer
+{
+    // Frames rendered per call to renderSamples, standing in for the device buffer size.
+    constexpr size_t RENDER_BUFFER_FRAMES = 512;
+
+    // Play a MIDI sequence through a fresh generator, then let the last notes
+    // ring out. Returns false if the file couldn't be written.
+    bool RenderMidiToFile(const MidiSequence& sequence, const MidiSettings& settings, const std::string& path);
+}
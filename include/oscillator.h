@@ -1,13 +1,19 @@
 #pragma once
 
 #include "constants.h"
+#include "envelope.h"
+#include "kernels.h"
+#include "noise.h"
 
 #include <algorithm>
-#include <functional>
+#include <cmath>
+#include <immintrin.h>
+#include <span>
+#include <tuple>
 
 constexpr phase_t hz_to_delta(frequency_t hz)
 {
-    return static_cast<phase_t>(hz * MAX_PHASE_OVER_SAMPLE_RATE + 0.5);
+    return static_cast<phase_t>(hz * PHASE_CYCLE_OVER_SAMPLE_RATE + 0.5);
 }
 
 enum class OscillatorType
@@ -15,15 +21,83 @@ enum class OscillatorType
     Sine,
     Square,
     Triangle,
-    Saw
+    Saw,
+    WhiteNoise,
+    PinkNoise,
+    BrownNoise
 };
 
+// Noise types aren't wavetable frames; they're generated, and have no pitch.
+constexpr bool isNoise(OscillatorType type) { return type >= OscillatorType::WhiteNoise; }
+
+inline const std::array<float, TABLE_SIZE>& getWaveTable(OscillatorType type)
+{
+    switch (type)
+    {
+    case OscillatorType::Square:   return WaveTables::getSquare();
+    case OscillatorType::Triangle: return WaveTables::getTriangle();
+    case OscillatorType::Saw:      return WaveTables::getSaw();
+    case OscillatorType::Sine:
+    default:                       return WaveTables::getSine();
+    }
+}
+
+// A position in the wavetable, resolved to the two frames either side of it and
+// how far along it is from the first to the second.
+struct WavetableFrames
+{
+    const float* from;
+    const float* to;
+    float        t;
+
+    __forceinline float read(size_t index) const
+    {
+        const float a = from[index];
+        return a + (to[index] - a) * t;
+    }
+
+    // Four reads at once, for four unison lanes: the frames are read a lane at a time
+    // (there's no gather before AVX2), and mixed together with SSE.
+    __forceinline __m128 readLanes(const phase_t* indices) const
+    {
+        const __m128 a = _mm_set_ps(from[indices[3]], from[indices[2]], from[indices[1]], from[indices[0]]);
+        const __m128 b = _mm_set_ps(to[indices[3]], to[indices[2]], to[indices[1]], to[indices[0]]);
+        return _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(b, a), _mm_set1_ps(t)));
+    }
+};
+
+// position is in frames, in [0, WAVETABLE_FRAMES - 1].
+__forceinline WavetableFrames getWavetableFrames(float position)
+{
+    const size_t frame = std::min(size_t(position), WAVETABLE_FRAMES - 2);
+    const auto& frames = WaveTables::getFrames();
+    return { frames[frame].data(), frames[frame + 1].data(), position - float(frame) };
+}
+
+constexpr size_t MAX_UNISON_VOICES = 16;
+
+// Unison voices are rendered in groups of this many lanes, one SSE register; lanes
+// past the voice count are silent, so the inner loop always runs over whole registers.
+constexpr size_t UNISON_LANE_GROUP = 4;
+
+// A unison oscillator stacks several detuned copies of itself, spread across the
+// stereo field and started at random phases - the classic supersaw.
+struct UnisonSettings
+{
+    uint8_t voices{ 1 };      // 1 disables unison
+    float   detune{ 20.0f };  // cents from the center to the outermost voices
+    float   spread{ 0.5f };   // stereo spread, out of 1.0
+};
+
+// Marks an oscillator that isn't synced to another.
+constexpr OscillatorId NO_SYNC_MASTER = UINT8_MAX;
+
 enum class OscillatorState
 {
     Uninitialized,
     Active,
     Deactivated,
-    // TODO: This fading logic needs to be encapsulated somehow
+    // The fading states last as long as the envelope's attack or release.
     FadingOutDeactivate,
     FadingOutRemove,
     FadingIn
@@ -37,6 +111,7 @@ struct OscillatorSettings
         , type(type)
         , frequency(frequency)
         , volume(volume)
+        , wavetablePosition(isNoise(type) ? 0.0f : float(type))
     { }
 
     OscillatorState state{ OscillatorState::Uninitialized };
@@ -44,6 +119,10 @@ struct OscillatorSettings
     frequency_t     frequency{ 0 };
     volume_t        volume{ 0 };     // out of 1.0
     pan_t           pan{ 0.0f };  // in range [-1.0, 1.0]
+    float           wavetablePosition{ 0.0f }; // in frames; a whole number sits on the type's own table
+    OscillatorId    syncMaster{ NO_SYNC_MASTER }; // hard sync: restart whenever this oscillator's cycle does
+    EnvelopeSettings envelope;
+    UnisonSettings  unison;
 };
 
 // A Fader is a helper class to lerp between a start and target point.
@@ -64,14 +143,11 @@ struct Fader
         target = to;
     }
 
-    T update(std::function<void()> onFadeEnd = nullptr)
+    T update()
     {
         if (fade_steps_left > 0)
         {
             fade_steps_left--;
-            if (onFadeEnd && fade_steps_left == 0)
-                onFadeEnd();
-
             return getValue();
         }
         else
@@ -87,6 +163,8 @@ struct Fader
         return T(std::lerp(start, target, t));
     }
 
+    bool isFinished() const { return fade_steps_left == 0; }
+
 private:
     uint16_t fade_steps_left{ 0 };
     T start{};
@@ -97,6 +175,8 @@ private:
 // phase step, which is used as an index into a wave table for the specified wave type.
 // The Oscillator is responsible for its state, including frequency, phase step, volume,
 // pan, and fade. It supports smoothly transitioning between states in a realtime context.
+// Attack and release are driven by the owning Oscillators' envelope bank, which reports
+// back through onEnvelopeEvent() when the oscillator should leave a fading state.
 struct Oscillator
 {
     Oscillator(OscillatorSettings settings = OscillatorSettings())
@@ -106,36 +186,132 @@ struct Oscillator
         , m_phase_step_fader(m_phase_step)
         , m_left_pan_fader(1.0f)
         , m_right_pan_fader(1.0f)
-        //m_wave_type_fader(1.0f)
+        , m_position_fader(m_settings.wavetablePosition)
     {
         assert(m_settings.volume >= 0 && m_settings.volume <= 1.0);
 
         // First invocation of updatePhase should return zero. Go back one to allow that.
         m_phase_counter -= m_phase_step;
+
+        setUnison(m_settings.unison);
     }
 
-    // Designed to be called in a loop...
-    __forceinline phase_t updatePhase()
+    // A phase step times a pitch ratio. Stacked frequency routes can take it to a whole
+    // cycle or more, which doesn't fit a phase_t (and is far past Nyquist anyway), so
+    // it stops just short of one. (Written so a NaN stops there too.)
+    static __forceinline phase_t scalePhaseStep(phase_t step, float pitchRatio)
+    {
+        const double scaled = double(step) * pitchRatio + 0.5;
+        return phase_t(scaled < MAX_PHASE_STEP ? scaled : MAX_PHASE_STEP);
+    }
+
+    // Designed to be called in a loop... The pitch ratio comes from frequency modulation.
+    // Returns the full 32-bit phase, for callers that offset it (phase modulation).
+    __forceinline phase_t updatePhaseAccumulator(float pitchRatio = 1.0f)
     {
         m_phase_step = m_phase_step_fader.update();
-        m_phase_counter += m_phase_step;
-        return m_phase_counter == TABLE_SIZE ? 0 : m_phase_counter;
+        m_phase_counter += scalePhaseStep(m_phase_step, pitchRatio);
+        return m_phase_counter;
     }
 
-    // Designed to be called in a loop...
-    __forceinline volume_t updateVolume()
+    // Designed to be called in a loop... Returns an index into the wave tables.
+    __forceinline size_t updatePhase(float pitchRatio = 1.0f)
+    {
+        return updatePhaseAccumulator(pitchRatio) >> PHASE_FRACTION_BITS;
+    }
+
+    // Designed to be called in a loop, in place of updatePhase, on a synced oscillator.
+    // sinceWrap is how far (in samples) this sample is past a wrap of the master, or
+    // negative if the master didn't wrap before it. On a wrap, the phase restarts as
+    // if at the exact moment of the wrap, and resetFrom is where it was at that moment.
+    __forceinline size_t updateSyncedPhase(float sinceWrap, phase_t& resetFrom, float pitchRatio = 1.0f)
+    {
+        const phase_t previous = m_phase_counter;
+        const phase_t phase = updatePhaseAccumulator(pitchRatio);
+        if (sinceWrap < 0.0f)
+            return phase >> PHASE_FRACTION_BITS;
+
+        const float increment = float(phase_t(phase - previous));
+        resetFrom = previous + phase_t(increment * (1.0f - sinceWrap));
+        m_phase_counter = phase_t(increment * sinceWrap);
+        return m_phase_counter >> PHASE_FRACTION_BITS;
+    }
+
+    // Work out, without advancing anything, where the phase will wrap over the next
+    // wraps.size() samples, given the pitch ramp they'll be rendered with. Each entry
+    // is how far that sample is past a wrap (see updateSyncedPhase), or -1 for none.
+    void findWraps(std::span<float> wraps, float pitchRatio, float pitchRatioStep) const
+    {
+        Fader<phase_t, PhaseFadeLength> stepFader = m_phase_step_fader;
+        phase_t counter = m_phase_counter;
+        for (float& wrap : wraps)
+        {
+            const phase_t increment = scalePhaseStep(stepFader.update(), pitchRatio);
+            const phase_t next = counter + increment;
+            wrap = next < counter ? float(next) / float(increment) : -1.0f;
+            counter = next;
+            pitchRatio += pitchRatioStep;
+        }
+    }
+
+    // Fill output with the next samples of a noise type's noise.
+    void generateNoise(std::span<float> output)
     {
-        auto onVolumeFadeEnd = [this]
+        switch (m_settings.type)
         {
-            if (m_settings.state == OscillatorState::FadingIn)
-                m_settings.state = OscillatorState::Active;
-            else if (m_settings.state == OscillatorState::FadingOutDeactivate)
-                m_settings.state = OscillatorState::Deactivated;
-            else if (m_settings.state == OscillatorState::FadingOutRemove)
-                reset();
-        };
+        case OscillatorType::PinkNoise:  m_noise.generatePink(output);  break;
+        case OscillatorType::BrownNoise: m_noise.generateBrown(output); break;
+        default:                         m_noise.generateWhite(output); break;
+        }
+    }
+
+    // Every oscillator gets its own noise and unison start phases, the same on every
+    // run. Seed before rendering: the unison phases are drawn again from the new seed.
+    void seed(uint32_t seed)
+    {
+        m_noise.seed(seed);
+        m_unison_seed = seed * 0x85EBCA6Bu;
+        for (size_t lane = 0; lane < MAX_UNISON_VOICES; ++lane)
+            m_unison_phase[lane] = nextUnisonPhase();
+    }
+
+    // Designed to be called in a loop... Advances every unison voice by one sample
+    // and returns the stereo sum of their table values.
+    __forceinline std::pair<float, float> updateUnison(const std::array<float, TABLE_SIZE>& table, float pitchRatio = 1.0f)
+    {
+        if (Kernels::useScalar())
+            return updateUnisonScalar([&table](size_t index) { return table[index]; }, pitchRatio);
+        return updateUnisonLanes([&table](const phase_t* indices) {
+            return _mm_set_ps(table[indices[3]], table[indices[2]], table[indices[1]], table[indices[0]]);
+        }, pitchRatio);
+    }
+
+    // As above, but every lane reads between the same two wavetable frames.
+    __forceinline std::pair<float, float> updateUnison(const WavetableFrames& frames, float pitchRatio = 1.0f)
+    {
+        if (Kernels::useScalar())
+            return updateUnisonScalar([&frames](size_t index) { return frames.read(index); }, pitchRatio);
+        return updateUnisonLanes([&frames](const phase_t* indices) { return frames.readLanes(indices); }, pitchRatio);
+    }
+
+    // Designed to be called in a loop... Returns the position in the wavetable, in
+    // frames, with the offset (from modulation) added.
+    __forceinline float updateWavetablePosition(float offset = 0.0f)
+    {
+        return std::clamp(m_position_fader.update() + offset, 0.0f, float(WAVETABLE_FRAMES - 1));
+    }
+
+    // Whether the oscillator rests on a single frame, so it can be read from that
+    // frame's table alone rather than from two.
+    __forceinline bool isOnWavetableFrame() const
+    {
+        return m_position_fader.isFinished() && m_settings.wavetablePosition == std::floor(m_settings.wavetablePosition);
+    }
 
-        return m_settings.volume = m_volume_fader.update(onVolumeFadeEnd);
+    // Designed to be called in a loop...
+    __forceinline volume_t updateVolume()
+    {
+        return m_settings.volume = m_volume_fader.update();
     }
 
     std::tuple<float, float> updatePan()
@@ -146,6 +322,18 @@ struct Oscillator
     void activate(volume_t volume) { fadeIn(volume); }
     void deactivate(bool remove) { fadeOut(remove); }
 
+    // Called by the envelope bank at the end of a control block in which this
+    // oscillator's attack or release finished.
+    void onEnvelopeEvent(EnvelopeEvent event)
+    {
+        if (event == EnvelopeEvent::AttackEnded && m_settings.state == OscillatorState::FadingIn)
+            m_settings.state = OscillatorState::Active;
+        else if (event == EnvelopeEvent::ReleaseEnded && m_settings.state == OscillatorState::FadingOutDeactivate)
+            m_settings.state = OscillatorState::Deactivated;
+        else if (event == EnvelopeEvent::ReleaseEnded && m_settings.state == OscillatorState::FadingOutRemove)
+            reset();
+    }
+
     void setFrequency(frequency_t frequency)
     {
         m_phase_step_fader.fade(m_phase_step_fader.getValue(), hz_to_delta(frequency));
@@ -154,8 +342,9 @@ struct Oscillator
 
     void setVolume(volume_t volume)
     {
+        // Only the volume fades here; the state is left to the envelope.
         if (isActive())
-            fade(m_volume_fader.getValue(), volume, OscillatorState::Active);
+            fadeVolume(m_volume_fader.getValue(), volume);
         else
             m_settings.volume = volume;
     }
@@ -179,16 +368,71 @@ struct Oscillator
         m_settings.pan = pan;
     }
 
+    // Changing to a wave type scans over to its frame, so the wave morphs rather than jumps.
     void setType(OscillatorType type)
     {
+        if (!isNoise(type))
+            setWavetablePosition(float(type));
         m_settings.type = type;
     }
 
+    void setWavetablePosition(float position)
+    {
+        position = std::clamp(position, 0.0f, float(WAVETABLE_FRAMES - 1));
+        m_position_fader.fade(m_position_fader.getValue(), position);
+        m_settings.wavetablePosition = position;
+    }
+
+    void setSyncMaster(OscillatorId master)
+    {
+        m_settings.syncMaster = master;
+    }
+
+    void setEnvelope(EnvelopeSettings const& envelope)
+    {
+        m_settings.envelope = envelope;
+    }
+
+    void setUnison(UnisonSettings const& unison)
+    {
+        const size_t voices = std::clamp<size_t>(unison.voices, 1, MAX_UNISON_VOICES);
+        const bool voiceCountChanged = voices != m_settings.unison.voices || m_unison_lanes == 0;
+        m_settings.unison = unison;
+        m_settings.unison.voices = uint8_t(voices);
+        m_unison_lanes = (voices + UNISON_LANE_GROUP - 1) / UNISON_LANE_GROUP * UNISON_LANE_GROUP;
+
+        // Keep the overall loudness roughly constant as voices are added.
+        const float gain = 1.0f / std::sqrt(float(voices));
+        for (size_t lane = 0; lane < MAX_UNISON_VOICES; ++lane)
+        {
+            // Spread voices evenly from -1 to 1; a single voice sits in the center.
+            const float position = voices > 1 ? float(lane) / float(voices - 1) * 2.0f - 1.0f : 0.0f;
+            const bool audible = lane < voices;
+            const float pan = position * unison.spread;
+            m_unison_ratio[lane] = float(std::exp2(position * unison.detune / 1200.0f));
+            m_unison_left[lane] = audible ? gain * (pan > 0.0f ? 1.0f - pan : 1.0f) : 0.0f;
+            m_unison_right[lane] = audible ? gain * (pan < 0.0f ? 1.0f + pan : 1.0f) : 0.0f;
+        }
+
+        // Only restart the phases when voices come or go, so detune and spread
+        // changes don't click.
+        if (voiceCountChanged)
+        {
+            for (size_t lane = 0; lane < MAX_UNISON_VOICES; ++lane)
+                m_unison_phase[lane] = nextUnisonPhase();
+        }
+    }
+
     __forceinline OscillatorState getState()      const { return m_settings.state; }
+    __forceinline phase_t         getPhase()      const { return m_phase_counter; } // of the last sample rendered
     __forceinline OscillatorType  getType()       const { return m_settings.type; }
     __forceinline frequency_t     getFrequency()  const { return m_settings.frequency; }
     __forceinline volume_t        getVolume()     const { return m_settings.volume; }
     __forceinline pan_t           getPan()        const { return m_settings.pan; }
+    __forceinline float           getWavetablePosition() const { return m_settings.wavetablePosition; }
+    __forceinline OscillatorId    getSyncMaster() const { return m_settings.syncMaster; }
+    __forceinline EnvelopeSettings const& getEnvelope() const { return m_settings.envelope; }
+    __forceinline UnisonSettings const&   getUnison()   const { return m_settings.unison; }
     __forceinline phase_t         getPhaseStep()  const { return m_phase_step; }
     __forceinline bool            isInitialized() const { return m_settings.state != OscillatorState::Uninitialized; }
     __forceinline bool            isActive()      const { return m_settings.state == OscillatorState::Active              ||
@@ -198,38 +442,39 @@ struct Oscillator
 
     void reset() { *this = Oscillator(); }
 
-    void fade(volume_t start, volume_t target, OscillatorState state)
+    void fadeVolume(volume_t start, volume_t target)
     {
-        m_settings.state = state;
         m_volume_fader.fade(start, target);
         m_settings.volume = start;
     }
 
     void fadeIn(volume_t target)
     {
-        // Set up the volume fade, starting at 0 and targeting the existing volume.
-        fade(0.0f, target, OscillatorState::FadingIn);
+        // The envelope's attack ramps up from silence, so the volume itself
+        // can jump straight to the target.
+        m_settings.state = OscillatorState::FadingIn;
+        fadeVolume(target, target);
     }
 
     void fadeOut(bool remove)
     {
-        // Set up the volume fade, starting at the current volume and targeting 0.
-        if (remove)
-            fade(m_settings.volume, 0.0f, OscillatorState::FadingOutRemove);
-        else
-            fade(m_settings.volume, 0.0f, OscillatorState::FadingOutDeactivate);
+        // The envelope's release ramps down to silence; the volume is untouched.
+        m_settings.state = remove ? OscillatorState::FadingOutRemove : OscillatorState::FadingOutDeactivate;
     }
 
 private:
     OscillatorSettings m_settings;
 
-    // Counter will wrap around at UINT16_MAX back to 0.
+    // The largest step scalePhaseStep gives: one short of a whole cycle.
+    static constexpr double MAX_PHASE_STEP = PHASE_CYCLE - 1.0;
+
+    // Counter will wrap around at UINT32_MAX back to 0: a full cycle.
     phase_t m_phase_counter{ 0 };
     phase_t m_phase_step{ 0 };
 
     // Automatically fade volume after a volume change.
     // This helps avoid discontinuities at sample chunk boundaries.
-    // The fade length should probably be configurable.
+    // Attack and release are the envelope's job; this only smooths volume edits.
     static constexpr uint16_t VolumeFadeLength{ 256 };
     Fader<volume_t, VolumeFadeLength> m_volume_fader;
 
@@ -242,9 +487,88 @@ private:
     Fader<pan_t, PanFadeLength> m_left_pan_fader;
     Fader<pan_t, PanFadeLength> m_right_pan_fader;
 
-    // TODO: support lerp between waves
-    //static constexpr uint16_t WaveTypeFadeLength {256};
-    //Fader<float, WaveTypeFadeLength> m_wave_type_fader;
+    // Automatically scan to a new wavetable position after a position or type change.
+    static constexpr uint16_t PositionFadeLength{ 256 };
+    Fader<float, PositionFadeLength> m_position_fader;
+
+    // Random start phases come from a seeded generator (see seed), so offline renders repeat exactly.
+    phase_t nextUnisonPhase()
+    {
+        // splitmix32
+        uint32_t z = (m_unison_seed += 0x9E3779B9u);
+        z = (z ^ (z >> 16)) * 0x85EBCA6Bu;
+        z = (z ^ (z >> 13)) * 0xC2B2AE35u;
+        return z ^ (z >> 16);
+    }
+
+    // Four lanes at a time with SSE: the phases advance and the values are panned and
+    // summed a register at a time. There's no gather before AVX2, so read, given the
+    // four lanes' table indices, looks them up one lane at a time.
+    template<class Read>
+    __forceinline std::pair<float, float> updateUnisonLanes(Read&& read, float pitchRatio)
+    {
+        updatePhaseAccumulator(pitchRatio);
+        const __m128 step = _mm_set1_ps(float(scalePhaseStep(m_phase_step, pitchRatio)));
+
+        // An increment is below 2^32 but may not be below 2^31, past the signed range
+        // cvttps converts; taking 2^32 off those gives the same bits once wrapped.
+        const __m128 signedLimit = _mm_set1_ps(2147483648.0f);
+        const __m128 cycle = _mm_set1_ps(4294967296.0f);
+
+        __m128 left = _mm_setzero_ps();
+        __m128 right = _mm_setzero_ps();
+        alignas(16) std::array<phase_t, UNISON_LANE_GROUP> indices;
+        for (size_t lane = 0; lane < m_unison_lanes; lane += UNISON_LANE_GROUP)
+        {
+            __m128 increment = _mm_mul_ps(step, _mm_load_ps(&m_unison_ratio[lane]));
+            increment = _mm_sub_ps(increment, _mm_and_ps(_mm_cmpge_ps(increment, signedLimit), cycle));
+            __m128i* const phase = reinterpret_cast<__m128i*>(&m_unison_phase[lane]);
+            const __m128i advanced = _mm_add_epi32(_mm_load_si128(phase), _mm_cvttps_epi32(increment));
+            _mm_store_si128(phase, advanced);
+
+            _mm_store_si128(reinterpret_cast<__m128i*>(indices.data()), _mm_srli_epi32(advanced, PHASE_FRACTION_BITS));
+            const __m128 value = read(indices.data());
+            left = _mm_add_ps(left, _mm_mul_ps(value, _mm_load_ps(&m_unison_left[lane])));
+            right = _mm_add_ps(right, _mm_mul_ps(value, _mm_load_ps(&m_unison_right[lane])));
+        }
+        return { HorizontalSum(left), HorizontalSum(right) };
+    }
+
+    // The scalar reference for updateUnisonLanes: a lane at a time, read given one table index.
+    template<class Read>
+    __forceinline std::pair<float, float> updateUnisonScalar(Read&& read, float pitchRatio)
+    {
+        updatePhaseAccumulator(pitchRatio);
+        const float step = float(scalePhaseStep(m_phase_step, pitchRatio));
+
+        float left = 0.0f;
+        float right = 0.0f;
+        for (size_t lane = 0; lane < m_unison_lanes; ++lane)
+        {
+            m_unison_phase[lane] += phase_t(int64_t(step * m_unison_ratio[lane]));
+            const float value = read(size_t(m_unison_phase[lane] >> PHASE_FRACTION_BITS));
+            left += value * m_unison_left[lane];
+            right += value * m_unison_right[lane];
+        }
+        return { left, right };
+    }
+
+    static __forceinline float HorizontalSum(__m128 sum)
+    {
+        sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+        sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+        return _mm_cvtss_f32(sum);
+    }
+
+    NoiseSource m_noise;
+
+    // Unison voice state, one lane per voice.
+    size_t m_unison_lanes{ 0 };
+    uint32_t m_unison_seed{ 0 };
+    alignas(32) std::array<phase_t, MAX_UNISON_VOICES> m_unison_phase{};
+    alignas(32) std::array<float, MAX_UNISON_VOICES>   m_unison_ratio{};
+    alignas(32) std::array<float, MAX_UNISON_VOICES>   m_unison_left{};
+    alignas(32) std::array<float, MAX_UNISON_VOICES>   m_unison_right{};
 };
 
 // A collection of oscillators, this represents the state of a single generator.
@@ -267,10 +591,30 @@ struct Oscillators
             return std::nullopt;
 
         oscillator.fadeIn(oscillator.getVolume());
+        oscillator.seed(getOscillatorSeed(id.value()));
+        m_envelopes.noteOn(id.value(), oscillator.getEnvelope());
         m_oscillators.at(id.value()) = std::move(oscillator);
         return id;
     }
 
+    // Put an oscillator at a specific id, replacing whatever was there. Used to build
+    // a bank from a preset, where the ids have to match the saved ones.
+    void placeOscillator(OscillatorId id, OscillatorSettings settings)
+    {
+        Oscillator oscillator(std::move(settings));
+        oscillator.seed(getOscillatorSeed(id));
+        if (oscillator.getState() == OscillatorState::Deactivated || !oscillator.isInitialized())
+        {
+            m_envelopes.reset(id);
+        }
+        else
+        {
+            oscillator.fadeIn(oscillator.getVolume());
+            m_envelopes.noteOn(id, oscillator.getEnvelope());
+        }
+        m_oscillators.at(id) = std::move(oscillator);
+    }
+
     // Remove the oscillator at the given id.
     // Returns false if the given oscillator id doesn't exist.
     bool removeOscillator(OscillatorId id)
@@ -280,13 +624,17 @@ struct Oscillators
             return false;
 
         oscillator.deactivate(true);
+        m_envelopes.noteOff(id);
         return true;
     }
 
     void removeAllOscillators()
     {
-        for (auto& oscillator : m_oscillators)
-            oscillator.deactivate(true);
+        for (OscillatorId id = 0; id < MAX_OSCILLATORS; ++id)
+        {
+            if (m_oscillators.at(id).isInitialized())
+                removeOscillator(id);
+        }
     }
 
     // Activate the oscillator at the given id.
@@ -298,6 +646,7 @@ struct Oscillators
             return false;
 
         oscillator.activate(volume);
+        m_envelopes.noteOn(id, oscillator.getEnvelope());
         return true;
     }
 
@@ -310,6 +659,7 @@ struct Oscillators
             return false;
 
         oscillator.deactivate(false);
+        m_envelopes.noteOff(id);
         return true;
     }
 
@@ -353,6 +703,84 @@ struct Oscillators
         return true;
     }
 
+    bool setWavetablePosition(OscillatorId id, float position)
+    {
+        auto& oscillator = m_oscillators.at(id);
+        if (!oscillator.isInitialized())
+            return false;
+
+        oscillator.setWavetablePosition(position);
+        return true;
+    }
+
+    // Sync an oscillator to another, or pass NO_SYNC_MASTER to stop syncing it.
+    // An oscillator can't be synced to itself, and sync doesn't chain: the master
+    // can't be synced itself, and an oscillator others follow can't become synced.
+    // (A master's wraps are predicted from its free-running phase, which a synced
+    // master doesn't have.) Nor can noise lead; it has no phase to wrap.
+    bool setSyncMaster(OscillatorId id, OscillatorId master)
+    {
+        auto& oscillator = m_oscillators.at(id);
+        if (!oscillator.isInitialized() || master == id || (master >= MAX_OSCILLATORS && master != NO_SYNC_MASTER))
+            return false;
+
+        if (master != NO_SYNC_MASTER)
+        {
+            if (m_oscillators.at(master).getSyncMaster() != NO_SYNC_MASTER || isNoise(m_oscillators.at(master).getType()))
+                return false;
+            for (auto const& other : m_oscillators)
+            {
+                if (other.isInitialized() && other.getSyncMaster() == id)
+                    return false;
+            }
+        }
+
+        oscillator.setSyncMaster(master);
+        return true;
+    }
+
+    bool setUnison(OscillatorId id, UnisonSettings const& unison)
+    {
+        auto& oscillator = m_oscillators.at(id);
+        if (!oscillator.isInitialized())
+            return false;
+
+        oscillator.setUnison(unison);
+        return true;
+    }
+
+    bool setEnvelope(OscillatorId id, EnvelopeSettings const& envelope)
+    {
+        auto& oscillator = m_oscillators.at(id);
+        if (!oscillator.isInitialized())
+            return false;
+
+        oscillator.setEnvelope(envelope);
+        m_envelopes.setSettings(id, envelope);
+        return true;
+    }
+
+    // Let each oscillator react to its envelope finishing an attack or release.
+    // Called once per control block, after the block has been rendered, so the
+    // tail of a release is heard before the oscillator is deactivated or reset.
+    void handleEnvelopeEvents()
+    {
+        for (OscillatorId id = 0; id < MAX_OSCILLATORS; ++id)
+        {
+            const EnvelopeEvent event = m_envelopes.takeEvent(id);
+            if (event == EnvelopeEvent::None)
+                continue;
+
+            auto& oscillator = m_oscillators.at(id);
+            oscillator.onEnvelopeEvent(event);
+            if (!oscillator.isInitialized())
+                m_envelopes.reset(id);
+        }
+    }
+
+    __forceinline Oscillator& at(OscillatorId id) { return m_oscillators[id]; }
+    __forceinline Envelopes<MAX_OSCILLATORS>& getEnvelopes() { return m_envelopes; }
+
     size_t getMaxSize() const { return m_oscillators.max_size(); }
     size_t countActiveOscillators() const
     {
@@ -365,7 +793,14 @@ struct Oscillators
     auto cbegin() const { return m_oscillators.cbegin(); }
     auto cend()   const { return m_oscillators.cend(); }
 
+    // Oscillators added from now on are seeded from this and their id, so no two
+    // oscillators in any generator share noise or unison phases. Give each generator
+    // its own.
+    void setSeed(uint32_t seed) { m_seed = seed; }
+
 private:
+    uint32_t getOscillatorSeed(OscillatorId id) const { return m_seed * MAX_OSCILLATORS + id; }
+
     // Returns the lowest index possible that contains an uninitialized oscillator.
     std::optional<OscillatorId> getNextOscillatorId() const
     {
@@ -390,4 +825,6 @@ private:
     }
 
     std::array<Oscillator, MAX_OSCILLATORS> m_oscillators;
+    Envelopes<MAX_OSCILLATORS> m_envelopes;
+    uint32_t m_seed{ 0 };
 };
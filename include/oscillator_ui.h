@@ -1,12 +1,17 @@
 #pragma once
 
 #include "oscillator.h"
+#include "preset.h"
 #include "thread_communication.h"
 
 #include "portaudio.h"
 
+#include <future>
+
 struct UIOscillatorView
 {
+    explicit UIOscillatorView(size_t generator) : m_generator(generator) { }
+
     // This function, called from the non-realtime thread, checks for responses
     // to requests sent in prior frames. Responses must come back in the same
     // order that they were sent, and they must have the expected response values.
@@ -16,16 +21,100 @@ struct UIOscillatorView
     // changes settings.
     void Show();
 
+    // Draw the LFOs, the modulation routes, and the control rate.
+    void ShowModulation();
+
+    // Draw the FM operator groups.
+    void ShowFm();
+
+    // Draw the granular clouds.
+    void ShowGranular();
+
+    // Draw the sample files and the streaming sample voices.
+    void ShowSamples();
+
+    // Draw the MIDI file player.
+    void ShowMidi();
+
+    // Draw the partial analyzer and the resynthesis player.
+    void ShowResynthesis();
+
 private:
+    // The generator this view edits.
+    size_t m_generator{ 0 };
+
     // Get a request id suitable for identifying the next request event.
     RequestId GetNextRequestId();
 
     // Draw the settings for a single oscillator.
     void ShowOscillator(const OscillatorId& oscillatorId, const OscillatorSettings& settings);
 
+    // Draw the ADSR settings for a single oscillator.
+    void ShowEnvelope(const OscillatorId& oscillatorId, const EnvelopeSettings& envelope);
+
+    // Draw what every voice is doing right now, from the realtime thread's latest snapshot.
+    void ShowVoices();
+
+    // Draw the unison settings for a single oscillator.
+    void ShowUnison(const OscillatorId& oscillatorId, const UnisonSettings& unison);
+
+    // Draw the hard sync setting for a single oscillator.
+    void ShowSync(const OscillatorId& oscillatorId, OscillatorId syncMaster);
+
     // Keep track of the request id that's next up. I think uint32 is Unique Enough.
     RequestId m_currentRequestId{ 0 };
 
+    // Draw the settings for a single LFO or modulation route.
+    void ShowLfo(size_t lfoIndex, const LfoSettings& lfo);
+    void ShowRoute(size_t routeIndex, const ModulationRoute& route);
+
+    // Draw the settings for a single FM group.
+    void ShowFmGroup(size_t groupIndex, const FmGroupSettings& group);
+
+    // Draw the settings for a single grain cloud.
+    void ShowGrainCloud(size_t cloudIndex, const GrainCloudSettings& cloud);
+
     // Updated when a response comes back successfully (and only then).
     std::unordered_map<OscillatorId, OscillatorSettings> m_oscillators;
+    std::array<LfoSettings, MAX_LFOS> m_lfos{};
+    std::array<ModulationRoute, MAX_MODULATION_ROUTES> m_routes{};
+    size_t m_controlBlockSize{ CONTROL_BLOCK_SIZE };
+    std::array<FmGroupSettings, MAX_FM_GROUPS> m_fmGroups{};
+    std::array<GrainCloudSettings, MAX_GRAIN_CLOUDS> m_grainClouds{};
+
+    // Settings for the next sample to play.
+    char m_samplePath[260]{};
+    float m_sampleRate{ 1.0f };
+    volume_t m_sampleVolume{ 0.5f };
+
+    // Loaded MIDI files stay loaded; the realtime thread may be playing any of them.
+    char m_midiPath[260]{};
+    char m_midiRenderPath[260]{ "render.wav" };
+    MidiSettings m_midiSettings{};
+    std::vector<std::unique_ptr<MidiSequence>> m_midiSequences;
+
+    // The offline render in progress, if any, and how the last one went.
+    std::future<bool> m_midiRender;
+    const char* m_midiRenderStatus{ "" };
+
+    // Loaded partial tracks stay loaded too, for the same reason.
+    char m_resynthesisWavPath[260]{};
+    char m_partialsPath[260]{ "analysis.partials" };
+    ResynthesisSettings m_resynthesisSettings{};
+    float m_resynthesisSemitones{ 0.0f };
+    std::vector<std::unique_ptr<PartialTracks>> m_partialTracks;
+
+    // Presets: the one on its way to the realtime thread replaces m_oscillators once installed.
+    char m_presetPath[260]{ "preset.avp" };
+    std::optional<PresetSnapshot> m_pendingPreset;
 };
+
+// Each generator has its own view.
+UIOscillatorView& GetUIOscillatorView(size_t generator);
+
+// Draw every generator's mix gain and CPU load, and let the user pick which
+// generator the other windows edit. Returns the picked generator.
+size_t ShowGeneratorMixer();
+
+// Draw the master bus reverb: the impulse response it's using and how wet it is.
+void ShowReverb();
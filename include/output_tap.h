@@ -0,0 +1,63 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// A copy of the recent output of the audio callback, for analysis and display
+// off the realtime thread. The callback's only cost is one write into a fixed
+// ring. It never waits for readers; it just overwrites the oldest audio. Any
+// number of readers copy what they need straight out of the ring by absolute
+// frame position. A copy fails, rather than returning torn data, if the writer
+// came around and overwrote part of it.
+struct OutputTap
+{
+    // About 1.5s of stereo audio at 44.1 kHz.
+    static constexpr size_t TAP_FRAMES = size_t(1) << 16;
+
+    static OutputTap& getInstance();
+
+    // Call on the audio callback's thread with interleaved stereo samples.
+    void write(const float* samples, size_t frames)
+    {
+        const uint64_t written = m_written.load(std::memory_order_relaxed);
+
+        // Claim the frames before overwriting them, so readers can tell.
+        m_claimed.store(written + frames, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        for (size_t index = 0; index < frames * 2; ++index)
+            m_samples[(written * 2 + index) & MASK].store(samples[index], std::memory_order_relaxed);
+
+        m_written.store(written + frames, std::memory_order_release);
+    }
+
+    // Frames written so far; the newest frame is at getWritten() - 1. Safe from any thread.
+    uint64_t getWritten() const { return m_written.load(std::memory_order_acquire); }
+
+    // Copy frames [start, start + frames) as separate left and right channels.
+    // Returns false if any of them haven't been written yet, or were overwritten.
+    bool copy(uint64_t start, size_t frames, float* left, float* right) const
+    {
+        if (frames > TAP_FRAMES || start + frames > getWritten())
+            return false;
+
+        for (size_t frame = 0; frame < frames; ++frame)
+        {
+            const size_t index = size_t((start + frame) * 2) & MASK;
+            left[frame] = m_samples[index].load(std::memory_order_relaxed);
+            right[frame] = m_samples[index + 1].load(std::memory_order_relaxed);
+        }
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return m_claimed.load(std::memory_order_relaxed) - start <= TAP_FRAMES;
+    }
+
+private:
+    static constexpr size_t MASK = TAP_FRAMES * 2 - 1;
+
+    alignas(64) std::atomic<uint64_t> m_written{ 0 }; // frames fully written
+    std::atomic<uint64_t> m_claimed{ 0 };             // frames written or being written
+    alignas(64) std::array<std::atomic<float>, TAP_FRAMES * 2> m_samples{};
+};
@@ -1,5 +1,7 @@
 #pragma once
 
+#include "constants.h"
+
 #include "portaudio.h"
 
 using PaCallbackT = int (*)(
@@ -9,6 +11,17 @@ using PaCallbackT = int (*)(
     const PaStreamCallbackTimeInfo*,
     PaStreamCallbackFlags, void*);
 
-PaStream* InitializePAStream(PaCallbackT paCallback);
+// Open and start an output stream. framesPerBuffer asks for a fixed buffer size
+// (and a matching latency); unspecified leaves both to the device. Returns null
+// if the stream couldn't be opened or started.
+PaStream* InitializePAStream(PaCallbackT paCallback,
+                             unsigned long framesPerBuffer = paFramesPerBufferUnspecified,
+                             void* userData = nullptr,
+                             double sampleRate = SAMPLE_RATE);
+
+// The rate the output device runs at by default (in WASAPI shared mode, the rate
+// the system mixes at), or 0 if there's no output device.
+double GetOutputDeviceSampleRate();
 
-void TearDownPAStream(PaStream* stream);
+// Stop and close one stream, leaving portaudio running.
+void ClosePAStream(PaStream* stream);
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+// Partials: a sound analyzed into sinusoids that drift in frequency and amplitude
+// over time, for resynthesis (see resynthesis.h). A partial file holds a series of
+// analysis frames, one every hop; each frame lists the partials sounding at that
+// moment. Each partial belongs to a slot, which it keeps from frame to frame for
+// as long as it lasts, so the player can run one oscillator per slot. A slot is
+// only ever reused after at least one frame without a partial in it.
+
+// Playback runs one oscillator per slot; analysis never uses more than this many.
+constexpr size_t MAX_PARTIALS = 1024;
+
+// One partial in one frame. Eight bytes, written as is.
+struct PartialPoint
+{
+    uint16_t slot{ 0 };
+    uint16_t amplitude{ 0 }; // linear, out of UINT16_MAX
+    float    frequency{ 0 }; // Hz
+};
+static_assert(sizeof(PartialPoint) == 8);
+
+// The file is this header, then the number of points in each frame (a uint32_t
+// per frame), then every frame's points back to back.
+struct PartialFileHeader
+{
+    char     magic[4]{ 'A', 'V', 'P', 'T' };
+    uint32_t version{ 1 };
+    uint32_t sampleRate{ 0 }; // of the analyzed file
+    uint32_t hopSize{ 0 };    // frames of the analyzed file between analysis frames
+    uint32_t frameCount{ 0 };
+    uint32_t pointCount{ 0 };
+};
+
+// A partial file, in memory. Loaded partials stay loaded; the realtime thread may
+// be playing any of them.
+struct PartialTracks
+{
+    uint32_t sampleRate{ 0 };
+    uint32_t hopSize{ 0 };
+    std::vector<uint32_t> frameStart; // where each frame's points start, plus one past the end
+    std::vector<PartialPoint> points;
+
+    size_t getFrameCount() const { return frameStart.empty() ? 0 : frameStart.size() - 1; }
+    double getSeconds() const { return sampleRate == 0 ? 0.0 : double(getFrameCount()) * hopSize / sampleRate; }
+
+    std::span<const PartialPoint> getFrame(size_t frame) const
+    {
+        return std::span(points).subspan(frameStart[frame], frameStart[frame + 1] - frameStart[frame]);
+    }
+};
+
+struct PartialAnalysisSettings
+{
+    uint32_t fftSize{ 4096 };
+    uint32_t hopSize{ 256 };
+    float    thresholdDb{ -72.0f }; // quieter peaks are ignored, relative to a full-scale sine
+    size_t   maxPartials{ MAX_PARTIALS };
+    size_t   threads{ 0 };          // 0 uses every hardware thread
+};
+
+// Analyze a WAV file into partial tracks. This takes a while; call it off the UI
+// thread if you can. The spectra are computed on several threads; tracking the
+// peaks from frame to frame happens afterwards, in order, on the calling thread.
+std::optional<PartialTracks> AnalyzePartials(const std::string& wavPath, const PartialAnalysisSettings& settings = {});
+
+bool SavePartials(const PartialTracks& tracks, const std::string& path);
+std::optional<PartialTracks> LoadPartials(const std::string& path);
@@ -1,11 +1,22 @@
 #pragma once
 
+#include "generator.h"
 #include "logging.h"
+#include "spectrum_analyzer.h"
 
 namespace Plotting
 {
     // Draw a live updating graph of L, R signals. Right now it moves too fast and I get dizzy lol
     // Requires log buffers (LOG_SESSION_TO_FILE), which should probably be moving windows of history.
     void DrawOscilatorPlot(const std::vector<float>& logBufferL, const std::vector<float>& logBufferR);
+
+    // Draw the spectrum analyzer's latest frame: band levels, and their held peaks, over log frequency.
+    void DrawSpectrum(const std::array<float, SPECTRUM_BANDS>& bandFrequencies, const SpectrumFrame& frame);
+
+    // Draw a triggered oscilloscope of the output tap. Each frame copies one window's
+    // worth of audio (plus room to search for a trigger) and plots it in place. The
+    // trigger can be a rising edge through a level, a crossing of the level in either
+    // direction, or the start of a cycle of one of the voices.
+    void DrawScope(std::span<const VoiceSnapshot> voices);
 }
 
@@ -0,0 +1,79 @@
+#pragma once
+
+#include "oscillator.h"
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+
+constexpr size_t PRESET_OSCILLATORS = 8;
+constexpr uint32_t PRESET_VERSION = 3;
+
+// A preset is this struct, byte for byte, on disk. Loading one maps the file and
+// checks the header; there is nothing to parse. Any change to OscillatorSettings
+// changes the layout, so bump PRESET_VERSION along with it.
+struct PresetSnapshot
+{
+    char     magic[4]{ 'A', 'V', 'P', 'S' };
+    uint32_t version{ PRESET_VERSION };
+    uint32_t oscillatorCount{ PRESET_OSCILLATORS };
+    uint32_t size{ 0 }; // sizeof(PresetSnapshot), to catch layout changes without a version bump
+
+    // Indexed by oscillator id. Uninitialized entries are empty slots.
+    std::array<OscillatorSettings, PRESET_OSCILLATORS> oscillators{};
+};
+static_assert(std::is_trivially_copyable_v<PresetSnapshot>);
+
+// Capture the oscillators the UI knows about. Oscillators caught mid-fade are saved
+// as whatever they're fading towards.
+PresetSnapshot MakePresetSnapshot(const std::unordered_map<OscillatorId, OscillatorSettings>& oscillators);
+
+bool SavePreset(const PresetSnapshot& preset, const std::string& path);
+
+// A preset file mapped into memory, read-only. The snapshot is valid for as long as
+// the MappedPreset lives.
+struct MappedPreset
+{
+    ~MappedPreset();
+
+    const PresetSnapshot& get() const { return *m_snapshot; }
+
+    // Returns nothing if the file can't be mapped or isn't a preset of this version.
+    static std::unique_ptr<MappedPreset> open(const std::string& path);
+
+private:
+    MappedPreset() = default;
+
+    const PresetSnapshot* m_snapshot{ nullptr };
+    void*                 m_file{ nullptr };    // OS handles, released on destruction
+    void*                 m_mapping{ nullptr };
+};
+
+// Check the header, and every field of every oscillator against the rules the
+// setters apply: a mapped file is only bytes, and may be corrupt or hand-edited.
+bool IsValidPreset(const PresetSnapshot& preset);
+
+// Build a complete bank of oscillators from a snapshot. This happens off the
+// realtime thread; the realtime thread only swaps the finished bank in. Returns
+// nothing if any part of the snapshot is invalid. The seed is the generator's (see
+// Generator::setSeed).
+template<uint8_t MAX_OSCILLATORS>
+std::unique_ptr<Oscillators<MAX_OSCILLATORS>> BuildOscillators(const PresetSnapshot& preset, uint32_t seed)
+{
+    static_assert(MAX_OSCILLATORS == PRESET_OSCILLATORS);
+
+    if (!IsValidPreset(preset))
+        return nullptr;
+
+    auto bank = std::make_unique<Oscillators<MAX_OSCILLATORS>>();
+    bank->setSeed(seed);
+    for (OscillatorId id = 0; id < MAX_OSCILLATORS; ++id)
+    {
+        if (preset.oscillators[id].state != OscillatorState::Uninitialized)
+            bank->placeOscillator(id, preset.oscillators[id]);
+    }
+    return bank;
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdio>
+
+// Realtime-safety checking - if enabled, anything that allocates, frees, or blocks
+// while a thread is rendering audio is recorded (or aborts the program). It's
+// meant for debugging and for headless runs like --render-check, not for shipping:
+// it replaces the global operator new and delete, and with glibc, malloc, calloc,
+// realloc, free, pthread_mutex_lock, and pthread_cond_wait as well. Elsewhere, other
+// blocking calls are only caught where checkBlockingCall marks them. Enable it by
+// building with REALTIME_SANITIZER defined to true (the CMake option of the same name).
+#ifndef REALTIME_SANITIZER
+#define REALTIME_SANITIZER false
+#endif
+
+namespace RealtimeSanitizer
+{
+    enum class Mode
+    {
+        Record, // count each violation and keep the first few stacks
+        Abort   // report the violation and abort on the spot
+    };
+
+    // Stacks are kept for this many violations; after that, they're only counted.
+    constexpr size_t MAX_RECORDED_VIOLATIONS = 64;
+    constexpr size_t MAX_STACK_FRAMES = 24;
+
+#if REALTIME_SANITIZER
+
+    void setMode(Mode mode);
+
+    // Marks the rest of the enclosing block as realtime on this thread. Scopes nest.
+    struct ScopedRealtime
+    {
+        ScopedRealtime();
+        ~ScopedRealtime();
+        ScopedRealtime(const ScopedRealtime&) = delete;
+        ScopedRealtime& operator=(const ScopedRealtime&) = delete;
+    };
+
+    // Call at the top of anything that can block (locks, file access, sleeps), and
+    // before any other system call the audio threads make, like waking another
+    // thread. Allocation is caught without this.
+    void checkBlockingCall(const char* what);
+
+    // Safe from any thread.
+    size_t getViolationCount();
+
+    // Write the count and the recorded stacks. Call off the realtime thread.
+    void report(FILE* output);
+
+#else
+
+    inline void setMode(Mode) {}
+
+    struct ScopedRealtime
+    {
+        // Not = default, so unused-variable warnings stay quiet when disabled.
+        ScopedRealtime() {}
+        ~ScopedRealtime() {}
+    };
+
+    inline void checkBlockingCall(const char*) {}
+
+    inline size_t getViolationCount() { return 0; }
+
+    inline void report(FILE*) {}
+
+#endif
+}
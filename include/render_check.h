@@ -0,0 +1,96 @@
+#pragma once
+
+#include "kernels.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+// A regression check for the generator's rendering. A script of timed requests is
+// played through the same path the audio callback uses (the request queue,
+// ProcessModifyGeneratorRequests, and GeneratorMixer::writeSamples), and the output is compared
+// against a golden render saved earlier. Rendering is deterministic and needs no
+// audio device or window, so optimized kernels can be checked anywhere the
+// generator builds: render the goldens with the scalar reference, then run the
+// check against them with each kernel variant (see kernels.h). The scripts and goldens
+// kept in tests/render_check are run by ctest, once per variant.
+//
+//     render_check [--update] [--kernels sse|scalar] [--abort-on-violation] script.txt golden.wav
+//
+// (or audiovisual.exe --render-check, with the same arguments). Checks run the SSE
+// kernels unless told otherwise; --update saves the render as the new golden, with
+// the scalar kernels unless told otherwise. Built with REALTIME_SANITIZER, a render
+// that isn't realtime safe fails; --abort-on-violation stops it at the first
+// violation instead (see realtime_sanitizer.h).
+//
+// A script is plain text, one command per line; '#' starts a comment.
+//     length <frames>                       total frames to render (required)
+//     at <frame> add <type> <frequency> <volume>
+//     at <frame> remove <id>
+//     at <frame> activate <id> <volume>
+//     at <frame> deactivate <id>
+//     at <frame> frequency <id> <frequency>
+//     at <frame> volume <id> <volume>
+//     at <frame> pan <id> <pan>
+//     at <frame> type <id> <type>
+//     at <frame> morph <id> <position>       wavetable position, 0 (sine) to 3 (saw)
+//     at <frame> envelope <id> <attack> <decay> <sustain> <release>
+//     at <frame> unison <id> <voices> <detune> <spread>
+//     at <frame> sync <id> <master>         hard sync to another oscillator; -1 for off
+//     at <frame> blocksize <frames>
+//     at <frame> saturate <curve> <oversampling> <drive>   the output stage, from the buffer it lands in; 1, 2 or 4 times
+//     at <frame> lfo <index> <shape> <rate>
+//     at <frame> route <index> <lfo> <id> <destination> <depth>
+//     at <frame> fm <group> <algorithm> <depth> <feedback> <id> <id> <id> <id>   -1 for no operator
+// Types are sine, square, triangle, saw, white, pink, and brown. Curves are hardclip
+// (the default), tanh, softknee, and asymmetric. LFO shapes are sine, triangle, square,
+// and saw; destinations are volume, pan, frequency, and wavetable. Oscillators get ids
+// in the order they're added, starting at 0.
+namespace RenderCheck
+{
+    // Frames per GeneratorMixer::writeSamples call, standing in for the device buffer size.
+    constexpr size_t CHECK_BUFFER_FRAMES = 512;
+
+    // Defaults for passing a check. Reordered floating point math (SIMD) lands
+    // well inside these; a changed waveform doesn't.
+    constexpr double MAX_ERROR_TOLERANCE = 1e-4;    // -80 dBFS
+    constexpr double RMS_ERROR_TOLERANCE = 1e-5;    // -100 dBFS
+    constexpr double SPECTRAL_TOLERANCE_DB = 0.5;
+
+    struct Comparison
+    {
+        double maxError{ 0.0 };       // largest sample difference
+        double rmsError{ 0.0 };       // over every sample of both channels
+        double spectralError{ 0.0 };  // worst log-spectral distance of any analysis frame, in dB
+        bool   lengthMatches{ true };
+
+        bool passed() const
+        {
+            return lengthMatches && maxError <= MAX_ERROR_TOLERANCE && rmsError <= RMS_ERROR_TOLERANCE &&
+                   spectralError <= SPECTRAL_TOLERANCE_DB;
+        }
+    };
+
+    // Interleaved stereo.
+    using Render = std::vector<float>;
+
+    // Play a script through a generator that hasn't rendered anything yet. Returns
+    // nothing, and describes the problem in error, if the script doesn't parse.
+    std::optional<Render> RenderScript(const std::string& scriptPath, std::string& error);
+
+    // Golden renders are 32-bit float stereo wav files.
+    bool SaveGolden(const Render& render, const std::string& path);
+    std::optional<Render> LoadGolden(const std::string& path);
+
+    Comparison Compare(const Render& render, const Render& golden);
+
+    // Render the script with the given kernels and compare it with the golden, or (when
+    // updating) save it as the new golden. Writes a one-line report to stdout. Returns a
+    // process exit code.
+    int Run(const std::string& scriptPath, const std::string& goldenPath, bool updateGolden, KernelVariant kernels);
+
+    // Run from the arguments shown above, after the program's name (and --render-check).
+    int RunCommandLine(const std::vector<std::string>& arguments);
+}
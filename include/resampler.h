@@ -0,0 +1,203 @@
+#pragma once
+
+#include "constants.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <memory>
+#include <span>
+#include <vector>
+
+// Longer filters pass more of the top octave and reject more of the images, for more CPU.
+// The image levels are the worst found for a tone anywhere in the passband.
+enum class ResamplerQuality : uint8_t
+{
+    Draft,    // 16 taps: flat to about 16 kHz, images down 60 dB
+    Standard, // 32 taps: flat to about 18 kHz, images down 85 dB
+    High,     // 64 taps: flat to about 20 kHz, images down 94 dB
+    Count
+};
+
+// Stereo sample rate conversion by any ratio, through a windowed-sinc filter stored
+// as a bank of polyphase branches. Each output frame sits at a fractional position
+// in the input; the two branches either side of its fraction are interpolated into
+// one, which is then run across the input around the position with SSE, four taps
+// at a time, for both channels at once.
+//
+// The converter pulls its input: process asks a source for however many input frames
+// the output needs, so the source runs at its own (fixed) rate while the output runs
+// at any other. The ratio can be nudged while running (see setCorrection); a change
+// ramps in across the next call, so it doesn't click.
+//
+// Setting up allocates; processing doesn't.
+struct PolyphaseResampler
+{
+    // How far setCorrection can move the ratio, either way.
+    static constexpr double MAX_CORRECTION = 0.01;
+
+    // Calls to process longer than maxOutputFrames are handled in pieces.
+    PolyphaseResampler(ResamplerQuality quality, double inputRate, double outputRate, size_t maxOutputFrames);
+
+    // Scale the ratio (input frames per output frame) by correction, clamped to within
+    // MAX_CORRECTION of 1.
+    void   setCorrection(double correction) { m_target_correction = std::clamp(correction, 1.0 - MAX_CORRECTION, 1.0 + MAX_CORRECTION); }
+    double getCorrection() const            { return m_target_correction; }
+
+    // How far the output lags the input, in input frames.
+    double getDelay() const { return double(m_taps) / 2.0; }
+
+    ResamplerQuality getQuality() const { return m_quality; }
+
+    // Fill the (interleaved stereo) output. source(std::span<float>) is called with an
+    // interleaved stereo buffer to fill, once per piece of output, and may be given
+    // any number of frames, including none.
+    template<class Source>
+    void process(std::span<float> output, Source&& source)
+    {
+        const size_t frames = output.size() / 2;
+        for (size_t start = 0; start < frames; start += m_max_output_frames)
+        {
+            const size_t count = std::min(m_max_output_frames, frames - start);
+            const size_t needed = prepare(count);
+            if (needed > 0)
+                source(std::span(m_pulled).first(needed * 2));
+            render(output.subspan(start * 2, count * 2), needed);
+        }
+    }
+
+private:
+    // Work out the steps for the next count output frames; returns how many input
+    // frames have to be pulled to cover them.
+    size_t prepare(size_t count);
+
+    // Take in the pulled input, and write the output prepare was called for.
+    void render(std::span<float> output, size_t pulled);
+
+    ResamplerQuality m_quality;
+    size_t m_taps;
+    size_t m_phases;
+    size_t m_max_output_frames;
+
+    // Branch p (for a fraction of p / m_phases) is at p * m_taps; there's one extra
+    // branch at the end, for a fraction of 1, to interpolate towards.
+    std::vector<float> m_coefficients;
+
+    double m_nominal_step;              // input frames per output frame
+    double m_correction{ 1.0 };         // at the end of the last call
+    double m_target_correction{ 1.0 };
+
+    // The input from the oldest frame the next output needs, by channel; m_position is
+    // where in it the next output frame sits.
+    std::array<std::vector<float>, 2> m_input;
+    size_t m_available{ 0 };
+    double m_position{ 0.0 };
+
+    // For the piece between prepare and render.
+    double m_step{ 0.0 };
+    double m_step_change{ 0.0 };
+
+    std::vector<float> m_pulled; // interleaved
+};
+
+struct ResamplerSettings
+{
+    ResamplerQuality quality{ ResamplerQuality::Standard };
+
+    // Measure how fast the device really plays, and track it, so the engine renders
+    // exactly SAMPLE_RATE frames per second by the system clock (within
+    // MAX_CORRECTION). Converts even when the device's nominal rate is SAMPLE_RATE.
+    bool driftCompensation{ false };
+};
+
+// Converts the engine's output from SAMPLE_RATE to the rate the device runs at, so the
+// stream can be opened at the device's own rate and the conversion is ours rather than
+// the driver's. The UI thread sets it up; the audio thread picks up a new converter
+// between buffers and hands the old one back to be freed, like ConvolutionReverb.
+struct OutputResampler
+{
+    // Output buffers longer than this are converted in pieces.
+    static constexpr size_t MAX_OUTPUT_FRAMES = 2048;
+
+    static OutputResampler& getInstance();
+
+    ~OutputResampler();
+
+    // Call on the UI thread, before opening a stream at outputRate and whenever the
+    // settings change. At SAMPLE_RATE with no drift compensation, the engine's output
+    // passes straight through.
+    void configure(double outputRate, ResamplerSettings const& settings);
+
+    // Call on the UI thread, once a frame: frees converters the audio thread is done with.
+    void update();
+
+    // UI thread only: what configure was last called with.
+    double getOutputRate() const                { return m_output_rate; }
+    ResamplerSettings const& getSettings() const { return m_settings; }
+
+    // The device rate measured by drift compensation, or 0 until there's a measurement.
+    double getMeasuredRate() const { return m_measured_rate.load(std::memory_order_relaxed); }
+
+    // How far the output lags the engine, in seconds.
+    double getDelaySeconds() const { return m_delay_seconds.load(std::memory_order_relaxed); }
+
+    // Call on the audio thread. Fill the (interleaved stereo) output at the device rate,
+    // calling render(std::span<float>) for however much engine output that takes.
+    // dacTime is the stream time the output reaches the DAC (0 if the host can't say),
+    // for drift compensation.
+    template<class Render>
+    void process(std::span<float> output, double dacTime, Render&& render)
+    {
+        pickUpPending();
+        if (m_current == nullptr || m_current->resampler == nullptr)
+        {
+            render(output);
+            return;
+        }
+
+        if (m_current->driftCompensation)
+            trackDeviceRate(dacTime, output.size() / 2);
+        m_current->resampler->process(output, render);
+    }
+
+private:
+    // After this long, a measurement of the device rate is precise enough to act on.
+    static constexpr double MIN_MEASUREMENT_SECONDS = 2.0;
+
+    // A buffer reaching the DAC further than this from where the last one ended means
+    // frames went missing; see trackDeviceRate.
+    static constexpr double DISCONTINUITY_SECONDS = 0.005;
+
+    struct Converter
+    {
+        std::unique_ptr<PolyphaseResampler> resampler; // null passes straight through
+        double outputRate{ SAMPLE_RATE };
+        bool   driftCompensation{ false };
+    };
+
+    OutputResampler() = default;
+
+    void pickUpPending();
+    void trackDeviceRate(double dacTime, size_t frames);
+
+    // Ownership moves UI -> m_pending -> audio thread (m_current) -> m_retired -> UI.
+    // The audio thread only swaps once the last retired converter has been collected.
+    std::atomic<Converter*> m_pending{ nullptr };
+    std::atomic<Converter*> m_retired{ nullptr };
+    Converter* m_current{ nullptr };
+
+    // Audio thread: the device clock, since the measurement started.
+    double   m_clock_start{ 0.0 };
+    uint64_t m_clock_frames{ 0 };
+    bool     m_clock_started{ false };
+    double   m_last_dac_time{ 0.0 };
+    size_t   m_last_frames{ 0 };
+
+    std::atomic<double> m_measured_rate{ 0.0 };
+    std::atomic<double> m_delay_seconds{ 0.0 };
+
+    // UI thread only.
+    double m_output_rate{ SAMPLE_RATE };
+    ResamplerSettings m_settings{};
+};
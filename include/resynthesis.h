@@ -0,0 +1,204 @@
+#pragma once
+
+#include "constants.h"
+#include "partials.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <span>
+
+struct ResynthesisSettings
+{
+    float    stretch{ 1.0f }; // 2 plays at half speed; the pitch stays put
+    float    pitch{ 1.0f };   // frequency ratio; the timing stays put
+    volume_t volume{ 0.5f };
+    bool     loop{ false };
+};
+
+// Plays partial tracks (see partials.h) as a bank of sine oscillators, one per slot.
+// The bank is kept as parallel arrays (phase, phase step, amplitude, and the targets
+// for each), so a control block is one pass over each partial's state.
+//
+// Once per control block the player works out where it will be in the tracks at the
+// end of the block, reads every slot's frequency and amplitude there (interpolating
+// between the two analysis frames around it), and every oscillator glides to it
+// across the block. Time-stretching only changes how fast that position moves;
+// pitch-shifting scales every frequency. Partials pitched over Nyquist fall silent.
+struct ResynthesisPlayer
+{
+    // Start playing from the beginning. The tracks must stay loaded while they play.
+    // Returns false for empty tracks or bad settings.
+    bool play(const PartialTracks* tracks, ResynthesisSettings const& settings)
+    {
+        if (tracks == nullptr || tracks->getFrameCount() == 0 || tracks->hopSize == 0 || !setSettings(settings))
+            return false;
+
+        m_tracks = tracks;
+        m_position = 0.0;
+        m_stopping = false;
+        return true;
+    }
+
+    // Change the settings of what's playing, or of what plays next. Returns false if
+    // the stretch or pitch isn't positive.
+    bool setSettings(ResynthesisSettings const& settings)
+    {
+        if (!(settings.stretch > 0.0f) || !(settings.pitch > 0.0f))
+            return false;
+
+        m_settings = settings;
+        return true;
+    }
+
+    // Fade every partial out over the next control block, then stop.
+    void stop() { m_stopping = true; }
+
+    bool isPlaying() const { return m_tracks != nullptr; }
+    const PartialTracks* getTracks() const { return m_tracks; }
+    ResynthesisSettings const& getSettings() const { return m_settings; }
+
+    // Partials sounding at the end of the last block.
+    size_t getPartialCount() const { return m_partial_count; }
+
+    // Mix the partials into the (interleaved stereo) output block, the same in both channels.
+    void render(std::span<float> output)
+    {
+        if (m_tracks == nullptr)
+            return;
+
+        const size_t frames = output.size() / 2;
+        advance(frames);
+        loadTargets();
+        synthesize(frames);
+
+        const float volumeStep = (m_settings.volume - m_volume) / float(frames);
+        for (size_t frame = 0; frame < frames; ++frame)
+        {
+            m_volume += volumeStep;
+            output[frame * 2]     += m_mono[frame] * m_volume; // left channel
+            output[frame * 2 + 1] += m_mono[frame] * m_volume; // right channel
+        }
+        m_volume = m_settings.volume;
+
+        if (m_stopping)
+        {
+            // Every partial reached zero at the end of this block.
+            m_tracks = nullptr;
+            m_partial_count = 0;
+        }
+    }
+
+private:
+    // Move the position to the end of the coming block, in analysis frames.
+    void advance(size_t frames)
+    {
+        const PartialTracks& tracks = *m_tracks;
+        const double framesPerHop = double(tracks.hopSize) * SAMPLE_RATE / double(tracks.sampleRate);
+        m_position += double(frames) / (framesPerHop * double(m_settings.stretch));
+
+        const double last = double(tracks.getFrameCount() - 1);
+        if (m_position < last)
+            return;
+
+        if (m_settings.loop && last > 0.0)
+            m_position = std::fmod(m_position, last);
+        else
+            m_stopping = true;
+    }
+
+    // Fill in the targets for every slot at the current position. Slots that aren't in
+    // either frame fade to silence at whatever frequency they had.
+    void loadTargets()
+    {
+        m_target_amplitude.fill(0.0f);
+        if (m_stopping)
+            return;
+
+        const PartialTracks& tracks = *m_tracks;
+        const size_t frame = size_t(m_position);
+        const size_t nextFrame = std::min(frame + 1, tracks.getFrameCount() - 1);
+        const float t = float(m_position - double(frame));
+
+        if (++m_stamp == 0)
+        {
+            m_seen.fill(0);
+            m_stamp = 1;
+        }
+
+        constexpr float AMPLITUDE_SCALE = 1.0f / float(UINT16_MAX);
+        for (const PartialPoint& point : tracks.getFrame(frame))
+        {
+            m_target_amplitude[point.slot] = float(point.amplitude) * AMPLITUDE_SCALE * (1.0f - t);
+            m_target_frequency[point.slot] = point.frequency;
+            m_seen[point.slot] = m_stamp;
+        }
+        for (const PartialPoint& point : tracks.getFrame(nextFrame))
+        {
+            // A partial that only starts in the next frame is at its starting frequency already.
+            float& frequency = m_target_frequency[point.slot];
+            m_target_amplitude[point.slot] += float(point.amplitude) * AMPLITUDE_SCALE * t;
+            frequency = m_seen[point.slot] == m_stamp ? frequency + (point.frequency - frequency) * t : point.frequency;
+        }
+    }
+
+    void synthesize(size_t frames)
+    {
+        const float* const sine = WaveTables::getSine().data();
+        const float pitchToStep = m_settings.pitch * float(PHASE_CYCLE_OVER_SAMPLE_RATE);
+        constexpr float NYQUIST_STEP = float(PHASE_CYCLE / 2.0);
+        const float frameScale = 1.0f / float(frames);
+
+        std::fill(m_mono.begin(), m_mono.begin() + frames, 0.0f);
+        m_partial_count = 0;
+        for (size_t slot = 0; slot < MAX_PARTIALS; ++slot)
+        {
+            float amplitude = m_amplitude[slot];
+            const bool aboveNyquist = m_target_frequency[slot] * pitchToStep >= NYQUIST_STEP;
+            const float targetAmplitude = aboveNyquist ? 0.0f : m_target_amplitude[slot];
+            if (amplitude == 0.0f && targetAmplitude == 0.0f)
+                continue;
+
+            // Rising out of silence, there's nothing to glide from. A partial pitched past
+            // Nyquist fades out where it was instead of gliding on: up there it would only
+            // alias, and its step could overflow the phase.
+            float step = amplitude == 0.0f ? m_target_frequency[slot] * pitchToStep : m_step[slot];
+            const float targetStep = aboveNyquist ? step : m_target_frequency[slot] * pitchToStep;
+            const float amplitudeStep = (targetAmplitude - amplitude) * frameScale;
+            const float stepStep = (targetStep - step) * frameScale;
+            phase_t phase = m_phase[slot];
+            for (size_t frame = 0; frame < frames; ++frame)
+            {
+                m_mono[frame] += sine[phase >> PHASE_FRACTION_BITS] * amplitude;
+                phase += phase_t(step);
+                amplitude += amplitudeStep;
+                step += stepStep;
+            }
+
+            m_phase[slot] = phase;
+            m_step[slot] = targetStep;
+            m_amplitude[slot] = targetAmplitude;
+            m_partial_count += targetAmplitude > 0.0f ? 1 : 0;
+        }
+    }
+
+    const PartialTracks* m_tracks{ nullptr };
+    ResynthesisSettings m_settings{};
+    double m_position{ 0.0 }; // in analysis frames, at the end of the last block
+    bool m_stopping{ false };
+    volume_t m_volume{ 0.0f };
+    size_t m_partial_count{ 0 };
+
+    // The bank, by slot.
+    alignas(32) std::array<phase_t, MAX_PARTIALS> m_phase{};
+    alignas(32) std::array<float, MAX_PARTIALS> m_step{};
+    alignas(32) std::array<float, MAX_PARTIALS> m_amplitude{};
+    alignas(32) std::array<float, MAX_PARTIALS> m_target_amplitude{};
+    alignas(32) std::array<float, MAX_PARTIALS> m_target_frequency{};
+
+    // Which slots the first of the two frames had, while loading targets.
+    std::array<uint32_t, MAX_PARTIALS> m_seen{};
+    uint32_t m_stamp{ 0 };
+
+    alignas(32) std::array<float, MAX_CONTROL_BLOCK_SIZE> m_mono{};
+};
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+// A single-producer single-consumer ring buffer of trivially copyable values, for
+// moving bulk data (audio) between threads. Unlike the farbot fifo, which moves one
+// object at a time, reads and writes here move contiguous runs of values. All
+// storage is inline, so nothing allocates after construction, and neither side
+// ever blocks: a full or empty buffer just means a short read or write.
+template<class T, size_t CAPACITY>
+struct RingBuffer
+{
+    static_assert((CAPACITY & (CAPACITY - 1)) == 0, "capacity must be a power of 2");
+
+    // Producer side. Returns the number of values actually written.
+    size_t write(const T* values, size_t count)
+    {
+        const size_t writeIndex = m_write_index.load(std::memory_order_relaxed);
+        const size_t readIndex = m_read_index.load(std::memory_order_acquire);
+        count = std::min(count, CAPACITY - (writeIndex - readIndex));
+
+        const size_t start = writeIndex & MASK;
+        const size_t firstRun = std::min(count, CAPACITY - start);
+        std::copy_n(values, firstRun, m_values.begin() + start);
+        std::copy_n(values + firstRun, count - firstRun, m_values.begin());
+
+        m_write_index.store(writeIndex + count, std::memory_order_release);
+        return count;
+    }
+
+    // Consumer side. Returns the number of values actually read.
+    size_t read(T* values, size_t count)
+    {
+        const size_t readIndex = m_read_index.load(std::memory_order_relaxed);
+        const size_t writeIndex = m_write_index.load(std::memory_order_acquire);
+        count = std::min(count, writeIndex - readIndex);
+
+        const size_t start = readIndex & MASK;
+        const size_t firstRun = std::min(count, CAPACITY - start);
+        std::copy_n(m_values.begin() + start, firstRun, values);
+        std::copy_n(m_values.begin(), count - firstRun, values + firstRun);
+
+        m_read_index.store(readIndex + count, std::memory_order_release);
+        return count;
+    }
+
+    __forceinline bool pop(T& value) { return read(&value, 1) == 1; }
+
+    // Either side may ask; the answer is only a lower bound for the asking side.
+    size_t readAvailable() const
+    {
+        return m_write_index.load(std::memory_order_acquire) - m_read_index.load(std::memory_order_acquire);
+    }
+
+    size_t writeAvailable() const { return CAPACITY - readAvailable(); }
+
+    // Only safe while neither side is using the buffer.
+    void clear()
+    {
+        m_read_index.store(0, std::memory_order_relaxed);
+        m_write_index.store(0, std::memory_order_release);
+    }
+
+    static constexpr size_t capacity() { return CAPACITY; }
+
+private:
+    static constexpr size_t MASK = CAPACITY - 1;
+
+    // The indices count up forever and are masked on use; keep them on separate cache lines.
+    alignas(64) std::atomic<size_t> m_read_index{ 0 };
+    alignas(64) std::atomic<size_t> m_write_index{ 0 };
+    alignas(64) std::array<T, CAPACITY> m_values{};
+};
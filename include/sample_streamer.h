@@ -0,0 +1,66 @@
+#pragma once
+
+#include "sample_voice.h"
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+// The non-realtime half of sample playback. Loading a file reads its header and
+// the resident head; after that, a background thread keeps every prefetching or
+// playing stream's ring topped up from disk, ahead of the realtime voice reading it.
+// Only 16-, 24-, and 32-bit PCM and 32-bit float WAV files are supported. Mono files
+// play in both channels; files with more than two channels play their first two.
+struct SampleStreamer
+{
+    static SampleStreamer& getInstance();
+
+    // Start and stop the background reader thread.
+    void start();
+    void stop();
+
+    // Call on the UI thread. Returns the index of the loaded file, or nothing if
+    // the file couldn't be read.
+    std::optional<size_t> loadFile(const std::string& path);
+
+    // Call on the UI thread. Claims a free stream for the file and starts
+    // prefetching it; the returned stream is ready for a PlaySample request.
+    std::optional<size_t> prepareStream(size_t fileIndex);
+
+    // Stream indices match the generator's sample voice indices.
+    SampleStream& getStream(size_t stream) { return m_streams[stream]; }
+
+    size_t            getFileCount() const { return m_files.size(); }
+    const SampleFile& getFile(size_t fileIndex) const { return *m_files[fileIndex]; }
+
+private:
+    // What the reader thread needs to know to continue a stream from disk.
+    struct StreamReader
+    {
+        std::ifstream file;
+        size_t        nextFrame{ 0 }; // next frame to read from disk
+    };
+
+    void run();
+    void fillStream(size_t stream);
+
+    std::vector<std::unique_ptr<SampleFile>> m_files;
+    std::array<SampleStream, MAX_SAMPLE_VOICES> m_streams;
+    std::array<StreamReader, MAX_SAMPLE_VOICES> m_readers;
+
+    // Raw bytes on their way to being frames; one for each thread that reads files.
+    std::vector<uint8_t> m_load_scratch;
+    std::vector<uint8_t> m_read_scratch;
+
+    std::thread m_thread;
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    std::atomic<bool> m_running{ false };
+};
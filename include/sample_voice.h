@@ -0,0 +1,207 @@
+#pragma once
+
+#include "constants.h"
+#include "oscillator.h"
+#include "ring_buffer.h"
+
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <ios>
+#include <span>
+#include <string>
+#include <vector>
+
+constexpr size_t MAX_SAMPLE_VOICES = 8;
+
+// How much of the start of every sample file stays in memory, so a voice can
+// start instantly while the streamer catches up from disk.
+constexpr double SAMPLE_HEAD_SECONDS = 0.3;
+
+// Each voice streams through a ring of this many frames (~0.75s at 44.1 kHz).
+constexpr size_t SAMPLE_STREAM_FRAMES = size_t(1) << 15;
+
+struct SampleFrame
+{
+    float left{ 0.0f };
+    float right{ 0.0f };
+};
+
+// A sample file known to the streamer. Only the head is resident; the rest is
+// read from disk as it's needed. Files live as long as the streamer does, so the
+// realtime thread can hold plain pointers to them.
+struct SampleFile
+{
+    std::string              path;
+    uint32_t                 sampleRate{ SAMPLE_RATE };
+    size_t                   frames{ 0 };    // total length of the file
+    std::vector<SampleFrame> head;           // the first SAMPLE_HEAD_SECONDS of the file
+
+    // Layout of the WAV data, for the streamer.
+    uint16_t                 channels{ 0 };
+    uint16_t                 bitsPerSample{ 0 };
+    bool                     isFloat{ false };
+    std::streamoff           dataOffset{ 0 }; // where the first frame starts in the file
+};
+
+// Ownership of a stream moves around a fixed cycle, and whoever owns a stream
+// is the only one that may change it (other than the ring's read and write ends):
+//   Free -> Prefetching: the UI thread claims a free stream for a file
+//   Prefetching -> Playing: the realtime thread starts a voice on it
+//   Playing -> Finished: the realtime thread reaches the end or finishes fading out
+//   Finished -> Free: the streamer closes the file and releases the stream
+enum class SampleStreamState : uint8_t
+{
+    Free,
+    Prefetching,
+    Playing,
+    Finished
+};
+
+// The data shared between the streamer (producer) and a realtime voice (consumer).
+// The ring holds the file's frames in order, starting right after the head.
+struct SampleStream
+{
+    std::atomic<SampleStreamState>                    state{ SampleStreamState::Free };
+    const SampleFile*                                 file{ nullptr };
+    std::atomic<uint32_t>                             underruns{ 0 }; // blocks cut short waiting on disk
+    RingBuffer<SampleFrame, SAMPLE_STREAM_FRAMES>     ring;
+};
+
+// Plays sample files at any speed with 4-point Hermite interpolation. Runs on the
+// realtime thread and never touches the disk: frames come from the file's resident
+// head, then from the stream's ring. If the ring runs dry, the voice holds its place
+// and goes quiet for the rest of the block rather than skipping ahead.
+struct SampleVoice
+{
+    // Returns false if the stream isn't ready for a voice.
+    bool play(SampleStream& stream, float rate, volume_t volume)
+    {
+        SampleStreamState expected = SampleStreamState::Prefetching;
+        if (!stream.state.compare_exchange_strong(expected, SampleStreamState::Playing, std::memory_order_acq_rel))
+            return false;
+
+        if (m_stream != nullptr)
+            finish();
+
+        m_stream = &stream;
+        m_position = 0.0;
+        m_increment = double(rate) * double(stream.file->sampleRate) * ONE_OVER_SAMPLE_RATE;
+        m_history = { SampleFrame{}, fetchHead(0), fetchHead(1), fetchHead(2) };
+        m_next_frame = 3;
+        m_stopping = false;
+        m_volume_fader.fade(0.0f, volume);
+        return true;
+    }
+
+    // Fade out; the stream is handed back once the fade is done.
+    bool stop()
+    {
+        if (m_stream == nullptr)
+            return false;
+
+        m_stopping = true;
+        m_volume_fader.fade(m_volume_fader.getValue(), 0.0f);
+        return true;
+    }
+
+    void setRate(float rate)
+    {
+        if (m_stream != nullptr)
+            m_increment = double(rate) * double(m_stream->file->sampleRate) * ONE_OVER_SAMPLE_RATE;
+    }
+
+    void setVolume(volume_t volume)
+    {
+        if (!m_stopping)
+            m_volume_fader.fade(m_volume_fader.getValue(), volume);
+    }
+
+    __forceinline bool isPlaying() const { return m_stream != nullptr; }
+
+    // Mix this voice into an (interleaved stereo) output block.
+    void render(std::span<float> output)
+    {
+        if (m_stream == nullptr)
+            return;
+
+        const size_t frames = m_stream->file->frames;
+        for (size_t index = 0; index < output.size(); index += 2)
+        {
+            // Pull in frames until the history brackets the playhead.
+            const size_t wholePosition = size_t(m_position);
+            while (m_next_frame <= wholePosition + 2)
+            {
+                SampleFrame frame;
+                if (!fetch(m_next_frame, frame))
+                {
+                    m_stream->underruns.fetch_add(1, std::memory_order_relaxed);
+                    if (m_stopping)
+                        finish(); // nothing left worth waiting for
+                    return;
+                }
+                m_history = { m_history[1], m_history[2], m_history[3], frame };
+                ++m_next_frame;
+            }
+
+            const float t = float(m_position - double(wholePosition));
+            const volume_t volume = m_volume_fader.update();
+            output[index]     += hermite(t, m_history[0].left, m_history[1].left, m_history[2].left, m_history[3].left) * volume;
+            output[index + 1] += hermite(t, m_history[0].right, m_history[1].right, m_history[2].right, m_history[3].right) * volume;
+
+            m_position += m_increment;
+            if (m_position >= double(frames) || (m_stopping && m_volume_fader.isFinished()))
+            {
+                finish();
+                return;
+            }
+        }
+    }
+
+private:
+    __forceinline SampleFrame fetchHead(size_t frame) const
+    {
+        const auto& head = m_stream->file->head;
+        return frame < head.size() ? head[frame] : SampleFrame{};
+    }
+
+    // Frames past the head come off the ring strictly in order.
+    __forceinline bool fetch(size_t frame, SampleFrame& value)
+    {
+        if (frame >= m_stream->file->frames)
+        {
+            value = {};
+            return true;
+        }
+        if (frame < m_stream->file->head.size())
+        {
+            value = m_stream->file->head[frame];
+            return true;
+        }
+        return m_stream->ring.pop(value);
+    }
+
+    void finish()
+    {
+        m_stream->state.store(SampleStreamState::Finished, std::memory_order_release);
+        m_stream = nullptr;
+    }
+
+    static __forceinline float hermite(float t, float y0, float y1, float y2, float y3)
+    {
+        const float c1 = 0.5f * (y2 - y0);
+        const float c2 = y0 - 2.5f * y1 + 2.0f * y2 - 0.5f * y3;
+        const float c3 = 0.5f * (y3 - y0) + 1.5f * (y1 - y2);
+        return ((c3 * t + c2) * t + c1) * t + y1;
+    }
+
+    static constexpr uint16_t VolumeFadeLength{ 256 };
+
+    SampleStream*                     m_stream{ nullptr };
+    double                            m_position{ 0.0 };  // in source frames
+    double                            m_increment{ 1.0 }; // source frames per output frame
+    size_t                            m_next_frame{ 0 };  // next source frame to pull into the history
+    std::array<SampleFrame, 4>        m_history{};        // frames floor(position) - 1 through + 2
+    bool                              m_stopping{ false };
+    Fader<volume_t, VolumeFadeLength> m_volume_fader{ 0.0f };
+};
@@ -0,0 +1,120 @@
+#pragma once
+
+#include "constants.h"
+
+#include <array>
+#include <cstdio>
+#include <span>
+
+// The last stage of the output: hard clipping, or a saturation curve, optionally run
+// at two or four times the sample rate so the harmonics it adds above Nyquist are
+// filtered out instead of aliasing back down.
+enum class SaturationCurve : uint8_t
+{
+    HardClip,
+    Tanh,
+    SoftKnee,   // untouched up to half scale, then bending smoothly towards full scale
+    Asymmetric, // squashes the negative half harder, for even harmonics
+    Count
+};
+
+struct SaturationSettings
+{
+    SaturationCurve curve{ SaturationCurve::HardClip };
+    uint8_t         oversampling{ 1 }; // 1, 2 or 4
+    float           drive{ 1.0f };     // gain into the curve
+
+    // False for an unknown curve, an oversampling factor other than 1, 2 or 4, or a
+    // drive that isn't positive.
+    bool isValid() const
+    {
+        return curve < SaturationCurve::Count && drive > 0.0f && (oversampling == 1 || oversampling == 2 || oversampling == 4);
+    }
+
+    bool operator==(const SaturationSettings&) const = default;
+};
+
+// Longer buffers go through the stage in pieces of this many frames.
+constexpr size_t MAX_SATURATION_FRAMES = 512;
+
+// Taps on each side of the center of a half-band filter, not counting the zeros.
+constexpr size_t MAX_HALF_BAND_TAPS = 32;
+
+// One channel of 2x upsampling through a half-band lowpass. Every other tap of a
+// half-band filter is zero except the center one, so the polyphase branch that
+// lands on input samples is a plain (delayed) copy, and only the branch between
+// them is a real filter: symmetric, so each tap needs one multiply for two inputs.
+// Four outputs are worked out at once with SSE.
+struct HalfBandUpsampler
+{
+    // The taps of the branch between samples, nearest first, for a filter with a DC gain of 1.
+    void setTaps(std::span<const float> taps);
+    void reset();
+
+    // Write 2 * frames outputs for frames inputs; frames is at most 2 * MAX_SATURATION_FRAMES.
+    void process(const float* input, size_t frames, float* output);
+
+private:
+    size_t m_tap_count{ 0 };
+    std::array<float, MAX_HALF_BAND_TAPS> m_taps{};
+
+    // The last 2 * m_tap_count inputs, then this call's.
+    alignas(32) std::array<float, MAX_HALF_BAND_TAPS * 2 + MAX_SATURATION_FRAMES * 2> m_history{};
+};
+
+// One channel of 2x downsampling through the same kind of filter. The input is split
+// into its even and odd samples (its two polyphase branches) so that, like the
+// upsampler, every tap reads consecutive samples and SSE works out four outputs at once.
+struct HalfBandDownsampler
+{
+    void setTaps(std::span<const float> taps);
+    void reset();
+
+    // Write frames outputs for 2 * frames inputs; frames is at most 2 * MAX_SATURATION_FRAMES.
+    void process(const float* input, size_t frames, float* output);
+
+private:
+    size_t m_tap_count{ 0 };
+    std::array<float, MAX_HALF_BAND_TAPS> m_taps{};
+    alignas(32) std::array<float, MAX_HALF_BAND_TAPS * 2 + MAX_SATURATION_FRAMES * 2> m_even{};
+    alignas(32) std::array<float, MAX_HALF_BAND_TAPS * 2 + MAX_SATURATION_FRAMES * 2> m_odd{};
+};
+
+// The output stage of a generator, or of the mixer. With the default settings it
+// hard clips, as before. Oversampling 4x cascades two 2x stages: the first, next to
+// the base rate, needs a steep filter; the second only has to clear the images
+// around twice the base rate, so it gets by with far fewer taps. Oversampling delays
+// the output by about 60 frames.
+struct Saturator
+{
+    Saturator();
+
+    // Returns false for invalid settings (see SaturationSettings::isValid). Changing the
+    // factor starts the filters afresh.
+    bool setSettings(SaturationSettings const& settings);
+    SaturationSettings const& getSettings() const { return m_settings; }
+
+    // Saturate the (interleaved stereo) output in place.
+    void process(std::span<float> output);
+
+private:
+    void processChannel(float* samples, size_t frames, size_t channel);
+
+    SaturationSettings m_settings{};
+
+    // By channel.
+    std::array<HalfBandUpsampler, 2> m_up{};        // base rate to 2x
+    std::array<HalfBandUpsampler, 2> m_up_twice{};  // 2x to 4x
+    std::array<HalfBandDownsampler, 2> m_down{};
+    std::array<HalfBandDownsampler, 2> m_down_twice{};
+    std::array<float, 2> m_dc_input{};  // DC blocker state, for the asymmetric curve
+    std::array<float, 2> m_dc_output{};
+
+    alignas(32) std::array<float, MAX_SATURATION_FRAMES> m_channel{};
+    alignas(32) std::array<float, MAX_SATURATION_FRAMES * 2> m_twice{};
+    alignas(32) std::array<float, MAX_SATURATION_FRAMES * 4> m_four_times{};
+};
+
+// Time every curve at every oversampling factor over a range of buffer sizes, and
+// print a table of the cost per frame and the share of a core it takes at SAMPLE_RATE.
+void BenchmarkSaturation(std::FILE* out);
@@ -0,0 +1,80 @@
+#pragma once
+
+#include "constants.h"
+#include "fft.h"
+#include "triple_buffer.h"
+
+#include <array>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+// The spectrum is shown in this many bands, spaced evenly in log frequency.
+constexpr size_t SPECTRUM_BANDS = 160;
+constexpr double SPECTRUM_LOWEST_FREQUENCY = 20.0;
+constexpr double SPECTRUM_HIGHEST_FREQUENCY = 20000.0;
+constexpr float  SPECTRUM_FLOOR_DB = -120.0f;
+
+// One analyzed frame, in dBFS per band.
+struct SpectrumFrame
+{
+    std::array<float, SPECTRUM_BANDS> levels = makeSilence();
+    std::array<float, SPECTRUM_BANDS> peaks = makeSilence(); // held for a while, then falling
+
+    static constexpr std::array<float, SPECTRUM_BANDS> makeSilence()
+    {
+        std::array<float, SPECTRUM_BANDS> silence{};
+        silence.fill(SPECTRUM_FLOOR_DB);
+        return silence;
+    }
+};
+
+// Analyzes the output tap on a thread of its own: a Hann-windowed FFT of the mid
+// channel every quarter window (75% overlap), reduced to log-spaced bands with
+// peak hold. Finished frames are published through a triple buffer for the UI.
+// Nothing here runs on the audio callback's thread.
+struct SpectrumAnalyzer
+{
+    static constexpr size_t FFT_SIZE = 4096; // ~93 ms at 44.1 kHz, ~10.8 Hz per bin
+    static constexpr size_t HOP_SIZE = FFT_SIZE / 4;
+
+    static SpectrumAnalyzer& getInstance();
+
+    // Start and stop the analysis thread.
+    void start();
+    void stop();
+
+    // Call on the UI thread: pick up the newest frame (if there is one) and return it.
+    const SpectrumFrame& getLatestFrame();
+
+    // Center frequency of each band. Fixed, so safe to read from anywhere.
+    const std::array<float, SPECTRUM_BANDS>& getBandFrequencies() const { return m_band_frequencies; }
+
+private:
+    SpectrumAnalyzer();
+
+    void run();
+    void analyze(); // one frame from m_history
+
+    RealFft m_fft{ FFT_SIZE };
+    std::vector<float> m_window;
+    std::vector<float> m_history;   // the last FFT_SIZE mid samples, oldest first
+    std::vector<float> m_windowed;
+    std::vector<float> m_real;
+    std::vector<float> m_imaginary;
+    std::vector<float> m_bin_levels; // dB per FFT bin
+    float m_window_gain{ 1.0f };     // scales a full-scale sine to 0 dB
+
+    // Each band covers FFT bins [first, last]; narrow low bands interpolate instead.
+    std::array<float, SPECTRUM_BANDS> m_band_frequencies{};
+    std::array<size_t, SPECTRUM_BANDS> m_band_first_bin{};
+    std::array<size_t, SPECTRUM_BANDS> m_band_last_bin{};
+
+    std::array<float, SPECTRUM_BANDS> m_peaks{};
+    std::array<float, SPECTRUM_BANDS> m_peak_ages{}; // seconds since each peak was set
+
+    TripleBuffer<SpectrumFrame> m_frames;
+
+    std::thread m_thread;
+    std::atomic<bool> m_running{ false };
+};
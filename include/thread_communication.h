@@ -2,12 +2,17 @@
 
 #include "generator.h"
 #include "oscillator.h"
-#include "util.h"
+#include "saturation.h"
 
 #include <farbot/AsyncCaller.hpp>
 #include <farbot/fifo.hpp>
 #include <farbot/RealtimeObject.hpp>
 
+#include <chrono>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <optional>
 #include <queue>
 #include <unordered_map>
 
@@ -23,8 +28,6 @@
 // If the realtime thread needs potentially expensive code executed (such as
 // system calls), it can defer that code to the UI thread via another queue.
 
-struct UIOscillatorView;
-
 using RequestId = uint32_t;
 
 // Define events to be passed between threads on lock-free queues.
@@ -42,13 +45,40 @@ namespace Events
             SetOscillatorFrequency,
             SetOscillatorVolume,
             SetOscillatorPan,
-            SetOscillatorType
+            SetOscillatorType,
+            SetOscillatorWavetablePosition,
+            SetOscillatorEnvelope,
+            SetOscillatorUnison,
+            SetOscillatorSync,
+            SetLfo,
+            SetModulationRoute,
+            SetControlBlockSize,
+            SetFmGroup,
+            SetGrainCloud,
+            PlaySample,
+            StopSample,
+            PlayMidi,
+            StopMidi,
+            PlayResynthesis,
+            SetResynthesis,
+            StopResynthesis,
+            SetSaturation,
+            InstallPreset
         };
 
         struct Request
         {
             RequestId id{ 0 };
             Action action{};
+            size_t generator{ 0 }; // which generator the request is for
+
+            // The generator sample time at which to apply the request. Unset (or in the
+            // past) means as soon as possible. Requests are still applied in queue order,
+            // so anything queued behind a timed request waits for it.
+            std::optional<uint64_t> sampleTime;
+
+            // When the request was built - right before it's pushed - for measuring latency.
+            std::chrono::steady_clock::time_point createdTime{ std::chrono::steady_clock::now() };
 
             virtual ~Request() = default; // avoid memory leaks when deleting
         };
@@ -74,6 +104,91 @@ namespace Events
         struct SetOscillatorVolumeRequest    : ModifyOscillatorRequest { volume_t       newVolume{}; };
         struct SetOscillatorPanRequest       : ModifyOscillatorRequest { pan_t          newPan{}; };
         struct SetOscillatorTypeRequest      : ModifyOscillatorRequest { OscillatorType newType{}; };
+        struct SetOscillatorWavetablePositionRequest : ModifyOscillatorRequest { float newPosition{}; };
+        struct SetOscillatorEnvelopeRequest  : ModifyOscillatorRequest { EnvelopeSettings newEnvelope{}; };
+        struct SetOscillatorUnisonRequest    : ModifyOscillatorRequest { UnisonSettings   newUnison{}; };
+        struct SetOscillatorSyncRequest      : ModifyOscillatorRequest { OscillatorId     newSyncMaster{ NO_SYNC_MASTER }; };
+
+        struct SetLfoRequest : Request
+        {
+            size_t lfoIndex{};
+            LfoSettings newLfo{};
+        };
+
+        struct SetModulationRouteRequest : Request
+        {
+            size_t routeIndex{};
+            ModulationRoute newRoute{};
+        };
+
+        struct SetControlBlockSizeRequest : Request
+        {
+            size_t newControlBlockSize{};
+        };
+
+        struct SetFmGroupRequest : Request
+        {
+            size_t groupIndex{};
+            FmGroupSettings newGroup{};
+        };
+
+        struct SetGrainCloudRequest : Request
+        {
+            size_t cloudIndex{};
+            GrainCloudSettings newCloud{};
+        };
+
+        // The stream must already be prepared by the sample streamer.
+        struct PlaySampleRequest : Request
+        {
+            size_t voice{};
+            float rate{ 1.0f };
+            volume_t volume{};
+        };
+
+        struct StopSampleRequest : Request
+        {
+            size_t voice{};
+        };
+
+        // The sequence must outlive its playback; the UI keeps loaded sequences around.
+        struct PlayMidiRequest : Request
+        {
+            const MidiSequence* sequence{ nullptr };
+            MidiSettings settings{};
+        };
+
+        struct StopMidiRequest : Request { };
+
+        // Like MIDI sequences, the tracks must outlive their playback; the UI keeps loaded tracks around.
+        struct PlayResynthesisRequest : Request
+        {
+            const PartialTracks* tracks{ nullptr };
+            ResynthesisSettings settings{};
+        };
+
+        // Changes the stretch, pitch and volume of what's playing, without restarting it.
+        struct SetResynthesisRequest : Request
+        {
+            ResynthesisSettings newSettings{};
+        };
+
+        struct StopResynthesisRequest : Request { };
+
+        // Sets the mixer's saturation stage (see GeneratorMixer::setSaturation), which every
+        // generator shares; any generator's queue will do.
+        struct SetSaturationRequest : Request
+        {
+            SaturationSettings newSaturation{};
+        };
+
+        // The generator takes the bank when it handles the request. Otherwise it goes
+        // with the request, which is freed off the realtime thread like any other.
+        // (Mutable, since requests are handled as const.)
+        struct InstallPresetRequest : Request
+        {
+            mutable std::unique_ptr<Generator<>::OscillatorBank> oscillators;
+        };
 
         // Responses
         enum class Result : uint8_t
@@ -93,7 +208,43 @@ namespace Events
             SetOscillatorPanSucceeded,
             SetOscillatorPanFailed,
             SetOscillatorTypeSucceeded,
-            SetOscillatorTypeFailed
+            SetOscillatorTypeFailed,
+            SetOscillatorWavetablePositionSucceeded,
+            SetOscillatorWavetablePositionFailed,
+            SetOscillatorEnvelopeSucceeded,
+            SetOscillatorEnvelopeFailed,
+            SetOscillatorUnisonSucceeded,
+            SetOscillatorUnisonFailed,
+            SetOscillatorSyncSucceeded,
+            SetOscillatorSyncFailed,
+            SetLfoSucceeded,
+            SetLfoFailed,
+            SetModulationRouteSucceeded,
+            SetModulationRouteFailed,
+            SetControlBlockSizeSucceeded,
+            SetControlBlockSizeFailed,
+            SetFmGroupSucceeded,
+            SetFmGroupFailed,
+            SetGrainCloudSucceeded,
+            SetGrainCloudFailed,
+            PlaySampleSucceeded,
+            PlaySampleFailed,
+            StopSampleSucceeded,
+            StopSampleFailed,
+            PlayMidiSucceeded,
+            PlayMidiFailed,
+            StopMidiSucceeded,
+            StopMidiFailed,
+            PlayResynthesisSucceeded,
+            PlayResynthesisFailed,
+            SetResynthesisSucceeded,
+            SetResynthesisFailed,
+            StopResynthesisSucceeded,
+            StopResynthesisFailed,
+            SetSaturationSucceeded,
+            SetSaturationFailed,
+            InstallPresetSucceeded,
+            InstallPresetFailed
         };
 
         // Not inheritance to avoid allocating on the realtime thread.
@@ -110,6 +261,34 @@ namespace Events
             std::optional<volume_t> volume;
             std::optional<pan_t> pan;
             std::optional<OscillatorType> type;
+            std::optional<float> wavetablePosition;
+            std::optional<EnvelopeSettings> envelope;
+            std::optional<UnisonSettings> unison;
+            std::optional<OscillatorId> syncMaster; // NO_SYNC_MASTER when sync was turned off
+
+            // For modulation changes
+            std::optional<size_t> lfoIndex;
+            std::optional<LfoSettings> lfo;
+            std::optional<size_t> routeIndex;
+            std::optional<ModulationRoute> route;
+            std::optional<size_t> controlBlockSize;
+
+            // For FM group changes
+            std::optional<size_t> fmGroupIndex;
+            std::optional<FmGroupSettings> fmGroup;
+
+            // For grain cloud changes
+            std::optional<size_t> grainCloudIndex;
+            std::optional<GrainCloudSettings> grainCloud;
+
+            // For sample playback
+            std::optional<size_t> sampleVoice;
+
+            // For resynthesis playback
+            std::optional<ResynthesisSettings> resynthesis;
+
+            // For the output stage
+            std::optional<SaturationSettings> saturation;
         };
     }
 }
@@ -134,45 +313,68 @@ struct ThreadCommunication
 
     using AsyncCallerType = farbot::AsyncCaller<farbot::fifo_options::concurrency::single>;
 
+    // Every generator has its own set of queues, since each one is rendered (and
+    // so produces responses and deferred work) on its own realtime thread. Generator
+    // 0 renders on the audio callback's thread, which shares its queues.
+
     // Get a reference to the generator settings event queue, used for
     // passing messages from the non-realtime thread to the realtime thread.
-    static RequestQueueType& getModifyGeneratorRequestQueue();
+    static RequestQueueType& getModifyGeneratorRequestQueue(size_t generator);
 
     // Get a reference to the oscillator modification result event queue, used for
     // passing messages about the status of an oscillator modification request from
     // the realtime thread to the non-realtime thread.
-    static ResponseQueueType& getModifyGeneratorResponseQueue();
+    static ResponseQueueType& getModifyGeneratorResponseQueue(size_t generator);
 
     // Get a reference to the AsyncCaller, a mechanism for dispatching lambdas to the
     // non-realtime thread without waiting or blocking. Useful for deferring stuff.
-    static AsyncCallerType& getRealtimeAsyncCaller();
+    static AsyncCallerType& getRealtimeAsyncCaller(size_t generator);
 
     // Call on the realtime thread to defer execution to the non-realtime thread.
     // Useful for deleting memory or any other syscall-inducing functionality.
-    static bool deferToNonRealtimeThread(std::function<void()>&& fn);
+    // Pass the generator being rendered on the calling thread (0 on the audio callback's thread).
+    static bool deferToNonRealtimeThread(std::function<void()>&& fn, size_t generator = 0);
 
-    // Call on the non-realtime thread to run deferred code.
+    // Call on the non-realtime thread to run deferred code, for every generator.
     static bool processDeferredActions();
 };
 
 struct GeneratorAccess
 {
-    // Get a reference to the generator.
-    static Generator<>& getInstance();
+    // Get a reference to one of the generators.
+    static Generator<>& getInstance(size_t generator);
 };
 
 // The functions in this namespace help the UI thread push events to
 // the realtime thread via the modify generator request queue.
 namespace EventBuilder
 {
-    bool PushAddOscillatorEvent(RequestId requestId, OscillatorSettings settings);
-    bool PushRemoveOscillatorEvent(RequestId requestId, OscillatorId idToRemove);
-    bool PushActivateOscillatorEvent(RequestId requestId, OscillatorId idToModify, volume_t volume);
-    bool PushDeactivateOscillatorEvent(RequestId requestId, OscillatorId idToModify);
-    bool PushSetOscillatorFrequencyEvent(RequestId requestId, OscillatorId idToModify, frequency_t frequency);
-    bool PushSetOscillatorVolumeEvent(RequestId requestId, OscillatorId idToModify, volume_t volume);
-    bool PushSetOscillatorPanEvent(RequestId requestId, OscillatorId idToModify, pan_t pan);
-    bool PushSetOscillatorTypeEvent(RequestId requestId, OscillatorId idToModify, OscillatorType type);
+    bool PushAddOscillatorEvent(size_t generator, RequestId requestId, OscillatorSettings settings, std::optional<uint64_t> sampleTime = std::nullopt);
+    bool PushRemoveOscillatorEvent(size_t generator, RequestId requestId, OscillatorId idToRemove, std::optional<uint64_t> sampleTime = std::nullopt);
+    bool PushActivateOscillatorEvent(size_t generator, RequestId requestId, OscillatorId idToModify, volume_t volume, std::optional<uint64_t> sampleTime = std::nullopt);
+    bool PushDeactivateOscillatorEvent(size_t generator, RequestId requestId, OscillatorId idToModify, std::optional<uint64_t> sampleTime = std::nullopt);
+    bool PushSetOscillatorFrequencyEvent(size_t generator, RequestId requestId, OscillatorId idToModify, frequency_t frequency, std::optional<uint64_t> sampleTime = std::nullopt);
+    bool PushSetOscillatorVolumeEvent(size_t generator, RequestId requestId, OscillatorId idToModify, volume_t volume, std::optional<uint64_t> sampleTime = std::nullopt);
+    bool PushSetOscillatorPanEvent(size_t generator, RequestId requestId, OscillatorId idToModify, pan_t pan, std::optional<uint64_t> sampleTime = std::nullopt);
+    bool PushSetOscillatorTypeEvent(size_t generator, RequestId requestId, OscillatorId idToModify, OscillatorType type, std::optional<uint64_t> sampleTime = std::nullopt);
+    bool PushSetOscillatorWavetablePositionEvent(size_t generator, RequestId requestId, OscillatorId idToModify, float position, std::optional<uint64_t> sampleTime = std::nullopt);
+    bool PushSetOscillatorEnvelopeEvent(size_t generator, RequestId requestId, OscillatorId idToModify, EnvelopeSettings envelope, std::optional<uint64_t> sampleTime = std::nullopt);
+    bool PushSetOscillatorUnisonEvent(size_t generator, RequestId requestId, OscillatorId idToModify, UnisonSettings unison, std::optional<uint64_t> sampleTime = std::nullopt);
+    bool PushSetOscillatorSyncEvent(size_t generator, RequestId requestId, OscillatorId idToModify, OscillatorId syncMaster, std::optional<uint64_t> sampleTime = std::nullopt);
+    bool PushSetLfoEvent(size_t generator, RequestId requestId, size_t lfoIndex, LfoSettings lfo, std::optional<uint64_t> sampleTime = std::nullopt);
+    bool PushSetModulationRouteEvent(size_t generator, RequestId requestId, size_t routeIndex, ModulationRoute route, std::optional<uint64_t> sampleTime = std::nullopt);
+    bool PushSetControlBlockSizeEvent(size_t generator, RequestId requestId, size_t controlBlockSize, std::optional<uint64_t> sampleTime = std::nullopt);
+    bool PushSetFmGroupEvent(size_t generator, RequestId requestId, size_t groupIndex, FmGroupSettings group, std::optional<uint64_t> sampleTime = std::nullopt);
+    bool PushSetGrainCloudEvent(size_t generator, RequestId requestId, size_t cloudIndex, GrainCloudSettings cloud, std::optional<uint64_t> sampleTime = std::nullopt);
+    bool PushPlaySampleEvent(size_t generator, RequestId requestId, size_t voice, float rate, volume_t volume, std::optional<uint64_t> sampleTime = std::nullopt);
+    bool PushStopSampleEvent(size_t generator, RequestId requestId, size_t voice, std::optional<uint64_t> sampleTime = std::nullopt);
+    bool PushPlayMidiEvent(size_t generator, RequestId requestId, const MidiSequence* sequence, MidiSettings settings, std::optional<uint64_t> sampleTime = std::nullopt);
+    bool PushStopMidiEvent(size_t generator, RequestId requestId, std::optional<uint64_t> sampleTime = std::nullopt);
+    bool PushPlayResynthesisEvent(size_t generator, RequestId requestId, const PartialTracks* tracks, ResynthesisSettings settings, std::optional<uint64_t> sampleTime = std::nullopt);
+    bool PushSetResynthesisEvent(size_t generator, RequestId requestId, ResynthesisSettings settings, std::optional<uint64_t> sampleTime = std::nullopt);
+    bool PushStopResynthesisEvent(size_t generator, RequestId requestId, std::optional<uint64_t> sampleTime = std::nullopt);
+    bool PushSetSaturationEvent(size_t generator, RequestId requestId, SaturationSettings saturation, std::optional<uint64_t> sampleTime = std::nullopt);
+    bool PushInstallPresetEvent(size_t generator, RequestId requestId, std::unique_ptr<Generator<>::OscillatorBank> oscillators, std::optional<uint64_t> sampleTime = std::nullopt);
 }
 
 // TODO: add request type to params. add bool success to params. add request type to response. simplify ::result enum
@@ -186,12 +388,30 @@ namespace EventBuilder
 
 bool DispatchModifyGeneratorRequest(const Events::ModifyGenerator::Request& request);
 
-// Read from the generator request queue; handle all requests.
+// Read from a generator's request queue; handle all requests due at or before
+// the given generator sample time. The first request due later is held back, along
+// with everything queued behind it, until its time comes.
 // Respond to each request to alert the UI thread what happened.
 // This function is meant to be called by the realtime thread;
 // it is in charge of honoring requests that it modify its settings.
-void ProcessModifyGeneratorRequests();
+void ProcessModifyGeneratorRequests(size_t generator, uint64_t sampleTime);
+
+// Frames from the given sample time until the generator's held request is due, if there is one.
+size_t FramesUntilNextModifyGeneratorRequest(size_t generator, uint64_t sampleTime);
+
+// Call on the realtime thread after rendering: hands any oscillator bank the
+// generator is done with to the non-realtime thread to be freed.
+void ReclaimRetiredOscillators(size_t generator);
 
-std::queue<RequestId>& GetRequestIds();
+// Lets Generator::renderSamples apply requests as it renders, ending control blocks
+// wherever a request is due so the change lands on its exact sample.
+struct ModifyGeneratorRequestEvents
+{
+    size_t generator{ 0 };
+
+    void   dispatchDueEvents(uint64_t sampleTime)          { ProcessModifyGeneratorRequests(generator, sampleTime); }
+    size_t framesUntilNextEvent(uint64_t sampleTime) const { return FramesUntilNextModifyGeneratorRequest(generator, sampleTime); }
+};
 
-UIOscillatorView& GetUIOscillatorView();
+// Requests in flight, per generator, in the order they were sent.
+std::queue<RequestId>& GetRequestIds(size_t generator);
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+
+// A timeline of what each thread was doing, for seeing how the audio callback,
+// the UI frame loop, and the work deferred between them interleave. Code marks
+// spans with Tracing::Span; while tracing is started, each thread appends them to
+// a ring of its own (no locks, no allocation, timestamps straight from the TSC).
+// The rings hold the most recent few seconds and are written out on demand as a
+// Chrome trace (chrome://tracing, or ui.perfetto.dev). While tracing is stopped a
+// span costs one relaxed load.
+namespace Tracing
+{
+    constexpr size_t MAX_TRACE_THREADS = 16;               // threads running at once past this aren't traced
+    constexpr size_t EVENTS_PER_THREAD = size_t(1) << 15;  // per-thread ring size
+    constexpr size_t MAX_THREAD_NAME = 32;
+
+    extern std::atomic<bool> g_enabled;
+
+    inline uint64_t now() { return __rdtsc(); }
+    inline bool isEnabled() { return g_enabled.load(std::memory_order_relaxed); }
+
+    // Call from the UI thread. Starting allocates the rings the first time.
+    void start();
+    void stop();
+
+    // Write everything recorded since the last start. Stop first for a clean cut.
+    bool writeChromeTrace(const std::string& path);
+
+    // Name the calling thread in traces. Only the first call on a thread counts. A
+    // thread that exits frees its slot, so name threads as they start, not just once
+    // per process.
+    void setThreadName(const char* name);
+
+    // Add a span that began at the given now() and ends now. Realtime safe.
+    void record(const char* name, uint64_t begin);
+
+    // Records from construction to destruction. The name must outlive the trace (use a literal).
+    struct Span
+    {
+        explicit Span(const char* name)
+            : m_name(name)
+            , m_begin(isEnabled() ? now() : 0)
+        {
+        }
+
+        ~Span()
+        {
+            if (m_begin != 0)
+                record(m_name, m_begin);
+        }
+
+        Span(const Span&) = delete;
+        Span& operator=(const Span&) = delete;
+
+    private:
+        const char* m_name;
+        uint64_t m_begin;
+    };
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+// A single-producer single-consumer triple buffer, for publishing the latest value
+// of something the reader only ever wants the newest copy of. The writer fills its
+// back buffer and publishes it; the reader picks up whatever was published last.
+// Neither side ever waits, and a slow reader just skips values. All three copies
+// live inline, so nothing allocates after construction.
+template<class T>
+struct TripleBuffer
+{
+    // Writer side. Fill this in, then publish it.
+    __forceinline T& getWriteBuffer() { return m_buffers[m_back]; }
+
+    // Writer side. Swap the back buffer with the middle one, marking it new.
+    void publish()
+    {
+        const uint8_t previous = m_middle.exchange(uint8_t(m_back | NEW_BIT), std::memory_order_acq_rel);
+        m_back = previous & INDEX_MASK;
+    }
+
+    // Reader side. Take the newest published value, if there's been one since the last
+    // call. Returns false (and keeps the current value) if there's nothing new.
+    bool update()
+    {
+        if ((m_middle.load(std::memory_order_relaxed) & NEW_BIT) == 0)
+            return false;
+
+        const uint8_t previous = m_middle.exchange(m_front, std::memory_order_acq_rel);
+        m_front = previous & INDEX_MASK;
+        return true;
+    }
+
+    // Reader side. The value as of the last successful update().
+    __forceinline const T& read() const { return m_buffers[m_front]; }
+
+private:
+    static constexpr uint8_t INDEX_MASK{ 0x3 };
+    static constexpr uint8_t NEW_BIT{ 0x4 };
+
+    std::array<T, 3> m_buffers{};
+    uint8_t m_back{ 0 };                  // writer only
+    uint8_t m_front{ 1 };                 // reader only
+    std::atomic<uint8_t> m_middle{ 2 };   // index, plus NEW_BIT once the writer publishes into it
+};
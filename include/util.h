@@ -1,5 +1,7 @@
 #pragma once
 
+#include "constants.h"
+
 #include "imgui.h"
 #include "portaudio.h"
 
@@ -33,12 +35,6 @@ struct ScrollingBuffer
     std::vector<ImVec2> buffer;
 };
 
-template<class Ts>
-void unused(Ts...)
-{ }
-
-constexpr bool isPowerOf2(int n) { return (n & (n - 1)) == 0; }
-
 constexpr float clamp(float x, float lowerlimit, float upperlimit) {
     if (x < lowerlimit)
         x = lowerlimit;
@@ -56,3 +52,11 @@ constexpr float smoothstep(float edge0, float edge1, float x) {
 
 // Show portaudio debug info. Possibly useful for debugging.
 void ShowDebugInfo(PaStream* stream);
+
+// Show the stream's buffer size and load, and let adaptive sizing be turned on and off.
+struct BufferSizeController;
+void ShowBufferSizeController(BufferSizeController& controller);
+
+// Show the output sample rate conversion, and let its quality and drift compensation be changed.
+struct OutputResampler;
+void ShowOutputResampler(OutputResampler& resampler);
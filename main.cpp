@@ -3,10 +3,24 @@
 
 #include "framework.h"
 #include "audiovisual.h"
+#include "buffer_size_controller.h"
+#include "convolution.h"
+#include "generator_mixer.h"
+#include "latency_probe.h"
 #include "logging.h"
+#include "offline_renderer.h"
+#include "output_tap.h"
+#include "partials.h"
 #include "oscillator_ui.h"
 #include "pa_management.h"
 #include "plotting.h"
+#include "realtime_sanitizer.h"
+#include "render_check.h"
+#include "resampler.h"
+#include "sample_streamer.h"
+#include "saturation.h"
+#include "spectrum_analyzer.h"
+#include "tracing.h"
 #include "windowing.h"
 
 // This function runs on the realtime thread provided by portaudio.
@@ -16,41 +30,143 @@
 static int paCallback(const void*                     /*inputBuffer*/,
                       void*                           outputBuffer,
                       unsigned long                   framesPerBuffer,
-                      const PaStreamCallbackTimeInfo* /*timeInfo*/,
+                      const PaStreamCallbackTimeInfo* timeInfo,
                       PaStreamCallbackFlags           /*statusFlags*/,
                       void*                           /*userData*/)
 {
-    ProcessModifyGeneratorRequests();
+    RealtimeSanitizer::ScopedRealtime realtime;
+    Tracing::Span span("paCallback");
+    LatencyProbe::getInstance().beginBuffer(std::chrono::steady_clock::now());
+    float* out = static_cast<float*>(outputBuffer);
 
-    Generator<>& generator = GeneratorAccess::getInstance();
-    float*       out       = static_cast<float*>(outputBuffer);
+    // Every generator renders (in parallel) and is mixed in, at SAMPLE_RATE. Requests are
+    // applied as each generator renders, each at the sample it asks for. If the device
+    // runs at another rate, the converter asks for as much as this buffer takes.
+    auto& resampler = OutputResampler::getInstance();
+    resampler.process(std::span<float>(out, framesPerBuffer * 2ul), timeInfo->outputBufferDacTime,
+        [](std::span<float> engineOutput)
+        {
+            GeneratorMixer::getInstance().writeSamples(engineOutput);
 
-    generator.writeSamples(std::span<float>(out, framesPerBuffer * 2ul));
+            // Analysis happens elsewhere; this is just a ring write.
+            OutputTap::getInstance().write(engineOutput.data(), engineOutput.size() / 2);
 
 #if LOG_SESSION_TO_FILE
-    Logging::CopyBufferAndDefer(out, framesPerBuffer);
+            Logging::CopyBufferAndDefer(engineOutput.data(), static_cast<unsigned long>(engineOutput.size() / 2));
 #endif
+        });
+
+    LatencyProbe::getInstance().endBuffer(timeInfo->outputBufferDacTime - timeInfo->currentTime + resampler.getDelaySeconds());
 
     return paContinue;
 }
 
+// Render a MIDI file straight to a wav file, with no audio device or window.
+static int RenderMidiHeadless(const std::filesystem::path& midiPath, const std::filesystem::path& wavPath)
+{
+    WaveTables::Initialize();
+
+    auto sequence = LoadMidiFile(midiPath.string());
+    if (!sequence.has_value())
+        return 1;
+
+    const bool rendered = OfflineRenderer::RenderMidiToFile(*sequence, MidiSettings(), wavPath.string());
+    if (RealtimeSanitizer::getViolationCount() > 0)
+    {
+        RealtimeSanitizer::report(stderr);
+        return 1;
+    }
+    return rendered ? 0 : 1;
+}
+
+// Analyze a wav file into partial tracks for resynthesis, with no audio device or window.
+static int AnalyzePartialsHeadless(const std::filesystem::path& wavPath, const std::filesystem::path& partialsPath)
+{
+    auto tracks = AnalyzePartials(wavPath.string());
+    if (!tracks.has_value())
+        return 1;
+
+    return SavePartials(*tracks, partialsPath.string()) ? 0 : 1;
+}
+
+// Render a request script and compare it with (or, updating, save it as) a golden render.
+static int RenderCheckHeadless(int firstArgument)
+{
+    // This is a windowed app; borrow the console it was started from for the report.
+    if (AttachConsole(ATTACH_PARENT_PROCESS))
+    {
+        FILE* console = nullptr;
+        (void)freopen_s(&console, "CONOUT$", "w", stdout);
+    }
+
+    std::vector<std::string> arguments;
+    for (int argument = firstArgument; argument < __argc; ++argument)
+        arguments.push_back(std::filesystem::path(__wargv[argument]).string());
+    return RenderCheck::RunCommandLine(arguments);
+}
+
+// Time the saturation stage at every setting and a range of buffer sizes.
+static int BenchmarkSaturationHeadless()
+{
+    if (AttachConsole(ATTACH_PARENT_PROCESS))
+    {
+        FILE* console = nullptr;
+        (void)freopen_s(&console, "CONOUT$", "w", stdout);
+    }
+
+    BenchmarkSaturation(stdout);
+    return 0;
+}
+
 int APIENTRY wWinMain(_In_ HINSTANCE    /*hInstance*/,
                      _In_opt_ HINSTANCE /*hPrevInstance*/,
                      _In_ LPWSTR        /*lpCmdLine*/,
                      _In_ int           /*nCmdShow*/)
 {
+    // audiovisual.exe --render song.mid song.wav
+    if (__argc == 4 && std::wstring_view(__wargv[1]) == L"--render")
+        return RenderMidiHeadless(__wargv[2], __wargv[3]);
+
+    // audiovisual.exe --analyze sound.wav sound.partials
+    if (__argc == 4 && std::wstring_view(__wargv[1]) == L"--analyze")
+        return AnalyzePartialsHeadless(__wargv[2], __wargv[3]);
+
+    // audiovisual.exe --render-check [--update] [--kernels sse|scalar] [--abort-on-violation] script.txt golden.wav
+    if (__argc >= 2 && std::wstring_view(__wargv[1]) == L"--render-check")
+        return RenderCheckHeadless(2);
+
+    // audiovisual.exe --bench-saturation
+    if (__argc == 2 && std::wstring_view(__wargv[1]) == L"--bench-saturation")
+        return BenchmarkSaturationHeadless();
+
     if (Pa_Initialize() != paNoError)
         return -1;
 
-    PaStream* stream = InitializePAStream(paCallback);
-    if (stream == nullptr)
-        return -1;
+    // The workers have to be up before the stream starts calling back.
+    GeneratorMixer::getInstance().start();
+
+    // Open the stream at the device's own rate and convert to it ourselves, rather than
+    // leave it to the driver; if the device won't have that, ask for SAMPLE_RATE.
+    auto& resampler = OutputResampler::getInstance();
+    auto& streams = BufferSizeController::getInstance();
+    const double deviceRate = GetOutputDeviceSampleRate();
+    resampler.configure(deviceRate > 0.0 ? deviceRate : SAMPLE_RATE, ResamplerSettings());
+    if (!streams.open(paCallback, resampler.getOutputRate()))
+    {
+        resampler.configure(SAMPLE_RATE, ResamplerSettings());
+        if (!streams.open(paCallback, SAMPLE_RATE))
+            return -1;
+    }
 
     WaveTables::Initialize();
+    SampleStreamer::getInstance().start();
+    SpectrumAnalyzer::getInstance().start();
 
     if (!InitImGuiRendering())
         return 1;
 
+    Tracing::setThreadName("UI");
+
     // Main loop
     bool done = false;
     while (!done)
@@ -66,19 +182,70 @@ int APIENTRY wWinMain(_In_ HINSTANCE    /*hInstance*/,
         if (done)
             break;
 
+        streams.update();
+        resampler.update();
+        ConvolutionReverb::getInstance().update();
+
         RenderFrame(
-        [stream]()
+        [&streams, &resampler]()
         {
             // Handle communication from realtime thread
             (void)ThreadCommunication::processDeferredActions();
-            GetUIOscillatorView().HandleRealTimeResponse();
+            for (size_t generator = 0; generator < MAX_GENERATORS; ++generator)
+                GetUIOscillatorView(generator).HandleRealTimeResponse();
+
+            ImGui::Begin("Generators");
+            const size_t generator = ShowGeneratorMixer();
+            ImGui::End();
+
+            ImGui::Begin("Reverb");
+            ShowReverb();
+            ImGui::End();
 
             ImGui::Begin("Generator Settings");
-            GetUIOscillatorView().Show();
+            GetUIOscillatorView(generator).Show();
+            ImGui::End();
+
+            ImGui::Begin("Modulation");
+            GetUIOscillatorView(generator).ShowModulation();
+            ImGui::End();
+
+            ImGui::Begin("FM");
+            GetUIOscillatorView(generator).ShowFm();
+            ImGui::End();
+
+            ImGui::Begin("Granular");
+            GetUIOscillatorView(generator).ShowGranular();
+            ImGui::End();
+
+            // Sample streams belong to the first generator.
+            ImGui::Begin("Samples");
+            GetUIOscillatorView(0).ShowSamples();
+            ImGui::End();
+
+            ImGui::Begin("MIDI");
+            GetUIOscillatorView(generator).ShowMidi();
+            ImGui::End();
+
+            ImGui::Begin("Resynthesis");
+            GetUIOscillatorView(generator).ShowResynthesis();
+            ImGui::End();
+
+            ImGui::Begin("Spectrum");
+            auto& analyzer = SpectrumAnalyzer::getInstance();
+            Plotting::DrawSpectrum(analyzer.getBandFrequencies(), analyzer.getLatestFrame());
+            ImGui::End();
+
+            ImGui::Begin("Scope");
+            auto& snapshots = GeneratorAccess::getInstance(generator).getSnapshots();
+            (void)snapshots.update();
+            Plotting::DrawScope(snapshots.read().voices);
             ImGui::End();
 
             ImGui::Begin("Debug Info");
-            ShowDebugInfo(stream);
+            ShowDebugInfo(streams.getStream());
+            ShowBufferSizeController(streams);
+            ShowOutputResampler(resampler);
             ImGui::End();
 
 #if LOG_SESSION_TO_FILE
@@ -91,11 +258,24 @@ int APIENTRY wWinMain(_In_ HINSTANCE    /*hInstance*/,
     }
 
     TearDownWindowRendering();
-    TearDownPAStream(stream);
+    streams.close();
+    Pa_Terminate();
+    GeneratorMixer::getInstance().stop();
+    SampleStreamer::getInstance().stop();
+    SpectrumAnalyzer::getInstance().stop();
 
 #if LOG_SESSION_TO_FILE
     Logging::WriteSessionToFile();
 #endif
 
+#if REALTIME_SANITIZER
+    FILE* violations = nullptr;
+    if (RealtimeSanitizer::getViolationCount() > 0 && fopen_s(&violations, "realtime_violations.txt", "w") == 0)
+    {
+        RealtimeSanitizer::report(violations);
+        fclose(violations);
+    }
+#endif
+
     return 0;
 }
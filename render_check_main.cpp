@@ -0,0 +1,12 @@
+// The render check on its own, with no window or audio device, for running the goldens
+// under ctest on any platform the engine builds on. See render_check.h.
+
+#include "render_check.h"
+
+#include <string>
+#include <vector>
+
+int main(int argc, char** argv)
+{
+    return RenderCheck::RunCommandLine(std::vector<std::string>(argv + 1, argv + argc));
+}
@@ -0,0 +1,401 @@
+#include "buffer_size_controller.h"
+
+#include "constants.h"
+#include "tracing.h"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+
+BufferSizeController& BufferSizeController::getInstance()
+{
+    static BufferSizeController controller;
+    return controller;
+}
+
+bool BufferSizeController::open(PaCallbackT render, double sampleRate)
+{
+    m_render = render;
+    m_sample_rate = sampleRate;
+    m_current = 0;
+    m_handoff.store(packHandoff(0, 0));
+    resetHandoffRing();
+    m_streams[0] = openStream(0, paFramesPerBufferUnspecified);
+    m_window_start = Clock::now();
+    return m_streams[0] != nullptr;
+}
+
+PaStream* BufferSizeController::openStream(size_t slot, unsigned long framesPerBuffer)
+{
+    m_thread_named[slot] = false;
+    m_ring_position[slot] = -1;
+    m_fading_in[slot] = false;
+    return InitializePAStream(streamCallback, framesPerBuffer, reinterpret_cast<void*>(intptr_t(slot)), m_sample_rate);
+}
+
+bool BufferSizeController::restartStream(size_t slot)
+{
+    Pa_StopStream(m_streams[slot]);
+    m_ring_position[slot] = -1;
+    m_fading_in[slot] = false;
+    return Pa_StartStream(m_streams[slot]) == paNoError;
+}
+
+void BufferSizeController::close()
+{
+    for (PaStream*& stream : m_streams)
+    {
+        if (stream != nullptr)
+            ClosePAStream(stream);
+        stream = nullptr;
+    }
+    m_switching = false;
+}
+
+void BufferSizeController::resetHandoffRing()
+{
+    m_rendered.store(-1);
+    m_claimant_need.store(-1);
+    m_fade_start.store(-1);
+}
+
+namespace
+{
+    // Where a buffer starts on the DAC's clock; hosts that can't say still give the callback time.
+    double GetDacTime(const PaStreamCallbackTimeInfo* timeInfo)
+    {
+        return timeInfo->outputBufferDacTime > 0.0 ? timeInfo->outputBufferDacTime : timeInfo->currentTime;
+    }
+}
+
+int BufferSizeController::streamCallback(const void* input, void* output, unsigned long frames,
+                                         const PaStreamCallbackTimeInfo* timeInfo, PaStreamCallbackFlags flags, void* userData)
+{
+    BufferSizeController& controller = getInstance();
+    const int slot = int(reinterpret_cast<intptr_t>(userData));
+    float* const out = static_cast<float*>(output);
+
+    // Every stream has a callback thread of its own; name each once, as it starts.
+    if (!controller.m_thread_named[slot])
+    {
+        Tracing::setThreadName("audio callback");
+        controller.m_thread_named[slot] = true;
+    }
+
+    // A new stream claims rendering, and until it gets it plays what the old one renders for it.
+    uint32_t handoff = controller.m_handoff.load(std::memory_order_acquire);
+    if (getOwner(handoff) != slot)
+    {
+        if (getClaimant(handoff) != slot)
+            (void)controller.m_handoff.compare_exchange_strong(handoff, packHandoff(getOwner(handoff), slot), std::memory_order_relaxed);
+        controller.playClaim(slot, out, frames, timeInfo);
+        return paContinue;
+    }
+
+    if (getClaimant(handoff) != slot || controller.m_rendered.load(std::memory_order_relaxed) >= 0)
+        return controller.renderHandoff(slot, handoff, input, out, frames, timeInfo, flags);
+
+    const auto renderStart = Clock::now();
+    const int result = controller.m_render(input, output, frames, timeInfo, flags, nullptr);
+    const std::chrono::duration<float> elapsed = Clock::now() - renderStart;
+    controller.recordCallback(frames, elapsed.count() * float(controller.m_sample_rate) / float(frames), flags);
+    return result;
+}
+
+int BufferSizeController::renderHandoff(int slot, uint32_t handoff, const void* input, float* output, unsigned long frames,
+                                        const PaStreamCallbackTimeInfo* timeInfo, PaStreamCallbackFlags flags)
+{
+    int64_t rendered = m_rendered.load(std::memory_order_relaxed);
+    if (rendered < 0)
+    {
+        // The first buffer since the claim starts the ring.
+        m_ring_time.store(GetDacTime(timeInfo), std::memory_order_relaxed);
+        m_ring_position[slot] = 0;
+        rendered = 0;
+        m_rendered.store(0, std::memory_order_release);
+    }
+
+    const int64_t position = m_ring_position[slot];
+    const int64_t fadeStart = m_fade_start.load(std::memory_order_relaxed);
+    bool claimed = getClaimant(handoff) != slot;
+    if (claimed && fadeStart >= 0 && position >= fadeStart + CROSSFADE_FRAMES)
+    {
+        // Faded out. Everything rendered into the ring is published to the new owner by the release.
+        if (m_handoff.compare_exchange_strong(handoff, packHandoff(getClaimant(handoff), getClaimant(handoff)),
+                                              std::memory_order_acq_rel))
+        {
+            std::fill(output, output + frames * 2, 0.0f);
+            return paComplete;
+        }
+        // The claim was withdrawn; carry on as the only stream.
+        claimed = false;
+    }
+
+    // Render this buffer and, while there's a claimant, enough ahead that it doesn't run
+    // dry before the next callback here. Catching up with a claimant whose buffers fall
+    // further ahead takes at most one buffer extra per callback, so the load doesn't spike.
+    const int64_t end = position + int64_t(frames);
+    const int64_t claimantNeed = m_claimant_need.load(std::memory_order_relaxed);
+    int64_t target = end;
+    if (claimed && claimantNeed >= 0)
+        target = std::clamp(claimantNeed + int64_t(frames), end, std::max(end, rendered + 2 * int64_t(frames)));
+
+    int result = paContinue;
+    if (target > rendered)
+    {
+        const auto renderStart = Clock::now();
+        result = renderRing(rendered, target, input, timeInfo, flags);
+        const std::chrono::duration<float> elapsed = Clock::now() - renderStart;
+        recordCallback(frames, elapsed.count() * float(m_sample_rate) / float(target - rendered), flags);
+        rendered = target;
+    }
+
+    // Once the claimant is covered, fade across frames neither stream has played yet.
+    if (claimed && fadeStart < 0 && claimantNeed >= 0 && rendered >= claimantNeed + int64_t(frames))
+        m_fade_start.store(std::max(end, claimantNeed), std::memory_order_relaxed);
+
+    // A withdrawn claim leaves the old stream at full level.
+    playRing(slot, output, frames, m_fading_in[slot] ? Fade::In : claimed ? Fade::Out : Fade::None);
+
+    if (!claimed && m_ring_position[slot] >= rendered)
+    {
+        // Played out: render straight into the output from the next buffer on.
+        m_ring_position[slot] = -1;
+        m_fading_in[slot] = false;
+        m_claimant_need.store(-1, std::memory_order_relaxed);
+        m_fade_start.store(-1, std::memory_order_relaxed);
+        m_rendered.store(-1, std::memory_order_release);
+    }
+    return result;
+}
+
+void BufferSizeController::playClaim(int slot, float* output, unsigned long frames, const PaStreamCallbackTimeInfo* timeInfo)
+{
+    if (m_rendered.load(std::memory_order_acquire) < 0)
+    {
+        std::fill(output, output + frames * 2, 0.0f);
+        return;
+    }
+
+    // Place this stream's buffers in the ring by when they reach the DAC, once; after
+    // that they follow on from each other, so jitter in the timestamps can't skip or
+    // repeat frames.
+    int64_t& position = m_ring_position[slot];
+    if (position < 0)
+    {
+        position = std::llround((GetDacTime(timeInfo) - m_ring_time.load(std::memory_order_relaxed)) * m_sample_rate);
+        m_fading_in[slot] = true;
+    }
+    playRing(slot, output, frames, Fade::In);
+
+    // Assume the next buffer is the same size.
+    m_claimant_need.store(position + int64_t(frames), std::memory_order_relaxed);
+}
+
+int BufferSizeController::renderRing(int64_t from, int64_t to, const void* input,
+                                     const PaStreamCallbackTimeInfo* timeInfo, PaStreamCallbackFlags flags)
+{
+    int result = paContinue;
+    const double ringTime = m_ring_time.load(std::memory_order_relaxed);
+    while (from < to)
+    {
+        const size_t index = size_t(from) & (HANDOFF_RING_FRAMES - 1);
+        const size_t count = std::min({ size_t(to - from), HANDOFF_RING_FRAMES - index, size_t(MAX_FRAMES) });
+
+        // Each piece is rendered for when it reaches the DAC, so drift compensation sees a steady clock.
+        PaStreamCallbackTimeInfo pieceTime = *timeInfo;
+        pieceTime.outputBufferDacTime = ringTime + double(from) / m_sample_rate;
+        result = m_render(input, &m_ring[index * 2], count, &pieceTime, flags, nullptr);
+
+        from += int64_t(count);
+        m_rendered.store(from, std::memory_order_release);
+    }
+    return result;
+}
+
+void BufferSizeController::playRing(int slot, float* output, unsigned long frames, Fade fade)
+{
+    const int64_t rendered = m_rendered.load(std::memory_order_acquire);
+    const int64_t fadeStart = m_fade_start.load(std::memory_order_relaxed);
+    int64_t& position = m_ring_position[slot];
+    for (unsigned long frame = 0; frame < frames; ++frame, ++position)
+    {
+        // Frames not rendered yet, or far enough behind that the owner may be overwriting
+        // them, play as silence. The owner never renders half a ring ahead in one go.
+        if (position < 0 || position >= rendered || rendered - position > int64_t(HANDOFF_RING_FRAMES / 2))
+        {
+            output[frame * 2] = 0.0f;
+            output[frame * 2 + 1] = 0.0f;
+            continue;
+        }
+
+        // Linear, since both streams play the same frames: the two gains always sum to one.
+        const float fadeIn = fadeStart < 0 ? 0.0f : std::clamp(float(position - fadeStart) / float(CROSSFADE_FRAMES), 0.0f, 1.0f);
+        const float gain = fade == Fade::In ? fadeIn : fade == Fade::Out ? 1.0f - fadeIn : 1.0f;
+        const size_t index = size_t(position) & (HANDOFF_RING_FRAMES - 1);
+        output[frame * 2] = m_ring[index * 2] * gain;
+        output[frame * 2 + 1] = m_ring[index * 2 + 1] * gain;
+    }
+}
+
+void BufferSizeController::recordCallback(unsigned long frames, float load, PaStreamCallbackFlags flags)
+{
+    m_frames.store(frames, std::memory_order_relaxed);
+
+    const auto increment = [](std::atomic<uint64_t>& counter) {
+        counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    };
+    increment(m_callbacks);
+    if (load > MISS_LOAD)
+        increment(m_missed);
+    if (load < HEADROOM_LOAD)
+        increment(m_headroom);
+    if ((flags & paOutputUnderflow) != 0)
+        increment(m_underflows);
+
+    float maxLoad = m_max_load.load(std::memory_order_relaxed);
+    while (load > maxLoad && !m_max_load.compare_exchange_weak(maxLoad, load, std::memory_order_relaxed)) { }
+}
+
+void BufferSizeController::update()
+{
+    // With no stream there's nothing to measure, and nothing to switch from.
+    if (!isRunning())
+        return;
+
+    const auto now = Clock::now();
+    if (m_switching)
+    {
+        finishSwitch(now);
+        return;
+    }
+
+    if (now - m_window_start >= WINDOW)
+        evaluateWindow(now);
+}
+
+void BufferSizeController::evaluateWindow(Clock::time_point now)
+{
+    const uint64_t callbacks = m_callbacks.load(std::memory_order_relaxed);
+    const uint64_t missed = m_missed.load(std::memory_order_relaxed);
+    const uint64_t headroom = m_headroom.load(std::memory_order_relaxed);
+    const uint64_t underflows = m_underflows.load(std::memory_order_relaxed);
+
+    const uint64_t windowCallbacks = callbacks - m_window_callbacks;
+    const uint64_t windowMissed = missed - m_window_missed;
+    const uint64_t windowHeadroom = headroom - m_window_headroom;
+    const uint64_t windowUnderflows = underflows - m_window_underflows;
+    m_window_callbacks = callbacks;
+    m_window_missed = missed;
+    m_window_headroom = headroom;
+    m_window_underflows = underflows;
+    m_window_start = now;
+
+    const unsigned long frames = m_frames.load(std::memory_order_relaxed);
+    m_stats.framesPerBuffer = frames;
+    m_stats.load = m_max_load.exchange(0.0f, std::memory_order_relaxed);
+    m_stats.underflows = underflows;
+
+    if (windowCallbacks == 0 || frames == 0)
+        return;
+
+    // One bad callback in a hundred counts as a miss; an underflow always does.
+    const bool miss = windowUnderflows > 0 || windowMissed * 100 > windowCallbacks;
+    const bool roomy = !miss && windowHeadroom == windowCallbacks;
+    m_miss_windows = miss ? m_miss_windows + 1 : 0;
+    m_headroom_windows = roomy ? m_headroom_windows + 1 : 0;
+
+    if (!m_adaptive)
+        return;
+
+    if (now >= m_floor_expires)
+        m_floor_frames = MIN_FRAMES;
+
+    if (m_miss_windows >= MISS_WINDOWS_TO_GROW && frames < MAX_FRAMES)
+    {
+        // Back off, and stay off this size for a while.
+        const unsigned long bigger = std::min(std::bit_floor(frames) * 2, MAX_FRAMES);
+        m_floor_frames = bigger;
+        m_floor_expires = now + BACKOFF_COOLDOWN;
+        beginSwitch(bigger, now);
+    }
+    else if (m_headroom_windows >= HEADROOM_WINDOWS_TO_SHRINK)
+    {
+        const unsigned long smaller = std::bit_ceil(frames) / 2;
+        if (smaller >= std::max(MIN_FRAMES, m_floor_frames))
+            beginSwitch(smaller, now);
+    }
+}
+
+void BufferSizeController::beginSwitch(unsigned long framesPerBuffer, Clock::time_point now)
+{
+    const size_t next = 1 - m_current;
+    m_streams[next] = openStream(next, framesPerBuffer);
+    m_miss_windows = 0;
+    m_headroom_windows = 0;
+    if (m_streams[next] == nullptr)
+    {
+        // The device won't do this size; don't keep asking.
+        m_floor_frames = std::max(m_floor_frames, framesPerBuffer * 2);
+        m_floor_expires = now + BACKOFF_COOLDOWN;
+        return;
+    }
+
+    m_switching = true;
+    m_switch_started = now;
+}
+
+void BufferSizeController::finishSwitch(Clock::time_point now)
+{
+    const size_t next = 1 - m_current;
+    if (getOwner(m_handoff.load(std::memory_order_acquire)) == int(next))
+    {
+        // Wait for the new stream to play out the ring, so the next switch starts afresh.
+        if (m_rendered.load(std::memory_order_acquire) >= 0)
+            return;
+
+        // The old stream faded out and completed.
+        ClosePAStream(m_streams[m_current]);
+        m_streams[m_current] = nullptr;
+        m_current = next;
+        ++m_stats.switches;
+    }
+    else if (now - m_switch_started > HANDOFF_TIMEOUT)
+    {
+        // The new stream never got going. Once it's closed it can't claim anything, so
+        // withdrawing its claim leaves the old stream rendering as before.
+        ClosePAStream(m_streams[next]);
+        m_streams[next] = nullptr;
+
+        uint32_t handoff = m_handoff.load(std::memory_order_acquire);
+        while (getOwner(handoff) == int(m_current) &&
+               !m_handoff.compare_exchange_weak(handoff, packHandoff(int(m_current), int(m_current)), std::memory_order_acq_rel)) { }
+
+        if (getOwner(handoff) == int(next))
+        {
+            // The handoff happened at the last moment and the old stream has completed;
+            // neither is running. Give rendering back to the old stream and start it again.
+            // If it won't start, there's no output at all; the UI says so (see isRunning).
+            m_handoff.store(packHandoff(int(m_current), int(m_current)), std::memory_order_release);
+            resetHandoffRing();
+            if (!restartStream(m_current))
+            {
+                ClosePAStream(m_streams[m_current]);
+                m_streams[m_current] = nullptr;
+            }
+        }
+    }
+    else
+    {
+        return;
+    }
+
+    // Measurements from the switch itself don't count.
+    m_switching = false;
+    m_window_start = now;
+    m_window_callbacks = m_callbacks.load(std::memory_order_relaxed);
+    m_window_missed = m_missed.load(std::memory_order_relaxed);
+    m_window_headroom = m_headroom.load(std::memory_order_relaxed);
+    m_window_underflows = m_underflows.load(std::memory_order_relaxed);
+}
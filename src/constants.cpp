@@ -22,26 +22,28 @@ void WaveTables::Initialize()
     }
 }
 
+std::array<std::array<float, TABLE_SIZE>, WAVETABLE_FRAMES>& WaveTables::getFrames()
+{
+    static std::array<std::array<float, TABLE_SIZE>, WAVETABLE_FRAMES> frames;
+    return frames;
+}
+
 std::array<float, TABLE_SIZE>& WaveTables::getSine()
 {
-    static std::array<float, TABLE_SIZE> sine;
-    return sine;
+    return getFrames()[0];
 }
 
 std::array<float, TABLE_SIZE>& WaveTables::getSquare()
 {
-    static std::array<float, TABLE_SIZE> square;
-    return square;
+    return getFrames()[1];
 }
 
 std::array<float, TABLE_SIZE>& WaveTables::getTriangle()
 {
-    static std::array<float, TABLE_SIZE> triangle;
-    return triangle;
+    return getFrames()[2];
 }
 
 std::array<float, TABLE_SIZE>& WaveTables::getSaw()
 {
-    static std::array<float, TABLE_SIZE> saw;
-    return saw;
+    return getFrames()[3];
 }
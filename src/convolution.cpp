@@ -0,0 +1,336 @@
+#include "convolution.h"
+
+#include "AudioFile.h"
+#include "realtime_sanitizer.h"
+#include "tracing.h"
+
+#include <algorithm>
+#include <cmath>
+#include <immintrin.h>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#endif
+
+UniformConvolver::UniformConvolver(std::span<const float> impulse, size_t blockSize)
+    : m_block_size(blockSize)
+    , m_bins(blockSize + 1)
+    , m_partitions(std::max<size_t>(1, (impulse.size() + blockSize - 1) / blockSize))
+    , m_fft(blockSize * 2)
+    , m_impulse_real(m_partitions * m_bins)
+    , m_impulse_imaginary(m_partitions * m_bins)
+    , m_delay_real(m_partitions * m_bins)
+    , m_delay_imaginary(m_partitions * m_bins)
+    , m_input(blockSize * 2)
+    , m_output(blockSize * 2)
+    , m_sum_real(m_bins)
+    , m_sum_imaginary(m_bins)
+{
+    for (size_t partition = 0; partition < m_partitions; ++partition)
+    {
+        const size_t start = std::min(partition * blockSize, impulse.size());
+        const size_t count = std::min(blockSize, impulse.size() - start);
+        std::fill(m_input.begin(), m_input.end(), 0.0f);
+        std::copy_n(impulse.begin() + ptrdiff_t(start), count, m_input.begin());
+        m_fft.forward(m_input, std::span(m_impulse_real).subspan(partition * m_bins, m_bins),
+                      std::span(m_impulse_imaginary).subspan(partition * m_bins, m_bins));
+    }
+    std::fill(m_input.begin(), m_input.end(), 0.0f);
+}
+
+void UniformConvolver::process(std::span<const float> input, std::span<float> output)
+{
+    // The transform covers the last block and this one; only the second half of its
+    // inverse is free of wraparound, and that's the output.
+    std::copy(m_input.begin() + ptrdiff_t(m_block_size), m_input.end(), m_input.begin());
+    std::copy(input.begin(), input.end(), m_input.begin() + ptrdiff_t(m_block_size));
+
+    m_newest = m_newest + 1 == m_partitions ? 0 : m_newest + 1;
+    m_fft.forward(m_input, std::span(m_delay_real).subspan(m_newest * m_bins, m_bins),
+                  std::span(m_delay_imaginary).subspan(m_newest * m_bins, m_bins));
+
+    std::fill(m_sum_real.begin(), m_sum_real.end(), 0.0f);
+    std::fill(m_sum_imaginary.begin(), m_sum_imaginary.end(), 0.0f);
+    float* const sumReal = m_sum_real.data();
+    float* const sumImaginary = m_sum_imaginary.data();
+    for (size_t partition = 0; partition < m_partitions; ++partition)
+    {
+        // Partition p meets the input from p blocks ago.
+        const size_t delayed = m_newest >= partition ? m_newest - partition : m_newest + m_partitions - partition;
+        const float* const hReal = m_impulse_real.data() + partition * m_bins;
+        const float* const hImaginary = m_impulse_imaginary.data() + partition * m_bins;
+        const float* const xReal = m_delay_real.data() + delayed * m_bins;
+        const float* const xImaginary = m_delay_imaginary.data() + delayed * m_bins;
+        for (size_t bin = 0; bin < m_bins; ++bin)
+        {
+            sumReal[bin] += hReal[bin] * xReal[bin] - hImaginary[bin] * xImaginary[bin];
+            sumImaginary[bin] += hReal[bin] * xImaginary[bin] + hImaginary[bin] * xReal[bin];
+        }
+    }
+
+    m_fft.inverse(m_sum_real, m_sum_imaginary, m_output);
+    std::copy(m_output.begin() + ptrdiff_t(m_block_size), m_output.end(), output.begin());
+}
+
+std::unique_ptr<ImpulseResponseConvolver> ImpulseResponseConvolver::load(const std::string& path)
+{
+    RealtimeSanitizer::checkBlockingCall("ImpulseResponseConvolver::load");
+    AudioFile<float> audioFile;
+    if (!audioFile.load(path) || audioFile.getNumChannels() == 0 || audioFile.getNumSamplesPerChannel() == 0 ||
+        audioFile.getSampleRate() == 0)
+        return nullptr;
+
+    const size_t sourceFrames = size_t(audioFile.getNumSamplesPerChannel());
+    const double ratio = double(audioFile.getSampleRate()) / SAMPLE_RATE; // source frames per output frame
+    const size_t frames = std::min(std::max<size_t>(1, size_t(double(sourceFrames) / ratio)), size_t(MAX_SECONDS * SAMPLE_RATE));
+
+    std::unique_ptr<ImpulseResponseConvolver> convolver(new ImpulseResponseConvolver());
+    convolver->m_frames = frames;
+    convolver->m_channels = std::min<size_t>(size_t(audioFile.getNumChannels()), 2);
+
+    std::array<std::vector<float>, 2> response;
+    double loudestEnergy = 0.0;
+    for (size_t channel = 0; channel < convolver->m_channels; ++channel)
+    {
+        const std::vector<float>& source = audioFile.samples[channel];
+        std::vector<float>& resampled = response[channel];
+        resampled.resize(frames);
+        double energy = 0.0;
+        for (size_t frame = 0; frame < frames; ++frame)
+        {
+            const double position = double(frame) * ratio;
+            const size_t index = size_t(position);
+            const float t = float(position - double(index));
+            const float a = source[index];
+            const float b = index + 1 < sourceFrames ? source[index + 1] : 0.0f;
+            resampled[frame] = a + (b - a) * t;
+            energy += double(resampled[frame]) * resampled[frame];
+        }
+        loudestEnergy = std::max(loudestEnergy, energy);
+    }
+
+    const float scale = loudestEnergy > 0.0 ? float(1.0 / std::sqrt(loudestEnergy)) : 0.0f;
+    for (size_t channel = 0; channel < 2; ++channel)
+    {
+        // A mono response plays in both channels.
+        std::vector<float>& channelResponse = response[std::min(channel, convolver->m_channels - 1)];
+        if (channel < convolver->m_channels)
+        {
+            for (float& sample : channelResponse)
+                sample *= scale;
+        }
+
+        const std::span<const float> impulse(channelResponse);
+        convolver->m_heads.push_back(std::make_unique<UniformConvolver>(impulse.first(std::min(frames, TAIL_OFFSET)), HEAD_BLOCK));
+        if (frames > TAIL_OFFSET)
+            convolver->m_tails.push_back(std::make_unique<UniformConvolver>(impulse.subspan(TAIL_OFFSET), TAIL_BLOCK));
+    }
+
+    if (!convolver->m_tails.empty())
+    {
+        for (size_t slot = 0; slot < TAIL_SLOTS; ++slot)
+        {
+            for (size_t channel = 0; channel < 2; ++channel)
+            {
+                convolver->m_tail_input[slot][channel].assign(TAIL_BLOCK, 0.0f);
+                convolver->m_tail_output[slot][channel].assign(TAIL_BLOCK, 0.0f);
+            }
+        }
+
+        convolver->m_running.store(true);
+        convolver->m_tail_thread = std::thread([convolver = convolver.get()]() { convolver->runTail(); });
+#if defined(_WIN32)
+        // It has deadlines too, if looser ones than the audio callback.
+        SetThreadPriority(convolver->m_tail_thread.native_handle(), THREAD_PRIORITY_HIGHEST);
+#endif
+    }
+    return convolver;
+}
+
+ImpulseResponseConvolver::~ImpulseResponseConvolver()
+{
+    if (!m_tail_thread.joinable())
+        return;
+
+    m_running.store(false, std::memory_order_release);
+    m_tail_posted.fetch_add(1, std::memory_order_release);
+    m_tail_posted.notify_all();
+    m_tail_thread.join();
+}
+
+void ImpulseResponseConvolver::process(std::span<float> inOut, float& gain, float gainStep)
+{
+    const size_t frames = inOut.size() / 2;
+    for (size_t frame = 0; frame < frames;)
+    {
+        // The wet block playing now came out of the last head block, HEAD_BLOCK frames ago.
+        const size_t count = std::min(frames - frame, HEAD_BLOCK - m_head_fill);
+        for (size_t offset = 0; offset < count; ++offset)
+        {
+            const size_t index = (frame + offset) * 2;
+            const size_t position = m_head_fill + offset;
+            gain += gainStep;
+            m_head_input[0][position] = inOut[index];
+            m_head_input[1][position] = inOut[index + 1];
+            inOut[index]     += m_wet[0][position] * gain; // left channel
+            inOut[index + 1] += m_wet[1][position] * gain; // right channel
+        }
+
+        m_head_fill += count;
+        frame += count;
+        if (m_head_fill == HEAD_BLOCK)
+        {
+            processHeadBlock();
+            m_head_fill = 0;
+        }
+    }
+}
+
+void ImpulseResponseConvolver::processHeadBlock()
+{
+    for (size_t channel = 0; channel < 2; ++channel)
+        m_heads[channel]->process(m_head_input[channel], m_wet[channel]);
+
+    if (!m_tails.empty())
+    {
+        // Hand the tail thread a block of input once there's a whole one.
+        const size_t inputSlot = size_t(m_tail_blocks % TAIL_SLOTS);
+        for (size_t channel = 0; channel < 2; ++channel)
+            std::copy(m_head_input[channel].begin(), m_head_input[channel].end(), m_tail_input[inputSlot][channel].begin() + ptrdiff_t(m_tail_fill));
+        m_tail_fill += HEAD_BLOCK;
+        if (m_tail_fill == TAIL_BLOCK)
+        {
+            m_tail_fill = 0;
+            m_tail_posted.store(++m_tail_blocks, std::memory_order_release);
+            RealtimeSanitizer::checkBlockingCall("ImpulseResponseConvolver notify"); // a system call, if a short one
+            m_tail_posted.notify_one();
+        }
+
+        // Tail block b is the response past TAIL_OFFSET to input block b, so it lands
+        // TAIL_OFFSET frames after that block started. Its input was handed over at
+        // least TAIL_OFFSET - TAIL_BLOCK frames before this point.
+        const uint64_t start = m_head_blocks * HEAD_BLOCK;
+        if (start >= TAIL_OFFSET)
+        {
+            const uint64_t block = (start - TAIL_OFFSET) / TAIL_BLOCK;
+            const size_t offset = size_t((start - TAIL_OFFSET) % TAIL_BLOCK);
+            if (m_tail_done.load(std::memory_order_acquire) <= block)
+            {
+                // Never sleep on the audio thread; it's usually a moment away. Still, it's
+                // waiting on another thread, which realtime code shouldn't.
+                RealtimeSanitizer::checkBlockingCall("ImpulseResponseConvolver waiting for the tail");
+                m_late_blocks.store(m_late_blocks.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+                while (m_tail_done.load(std::memory_order_acquire) <= block)
+                    _mm_pause();
+            }
+
+            const size_t outputSlot = size_t(block % TAIL_SLOTS);
+            for (size_t channel = 0; channel < 2; ++channel)
+            {
+                const float* const tail = m_tail_output[outputSlot][channel].data() + offset;
+                for (size_t index = 0; index < HEAD_BLOCK; ++index)
+                    m_wet[channel][index] += tail[index];
+            }
+        }
+    }
+
+    ++m_head_blocks;
+}
+
+void ImpulseResponseConvolver::runTail()
+{
+    Tracing::setThreadName("convolution tail");
+
+    uint64_t done = 0;
+    while (true)
+    {
+        m_tail_posted.wait(done, std::memory_order_acquire);
+
+        // The destructor stops us by clearing m_running, then bumping the count to
+        // wake us. Checking m_running after loading the count means a count with the
+        // bump in it always stops us, rather than being taken for one more block and
+        // leaving us waiting on a count that will never move again.
+        const uint64_t posted = m_tail_posted.load(std::memory_order_acquire);
+        if (!m_running.load(std::memory_order_acquire))
+            return;
+
+        // Catch up on every block handed over, in order; the delay lines depend on it.
+        for (; done < posted; m_tail_done.store(++done, std::memory_order_release))
+        {
+            const size_t slot = size_t(done % TAIL_SLOTS);
+            for (size_t channel = 0; channel < 2; ++channel)
+                m_tails[channel]->process(m_tail_input[slot][channel], m_tail_output[slot][channel]);
+        }
+    }
+}
+
+ConvolutionReverb& ConvolutionReverb::getInstance()
+{
+    static ConvolutionReverb reverb;
+    return reverb;
+}
+
+ConvolutionReverb::~ConvolutionReverb()
+{
+    delete m_pending.exchange(nullptr);
+    delete m_retired.exchange(nullptr);
+    delete m_current;
+}
+
+bool ConvolutionReverb::load(const std::string& path)
+{
+    std::unique_ptr<ImpulseResponseConvolver> convolver = ImpulseResponseConvolver::load(path);
+    if (!convolver)
+        return false;
+
+    // A response the audio thread never picked up is still ours to free.
+    m_loaded = convolver.get();
+    delete m_pending.exchange(convolver.release(), std::memory_order_acq_rel);
+    return true;
+}
+
+void ConvolutionReverb::clear()
+{
+    m_loaded = nullptr;
+    delete m_pending.exchange(nullptr, std::memory_order_acq_rel);
+    m_clear_requested.store(true, std::memory_order_release);
+}
+
+void ConvolutionReverb::update()
+{
+    // Freeing a response joins its tail thread, which is why it happens here.
+    delete m_retired.exchange(nullptr, std::memory_order_acq_rel);
+}
+
+void ConvolutionReverb::process(std::span<float> output)
+{
+    // Swap between buffers, once the UI has collected the last response swapped out.
+    // A new response fades in from silence; the old one's tail is cut off.
+    if (m_retired.load(std::memory_order_acquire) == nullptr)
+    {
+        if (m_clear_requested.load(std::memory_order_relaxed) && m_clear_requested.exchange(false, std::memory_order_acq_rel))
+        {
+            m_retired.store(m_current, std::memory_order_release);
+            m_current = nullptr;
+        }
+        else if (m_pending.load(std::memory_order_relaxed) != nullptr)
+        {
+            m_retired.store(m_current, std::memory_order_release);
+            m_current = m_pending.exchange(nullptr, std::memory_order_acq_rel);
+            m_processed_wet = 0.0f;
+        }
+    }
+
+    const float target = m_wet.load(std::memory_order_relaxed);
+    if (m_current == nullptr || output.empty())
+    {
+        m_processed_wet = target;
+        return;
+    }
+
+    Tracing::Span span("ConvolutionReverb::process");
+    float gain = m_processed_wet;
+    m_current->process(output, gain, (target - gain) / float(output.size() / 2));
+    m_processed_wet = target;
+}
@@ -0,0 +1,185 @@
+#include "fft.h"
+
+#include "constants.h"
+
+#include <cassert>
+#include <cmath>
+#include <immintrin.h>
+
+RealFft::RealFft(size_t size)
+    : m_size(size)
+    , m_half(size / 2)
+    , m_real(size / 2)
+    , m_imaginary(size / 2)
+    , m_bit_reverse(size / 2)
+    , m_twiddle_real(size / 2)
+    , m_twiddle_imaginary(size / 2)
+    , m_split_real(size / 2 + 1)
+    , m_split_imaginary(size / 2 + 1)
+{
+    assert(size >= 16 && (size & (size - 1)) == 0);
+
+    size_t bits = 0;
+    while ((size_t(1) << bits) < m_half)
+        ++bits;
+    for (size_t index = 0; index < m_half; ++index)
+    {
+        size_t reversed = 0;
+        for (size_t bit = 0; bit < bits; ++bit)
+            reversed |= ((index >> bit) & 1) << (bits - 1 - bit);
+        m_bit_reverse[index] = reversed;
+    }
+
+    // The stage with half-span h keeps its h twiddles at offset h - 1.
+    for (size_t span = 2; span <= m_half; span *= 2)
+    {
+        const size_t halfSpan = span / 2;
+        for (size_t index = 0; index < halfSpan; ++index)
+        {
+            const double angle = -TWO_PI * double(index) / double(span);
+            m_twiddle_real[halfSpan - 1 + index] = float(std::cos(angle));
+            m_twiddle_imaginary[halfSpan - 1 + index] = float(std::sin(angle));
+        }
+    }
+
+    for (size_t bin = 0; bin <= m_half; ++bin)
+    {
+        const double angle = -TWO_PI * double(bin) / double(m_size);
+        m_split_real[bin] = float(std::cos(angle));
+        m_split_imaginary[bin] = float(std::sin(angle));
+    }
+}
+
+void RealFft::forward(std::span<const float> input, std::span<float> real, std::span<float> imaginary)
+{
+    assert(input.size() == m_size && real.size() > m_half && imaginary.size() > m_half);
+
+    // Pack even samples into the real part and odd ones into the imaginary part, in bit-reversed order.
+    for (size_t index = 0; index < m_half; ++index)
+    {
+        const size_t source = m_bit_reverse[index];
+        m_real[index] = input[2 * source];
+        m_imaginary[index] = input[2 * source + 1];
+    }
+
+    transformHalf();
+
+    // Split the packed spectrum Z into the spectrum X of the real input:
+    // X[k] = (Z[k] + conj(Z[M - k])) / 2 - i e^(-2 pi i k / N) (Z[k] - conj(Z[M - k])) / 2
+    for (size_t bin = 0; bin <= m_half; ++bin)
+    {
+        const size_t k = bin == m_half ? 0 : bin;
+        const size_t mirror = bin == 0 ? 0 : m_half - bin;
+        const float zReal = m_real[k], zImaginary = m_imaginary[k];
+        const float mReal = m_real[mirror], mImaginary = m_imaginary[mirror];
+
+        const float evenReal = 0.5f * (zReal + mReal);
+        const float evenImaginary = 0.5f * (zImaginary - mImaginary);
+        const float oddReal = 0.5f * (zImaginary + mImaginary);
+        const float oddImaginary = -0.5f * (zReal - mReal);
+
+        const float wReal = m_split_real[bin], wImaginary = m_split_imaginary[bin];
+        real[bin] = evenReal + wReal * oddReal - wImaginary * oddImaginary;
+        imaginary[bin] = evenImaginary + wReal * oddImaginary + wImaginary * oddReal;
+    }
+}
+
+void RealFft::inverse(std::span<const float> real, std::span<const float> imaginary, std::span<float> output)
+{
+    assert(output.size() == m_size && real.size() > m_half && imaginary.size() > m_half);
+
+    // Undo the split: Z[k] = E[k] + i O[k], with E[k] = (X[k] + conj(X[M - k])) / 2 and
+    // O[k] = e^(2 pi i k / N) (X[k] - conj(X[M - k])) / 2. The inverse of Z is the
+    // conjugate of the forward transform of its conjugate, so the conjugate goes in,
+    // bit-reversed, and the result is conjugated on the way out.
+    for (size_t bin = 0; bin < m_half; ++bin)
+    {
+        const size_t mirror = m_half - bin;
+        const float xReal = real[bin], xImaginary = imaginary[bin];
+        const float mReal = real[mirror], mImaginary = imaginary[mirror];
+
+        const float evenReal = 0.5f * (xReal + mReal);
+        const float evenImaginary = 0.5f * (xImaginary - mImaginary);
+        const float differenceReal = 0.5f * (xReal - mReal);
+        const float differenceImaginary = 0.5f * (xImaginary + mImaginary);
+
+        // Multiply by the conjugate twiddle.
+        const float wReal = m_split_real[bin], wImaginary = -m_split_imaginary[bin];
+        const float oddReal = wReal * differenceReal - wImaginary * differenceImaginary;
+        const float oddImaginary = wReal * differenceImaginary + wImaginary * differenceReal;
+
+        const size_t target = m_bit_reverse[bin];
+        m_real[target] = evenReal - oddImaginary;
+        m_imaginary[target] = -(evenImaginary + oddReal);
+    }
+
+    transformHalf();
+
+    const float scale = 1.0f / float(m_half);
+    for (size_t index = 0; index < m_half; ++index)
+    {
+        output[2 * index] = m_real[index] * scale;
+        output[2 * index + 1] = -m_imaginary[index] * scale;
+    }
+}
+
+void RealFft::transformHalf()
+{
+    float* const re = m_real.data();
+    float* const im = m_imaginary.data();
+
+    // The first two stages have too few butterflies per group for SIMD.
+    for (size_t start = 0; start < m_half; start += 2)
+    {
+        const float tReal = re[start + 1], tImaginary = im[start + 1];
+        re[start + 1] = re[start] - tReal;
+        im[start + 1] = im[start] - tImaginary;
+        re[start] += tReal;
+        im[start] += tImaginary;
+    }
+    for (size_t start = 0; start < m_half; start += 4)
+    {
+        // Twiddles for a span of 4 are 1 and -i.
+        float tReal = re[start + 2], tImaginary = im[start + 2];
+        re[start + 2] = re[start] - tReal;
+        im[start + 2] = im[start] - tImaginary;
+        re[start] += tReal;
+        im[start] += tImaginary;
+
+        tReal = im[start + 3];
+        tImaginary = -re[start + 3];
+        re[start + 3] = re[start + 1] - tReal;
+        im[start + 3] = im[start + 1] - tImaginary;
+        re[start + 1] += tReal;
+        im[start + 1] += tImaginary;
+    }
+
+    for (size_t span = 8; span <= m_half; span *= 2)
+    {
+        const size_t halfSpan = span / 2;
+        const float* const twReal = m_twiddle_real.data() + halfSpan - 1;
+        const float* const twImaginary = m_twiddle_imaginary.data() + halfSpan - 1;
+        for (size_t start = 0; start < m_half; start += span)
+        {
+            float* const aReal = re + start;
+            float* const aImaginary = im + start;
+            float* const bReal = aReal + halfSpan;
+            float* const bImaginary = aImaginary + halfSpan;
+            for (size_t index = 0; index < halfSpan; index += 4)
+            {
+                const __m128 wr = _mm_loadu_ps(twReal + index);
+                const __m128 wi = _mm_loadu_ps(twImaginary + index);
+                const __m128 br = _mm_loadu_ps(bReal + index);
+                const __m128 bi = _mm_loadu_ps(bImaginary + index);
+                const __m128 tr = _mm_sub_ps(_mm_mul_ps(wr, br), _mm_mul_ps(wi, bi));
+                const __m128 ti = _mm_add_ps(_mm_mul_ps(wr, bi), _mm_mul_ps(wi, br));
+                const __m128 ar = _mm_loadu_ps(aReal + index);
+                const __m128 ai = _mm_loadu_ps(aImaginary + index);
+                _mm_storeu_ps(bReal + index, _mm_sub_ps(ar, tr));
+                _mm_storeu_ps(bImaginary + index, _mm_sub_ps(ai, ti));
+                _mm_storeu_ps(aReal + index, _mm_add_ps(ar, tr));
+                _mm_storeu_ps(aImaginary + index, _mm_add_ps(ai, ti));
+            }
+        }
+    }
+}
@@ -0,0 +1,166 @@
+#include "generator_mixer.h"
+
+#include "convolution.h"
+#include "realtime_sanitizer.h"
+#include "thread_communication.h"
+#include "tracing.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <immintrin.h>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#endif
+
+GeneratorMixer& GeneratorMixer::getInstance()
+{
+    static GeneratorMixer mixer;
+    return mixer;
+}
+
+void GeneratorMixer::start()
+{
+    if (m_running.load())
+        return;
+
+    // Workers wait for the epoch to move on from here. It can't move until m_running is set.
+    const uint32_t epoch = m_epoch.load();
+    for (size_t generator = 1; generator < MAX_GENERATORS; ++generator)
+    {
+        m_workers.emplace_back([this, generator, epoch]() { run(generator, epoch); });
+#if defined(_WIN32)
+        // As urgent as the audio callback, and preferably each on a core of its own.
+        SetThreadPriority(m_workers.back().native_handle(), THREAD_PRIORITY_TIME_CRITICAL);
+        SetThreadIdealProcessor(m_workers.back().native_handle(), DWORD(generator));
+#endif
+    }
+    m_running.store(true);
+}
+
+void GeneratorMixer::stop()
+{
+    if (!m_running.exchange(false))
+        return;
+
+    m_epoch.fetch_add(1);
+    RealtimeSanitizer::checkBlockingCall("GeneratorMixer::stop notify");
+    m_epoch.notify_all();
+    for (auto& worker : m_workers)
+        worker.join();
+    m_workers.clear();
+}
+
+void GeneratorMixer::writeSamples(std::span<float> output)
+{
+    Tracing::Span span("GeneratorMixer::writeSamples");
+    for (size_t start = 0; start < output.size(); start += MAX_MIX_FRAMES * 2)
+    {
+        const std::span<float> piece = output.subspan(start, std::min(output.size() - start, MAX_MIX_FRAMES * 2));
+        const size_t frames = piece.size() / 2;
+
+        if (m_running.load(std::memory_order_relaxed))
+        {
+            m_frames = frames;
+            m_pending.store(MAX_GENERATORS - 1, std::memory_order_relaxed);
+            // Waking a worker is a system call, so only make it if one went to sleep. Both
+            // sides are seq_cst: either we see the sleeper, or it sees the new epoch and
+            // doesn't wait.
+            m_epoch.fetch_add(1);
+            if (m_sleeping.load() != 0)
+            {
+                RealtimeSanitizer::checkBlockingCall("GeneratorMixer::writeSamples notify");
+                m_epoch.notify_all();
+            }
+
+            renderGenerator(0, frames);
+
+            // Never sleep on the audio thread. The workers started at the same time as
+            // the first generator, so they're usually done (or nearly) by now.
+            while (m_pending.load(std::memory_order_acquire) != 0)
+                _mm_pause();
+        }
+        else
+        {
+            for (size_t generator = 0; generator < MAX_GENERATORS; ++generator)
+                renderGenerator(generator, frames);
+        }
+
+        mix(piece);
+    }
+}
+
+void GeneratorMixer::run(size_t generator, uint32_t epoch)
+{
+    char threadName[Tracing::MAX_THREAD_NAME];
+    std::snprintf(threadName, sizeof(threadName), "generator %zu worker", generator);
+    Tracing::setThreadName(threadName);
+
+    while (true)
+    {
+        // The next buffer is often moments away; check a while before paying for a sleep.
+        for (int spin = 0; spin < WORKER_SPIN_COUNT && m_epoch.load(std::memory_order_acquire) == epoch; ++spin)
+            _mm_pause();
+        if (m_epoch.load(std::memory_order_acquire) == epoch)
+        {
+            m_sleeping.fetch_add(1);
+            m_epoch.wait(epoch);
+            m_sleeping.fetch_sub(1, std::memory_order_relaxed);
+        }
+        epoch = m_epoch.load(std::memory_order_acquire);
+
+        if (!m_running.load(std::memory_order_acquire))
+            return;
+
+        // Rendering for the callback, under the same rules.
+        RealtimeSanitizer::ScopedRealtime realtime;
+        renderGenerator(generator, m_frames);
+        m_pending.fetch_sub(1, std::memory_order_release);
+    }
+}
+
+void GeneratorMixer::renderGenerator(size_t generator, size_t frames)
+{
+    GeneratorState& state = m_generators[generator];
+    const auto renderStart = std::chrono::steady_clock::now();
+
+    GeneratorAccess::getInstance(generator).renderSamples(
+        std::span(state.buffer).first(frames * 2), ModifyGeneratorRequestEvents{ generator });
+    ReclaimRetiredOscillators(generator);
+
+    // Seconds spent over seconds of audio, smoothed over a few buffers so the UI can read it.
+    const std::chrono::duration<float> elapsed = std::chrono::steady_clock::now() - renderStart;
+    const float load = elapsed.count() * float(SAMPLE_RATE) / float(frames);
+    state.load.store(state.load.load(std::memory_order_relaxed) * 0.9f + load * 0.1f, std::memory_order_relaxed);
+}
+
+void GeneratorMixer::mix(std::span<float> output)
+{
+    std::fill(output.begin(), output.end(), 0.0f);
+
+    const size_t frames = output.size() / 2;
+    for (GeneratorState& state : m_generators)
+    {
+        // Ramp to the new gain across the piece so changes don't click.
+        const float target = state.gain.load(std::memory_order_relaxed);
+        const float step = (target - state.mixedGain) / float(frames);
+        float gain = state.mixedGain;
+        for (size_t index = 0; index < output.size(); index += 2)
+        {
+            output[index]     += state.buffer[index] * gain;
+            output[index + 1] += state.buffer[index + 1] * gain;
+            gain += step;
+        }
+        state.mixedGain = target;
+    }
+
+    ConvolutionReverb::getInstance().process(output);
+
+    // Hard clipping by default - useful for saving ears during testing.
+    const SaturationSettings saturation = m_saturation.load(std::memory_order_relaxed);
+    if (saturation != m_saturator.getSettings())
+        (void)m_saturator.setSettings(saturation);
+    m_saturator.process(output);
+}
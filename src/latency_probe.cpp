@@ -0,0 +1,119 @@
+#include "latency_probe.h"
+
+#include "thread_communication.h"
+
+#include <algorithm>
+#include <fstream>
+
+LatencyProbe& LatencyProbe::getInstance()
+{
+    static LatencyProbe probe;
+    return probe;
+}
+
+const char* LatencyProbe::getStageName(Stage stage)
+{
+    switch (stage)
+    {
+    case Queue: return "queue";
+    case Apply: return "apply";
+    case Dac:   return "dac";
+    case Total: return "total";
+    default:    return "";
+    }
+}
+
+void LatencyProbe::requestApplied(size_t generator, Clock::time_point created, uint64_t sampleTime)
+{
+    GeneratorPending& pending = m_pending[generator];
+    if (pending.count == pending.requests.size())
+        return;
+
+    pending.requests[pending.count++] = { created, Clock::now(), sampleTime };
+}
+
+void LatencyProbe::beginBuffer(Clock::time_point callbackTime)
+{
+    m_callback_time = callbackTime;
+    for (size_t generator = 0; generator < MAX_GENERATORS; ++generator)
+    {
+        m_pending[generator].count = 0;
+        m_pending[generator].bufferStart = GeneratorAccess::getInstance(generator).getSampleTime();
+    }
+}
+
+void LatencyProbe::endBuffer(double dacDelaySeconds)
+{
+    using Milliseconds = std::chrono::duration<float, std::milli>;
+
+    const Clock::time_point handedOver = Clock::now();
+
+    // The buffer's first frame reaches the DAC this long after the callback was called.
+    // Some host APIs don't report it; then there's nothing to measure past the callback.
+    const auto bufferDacTime = m_callback_time + std::chrono::duration_cast<Clock::duration>(
+                                                     std::chrono::duration<double>(std::max(dacDelaySeconds, 0.0)));
+
+    uint64_t measured = m_measured.load(std::memory_order_relaxed);
+    for (GeneratorPending& pending : m_pending)
+    {
+        for (size_t index = 0; index < pending.count; ++index)
+        {
+            const Pending& request = pending.requests[index];
+            const double frameOffset = double(request.sampleTime - pending.bufferStart) / double(SAMPLE_RATE);
+            const auto dacTime = std::max(handedOver, bufferDacTime + std::chrono::duration_cast<Clock::duration>(
+                                                                          std::chrono::duration<double>(frameOffset)));
+
+            const size_t slot = size_t(measured % HISTORY);
+            m_history[Queue][slot].store(Milliseconds(request.applied - request.created).count(), std::memory_order_relaxed);
+            m_history[Apply][slot].store(Milliseconds(handedOver - request.applied).count(), std::memory_order_relaxed);
+            m_history[Dac][slot].store(Milliseconds(dacTime - handedOver).count(), std::memory_order_relaxed);
+            m_history[Total][slot].store(Milliseconds(dacTime - request.created).count(), std::memory_order_relaxed);
+            ++measured;
+        }
+        pending.count = 0;
+    }
+    m_measured.store(measured, std::memory_order_release);
+}
+
+std::vector<float> LatencyProbe::copyHistory(Stage stage) const
+{
+    const size_t count = size_t(std::min<uint64_t>(m_measured.load(std::memory_order_acquire), HISTORY));
+    std::vector<float> history(count);
+    for (size_t index = 0; index < count; ++index)
+        history[index] = m_history[stage][index].load(std::memory_order_relaxed);
+    return history;
+}
+
+LatencyProbe::Percentiles LatencyProbe::getPercentiles(Stage stage) const
+{
+    std::vector<float> history = copyHistory(stage);
+    Percentiles percentiles;
+    percentiles.count = history.size();
+    if (history.empty())
+        return percentiles;
+
+    std::sort(history.begin(), history.end());
+    const auto at = [&history](float fraction) { return history[size_t(fraction * float(history.size() - 1) + 0.5f)]; };
+    percentiles.p50 = at(0.50f);
+    percentiles.p90 = at(0.90f);
+    percentiles.p99 = at(0.99f);
+    percentiles.max = history.back();
+    return percentiles;
+}
+
+bool LatencyProbe::writeCsv(const std::string& path) const
+{
+    std::array<std::vector<float>, STAGE_COUNT> history;
+    for (size_t stage = 0; stage < STAGE_COUNT; ++stage)
+        history[stage] = copyHistory(Stage(stage));
+
+    std::ofstream file(path, std::ios::trunc);
+    if (!file)
+        return false;
+
+    file << "queue_ms,apply_ms,dac_ms,total_ms\n";
+    const size_t count = std::min({ history[Queue].size(), history[Apply].size(), history[Dac].size(), history[Total].size() });
+    for (size_t index = 0; index < count; ++index)
+        file << history[Queue][index] << ',' << history[Apply][index] << ',' << history[Dac][index] << ',' << history[Total][index] << '\n';
+    return bool(file);
+}
@@ -1,5 +1,6 @@
 #include "logging.h"
 
+#include "realtime_sanitizer.h"
 #include "thread_communication.h"
 #include "AudioFile.h"
 
@@ -45,6 +46,8 @@ void WriteSessionToFile()
 
 void CopyBufferAndDefer(const float* out, unsigned long framesPerBuffer)
 {
+    // Called from the callback, and ends in a file write; the allocations are caught anyway.
+    RealtimeSanitizer::checkBlockingCall("Logging::CopyBufferAndDefer");
     std::vector<float> floatsLeft;
     std::vector<float> floatsRight;
     floatsLeft.reserve(framesPerBuffer); // allocating on the realtime thread! bad!
@@ -0,0 +1,257 @@
+#include "midi.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+namespace
+{
+    // A channel event still timed in ticks, before the tempo map is applied.
+    struct TimedEvent
+    {
+        uint64_t  tick{ 0 };
+        MidiEvent event;
+    };
+
+    struct TempoChange
+    {
+        uint64_t tick{ 0 };
+        uint32_t microsecondsPerQuarter{ 500000 }; // 120 bpm, the default
+    };
+
+    // Reads big-endian values and variable-length quantities from a byte range,
+    // failing (rather than running off the end) on truncated data.
+    struct ByteReader
+    {
+        const uint8_t* position;
+        const uint8_t* end;
+
+        bool has(size_t count) const { return size_t(end - position) >= count; }
+
+        bool readByte(uint8_t& value)
+        {
+            if (!has(1))
+                return false;
+            value = *position++;
+            return true;
+        }
+
+        bool readBigEndian(size_t bytes, uint32_t& value)
+        {
+            if (!has(bytes))
+                return false;
+            value = 0;
+            for (size_t index = 0; index < bytes; ++index)
+                value = (value << 8) | *position++;
+            return true;
+        }
+
+        bool readVariableLength(uint32_t& value)
+        {
+            value = 0;
+            for (int index = 0; index < 4; ++index)
+            {
+                uint8_t byte;
+                if (!readByte(byte))
+                    return false;
+                value = (value << 7) | (byte & 0x7F);
+                if ((byte & 0x80) == 0)
+                    return true;
+            }
+            return false;
+        }
+
+        bool skip(size_t count)
+        {
+            if (!has(count))
+                return false;
+            position += count;
+            return true;
+        }
+    };
+
+    // endTick is where the track ends: its end of track event, or its last event if it has none.
+    bool readTrack(ByteReader track, std::vector<TimedEvent>& events, std::vector<TempoChange>& tempos, uint64_t& endTick)
+    {
+        uint64_t tick = 0;
+        uint8_t runningStatus = 0;
+        while (track.has(1))
+        {
+            uint32_t delta;
+            if (!track.readVariableLength(delta))
+                return false;
+            tick += delta;
+            endTick = tick;
+
+            uint8_t status;
+            if (!track.readByte(status))
+                return false;
+
+            // Meta and sysex events cancel running status.
+            if (status == 0xFF)
+            {
+                runningStatus = 0;
+
+                // Meta event: only tempo and the end of the track matter here.
+                uint8_t type;
+                uint32_t length;
+                if (!track.readByte(type) || !track.readVariableLength(length) || !track.has(length))
+                    return false;
+
+                if (type == 0x2F)
+                    return true;
+                if (type == 0x51 && length == 3)
+                {
+                    uint32_t microsecondsPerQuarter = 0;
+                    track.readBigEndian(3, microsecondsPerQuarter);
+                    tempos.push_back({ tick, microsecondsPerQuarter });
+                }
+                else
+                {
+                    track.skip(length);
+                }
+                continue;
+            }
+
+            if (status == 0xF0 || status == 0xF7)
+            {
+                runningStatus = 0;
+                uint32_t length;
+                if (!track.readVariableLength(length) || !track.skip(length))
+                    return false;
+                continue;
+            }
+
+            // Channel messages may omit a repeated status byte.
+            uint8_t data1;
+            if (status & 0x80)
+            {
+                runningStatus = status;
+                if (!track.readByte(data1))
+                    return false;
+            }
+            else
+            {
+                if (runningStatus == 0)
+                    return false;
+                data1 = status;
+                status = runningStatus;
+            }
+
+            const uint8_t kind = status & 0xF0;
+            const uint8_t channel = status & 0x0F;
+            const bool hasSecondByte = kind != 0xC0 && kind != 0xD0;
+            uint8_t data2 = 0;
+            if (hasSecondByte && !track.readByte(data2))
+                return false;
+
+            switch (kind)
+            {
+            case 0x80:
+                events.push_back({ tick, { 0, MidiEventType::NoteOff, channel, data1, data2 } });
+                break;
+            case 0x90:
+                // A note on with no velocity is a note off.
+                events.push_back({ tick, { 0, data2 == 0 ? MidiEventType::NoteOff : MidiEventType::NoteOn, channel, data1, data2 } });
+                break;
+            case 0xB0:
+                events.push_back({ tick, { 0, MidiEventType::ControlChange, channel, data1, data2 } });
+                break;
+            default:
+                break; // aftertouch, program change, pitch bend: not supported (yet)
+            }
+        }
+        return true;
+    }
+}
+
+std::optional<MidiSequence> LoadMidiFile(const std::string& path)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file)
+        return std::nullopt;
+
+    const std::vector<uint8_t> bytes{ std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>() };
+    ByteReader reader{ bytes.data(), bytes.data() + bytes.size() };
+
+    // Header chunk
+    uint32_t headerLength, format, trackCount, division;
+    if (!reader.has(4) || std::memcmp(reader.position, "MThd", 4) != 0)
+        return std::nullopt;
+    reader.skip(4);
+    if (!reader.readBigEndian(4, headerLength) || headerLength < 6 ||
+        !reader.readBigEndian(2, format) || !reader.readBigEndian(2, trackCount) || !reader.readBigEndian(2, division) ||
+        !reader.skip(headerLength - 6))
+        return std::nullopt;
+    if (format > 1 || division == 0)
+        return std::nullopt; // format 2 (independent sequences) isn't supported
+
+    std::vector<TimedEvent> events;
+    std::vector<TempoChange> tempos;
+    uint64_t endTick = 0;
+    uint32_t tracksRead = 0;
+    while (tracksRead < trackCount)
+    {
+        uint32_t trackLength;
+        if (!reader.has(8))
+            return std::nullopt;
+
+        const bool isTrack = std::memcmp(reader.position, "MTrk", 4) == 0;
+        reader.skip(4);
+        if (!reader.readBigEndian(4, trackLength) || !reader.has(trackLength))
+            return std::nullopt;
+
+        // Unknown chunks are allowed, and skipped.
+        uint64_t trackEndTick = 0;
+        if (isTrack && !readTrack({ reader.position, reader.position + trackLength }, events, tempos, trackEndTick))
+            return std::nullopt;
+        endTick = std::max(endTick, trackEndTick);
+        reader.skip(trackLength);
+        if (isTrack)
+            ++tracksRead;
+    }
+
+    // Order by time; at the same tick, note offs go first so a repeated note retriggers cleanly.
+    std::stable_sort(events.begin(), events.end(), [](TimedEvent const& a, TimedEvent const& b) {
+        if (a.tick != b.tick)
+            return a.tick < b.tick;
+        return a.event.type == MidiEventType::NoteOff && b.event.type != MidiEventType::NoteOff;
+    });
+    std::stable_sort(tempos.begin(), tempos.end(), [](TempoChange const& a, TempoChange const& b) { return a.tick < b.tick; });
+
+    // Walk the tempo map alongside the events to turn ticks into seconds. SMPTE
+    // divisions are a fixed number of ticks per second, and ignore tempo.
+    const bool isSmpte = (division & 0x8000) != 0;
+    const double smpteTicksPerSecond = isSmpte ? double(-int8_t(division >> 8)) * double(division & 0xFF) : 0.0;
+
+    MidiSequence sequence;
+    sequence.events.reserve(events.size());
+    size_t nextTempo = 0;
+    uint64_t segmentTick = 0;
+    double segmentSeconds = 0.0;
+    double secondsPerTick = isSmpte ? 1.0 / smpteTicksPerSecond : 0.5 / double(division);
+
+    // Ticks have to come in order, as the tempo map is only walked forwards.
+    const auto tickToSample = [&](uint64_t tick) {
+        while (!isSmpte && nextTempo < tempos.size() && tempos[nextTempo].tick <= tick)
+        {
+            segmentSeconds += double(tempos[nextTempo].tick - segmentTick) * secondsPerTick;
+            segmentTick = tempos[nextTempo].tick;
+            secondsPerTick = tempos[nextTempo].microsecondsPerQuarter * 1e-6 / double(division);
+            ++nextTempo;
+        }
+        const double seconds = segmentSeconds + double(tick - segmentTick) * secondsPerTick;
+        return uint64_t(std::llround(seconds * SAMPLE_RATE));
+    };
+
+    for (TimedEvent const& timed : events)
+    {
+        MidiEvent event = timed.event;
+        event.sampleTime = tickToSample(timed.tick);
+        sequence.events.push_back(event);
+    }
+
+    sequence.lengthSamples = tickToSample(std::max(endTick, events.empty() ? 0 : events.back().tick));
+    return sequence;
+}
@@ -0,0 +1,58 @@
+#include "offline_renderer.h"
+
+#include "generator.h"
+#include "generator_mixer.h"
+#include "realtime_sanitizer.h"
+#include "AudioFile.h"
+
+#include <memory>
+#include <vector>
+
+namespace OfflineRenderer
+{
+
+bool RenderMidiToFile(const MidiSequence& sequence, const MidiSettings& settings, const std::string& path)
+{
+    // The generator is too big for the stack.
+    auto generator = std::make_unique<Generator<>>();
+    generator->getMidi().play(&sequence, settings, generator->getOscillators());
+
+    AudioFile<float>::AudioBuffer buffer;
+    buffer.resize(2);
+    buffer[0].reserve(size_t(sequence.lengthSamples) + SAMPLE_RATE);
+    buffer[1].reserve(size_t(sequence.lengthSamples) + SAMPLE_RATE);
+
+    // The same saturation as the live output. The mixer's own stage belongs to the
+    // audio callback, which may be running, so this is a copy of its settings.
+    Saturator saturator;
+    (void)saturator.setSettings(GeneratorMixer::getInstance().getSaturation());
+
+    // Keep going until the sequence is over and every note has finished its release.
+    std::vector<float> block(RENDER_BUFFER_FRAMES * 2);
+    auto& oscillators = generator->getOscillators();
+    const auto anyInitialized = [&oscillators]() {
+        return std::any_of(oscillators.cbegin(), oscillators.cend(), [](auto const& osc) { return osc.isInitialized(); });
+    };
+    while (generator->getMidi().isPlaying() || anyInitialized())
+    {
+        {
+            // Nothing has to keep up here, but the generator should behave as it would live.
+            RealtimeSanitizer::ScopedRealtime realtime;
+            generator->renderSamples(block);
+            saturator.process(block);
+        }
+        for (size_t index = 0; index < block.size(); index += 2)
+        {
+            buffer[0].push_back(block[index]);
+            buffer[1].push_back(block[index + 1]);
+        }
+    }
+
+    AudioFile<float> audioFile;
+    audioFile.setNumChannels(2);
+    audioFile.setSampleRate(SAMPLE_RATE);
+    audioFile.setAudioBuffer(buffer);
+    return audioFile.save(path);
+}
+
+}
@@ -1,4 +1,25 @@
 #include "oscillator_ui.h"
+#include "convolution.h"
+
+#include "generator_mixer.h"
+#include "offline_renderer.h"
+#include "sample_streamer.h"
+#include "tracing.h"
+#include "util.h"
+
+template<size_t... GENERATORS>
+static std::array<UIOscillatorView, MAX_GENERATORS> MakeUIOscillatorViews(std::index_sequence<GENERATORS...>)
+{
+    return { UIOscillatorView(GENERATORS)... };
+}
+
+UIOscillatorView& GetUIOscillatorView(size_t generator)
+{
+    assert(generator < MAX_GENERATORS);
+    static std::array<UIOscillatorView, MAX_GENERATORS> uiOscillatorViews =
+        MakeUIOscillatorViews(std::make_index_sequence<MAX_GENERATORS>{});
+    return uiOscillatorViews[generator];
+}
 
 RequestId UIOscillatorView::GetNextRequestId()
 {
@@ -8,11 +29,12 @@ RequestId UIOscillatorView::GetNextRequestId()
 
 void UIOscillatorView::HandleRealTimeResponse()
 {
+    Tracing::Span span("HandleRealTimeResponse");
     Events::ModifyGenerator::Response response;
-    if (ThreadCommunication::getModifyGeneratorResponseQueue().pop(response))
+    if (ThreadCommunication::getModifyGeneratorResponseQueue(m_generator).pop(response))
     {
         // Verify that the response responds to the expected request.
-        auto& requestIds = GetRequestIds();
+        auto& requestIds = GetRequestIds(m_generator);
         const RequestId expectedResponseRequestId = requestIds.front();
         requestIds.pop();
         assert(response.requestId == expectedResponseRequestId);
@@ -86,18 +108,135 @@ void UIOscillatorView::HandleRealTimeResponse()
             assert(response.type.has_value());
             assert(m_oscillators.contains(*response.oscillatorId));
             m_oscillators[*response.oscillatorId].type = *response.type;
+            if (!isNoise(*response.type))
+                m_oscillators[*response.oscillatorId].wavetablePosition = float(*response.type);
             break;
         case Events::ModifyGenerator::Result::SetOscillatorTypeFailed:
             assert(false); // this is bad; we tried to set the type of an oscillator that didn't exist. someone's confused.
             break;
+        case Events::ModifyGenerator::Result::SetOscillatorWavetablePositionSucceeded:
+            assert(response.oscillatorId.has_value());
+            assert(response.wavetablePosition.has_value());
+            assert(m_oscillators.contains(*response.oscillatorId));
+            m_oscillators[*response.oscillatorId].wavetablePosition = *response.wavetablePosition;
+            break;
+        case Events::ModifyGenerator::Result::SetOscillatorWavetablePositionFailed:
+            assert(false); // this is bad; we tried to morph an oscillator that didn't exist. someone's confused.
+            break;
+        case Events::ModifyGenerator::Result::SetOscillatorEnvelopeSucceeded:
+            assert(response.oscillatorId.has_value());
+            assert(response.envelope.has_value());
+            assert(m_oscillators.contains(*response.oscillatorId));
+            m_oscillators[*response.oscillatorId].envelope = *response.envelope;
+            break;
+        case Events::ModifyGenerator::Result::SetOscillatorEnvelopeFailed:
+            assert(false); // this is bad; we tried to set the envelope of an oscillator that didn't exist. someone's confused.
+            break;
+        case Events::ModifyGenerator::Result::SetOscillatorUnisonSucceeded:
+            assert(response.oscillatorId.has_value());
+            assert(response.unison.has_value());
+            assert(m_oscillators.contains(*response.oscillatorId));
+            m_oscillators[*response.oscillatorId].unison = *response.unison;
+            break;
+        case Events::ModifyGenerator::Result::SetOscillatorUnisonFailed:
+            assert(false); // this is bad; we tried to set the unison of an oscillator that didn't exist. someone's confused.
+            break;
+        case Events::ModifyGenerator::Result::SetOscillatorSyncSucceeded:
+            assert(response.oscillatorId.has_value());
+            assert(response.syncMaster.has_value());
+            assert(m_oscillators.contains(*response.oscillatorId));
+            m_oscillators[*response.oscillatorId].syncMaster = *response.syncMaster;
+            break;
+        case Events::ModifyGenerator::Result::SetOscillatorSyncFailed:
+            break; // e.g. the oscillator just became an FM operator, or sync would chain; the UI keeps the old master.
+        case Events::ModifyGenerator::Result::SetLfoSucceeded:
+            assert(response.lfoIndex.has_value());
+            assert(response.lfo.has_value());
+            m_lfos.at(*response.lfoIndex) = *response.lfo;
+            break;
+        case Events::ModifyGenerator::Result::SetLfoFailed:
+            assert(false); // this is bad; we tried to set an lfo that doesn't exist.
+            break;
+        case Events::ModifyGenerator::Result::SetModulationRouteSucceeded:
+            assert(response.routeIndex.has_value());
+            assert(response.route.has_value());
+            m_routes.at(*response.routeIndex) = *response.route;
+            break;
+        case Events::ModifyGenerator::Result::SetModulationRouteFailed:
+            break; // the route pointed somewhere invalid; the UI keeps the old route.
+        case Events::ModifyGenerator::Result::SetControlBlockSizeSucceeded:
+            assert(response.controlBlockSize.has_value());
+            m_controlBlockSize = *response.controlBlockSize;
+            break;
+        case Events::ModifyGenerator::Result::SetControlBlockSizeFailed:
+            assert(false); // the UI should only offer valid block sizes.
+            break;
+        case Events::ModifyGenerator::Result::SetFmGroupSucceeded:
+            assert(response.fmGroupIndex.has_value());
+            assert(response.fmGroup.has_value());
+            m_fmGroups.at(*response.fmGroupIndex) = *response.fmGroup;
+            break;
+        case Events::ModifyGenerator::Result::SetFmGroupFailed:
+            break; // the group pointed somewhere invalid or shared an operator; the UI keeps the old group.
+        case Events::ModifyGenerator::Result::SetGrainCloudSucceeded:
+            assert(response.grainCloudIndex.has_value());
+            assert(response.grainCloud.has_value());
+            m_grainClouds.at(*response.grainCloudIndex) = *response.grainCloud;
+            break;
+        case Events::ModifyGenerator::Result::SetGrainCloudFailed:
+            break; // e.g. a sample cloud with no sample loaded; the UI keeps the old cloud.
+        case Events::ModifyGenerator::Result::PlaySampleSucceeded:
+        case Events::ModifyGenerator::Result::StopSampleSucceeded:
+            break; // the streams report their own state; see ShowSamples.
+        case Events::ModifyGenerator::Result::PlaySampleFailed:
+            assert(false); // we only play streams we just prepared.
+            break;
+        case Events::ModifyGenerator::Result::StopSampleFailed:
+            break; // the sample reached its end before the stop arrived.
+        case Events::ModifyGenerator::Result::PlayMidiSucceeded:
+        case Events::ModifyGenerator::Result::StopMidiSucceeded:
+            break;
+        case Events::ModifyGenerator::Result::PlayMidiFailed:
+            assert(false); // we only play sequences we loaded.
+            break;
+        case Events::ModifyGenerator::Result::StopMidiFailed:
+            break; // the sequence ended before the stop arrived.
+        case Events::ModifyGenerator::Result::PlayResynthesisSucceeded:
+        case Events::ModifyGenerator::Result::SetResynthesisSucceeded:
+        case Events::ModifyGenerator::Result::StopResynthesisSucceeded:
+            break; // the UI owns the settings; the snapshot shows what's sounding.
+        case Events::ModifyGenerator::Result::PlayResynthesisFailed:
+            break; // the file had no frames in it.
+        case Events::ModifyGenerator::Result::SetResynthesisFailed:
+            assert(false); // the UI only offers positive stretches and pitches.
+            break;
+        case Events::ModifyGenerator::Result::StopResynthesisFailed:
+            break; // the tracks ended before the stop arrived.
+        case Events::ModifyGenerator::Result::SetSaturationSucceeded:
+        case Events::ModifyGenerator::Result::SetSaturationFailed:
+            break; // live output goes through the mixer's saturation stage instead; see ShowGeneratorMixer.
+        case Events::ModifyGenerator::Result::InstallPresetSucceeded:
+            assert(m_pendingPreset.has_value());
+            m_oscillators.clear();
+            for (OscillatorId id = 0; id < PRESET_OSCILLATORS; ++id)
+            {
+                if (m_pendingPreset->oscillators[id].state != OscillatorState::Uninitialized)
+                    m_oscillators[id] = m_pendingPreset->oscillators[id];
+            }
+            m_pendingPreset.reset();
+            break;
+        case Events::ModifyGenerator::Result::InstallPresetFailed:
+            assert(false); // we always send a bank.
+            m_pendingPreset.reset();
+            break;
         }
     }
 }
 
 void UIOscillatorView::Show()
 {
-    auto& requestIds = GetRequestIds();
-    auto& uiOscillatorView = GetUIOscillatorView();
+    auto& requestIds = GetRequestIds(m_generator);
+    auto& uiOscillatorView = GetUIOscillatorView(m_generator);
 
     ImGui::Text("Adjust settings of the generator:");
 
@@ -106,24 +245,72 @@ void UIOscillatorView::Show()
         const RequestId requestId = uiOscillatorView.GetNextRequestId();
         requestIds.push(requestId);
         EventBuilder::PushAddOscillatorEvent(
-            requestId,
+            m_generator, requestId,
             OscillatorSettings(OscillatorType::Sine, 200.f, .2f));
     }
 
+    ImGui::InputText("Preset##presetPath", m_presetPath, sizeof(m_presetPath));
+    ImGui::SameLine();
+    if (ImGui::Button("Save##presetSave"))
+        (void)SavePreset(MakePresetSnapshot(m_oscillators), m_presetPath);
+
+    // The whole bank is built here and swapped in by the realtime thread in one go.
+    ImGui::SameLine();
+    if (ImGui::Button("Load##presetLoad") && !m_pendingPreset.has_value())
+    {
+        if (auto preset = MappedPreset::open(m_presetPath))
+        {
+            m_pendingPreset = preset->get();
+            const RequestId requestId = uiOscillatorView.GetNextRequestId();
+            requestIds.push(requestId);
+            EventBuilder::PushInstallPresetEvent(m_generator, requestId, BuildOscillators<uint8_t(Generator<>::getMaxOscillators())>(*m_pendingPreset, uint32_t(m_generator)));
+        }
+    }
+
     for (const auto& [oscillatorId, settings] : m_oscillators)
         ShowOscillator(oscillatorId, settings);
+
+    ShowVoices();
+}
+
+void UIOscillatorView::ShowVoices()
+{
+    // Keep the last snapshot if the realtime thread hasn't published a new one.
+    auto& snapshots = GeneratorAccess::getInstance(m_generator).getSnapshots();
+    (void)snapshots.update();
+    const auto& snapshot = snapshots.read();
+
+    if (!ImGui::CollapsingHeader("Voices##liveVoices"))
+        return;
+
+    const char* stateNames[] = { "uninitialized", "active", "deactivated", "fading out", "fading out (remove)", "fading in" };
+    const char* stageNames[] = { "idle", "attack", "decay", "sustain", "release" };
+    ImGui::Text("At %.2fs", double(snapshot.sampleTime) / SAMPLE_RATE);
+    for (OscillatorId id = 0; id < snapshot.voices.size(); ++id)
+    {
+        const VoiceSnapshot& voice = snapshot.voices[id];
+        if (voice.state == OscillatorState::Uninitialized)
+            continue;
+
+        // Voices the UI didn't add belong to the MIDI player.
+        ImGui::Text("%u%s: %s, %.1f Hz, volume %.2f, %s",
+                    id, m_oscillators.contains(id) ? "" : " (MIDI)", stateNames[size_t(voice.state)],
+                    double(voice.frequency), double(voice.volume), stageNames[size_t(voice.envelopeStage)]);
+        ImGui::SameLine();
+        ImGui::ProgressBar(voice.envelopeLevel, ImVec2(100.0f, 0.0f), "");
+    }
 }
 
 void UIOscillatorView::ShowOscillator(const OscillatorId& oscillatorId, const OscillatorSettings& settings)
 {
-    auto& requestIds = GetRequestIds();
+    auto& requestIds = GetRequestIds(m_generator);
     char removeLabel[100];
     sprintf_s(removeLabel, "Remove##%u", oscillatorId);
     if (ImGui::Button(removeLabel))
     {
         const RequestId requestId = GetNextRequestId();
         requestIds.push(requestId);
-        EventBuilder::PushRemoveOscillatorEvent(requestId, oscillatorId);
+        EventBuilder::PushRemoveOscillatorEvent(m_generator, requestId, oscillatorId);
     }
 
     ImGui::SameLine();
@@ -136,13 +323,13 @@ void UIOscillatorView::ShowOscillator(const OscillatorId& oscillatorId, const Os
         requestIds.push(requestId);
 
         if (activeBool)
-            EventBuilder::PushActivateOscillatorEvent(requestId, oscillatorId, settings.volume);
+            EventBuilder::PushActivateOscillatorEvent(m_generator, requestId, oscillatorId, settings.volume);
         else
-            EventBuilder::PushDeactivateOscillatorEvent(requestId, oscillatorId);
+            EventBuilder::PushDeactivateOscillatorEvent(m_generator, requestId, oscillatorId);
     }
 
     ImGui::SameLine();
-    const char* types[] = { "Sine", "Square", "Triangle", "Saw" };
+    const char* types[] = { "Sine", "Square", "Triangle", "Saw", "White noise", "Pink noise", "Brown noise" };
     const int currentIndex = int(settings.type);
     const char* comboLabel = types[currentIndex];
     char typeLabel[100];
@@ -163,12 +350,23 @@ void UIOscillatorView::ShowOscillator(const OscillatorId& oscillatorId, const Os
 
                 const RequestId requestId = GetNextRequestId();
                 requestIds.push(requestId);
-                EventBuilder::PushSetOscillatorTypeEvent(requestId, oscillatorId, OscillatorType(n));
+                EventBuilder::PushSetOscillatorTypeEvent(m_generator, requestId, oscillatorId, OscillatorType(n));
             }
         }
         ImGui::EndCombo();
     }
 
+    // Scans across the wave types, in the order of the combo above.
+    float position = settings.wavetablePosition;
+    char positionLabel[100];
+    sprintf_s(positionLabel, "Morph##%u", oscillatorId);
+    if (ImGui::SliderFloat(positionLabel, &position, 0.0f, float(WAVETABLE_FRAMES - 1)))
+    {
+        const RequestId requestId = GetNextRequestId();
+        requestIds.push(requestId);
+        EventBuilder::PushSetOscillatorWavetablePositionEvent(m_generator, requestId, oscillatorId, position);
+    }
+
     volume_t volume = settings.volume;
     char volumeLabel[100];
     sprintf_s(volumeLabel, "Volume##%u", oscillatorId);
@@ -176,7 +374,7 @@ void UIOscillatorView::ShowOscillator(const OscillatorId& oscillatorId, const Os
     {
         const RequestId requestId = GetNextRequestId();
         requestIds.push(requestId);
-        EventBuilder::PushSetOscillatorVolumeEvent(requestId, oscillatorId, volume);
+        EventBuilder::PushSetOscillatorVolumeEvent(m_generator, requestId, oscillatorId, volume);
     }
 
     pan_t pan = settings.pan;
@@ -186,7 +384,7 @@ void UIOscillatorView::ShowOscillator(const OscillatorId& oscillatorId, const Os
     {
         const RequestId requestId = GetNextRequestId();
         requestIds.push(requestId);
-        EventBuilder::PushSetOscillatorPanEvent(requestId, oscillatorId, pan);
+        EventBuilder::PushSetOscillatorPanEvent(m_generator, requestId, oscillatorId, pan);
     }
 
     frequency_t frequency = settings.frequency;
@@ -196,9 +394,701 @@ void UIOscillatorView::ShowOscillator(const OscillatorId& oscillatorId, const Os
     {
         const RequestId requestId = GetNextRequestId();
         requestIds.push(requestId);
-        EventBuilder::PushSetOscillatorFrequencyEvent(requestId, oscillatorId, frequency);
+        EventBuilder::PushSetOscillatorFrequencyEvent(m_generator, requestId, oscillatorId, frequency);
+    }
+
+    ShowEnvelope(oscillatorId, settings.envelope);
+    ShowUnison(oscillatorId, settings.unison);
+    ShowSync(oscillatorId, settings.syncMaster);
+
+    ImGui::NewLine();
+}
+
+
+void UIOscillatorView::ShowEnvelope(const OscillatorId& oscillatorId, const EnvelopeSettings& envelope)
+{
+    auto& requestIds = GetRequestIds(m_generator);
+    EnvelopeSettings newEnvelope = envelope;
+    bool changed = false;
+
+    char attackLabel[100];
+    sprintf_s(attackLabel, "Attack##%u", oscillatorId);
+    changed |= ImGui::SliderFloat(attackLabel, &newEnvelope.attack, 0.0f, 5.0f, "%.3f s", ImGuiSliderFlags_Logarithmic);
+
+    char decayLabel[100];
+    sprintf_s(decayLabel, "Decay##%u", oscillatorId);
+    changed |= ImGui::SliderFloat(decayLabel, &newEnvelope.decay, 0.0f, 5.0f, "%.3f s", ImGuiSliderFlags_Logarithmic);
+
+    char sustainLabel[100];
+    sprintf_s(sustainLabel, "Sustain##%u", oscillatorId);
+    changed |= ImGui::SliderFloat(sustainLabel, &newEnvelope.sustain, 0.0f, 1.0f);
+
+    char releaseLabel[100];
+    sprintf_s(releaseLabel, "Release##%u", oscillatorId);
+    changed |= ImGui::SliderFloat(releaseLabel, &newEnvelope.release, 0.0f, 5.0f, "%.3f s", ImGuiSliderFlags_Logarithmic);
+
+    bool exponential = newEnvelope.curve == EnvelopeCurve::Exponential;
+    char curveLabel[100];
+    sprintf_s(curveLabel, "Exponential##%u", oscillatorId);
+    if (ImGui::Checkbox(curveLabel, &exponential))
+    {
+        newEnvelope.curve = exponential ? EnvelopeCurve::Exponential : EnvelopeCurve::Linear;
+        changed = true;
+    }
+
+    if (changed)
+    {
+        const RequestId requestId = GetNextRequestId();
+        requestIds.push(requestId);
+        EventBuilder::PushSetOscillatorEnvelopeEvent(m_generator, requestId, oscillatorId, newEnvelope);
+    }
+}
+
+void UIOscillatorView::ShowUnison(const OscillatorId& oscillatorId, const UnisonSettings& unison)
+{
+    auto& requestIds = GetRequestIds(m_generator);
+    UnisonSettings newUnison = unison;
+    bool changed = false;
+
+    int voices = unison.voices;
+    char voicesLabel[100];
+    sprintf_s(voicesLabel, "Unison##%u", oscillatorId);
+    if (ImGui::SliderInt(voicesLabel, &voices, 1, int(MAX_UNISON_VOICES)))
+    {
+        newUnison.voices = uint8_t(voices);
+        changed = true;
+    }
+
+    char detuneLabel[100];
+    sprintf_s(detuneLabel, "Detune##%u", oscillatorId);
+    changed |= ImGui::SliderFloat(detuneLabel, &newUnison.detune, 0.0f, 100.0f, "%.1f cents");
+
+    char spreadLabel[100];
+    sprintf_s(spreadLabel, "Spread##%u", oscillatorId);
+    changed |= ImGui::SliderFloat(spreadLabel, &newUnison.spread, 0.0f, 1.0f);
+
+    if (changed)
+    {
+        const RequestId requestId = GetNextRequestId();
+        requestIds.push(requestId);
+        EventBuilder::PushSetOscillatorUnisonEvent(m_generator, requestId, oscillatorId, newUnison);
+    }
+}
+
+void UIOscillatorView::ShowSync(const OscillatorId& oscillatorId, OscillatorId syncMaster)
+{
+    auto& requestIds = GetRequestIds(m_generator);
+
+    char currentLabel[32] = "Off";
+    if (syncMaster != NO_SYNC_MASTER)
+        sprintf_s(currentLabel, "Oscillator %u", syncMaster);
+
+    char syncLabel[100];
+    sprintf_s(syncLabel, "Sync to##%u", oscillatorId);
+    ImGui::SetNextItemWidth(140.0f);
+    if (!ImGui::BeginCombo(syncLabel, currentLabel))
+        return;
+
+    // Off first, then every oscillator that could be the master. Sync doesn't chain,
+    // so an oscillator others follow can't follow one itself, and a synced one can't
+    // lead; nor does noise lead, nor do FM operators sync.
+    std::optional<OscillatorId> selected;
+    if (ImGui::Selectable("Off", syncMaster == NO_SYNC_MASTER) && syncMaster != NO_SYNC_MASTER)
+        selected = NO_SYNC_MASTER;
+
+    const bool isFollowed = std::any_of(m_oscillators.begin(), m_oscillators.end(),
+                                        [oscillatorId](auto const& entry) { return entry.second.syncMaster == oscillatorId; });
+    const bool isOperator = std::any_of(m_fmGroups.begin(), m_fmGroups.end(), [oscillatorId](FmGroupSettings const& group) {
+        return group.enabled && std::find(group.operators.begin(), group.operators.end(), oscillatorId) != group.operators.end();
+    });
+    for (OscillatorId id = 0; id < Generator<>::getMaxOscillators() && !isFollowed && !isOperator; ++id)
+    {
+        if (id == oscillatorId || !m_oscillators.contains(id) || m_oscillators.at(id).syncMaster != NO_SYNC_MASTER ||
+            isNoise(m_oscillators.at(id).type))
+            continue;
+
+        char masterLabel[32];
+        sprintf_s(masterLabel, "Oscillator %u", id);
+        if (ImGui::Selectable(masterLabel, id == syncMaster) && id != syncMaster)
+            selected = id;
+    }
+    ImGui::EndCombo();
+
+    if (selected.has_value())
+    {
+        const RequestId requestId = GetNextRequestId();
+        requestIds.push(requestId);
+        EventBuilder::PushSetOscillatorSyncEvent(m_generator, requestId, oscillatorId, *selected);
     }
+}
+
+void UIOscillatorView::ShowModulation()
+{
+    auto& requestIds = GetRequestIds(m_generator);
+
+    ImGui::Text("Control rate:");
+    constexpr size_t blockSizes[] = { 8, 16, 32, 64, 128 };
+    for (size_t blockSize : blockSizes)
+    {
+        ImGui::SameLine();
+        char blockSizeLabel[100];
+        sprintf_s(blockSizeLabel, "%zu##controlBlockSize", blockSize);
+        if (ImGui::RadioButton(blockSizeLabel, m_controlBlockSize == blockSize) && m_controlBlockSize != blockSize)
+        {
+            const RequestId requestId = GetNextRequestId();
+            requestIds.push(requestId);
+            EventBuilder::PushSetControlBlockSizeEvent(m_generator, requestId, blockSize);
+        }
+    }
+
+    for (size_t lfoIndex = 0; lfoIndex < m_lfos.size(); ++lfoIndex)
+        ShowLfo(lfoIndex, m_lfos[lfoIndex]);
 
     ImGui::NewLine();
+    if (ImGui::Button("Add Route"))
+    {
+        auto const freeRoute = std::find_if(m_routes.cbegin(), m_routes.cend(),
+            [](auto const& route) { return !route.enabled; });
+        if (freeRoute != m_routes.cend())
+        {
+            ModulationRoute route;
+            route.enabled = true;
+            route.oscillator = m_oscillators.empty() ? 0 : m_oscillators.cbegin()->first;
+
+            const RequestId requestId = GetNextRequestId();
+            requestIds.push(requestId);
+            EventBuilder::PushSetModulationRouteEvent(m_generator, requestId, size_t(freeRoute - m_routes.cbegin()), route);
+        }
+    }
+
+    for (size_t routeIndex = 0; routeIndex < m_routes.size(); ++routeIndex)
+    {
+        if (m_routes[routeIndex].enabled)
+            ShowRoute(routeIndex, m_routes[routeIndex]);
+    }
+}
+
+void UIOscillatorView::ShowLfo(size_t lfoIndex, const LfoSettings& lfo)
+{
+    auto& requestIds = GetRequestIds(m_generator);
+    LfoSettings newLfo = lfo;
+    bool changed = false;
+
+    const char* shapes[] = { "Sine", "Triangle", "Square", "Saw" };
+    int shapeIndex = int(lfo.shape);
+    char shapeLabel[100];
+    sprintf_s(shapeLabel, "LFO %zu##lfoShape%zu", lfoIndex, lfoIndex);
+    ImGui::SetNextItemWidth(100.0f);
+    if (ImGui::Combo(shapeLabel, &shapeIndex, shapes, IM_ARRAYSIZE(shapes)))
+    {
+        newLfo.shape = LfoShape(shapeIndex);
+        changed = true;
+    }
+
+    ImGui::SameLine();
+    char rateLabel[100];
+    sprintf_s(rateLabel, "Rate##lfoRate%zu", lfoIndex);
+    changed |= ImGui::SliderFloat(rateLabel, &newLfo.rate, 0.01f, 50.0f, "%.2f Hz", ImGuiSliderFlags_Logarithmic);
+
+    if (changed)
+    {
+        const RequestId requestId = GetNextRequestId();
+        requestIds.push(requestId);
+        EventBuilder::PushSetLfoEvent(m_generator, requestId, lfoIndex, newLfo);
+    }
+}
+
+void UIOscillatorView::ShowRoute(size_t routeIndex, const ModulationRoute& route)
+{
+    auto& requestIds = GetRequestIds(m_generator);
+    ModulationRoute newRoute = route;
+    bool changed = false;
+
+    char removeLabel[100];
+    sprintf_s(removeLabel, "Remove##route%zu", routeIndex);
+    if (ImGui::Button(removeLabel))
+    {
+        newRoute.enabled = false;
+        changed = true;
+    }
+
+    ImGui::SameLine();
+    int lfo = route.lfo;
+    char lfoLabel[100];
+    sprintf_s(lfoLabel, "LFO##routeLfo%zu", routeIndex);
+    ImGui::SetNextItemWidth(60.0f);
+    if (ImGui::SliderInt(lfoLabel, &lfo, 0, int(MAX_LFOS) - 1))
+    {
+        newRoute.lfo = uint8_t(lfo);
+        changed = true;
+    }
+
+    ImGui::SameLine();
+    int oscillator = route.oscillator;
+    char oscillatorLabel[100];
+    sprintf_s(oscillatorLabel, "Oscillator##routeOscillator%zu", routeIndex);
+    ImGui::SetNextItemWidth(60.0f);
+    if (ImGui::SliderInt(oscillatorLabel, &oscillator, 0, int(Generator<>::getMaxOscillators()) - 1))
+    {
+        newRoute.oscillator = OscillatorId(oscillator);
+        changed = true;
+    }
+
+    ImGui::SameLine();
+    const char* destinations[] = { "Volume", "Pan", "Frequency", "Wavetable" };
+    int destinationIndex = int(route.destination);
+    char destinationLabel[100];
+    sprintf_s(destinationLabel, "##routeDestination%zu", routeIndex);
+    ImGui::SetNextItemWidth(100.0f);
+    if (ImGui::Combo(destinationLabel, &destinationIndex, destinations, IM_ARRAYSIZE(destinations)))
+    {
+        newRoute.destination = ModulationDestination(destinationIndex);
+        changed = true;
+    }
+
+    ImGui::SameLine();
+    char depthLabel[100];
+    sprintf_s(depthLabel, "Depth##routeDepth%zu", routeIndex);
+    changed |= ImGui::SliderFloat(depthLabel, &newRoute.depth, -1.0f, 1.0f);
+
+    if (changed)
+    {
+        const RequestId requestId = GetNextRequestId();
+        requestIds.push(requestId);
+        EventBuilder::PushSetModulationRouteEvent(m_generator, requestId, routeIndex, newRoute);
+    }
+}
+
+void UIOscillatorView::ShowFm()
+{
+    ImGui::Text("Operators are oscillators; their volume sets their output level.");
+    ImGui::Text("An oscillator can only be one operator, in one enabled group.");
+    for (size_t groupIndex = 0; groupIndex < m_fmGroups.size(); ++groupIndex)
+        ShowFmGroup(groupIndex, m_fmGroups[groupIndex]);
+}
+
+void UIOscillatorView::ShowFmGroup(size_t groupIndex, const FmGroupSettings& group)
+{
+    auto& requestIds = GetRequestIds(m_generator);
+    FmGroupSettings newGroup = group;
+    bool changed = false;
+
+    char enabledLabel[100];
+    sprintf_s(enabledLabel, "FM Group %zu##fmEnabled%zu", groupIndex, groupIndex);
+    changed |= ImGui::Checkbox(enabledLabel, &newGroup.enabled);
+
+    ImGui::SameLine();
+    const char* algorithmNames[FM_ALGORITHMS.size()];
+    for (size_t algorithm = 0; algorithm < FM_ALGORITHMS.size(); ++algorithm)
+        algorithmNames[algorithm] = FM_ALGORITHMS[algorithm].name;
+
+    int algorithmIndex = group.algorithm;
+    char algorithmLabel[100];
+    sprintf_s(algorithmLabel, "Algorithm##fmAlgorithm%zu", groupIndex);
+    ImGui::SetNextItemWidth(120.0f);
+    if (ImGui::Combo(algorithmLabel, &algorithmIndex, algorithmNames, IM_ARRAYSIZE(algorithmNames)))
+    {
+        newGroup.algorithm = uint8_t(algorithmIndex);
+        changed = true;
+    }
+
+    // -1 leaves the operator slot empty.
+    const int maxOscillatorId = int(Generator<>::getMaxOscillators()) - 1;
+    for (size_t op = 0; op < MAX_FM_OPERATORS; ++op)
+    {
+        if (op > 0)
+            ImGui::SameLine();
+
+        int oscillator = group.operators[op].has_value() ? int(*group.operators[op]) : -1;
+        char operatorLabel[100];
+        sprintf_s(operatorLabel, "Op %zu##fmOperator%zu_%zu", op + 1, groupIndex, op);
+        ImGui::SetNextItemWidth(60.0f);
+        if (ImGui::SliderInt(operatorLabel, &oscillator, -1, maxOscillatorId))
+        {
+            newGroup.operators[op] = oscillator < 0 ? std::nullopt : std::optional<OscillatorId>(OscillatorId(oscillator));
+            changed = true;
+        }
+    }
+
+    char depthLabel[100];
+    sprintf_s(depthLabel, "Depth##fmDepth%zu", groupIndex);
+    changed |= ImGui::SliderFloat(depthLabel, &newGroup.depth, 0.0f, 4.0f);
+
+    char feedbackLabel[100];
+    sprintf_s(feedbackLabel, "Feedback##fmFeedback%zu", groupIndex);
+    changed |= ImGui::SliderFloat(feedbackLabel, &newGroup.feedback, 0.0f, 1.0f);
+
+    if (changed)
+    {
+        const RequestId requestId = GetNextRequestId();
+        requestIds.push(requestId);
+        EventBuilder::PushSetFmGroupEvent(m_generator, requestId, groupIndex, newGroup);
+    }
+}
+
+void UIOscillatorView::ShowGranular()
+{
+    const auto& snapshot = GeneratorAccess::getInstance(m_generator).getSnapshots().read();
+    ImGui::Text("%zu of %zu grains playing", snapshot.grains, MAX_GRAINS);
+    for (size_t cloudIndex = 0; cloudIndex < m_grainClouds.size(); ++cloudIndex)
+        ShowGrainCloud(cloudIndex, m_grainClouds[cloudIndex]);
+}
+
+void UIOscillatorView::ShowGrainCloud(size_t cloudIndex, const GrainCloudSettings& cloud)
+{
+    auto& requestIds = GetRequestIds(m_generator);
+    GrainCloudSettings newCloud = cloud;
+    bool changed = false;
+
+    char enabledLabel[100];
+    sprintf_s(enabledLabel, "Cloud %zu##grainEnabled%zu", cloudIndex, cloudIndex);
+    changed |= ImGui::Checkbox(enabledLabel, &newCloud.enabled);
+
+    ImGui::SameLine();
+    const char* windowNames[] = { "Hann", "Triangle", "Tukey" };
+    int windowIndex = int(cloud.window);
+    char windowLabel[100];
+    sprintf_s(windowLabel, "Window##grainWindow%zu", cloudIndex);
+    ImGui::SetNextItemWidth(100.0f);
+    if (ImGui::Combo(windowLabel, &windowIndex, windowNames, IM_ARRAYSIZE(windowNames)))
+    {
+        newCloud.window = GrainWindow(windowIndex);
+        changed = true;
+    }
+
+    // The source is the wavetable, or one of the loaded sample files.
+    auto& streamer = SampleStreamer::getInstance();
+    ImGui::SameLine();
+    char sourceLabel[100];
+    sprintf_s(sourceLabel, "Source##grainSource%zu", cloudIndex);
+    ImGui::SetNextItemWidth(200.0f);
+    const char* sourceName = cloud.source == GrainSource::Sample ? cloud.sampleFile->path.c_str() : "Wavetable";
+    if (ImGui::BeginCombo(sourceLabel, sourceName))
+    {
+        if (ImGui::Selectable("Wavetable", cloud.source == GrainSource::Wavetable))
+        {
+            newCloud.source = GrainSource::Wavetable;
+            changed = true;
+        }
+        for (size_t fileIndex = 0; fileIndex < streamer.getFileCount(); ++fileIndex)
+        {
+            const SampleFile& file = streamer.getFile(fileIndex);
+            char fileLabel[300];
+            sprintf_s(fileLabel, "%s##grainFile%zu_%zu", file.path.c_str(), cloudIndex, fileIndex);
+            if (ImGui::Selectable(fileLabel, cloud.source == GrainSource::Sample && cloud.sampleFile == &file))
+            {
+                newCloud.source = GrainSource::Sample;
+                newCloud.sampleFile = &file;
+                changed = true;
+            }
+        }
+        ImGui::EndCombo();
+    }
+
+    char label[100];
+    if (newCloud.source == GrainSource::Wavetable)
+    {
+        sprintf_s(label, "Morph##grainMorph%zu", cloudIndex);
+        changed |= ImGui::SliderFloat(label, &newCloud.wavetablePosition, 0.0f, float(WAVETABLE_FRAMES - 1));
+        sprintf_s(label, "Frequency##grainFrequency%zu", cloudIndex);
+        changed |= ImGui::SliderFloat(label, &newCloud.frequency, 20.0f, 8000.0f, "%.3f", ImGuiSliderFlags_Logarithmic);
+    }
+    else
+    {
+        sprintf_s(label, "Position##grainPosition%zu", cloudIndex);
+        changed |= ImGui::SliderFloat(label, &newCloud.position, 0.0f, 1.0f);
+        sprintf_s(label, "Position spread##grainPositionSpread%zu", cloudIndex);
+        changed |= ImGui::SliderFloat(label, &newCloud.positionSpread, 0.0f, 1.0f);
+        sprintf_s(label, "Rate##grainRate%zu", cloudIndex);
+        changed |= ImGui::SliderFloat(label, &newCloud.rate, 0.25f, 4.0f);
+    }
+
+    sprintf_s(label, "Density##grainDensity%zu", cloudIndex);
+    changed |= ImGui::SliderFloat(label, &newCloud.density, 0.0f, 2000.0f, "%.1f grains/s", ImGuiSliderFlags_Logarithmic);
+    sprintf_s(label, "Length##grainLength%zu", cloudIndex);
+    changed |= ImGui::SliderFloat(label, &newCloud.grainLength, 0.005f, 1.0f, "%.3fs", ImGuiSliderFlags_Logarithmic);
+    sprintf_s(label, "Pitch spread##grainPitchSpread%zu", cloudIndex);
+    changed |= ImGui::SliderFloat(label, &newCloud.pitchSpread, 0.0f, 1200.0f, "%.0f cents");
+    sprintf_s(label, "Pan spread##grainPanSpread%zu", cloudIndex);
+    changed |= ImGui::SliderFloat(label, &newCloud.panSpread, 0.0f, 1.0f);
+    sprintf_s(label, "Volume##grainVolume%zu", cloudIndex);
+    changed |= ImGui::SliderFloat(label, &newCloud.volume, 0.0f, 1.0f);
+
+    if (changed)
+    {
+        const RequestId requestId = GetNextRequestId();
+        requestIds.push(requestId);
+        EventBuilder::PushSetGrainCloudEvent(m_generator, requestId, cloudIndex, newCloud);
+    }
+}
+
+void UIOscillatorView::ShowSamples()
+{
+    auto& requestIds = GetRequestIds(m_generator);
+    auto& streamer = SampleStreamer::getInstance();
+
+    ImGui::InputText("WAV file##samplePath", m_samplePath, sizeof(m_samplePath));
+    ImGui::SameLine();
+    if (ImGui::Button("Load##sampleLoad"))
+        (void)streamer.loadFile(m_samplePath);
+
+    ImGui::SliderFloat("Rate##sampleRate", &m_sampleRate, 0.25f, 4.0f);
+    ImGui::SliderFloat("Volume##sampleVolume", &m_sampleVolume, 0.0f, 1.0f);
+
+    for (size_t fileIndex = 0; fileIndex < streamer.getFileCount(); ++fileIndex)
+    {
+        const SampleFile& file = streamer.getFile(fileIndex);
+        char playLabel[100];
+        sprintf_s(playLabel, "Play##samplePlay%zu", fileIndex);
+        if (ImGui::Button(playLabel))
+        {
+            if (auto voice = streamer.prepareStream(fileIndex))
+            {
+                const RequestId requestId = GetNextRequestId();
+                requestIds.push(requestId);
+                EventBuilder::PushPlaySampleEvent(m_generator, requestId, *voice, m_sampleRate, m_sampleVolume);
+            }
+        }
+        ImGui::SameLine();
+        ImGui::Text("%s (%.1fs)", file.path.c_str(), double(file.frames) / file.sampleRate);
+    }
+
+    ImGui::Separator();
+    for (size_t voice = 0; voice < MAX_SAMPLE_VOICES; ++voice)
+    {
+        const SampleStream& stream = streamer.getStream(voice);
+        const SampleStreamState state = stream.state.load(std::memory_order_acquire);
+        const uint32_t underruns = stream.underruns.load(std::memory_order_relaxed);
+        const char* stateNames[] = { "free", "prefetching", "playing", "finished" };
+        ImGui::Text("Voice %zu: %s, %u underruns", voice, stateNames[size_t(state)], underruns);
+
+        if (state == SampleStreamState::Playing)
+        {
+            ImGui::SameLine();
+            char stopLabel[100];
+            sprintf_s(stopLabel, "Stop##sampleStop%zu", voice);
+            if (ImGui::Button(stopLabel))
+            {
+                const RequestId requestId = GetNextRequestId();
+                requestIds.push(requestId);
+                EventBuilder::PushStopSampleEvent(m_generator, requestId, voice);
+            }
+        }
+    }
 }
 
+void UIOscillatorView::ShowMidi()
+{
+    auto& requestIds = GetRequestIds(m_generator);
+
+    ImGui::InputText("MIDI file##midiPath", m_midiPath, sizeof(m_midiPath));
+    ImGui::SameLine();
+    if (ImGui::Button("Load##midiLoad"))
+    {
+        if (auto sequence = LoadMidiFile(m_midiPath))
+            m_midiSequences.push_back(std::make_unique<MidiSequence>(std::move(*sequence)));
+    }
+
+    int type = int(m_midiSettings.type);
+    const char* typeNames[] = { "Sine", "Square", "Triangle", "Saw", "White noise", "Pink noise", "Brown noise" };
+    ImGui::Combo("Wave##midiType", &type, typeNames, IM_ARRAYSIZE(typeNames));
+    m_midiSettings.type = OscillatorType(type);
+    ImGui::SliderFloat("Gain##midiGain", &m_midiSettings.gain, 0.0f, 1.0f);
+    ImGui::InputText("Render to##midiRenderPath", m_midiRenderPath, sizeof(m_midiRenderPath));
+    if (m_midiRender.valid() && m_midiRender.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+        m_midiRenderStatus = m_midiRender.get() ? "Rendered" : "Couldn't write the file";
+    ImGui::SameLine();
+    ImGui::Text("%s", m_midiRender.valid() ? "Rendering..." : m_midiRenderStatus);
+
+    for (size_t index = 0; index < m_midiSequences.size(); ++index)
+    {
+        const MidiSequence& sequence = *m_midiSequences[index];
+        char playLabel[100];
+        sprintf_s(playLabel, "Play##midiPlay%zu", index);
+        if (ImGui::Button(playLabel))
+        {
+            const RequestId requestId = GetNextRequestId();
+            requestIds.push(requestId);
+            EventBuilder::PushPlayMidiEvent(m_generator, requestId, &sequence, m_midiSettings);
+        }
+
+        // Rendering runs on a thread of its own, one render at a time; the sequence
+        // stays loaded for as long as the view does, so it outlives the render.
+        ImGui::SameLine();
+        ImGui::BeginDisabled(m_midiRender.valid());
+        char renderLabel[100];
+        sprintf_s(renderLabel, "Render##midiRender%zu", index);
+        if (ImGui::Button(renderLabel))
+        {
+            m_midiRender = std::async(std::launch::async, [&sequence, settings = m_midiSettings, path = std::string(m_midiRenderPath)]() {
+                return OfflineRenderer::RenderMidiToFile(sequence, settings, path);
+            });
+        }
+        ImGui::EndDisabled();
+
+        ImGui::SameLine();
+        ImGui::Text("Sequence %zu: %zu events, %.1fs", index, sequence.events.size(), double(sequence.lengthSamples) / SAMPLE_RATE);
+    }
+
+    if (ImGui::Button("Stop##midiStop"))
+    {
+        const RequestId requestId = GetNextRequestId();
+        requestIds.push(requestId);
+        EventBuilder::PushStopMidiEvent(m_generator, requestId);
+    }
+}
+
+void UIOscillatorView::ShowResynthesis()
+{
+    auto& requestIds = GetRequestIds(m_generator);
+
+    // Analysis happens right here on the UI thread (on every core), which stalls the UI for a moment.
+    ImGui::InputText("WAV file##resynthesisWavPath", m_resynthesisWavPath, sizeof(m_resynthesisWavPath));
+    ImGui::InputText("Partials file##partialsPath", m_partialsPath, sizeof(m_partialsPath));
+    if (ImGui::Button("Analyze##partialsAnalyze"))
+    {
+        if (auto tracks = AnalyzePartials(m_resynthesisWavPath))
+        {
+            (void)SavePartials(*tracks, m_partialsPath);
+            m_partialTracks.push_back(std::make_unique<PartialTracks>(std::move(*tracks)));
+        }
+    }
+    ImGui::SameLine();
+    if (ImGui::Button("Load##partialsLoad"))
+    {
+        if (auto tracks = LoadPartials(m_partialsPath))
+            m_partialTracks.push_back(std::make_unique<PartialTracks>(std::move(*tracks)));
+    }
+
+    bool changed = false;
+    changed |= ImGui::SliderFloat("Stretch##resynthesisStretch", &m_resynthesisSettings.stretch, 0.25f, 8.0f, "%.2fx", ImGuiSliderFlags_Logarithmic);
+    if (ImGui::SliderFloat("Pitch##resynthesisPitch", &m_resynthesisSemitones, -24.0f, 24.0f, "%.1f semitones"))
+    {
+        m_resynthesisSettings.pitch = std::exp2(m_resynthesisSemitones / 12.0f);
+        changed = true;
+    }
+    changed |= ImGui::SliderFloat("Volume##resynthesisVolume", &m_resynthesisSettings.volume, 0.0f, 1.0f);
+    changed |= ImGui::Checkbox("Loop##resynthesisLoop", &m_resynthesisSettings.loop);
+    if (changed)
+    {
+        const RequestId requestId = GetNextRequestId();
+        requestIds.push(requestId);
+        EventBuilder::PushSetResynthesisEvent(m_generator, requestId, m_resynthesisSettings);
+    }
+
+    for (size_t index = 0; index < m_partialTracks.size(); ++index)
+    {
+        const PartialTracks& tracks = *m_partialTracks[index];
+        char playLabel[100];
+        sprintf_s(playLabel, "Play##resynthesisPlay%zu", index);
+        if (ImGui::Button(playLabel))
+        {
+            const RequestId requestId = GetNextRequestId();
+            requestIds.push(requestId);
+            EventBuilder::PushPlayResynthesisEvent(m_generator, requestId, &tracks, m_resynthesisSettings);
+        }
+
+        ImGui::SameLine();
+        ImGui::Text("Tracks %zu: %zu frames, %zu points, %.1fs", index, tracks.getFrameCount(), tracks.points.size(), tracks.getSeconds());
+    }
+
+    const auto& snapshot = GeneratorAccess::getInstance(m_generator).getSnapshots().read();
+    ImGui::Text("%zu of %zu partials sounding", snapshot.partials, MAX_PARTIALS);
+    if (ImGui::Button("Stop##resynthesisStop"))
+    {
+        const RequestId requestId = GetNextRequestId();
+        requestIds.push(requestId);
+        EventBuilder::PushStopResynthesisEvent(m_generator, requestId);
+    }
+}
+
+size_t ShowGeneratorMixer()
+{
+    static size_t selectedGenerator = 0;
+    auto& mixer = GeneratorMixer::getInstance();
+
+    for (size_t generator = 0; generator < MAX_GENERATORS; ++generator)
+    {
+        char selectLabel[100];
+        sprintf_s(selectLabel, "Generator %zu##generatorSelect%zu", generator, generator);
+        if (ImGui::RadioButton(selectLabel, selectedGenerator == generator))
+            selectedGenerator = generator;
+
+        ImGui::SameLine();
+        float gain = mixer.getGain(generator);
+        char gainLabel[100];
+        sprintf_s(gainLabel, "Gain##generatorGain%zu", generator);
+        ImGui::SetNextItemWidth(150.0f);
+        if (ImGui::SliderFloat(gainLabel, &gain, 0.0f, 2.0f))
+            mixer.setGain(generator, gain);
+
+        // Over 100% means the generator alone can't keep up with the audio device.
+        ImGui::SameLine();
+        const float load = mixer.getLoad(generator);
+        char loadText[32];
+        sprintf_s(loadText, "CPU %.1f%%", double(load) * 100.0);
+        ImGui::ProgressBar(std::min(load, 1.0f), ImVec2(150.0f, 0.0f), loadText);
+    }
+
+    // The last stage before the device. Oversampling keeps the curves' harmonics from
+    // aliasing, at the cost of about 60 frames of latency.
+    SaturationSettings saturation = mixer.getSaturation();
+    bool saturationChanged = false;
+
+    const char* curves[] = { "Hard clip", "Tanh", "Soft knee", "Asymmetric" };
+    int curveIndex = int(saturation.curve);
+    ImGui::SetNextItemWidth(120.0f);
+    if (ImGui::Combo("Saturation##saturationCurve", &curveIndex, curves, IM_ARRAYSIZE(curves)))
+    {
+        saturation.curve = SaturationCurve(curveIndex);
+        saturationChanged = true;
+    }
+
+    ImGui::SameLine();
+    const char* factors[] = { "1x", "2x", "4x" };
+    int factorIndex = saturation.oversampling == 4 ? 2 : saturation.oversampling - 1;
+    ImGui::SetNextItemWidth(60.0f);
+    if (ImGui::Combo("Oversampling##saturationOversampling", &factorIndex, factors, IM_ARRAYSIZE(factors)))
+    {
+        saturation.oversampling = uint8_t(1 << factorIndex);
+        saturationChanged = true;
+    }
+
+    ImGui::SameLine();
+    ImGui::SetNextItemWidth(150.0f);
+    saturationChanged |= ImGui::SliderFloat("Drive##saturationDrive", &saturation.drive, 0.1f, 10.0f, "%.2f", ImGuiSliderFlags_Logarithmic);
+
+    if (saturationChanged)
+        mixer.setSaturation(saturation);
+
+    return selectedGenerator;
+}
+
+void ShowReverb()
+{
+    static char impulsePath[260]{};
+    auto& reverb = ConvolutionReverb::getInstance();
+
+    // Loading transforms the whole response right here on the UI thread, which stalls the UI for a moment.
+    ImGui::InputText("Impulse response##reverbPath", impulsePath, sizeof(impulsePath));
+    ImGui::SameLine();
+    if (ImGui::Button("Load##reverbLoad"))
+        (void)reverb.load(impulsePath);
+    ImGui::SameLine();
+    if (ImGui::Button("Clear##reverbClear"))
+        reverb.clear();
+
+    float wet = reverb.getWet();
+    if (ImGui::SliderFloat("Wet##reverbWet", &wet, 0.0f, 1.0f))
+        reverb.setWet(wet);
+
+    if (const ImpulseResponseConvolver* response = reverb.getLoaded())
+    {
+        ImGui::Text("%.2fs, %zu channel(s), %llu late blocks", response->getSeconds(), response->getChannels(),
+                    static_cast<unsigned long long>(response->getLateBlocks()));
+    }
+    else
+    {
+        ImGui::Text("No impulse response");
+    }
+}
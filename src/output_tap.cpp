@@ -0,0 +1,7 @@
+#include "output_tap.h"
+
+OutputTap& OutputTap::getInstance()
+{
+    static OutputTap tap;
+    return tap;
+}
@@ -13,11 +13,11 @@
 // automatically-generated list. I think this might require splitting the
 // initialization code from the api selection code, particularly so the code can
 // stop and start portaudio streams at will. but idk honestly. is anything knowable?
-PaStream* InitializePAStream(PaCallbackT paCallback)
+static PaDeviceIndex FindOutputDevice()
 {
     PaHostApiIndex const numAPIs = Pa_GetHostApiCount();
     if (numAPIs < 0)
-        return nullptr;
+        return paNoDevice;
 
     PaHostApiInfo const* hostApiInfo;
     PaDeviceIndex devIndex = 0;
@@ -31,6 +31,21 @@ PaStream* InitializePAStream(PaCallbackT paCallback)
             break;
         }
     }
+    return devIndex;
+}
+
+double GetOutputDeviceSampleRate()
+{
+    const PaDeviceIndex devIndex = FindOutputDevice();
+    const PaDeviceInfo* deviceInfo = devIndex == paNoDevice ? nullptr : Pa_GetDeviceInfo(devIndex);
+    return deviceInfo != nullptr ? deviceInfo->defaultSampleRate : 0.0;
+}
+
+PaStream* InitializePAStream(PaCallbackT paCallback, unsigned long framesPerBuffer, void* userData, double sampleRate)
+{
+    const PaDeviceIndex devIndex = FindOutputDevice();
+    if (devIndex == paNoDevice)
+        return nullptr;
 
     // WASAPI-specific stream parameters
     auto wasapiStreamInfo = std::make_unique<PaWasapiStreamInfo>();
@@ -63,28 +78,35 @@ PaStream* InitializePAStream(PaCallbackT paCallback)
     outputParameters.hostApiSpecificStreamInfo = wasapiStreamInfo.get();
     //outputParameters.hostApiSpecificStreamInfo = asioStreamInfo.get();
     outputParameters.sampleFormat = paFloat32;
-    outputParameters.suggestedLatency = Pa_GetDeviceInfo(outputParameters.device)->defaultLowOutputLatency;
+    outputParameters.suggestedLatency = framesPerBuffer == paFramesPerBufferUnspecified
+        ? Pa_GetDeviceInfo(outputParameters.device)->defaultLowOutputLatency
+        : double(framesPerBuffer) / sampleRate;
 
     PaError err;
     PaStream* stream;
     err = Pa_OpenStream(&stream,
         NULL,
         &outputParameters,
-        SAMPLE_RATE,
-        paFramesPerBufferUnspecified,
+        sampleRate,
+        framesPerBuffer,
         paClipOff,
         paCallback,
-        nullptr);
-    assert(err == PaErrorCode::paNoError);
+        userData);
+    if (err != PaErrorCode::paNoError)
+        return nullptr;
+
     err = Pa_StartStream(stream);
-    assert(err == PaErrorCode::paNoError);
+    if (err != PaErrorCode::paNoError)
+    {
+        Pa_CloseStream(stream);
+        return nullptr;
+    }
 
     return stream;
 }
 
-void TearDownPAStream(PaStream* stream)
+void ClosePAStream(PaStream* stream)
 {
     Pa_StopStream(stream);
     Pa_CloseStream(stream);
-    Pa_Terminate();
 }
@@ -0,0 +1,300 @@
+#include "partials.h"
+
+#include "AudioFile.h"
+#include "constants.h"
+#include "fft.h"
+#include "realtime_sanitizer.h"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <thread>
+
+namespace
+{
+    struct Peak
+    {
+        float frequency;
+        float amplitude;
+    };
+
+    // A partial that was sounding in the last frame.
+    struct Track
+    {
+        float    frequency;
+        uint16_t slot;
+    };
+
+    uint16_t quantizeAmplitude(float amplitude)
+    {
+        return uint16_t(std::lround(std::min(amplitude, 1.0f) * float(UINT16_MAX)));
+    }
+
+    std::vector<float> loadMono(const std::string& path, uint32_t& sampleRate)
+    {
+        AudioFile<float> audioFile;
+        if (!audioFile.load(path) || audioFile.getNumChannels() == 0)
+            return {};
+
+        sampleRate = audioFile.getSampleRate();
+        const size_t channels = size_t(audioFile.getNumChannels());
+        std::vector<float> mono(size_t(audioFile.getNumSamplesPerChannel()), 0.0f);
+        for (size_t channel = 0; channel < channels; ++channel)
+        {
+            for (size_t frame = 0; frame < mono.size(); ++frame)
+                mono[frame] += audioFile.samples[channel][frame] / float(channels);
+        }
+        return mono;
+    }
+
+    // Find the spectral peaks of frames [first, last), each frame centered on a multiple of the hop.
+    void findPeaks(const std::vector<float>& mono, const PartialAnalysisSettings& settings, uint32_t sampleRate,
+                   size_t first, size_t last, std::vector<std::vector<Peak>>& peaks)
+    {
+        const size_t size = settings.fftSize;
+        const size_t bins = size / 2 + 1;
+        RealFft fft(size);
+        std::vector<float> window(size);
+        std::vector<float> windowed(size);
+        std::vector<float> real(bins);
+        std::vector<float> imaginary(bins);
+        std::vector<float> logMagnitude(bins);
+
+        for (size_t index = 0; index < size; ++index)
+            window[index] = float(0.5 - 0.5 * std::cos(TWO_PI * double(index) / double(size)));
+
+        // A sine of amplitude A peaks at A * (window sum) / 2 = A * size / 4.
+        const float logGain = std::log(4.0f / float(size));
+        const float logThreshold = settings.thresholdDb * float(std::log(10.0) / 20.0);
+        const float binWidth = float(sampleRate) / float(size);
+
+        for (size_t frame = first; frame < last; ++frame)
+        {
+            const ptrdiff_t start = ptrdiff_t(frame * settings.hopSize) - ptrdiff_t(size / 2);
+            for (size_t index = 0; index < size; ++index)
+            {
+                const ptrdiff_t sample = start + ptrdiff_t(index);
+                windowed[index] = sample >= 0 && size_t(sample) < mono.size() ? mono[size_t(sample)] * window[index] : 0.0f;
+            }
+
+            fft.forward(windowed, real, imaginary);
+            for (size_t bin = 0; bin < bins; ++bin)
+                logMagnitude[bin] = 0.5f * std::log(real[bin] * real[bin] + imaginary[bin] * imaginary[bin] + 1e-20f) + logGain;
+
+            // Local maxima over the threshold, placed between bins by fitting a parabola
+            // to the log magnitudes around them.
+            std::vector<Peak>& framePeaks = peaks[frame];
+            for (size_t bin = 1; bin + 1 < bins; ++bin)
+            {
+                const float a = logMagnitude[bin - 1];
+                const float b = logMagnitude[bin];
+                const float c = logMagnitude[bin + 1];
+                if (b <= logThreshold || b <= a || b < c)
+                    continue;
+
+                const float curvature = a - 2.0f * b + c;
+                const float offset = curvature < 0.0f ? 0.5f * (a - c) / curvature : 0.0f;
+                framePeaks.push_back({ (float(bin) + offset) * binWidth, std::exp(b - 0.25f * (a - c) * offset) });
+            }
+
+            if (framePeaks.size() > settings.maxPartials)
+            {
+                std::nth_element(framePeaks.begin(), framePeaks.begin() + ptrdiff_t(settings.maxPartials), framePeaks.end(),
+                                 [](const Peak& x, const Peak& y) { return x.amplitude > y.amplitude; });
+                framePeaks.resize(settings.maxPartials);
+            }
+            std::sort(framePeaks.begin(), framePeaks.end(), [](const Peak& x, const Peak& y) { return x.frequency < y.frequency; });
+        }
+    }
+
+    // For each of the sorted frequencies in from, the index of the nearest of the sorted frequencies in to.
+    template <typename A, typename B>
+    void findNearest(const std::vector<A>& from, const std::vector<B>& to, std::vector<size_t>& nearest)
+    {
+        nearest.resize(from.size());
+        size_t candidate = 0;
+        for (size_t index = 0; index < from.size(); ++index)
+        {
+            const float frequency = from[index].frequency;
+            while (candidate + 1 < to.size() &&
+                   std::abs(to[candidate + 1].frequency - frequency) <= std::abs(to[candidate].frequency - frequency))
+                ++candidate;
+            nearest[index] = candidate;
+        }
+    }
+
+    // Link each frame's peaks to the last frame's partials. A peak and a partial continue
+    // each other when each is the other's nearest in frequency, and they're close enough.
+    // Other peaks start new partials, loudest first, while there are slots free; other
+    // partials end, and their slots are free again from the next frame on.
+    PartialTracks trackPeaks(const std::vector<std::vector<Peak>>& peaks, const PartialAnalysisSettings& settings, uint32_t sampleRate)
+    {
+        PartialTracks tracks;
+        tracks.sampleRate = sampleRate;
+        tracks.hopSize = settings.hopSize;
+        tracks.frameStart.reserve(peaks.size() + 1);
+        tracks.frameStart.push_back(0);
+
+        const float binWidth = float(sampleRate) / float(settings.fftSize);
+        std::vector<uint16_t> freeSlots;
+        for (size_t slot = settings.maxPartials; slot-- > 0;)
+            freeSlots.push_back(uint16_t(slot));
+
+        std::vector<Track> active;
+        std::vector<Track> next;
+        std::vector<size_t> peakNearest;
+        std::vector<size_t> trackNearest;
+        std::vector<size_t> births;
+        std::vector<uint16_t> ended;
+        for (const std::vector<Peak>& framePeaks : peaks)
+        {
+            findNearest(framePeaks, active, peakNearest);
+            findNearest(active, framePeaks, trackNearest);
+
+            next.clear();
+            births.clear();
+            ended.clear();
+            std::vector<bool> continued(active.size(), false);
+            for (size_t index = 0; index < framePeaks.size(); ++index)
+            {
+                const Peak& peak = framePeaks[index];
+                const size_t track = active.empty() ? 0 : peakNearest[index];
+                const float maxDeviation = std::max(2.0f * binWidth, 0.03f * peak.frequency);
+                if (!active.empty() && trackNearest[track] == index &&
+                    std::abs(active[track].frequency - peak.frequency) <= maxDeviation)
+                {
+                    continued[track] = true;
+                    next.push_back({ peak.frequency, active[track].slot });
+                    tracks.points.push_back({ active[track].slot, quantizeAmplitude(peak.amplitude), peak.frequency });
+                }
+                else
+                {
+                    births.push_back(index);
+                }
+            }
+
+            for (size_t track = 0; track < active.size(); ++track)
+            {
+                if (!continued[track])
+                    ended.push_back(active[track].slot);
+            }
+
+            std::sort(births.begin(), births.end(),
+                      [&framePeaks](size_t x, size_t y) { return framePeaks[x].amplitude > framePeaks[y].amplitude; });
+            for (size_t index : births)
+            {
+                if (freeSlots.empty())
+                    break;
+
+                const Peak& peak = framePeaks[index];
+                const uint16_t slot = freeSlots.back();
+                freeSlots.pop_back();
+                next.push_back({ peak.frequency, slot });
+                tracks.points.push_back({ slot, quantizeAmplitude(peak.amplitude), peak.frequency });
+            }
+
+            freeSlots.insert(freeSlots.end(), ended.begin(), ended.end());
+            std::sort(next.begin(), next.end(), [](const Track& x, const Track& y) { return x.frequency < y.frequency; });
+            std::swap(active, next);
+            tracks.frameStart.push_back(uint32_t(tracks.points.size()));
+        }
+        return tracks;
+    }
+}
+
+std::optional<PartialTracks> AnalyzePartials(const std::string& wavPath, const PartialAnalysisSettings& settings)
+{
+    RealtimeSanitizer::checkBlockingCall("AnalyzePartials");
+    if (!std::has_single_bit(settings.fftSize) || settings.fftSize < 16 || settings.hopSize == 0 ||
+        settings.hopSize > settings.fftSize || settings.maxPartials == 0 || settings.maxPartials > MAX_PARTIALS)
+        return std::nullopt;
+
+    uint32_t sampleRate = 0;
+    const std::vector<float> mono = loadMono(wavPath, sampleRate);
+    if (mono.empty() || sampleRate == 0)
+        return std::nullopt;
+
+    // Frames are independent until tracking, so each thread takes a run of them.
+    const size_t frameCount = (mono.size() + settings.hopSize - 1) / settings.hopSize;
+    const size_t threadCount = std::clamp<size_t>(settings.threads != 0 ? settings.threads : std::thread::hardware_concurrency(),
+                                                  1, frameCount);
+    std::vector<std::vector<Peak>> peaks(frameCount);
+    std::vector<std::thread> threads;
+    for (size_t thread = 0; thread < threadCount; ++thread)
+    {
+        const size_t first = frameCount * thread / threadCount;
+        const size_t last = frameCount * (thread + 1) / threadCount;
+        threads.emplace_back([&, first, last]() { findPeaks(mono, settings, sampleRate, first, last, peaks); });
+    }
+    for (std::thread& thread : threads)
+        thread.join();
+
+    return trackPeaks(peaks, settings, sampleRate);
+}
+
+bool SavePartials(const PartialTracks& tracks, const std::string& path)
+{
+    RealtimeSanitizer::checkBlockingCall("SavePartials");
+    PartialFileHeader header;
+    header.sampleRate = tracks.sampleRate;
+    header.hopSize = tracks.hopSize;
+    header.frameCount = uint32_t(tracks.getFrameCount());
+    header.pointCount = uint32_t(tracks.points.size());
+
+    std::vector<uint32_t> pointsPerFrame(tracks.getFrameCount());
+    for (size_t frame = 0; frame < pointsPerFrame.size(); ++frame)
+        pointsPerFrame[frame] = tracks.frameStart[frame + 1] - tracks.frameStart[frame];
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(pointsPerFrame.data()), std::streamsize(pointsPerFrame.size() * sizeof(uint32_t)));
+    file.write(reinterpret_cast<const char*>(tracks.points.data()), std::streamsize(tracks.points.size() * sizeof(PartialPoint)));
+    return bool(file);
+}
+
+std::optional<PartialTracks> LoadPartials(const std::string& path)
+{
+    RealtimeSanitizer::checkBlockingCall("LoadPartials");
+    std::ifstream file(path, std::ios::binary);
+    PartialFileHeader header;
+    if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)))
+        return std::nullopt;
+    if (std::memcmp(header.magic, "AVPT", 4) != 0 || header.version != PartialFileHeader{}.version ||
+        header.sampleRate == 0 || header.hopSize == 0)
+        return std::nullopt;
+
+    std::vector<uint32_t> pointsPerFrame(header.frameCount);
+    if (!file.read(reinterpret_cast<char*>(pointsPerFrame.data()), std::streamsize(pointsPerFrame.size() * sizeof(uint32_t))))
+        return std::nullopt;
+
+    PartialTracks tracks;
+    tracks.sampleRate = header.sampleRate;
+    tracks.hopSize = header.hopSize;
+    tracks.frameStart.reserve(size_t(header.frameCount) + 1);
+    tracks.frameStart.push_back(0);
+    uint64_t total = 0;
+    for (uint32_t count : pointsPerFrame)
+    {
+        total += count;
+        if (total > header.pointCount)
+            return std::nullopt;
+        tracks.frameStart.push_back(uint32_t(total));
+    }
+    if (total != header.pointCount)
+        return std::nullopt;
+
+    tracks.points.resize(header.pointCount);
+    if (!file.read(reinterpret_cast<char*>(tracks.points.data()), std::streamsize(tracks.points.size() * sizeof(PartialPoint))))
+        return std::nullopt;
+
+    // The player indexes its bank by slot, so a bad one must not get that far.
+    const bool valid = std::all_of(tracks.points.begin(), tracks.points.end(), [](const PartialPoint& point) {
+        return point.slot < MAX_PARTIALS && std::isfinite(point.frequency) && point.frequency >= 0.0f;
+    });
+    if (!valid)
+        return std::nullopt;
+
+    return tracks;
+}
@@ -1,14 +1,70 @@
 #include "plotting.h"
 
+#include "output_tap.h"
 #include "util.h"
 
 #include "implot.h"
 
+#include <algorithm>
+#include <array>
 #include <cmath>
+#include <optional>
 
 namespace Plotting
 {
 
+namespace
+{
+    enum class ScopeTrigger : int
+    {
+        Free,
+        RisingEdge,
+        Level,       // a crossing in either direction
+        VoicePhase   // every wrap of a voice's phase
+    };
+
+    constexpr size_t SCOPE_MAX_WINDOW_FRAMES = 4096;                  // ~93 ms
+    constexpr size_t SCOPE_CAPTURE_FRAMES = SCOPE_MAX_WINDOW_FRAMES * 2; // a window, and as much again to search
+
+    // Find where the shown window starts within a capture, or nothing if the trigger
+    // didn't fire. The trigger point sits a tenth of the way into the window; the
+    // newest trigger that leaves room for the whole window wins.
+    std::optional<size_t> findTrigger(ScopeTrigger trigger, const float* samples, size_t captureFrames, size_t windowFrames,
+                                      float level, uint64_t captureStart, double wrapTime, double period)
+    {
+        const size_t before = windowFrames / 10;
+        const size_t latest = captureFrames - (windowFrames - before);
+        switch (trigger)
+        {
+        case ScopeTrigger::Free:
+            return latest - before;
+        case ScopeTrigger::RisingEdge:
+        case ScopeTrigger::Level:
+            for (size_t index = latest; index > before; --index)
+            {
+                const bool wasBelow = samples[index - 1] < level;
+                const bool isBelow = samples[index] < level;
+                if (wasBelow && !isBelow)
+                    return index - before;
+                if (trigger == ScopeTrigger::Level && !wasBelow && isBelow)
+                    return index - before;
+            }
+            return std::nullopt;
+        case ScopeTrigger::VoicePhase:
+        {
+            // A voice at a steady frequency wraps every period, counting from the wrap we know
+            // of; trigger on the first frame after the newest one that fits.
+            const double cycles = std::floor((double(captureStart + latest) - wrapTime) / period);
+            const int64_t index = int64_t(std::ceil(wrapTime + cycles * period)) - int64_t(captureStart);
+            if (index < int64_t(before))
+                return std::nullopt;
+            return size_t(index) - before;
+        }
+        }
+        return std::nullopt;
+    }
+}
+
 void DrawOscilatorPlot(const std::vector<float>& logBufferL, const std::vector<float>& logBufferR)
 {
     static bool paused = false;
@@ -60,4 +116,102 @@ void DrawOscilatorPlot(const std::vector<float>& logBufferL, const std::vector<f
     }
 }
 
+void DrawSpectrum(const std::array<float, SPECTRUM_BANDS>& bandFrequencies, const SpectrumFrame& frame)
+{
+    if (ImPlot::BeginPlot("##Spectrum", ImVec2(-1, 250))) {
+        ImPlot::SetupAxes("Hz", "dB");
+        ImPlot::SetupAxisScale(ImAxis_X1, ImPlotScale_Log10);
+        ImPlot::SetupAxisLimits(ImAxis_X1, SPECTRUM_LOWEST_FREQUENCY, SPECTRUM_HIGHEST_FREQUENCY, ImGuiCond_Always);
+        ImPlot::SetupAxisLimits(ImAxis_Y1, -100.0, 0.0, ImGuiCond_Always);
+        ImPlot::SetNextFillStyle(IMPLOT_AUTO_COL, 0.5f);
+        ImPlot::PlotShaded("Level", bandFrequencies.data(), frame.levels.data(), int(SPECTRUM_BANDS), double(SPECTRUM_FLOOR_DB));
+        ImPlot::PlotLine("Peak", bandFrequencies.data(), frame.peaks.data(), int(SPECTRUM_BANDS));
+        ImPlot::EndPlot();
+    }
+}
+
+void DrawScope(std::span<const VoiceSnapshot> voices)
+{
+    static int trigger = int(ScopeTrigger::RisingEdge);
+    static float level = 0.0f;
+    static float windowMilliseconds = 20.0f;
+    static int voice = 0;
+
+    // Two captures: the one on screen, and the next. A capture only goes on screen once it triggers.
+    static std::array<std::array<float, SCOPE_CAPTURE_FRAMES>, 2> left{};
+    static std::array<std::array<float, SCOPE_CAPTURE_FRAMES>, 2> right{};
+    static size_t shown = 0;
+    static size_t shownStart = 0;
+    static size_t shownFrames = 0;
+
+    const char* triggers[] = { "Free", "Rising edge", "Level", "Voice phase" };
+    ImGui::Combo("Trigger##scopeTrigger", &trigger, triggers, IM_ARRAYSIZE(triggers));
+    if (ScopeTrigger(trigger) == ScopeTrigger::VoicePhase)
+        ImGui::SliderInt("Voice##scopeVoice", &voice, 0, int(voices.size()) - 1);
+    else if (ScopeTrigger(trigger) != ScopeTrigger::Free)
+        ImGui::SliderFloat("Level##scopeLevel", &level, -1.0f, 1.0f);
+    ImGui::SliderFloat("Window##scopeWindow", &windowMilliseconds, 1.0f, 1000.0f * SCOPE_MAX_WINDOW_FRAMES / SAMPLE_RATE, "%.1f ms");
+
+    const size_t windowFrames = std::clamp(size_t(windowMilliseconds * 0.001f * SAMPLE_RATE), size_t(16), SCOPE_MAX_WINDOW_FRAMES);
+    size_t captureFrames = windowFrames * 2;
+
+    // Locking to a voice means searching back as far as one of its periods.
+    double period = 0.0;
+    double wrapTime = 0.0;
+    if (ScopeTrigger(trigger) == ScopeTrigger::VoicePhase)
+    {
+        const VoiceSnapshot& lockVoice = voices[size_t(voice)];
+        if (lockVoice.state == OscillatorState::Uninitialized || lockVoice.frequency <= 0.0f)
+        {
+            ImGui::Text("Voice %d isn't playing.", voice);
+            return;
+        }
+        period = double(SAMPLE_RATE) / lockVoice.frequency;
+
+        // The tap counts frames in step with the generator's sample time, so the voice's
+        // published phase says when it next wraps, in tap frames.
+        wrapTime = double(lockVoice.phaseTime) + (PHASE_CYCLE - double(lockVoice.phase)) / PHASE_CYCLE * period;
+        captureFrames = std::min(windowFrames + std::max(windowFrames, size_t(std::ceil(period)) + 1), SCOPE_CAPTURE_FRAMES);
+    }
+
+    auto& tap = OutputTap::getInstance();
+    const uint64_t written = tap.getWritten();
+    const size_t next = 1 - shown;
+    if (written >= captureFrames)
+    {
+        const uint64_t captureStart = written - captureFrames;
+        if (tap.copy(captureStart, captureFrames, left[next].data(), right[next].data()))
+        {
+            const auto start = findTrigger(ScopeTrigger(trigger), left[next].data(), captureFrames, windowFrames,
+                                           level, captureStart, wrapTime, period);
+            if (start.has_value())
+            {
+                shown = next;
+                shownStart = *start;
+                shownFrames = windowFrames;
+            }
+        }
+    }
+
+    const bool triggered = shown == next || ScopeTrigger(trigger) == ScopeTrigger::Free;
+    ImGui::TextUnformatted(triggered ? "Triggered" : "Waiting for trigger");
+
+    if (ImPlot::BeginPlot("##Scope", ImVec2(-1, 250))) {
+        // Time is in milliseconds from the trigger point.
+        const double millisecondsPerFrame = 1000.0 / SAMPLE_RATE;
+        const double startTime = -double(shownFrames / 10) * millisecondsPerFrame;
+        ImPlot::SetupAxes("ms", NULL);
+        ImPlot::SetupAxisLimits(ImAxis_X1, startTime, startTime + double(shownFrames) * millisecondsPerFrame, ImGuiCond_Always);
+        ImPlot::SetupAxisLimits(ImAxis_Y1, -1.0, 1.0, ImGuiCond_Always);
+        if (shownFrames > 0)
+        {
+            ImPlot::PlotLine("L", left[shown].data() + shownStart, int(shownFrames), millisecondsPerFrame, startTime);
+            ImPlot::PlotLine("R", right[shown].data() + shownStart, int(shownFrames), millisecondsPerFrame, startTime);
+        }
+        const double triggerTime = 0.0;
+        ImPlot::PlotInfLines("##trigger", &triggerTime, 1);
+        ImPlot::EndPlot();
+    }
+}
+
 }
@@ -0,0 +1,189 @@
+#include "preset.h"
+
+#include "realtime_sanitizer.h"
+
+#include <cstring>
+#include <fstream>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+PresetSnapshot MakePresetSnapshot(const std::unordered_map<OscillatorId, OscillatorSettings>& oscillators)
+{
+    PresetSnapshot preset;
+    preset.size = sizeof(PresetSnapshot);
+    for (const auto& [id, settings] : oscillators)
+    {
+        if (id >= PRESET_OSCILLATORS)
+            continue;
+
+        OscillatorSettings saved = settings;
+        switch (saved.state)
+        {
+        case OscillatorState::FadingIn:
+            saved.state = OscillatorState::Active;
+            break;
+        case OscillatorState::FadingOutDeactivate:
+            saved.state = OscillatorState::Deactivated;
+            break;
+        case OscillatorState::FadingOutRemove:
+            saved.state = OscillatorState::Uninitialized;
+            break;
+        default:
+            break;
+        }
+        preset.oscillators[id] = saved;
+    }
+    return preset;
+}
+
+bool SavePreset(const PresetSnapshot& preset, const std::string& path)
+{
+    RealtimeSanitizer::checkBlockingCall("SavePreset");
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char*>(&preset), sizeof(preset));
+    return bool(file);
+}
+
+// Well past what the UI offers, but short of where the math goes wrong.
+constexpr float MAX_ENVELOPE_SECONDS = 60.0f;
+constexpr float MAX_UNISON_DETUNE = 1200.0f; // cents
+
+static bool isInRange(float value, float low, float high)
+{
+    // False for NaN, too.
+    return value >= low && value <= high;
+}
+
+static bool isValidOscillator(const PresetSnapshot& preset, OscillatorId id)
+{
+    const OscillatorSettings& settings = preset.oscillators[id];
+    if (settings.state == OscillatorState::Uninitialized)
+        return true;
+
+    // Snapshots only save the states fades settle on.
+    if (settings.state != OscillatorState::Active && settings.state != OscillatorState::Deactivated)
+        return false;
+
+    if (settings.type > OscillatorType::BrownNoise ||
+        !isInRange(settings.frequency, 0.0f, float(SAMPLE_RATE) / 2.0f) ||
+        !isInRange(settings.volume, 0.0f, 1.0f) ||
+        !isInRange(settings.pan, -1.0f, 1.0f) ||
+        !isInRange(settings.wavetablePosition, 0.0f, float(WAVETABLE_FRAMES - 1)))
+        return false;
+
+    const EnvelopeSettings& envelope = settings.envelope;
+    if (!isInRange(envelope.attack, 0.0f, MAX_ENVELOPE_SECONDS) || !isInRange(envelope.decay, 0.0f, MAX_ENVELOPE_SECONDS) ||
+        !isInRange(envelope.sustain, 0.0f, 1.0f) || !isInRange(envelope.release, 0.0f, MAX_ENVELOPE_SECONDS) ||
+        envelope.curve > EnvelopeCurve::Exponential)
+        return false;
+
+    const UnisonSettings& unison = settings.unison;
+    if (unison.voices < 1 || unison.voices > MAX_UNISON_VOICES ||
+        !isInRange(unison.detune, 0.0f, MAX_UNISON_DETUNE) || !isInRange(unison.spread, 0.0f, 1.0f))
+        return false;
+
+    // As Oscillators::setSyncMaster: not to itself, a synced oscillator, or noise.
+    // (Nor may anything follow this one if it's synced, which the same check catches
+    // from the other side.)
+    const OscillatorId master = settings.syncMaster;
+    if (master == NO_SYNC_MASTER)
+        return true;
+    return master < PRESET_OSCILLATORS && master != id &&
+           preset.oscillators[master].state != OscillatorState::Uninitialized &&
+           preset.oscillators[master].syncMaster == NO_SYNC_MASTER && !isNoise(preset.oscillators[master].type);
+}
+
+bool IsValidPreset(const PresetSnapshot& preset)
+{
+    if (std::memcmp(preset.magic, "AVPS", 4) != 0 || preset.version != PRESET_VERSION ||
+        preset.oscillatorCount != PRESET_OSCILLATORS || preset.size != sizeof(PresetSnapshot))
+        return false;
+
+    for (OscillatorId id = 0; id < PRESET_OSCILLATORS; ++id)
+    {
+        if (!isValidOscillator(preset, id))
+            return false;
+    }
+    return true;
+}
+
+#if defined(_WIN32)
+
+MappedPreset::~MappedPreset()
+{
+    if (m_snapshot != nullptr)
+        UnmapViewOfFile(m_snapshot);
+    if (m_mapping != nullptr)
+        CloseHandle(m_mapping);
+    if (m_file != nullptr && m_file != INVALID_HANDLE_VALUE)
+        CloseHandle(m_file);
+}
+
+std::unique_ptr<MappedPreset> MappedPreset::open(const std::string& path)
+{
+    RealtimeSanitizer::checkBlockingCall("MappedPreset::open");
+    std::unique_ptr<MappedPreset> preset(new MappedPreset());
+    preset->m_file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (preset->m_file == INVALID_HANDLE_VALUE)
+        return nullptr;
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(preset->m_file, &size) || size.QuadPart != LONGLONG(sizeof(PresetSnapshot)))
+        return nullptr;
+
+    preset->m_mapping = CreateFileMappingA(preset->m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (preset->m_mapping == nullptr)
+        return nullptr;
+
+    const void* view = MapViewOfFile(preset->m_mapping, FILE_MAP_READ, 0, 0, 0);
+    if (view == nullptr)
+        return nullptr;
+
+    preset->m_snapshot = static_cast<const PresetSnapshot*>(view);
+    if (!IsValidPreset(*preset->m_snapshot))
+        return nullptr;
+
+    return preset;
+}
+
+#else
+
+MappedPreset::~MappedPreset()
+{
+    if (m_snapshot != nullptr)
+        munmap(const_cast<PresetSnapshot*>(m_snapshot), sizeof(PresetSnapshot));
+}
+
+std::unique_ptr<MappedPreset> MappedPreset::open(const std::string& path)
+{
+    RealtimeSanitizer::checkBlockingCall("MappedPreset::open");
+    const int file = ::open(path.c_str(), O_RDONLY);
+    if (file < 0)
+        return nullptr;
+
+    struct stat info;
+    void* view = MAP_FAILED;
+    if (fstat(file, &info) == 0 && size_t(info.st_size) == sizeof(PresetSnapshot))
+        view = mmap(nullptr, sizeof(PresetSnapshot), PROT_READ, MAP_PRIVATE, file, 0);
+    close(file); // the mapping keeps the file open
+
+    if (view == MAP_FAILED)
+        return nullptr;
+
+    std::unique_ptr<MappedPreset> preset(new MappedPreset());
+    preset->m_snapshot = static_cast<const PresetSnapshot*>(view);
+    if (!IsValidPreset(*preset->m_snapshot))
+        return nullptr;
+
+    return preset;
+}
+
+#endif
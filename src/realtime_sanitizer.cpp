@@ -0,0 +1,359 @@
+#include "realtime_sanitizer.h"
+
+#if REALTIME_SANITIZER
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <crtdbg.h>
+#include <malloc.h>
+#elif __has_include(<execinfo.h>)
+#include <execinfo.h>
+#include <unistd.h>
+#define HAVE_EXECINFO 1
+#endif
+
+#if defined(__GLIBC__)
+#include <dlfcn.h>
+#include <pthread.h>
+#endif
+
+namespace RealtimeSanitizer
+{
+
+namespace
+{
+    struct Violation
+    {
+        const char*                          what{ nullptr };
+        std::array<void*, MAX_STACK_FRAMES>  frames{};
+        size_t                               frameCount{ 0 };
+        std::atomic<bool>                    recorded{ false };
+    };
+
+    std::array<Violation, MAX_RECORDED_VIOLATIONS> g_violations;
+    std::atomic<size_t> g_violation_count{ 0 };
+    std::atomic<Mode> g_mode{ Mode::Record };
+
+    // How many realtime scopes this thread is in.
+    thread_local int t_realtime_depth = 0;
+
+    // Set while the sanitizer itself allocates or reports, so it doesn't catch itself.
+    thread_local bool t_suspended = false;
+
+    struct Suspend
+    {
+        Suspend() : m_previous(t_suspended) { t_suspended = true; }
+        ~Suspend() { t_suspended = m_previous; }
+
+    private:
+        bool m_previous;
+    };
+
+    size_t captureStack(std::array<void*, MAX_STACK_FRAMES>& frames)
+    {
+#if defined(_WIN32)
+        return CaptureStackBackTrace(2, DWORD(frames.size()), frames.data(), nullptr);
+#elif HAVE_EXECINFO
+        return size_t(backtrace(frames.data(), int(frames.size())));
+#else
+        (void)frames;
+        return 0;
+#endif
+    }
+
+    void printStack(FILE* output, const void* const* frames, size_t frameCount)
+    {
+#if HAVE_EXECINFO
+        std::fflush(output);
+        backtrace_symbols_fd(const_cast<void* const*>(frames), int(frameCount), fileno(output));
+#else
+        for (size_t frame = 0; frame < frameCount; ++frame)
+            std::fprintf(output, "    %p\n", frames[frame]);
+#endif
+    }
+
+    // Nothing in here may allocate or lock; it runs on the realtime thread.
+    void violation(const char* what)
+    {
+        if (t_realtime_depth == 0 || t_suspended)
+            return;
+        Suspend suspend;
+
+        const size_t index = g_violation_count.fetch_add(1, std::memory_order_relaxed);
+        if (g_mode.load(std::memory_order_relaxed) == Mode::Abort)
+        {
+            std::array<void*, MAX_STACK_FRAMES> frames;
+            const size_t frameCount = captureStack(frames);
+            std::fprintf(stderr, "realtime violation: %s\n", what);
+            printStack(stderr, frames.data(), frameCount);
+            std::abort();
+        }
+
+        if (index < g_violations.size())
+        {
+            Violation& record = g_violations[index];
+            record.what = what;
+            record.frameCount = captureStack(record.frames);
+            record.recorded.store(true, std::memory_order_release);
+        }
+    }
+
+    void* allocate(size_t size, const char* what)
+    {
+        violation(what);
+        Suspend suspend;
+        return std::malloc(size == 0 ? 1 : size);
+    }
+
+    void deallocate(void* pointer, const char* what)
+    {
+        if (pointer == nullptr)
+            return;
+        violation(what);
+        Suspend suspend;
+        std::free(pointer);
+    }
+
+    void* allocateAligned(size_t size, std::align_val_t alignment, const char* what)
+    {
+        violation(what);
+        Suspend suspend;
+        const size_t align = size_t(alignment);
+#if defined(_WIN32)
+        return _aligned_malloc(size == 0 ? 1 : size, align);
+#else
+        return std::aligned_alloc(align, (size + align - 1) / align * align + (size == 0 ? align : 0));
+#endif
+    }
+
+    void deallocateAligned(void* pointer, const char* what)
+    {
+        if (pointer == nullptr)
+            return;
+        violation(what);
+        Suspend suspend;
+#if defined(_WIN32)
+        _aligned_free(pointer);
+#else
+        std::free(pointer);
+#endif
+    }
+
+#if defined(_WIN32) && defined(_DEBUG)
+    // The debug CRT reports every malloc, realloc, and free, which catches the
+    // allocations that don't go through operator new.
+    int allocationHook(int allocationType, void*, size_t, int blockType, long, const unsigned char*, int)
+    {
+        if (blockType == _CRT_BLOCK)
+            return TRUE;
+
+        switch (allocationType)
+        {
+        case _HOOK_ALLOC:   violation("malloc");  break;
+        case _HOOK_REALLOC: violation("realloc"); break;
+        case _HOOK_FREE:    violation("free");    break;
+        default:            break;
+        }
+        return TRUE;
+    }
+
+    [[maybe_unused]] const bool g_hook_installed = (_CrtSetAllocHook(allocationHook), true);
+#endif
+}
+
+void setMode(Mode mode)
+{
+    g_mode.store(mode);
+}
+
+ScopedRealtime::ScopedRealtime()
+{
+    ++t_realtime_depth;
+}
+
+ScopedRealtime::~ScopedRealtime()
+{
+    --t_realtime_depth;
+}
+
+void checkBlockingCall(const char* what)
+{
+    violation(what);
+}
+
+size_t getViolationCount()
+{
+    return g_violation_count.load();
+}
+
+void report(FILE* output)
+{
+    Suspend suspend;
+
+    const size_t count = getViolationCount();
+    std::fprintf(output, "%zu realtime violation(s)\n", count);
+    for (size_t index = 0; index < std::min(count, g_violations.size()); ++index)
+    {
+        const Violation& record = g_violations[index];
+        if (!record.recorded.load(std::memory_order_acquire))
+            continue;
+        std::fprintf(output, "#%zu %s\n", index, record.what);
+        printStack(output, record.frames.data(), record.frameCount);
+    }
+    std::fflush(output);
+}
+
+}
+
+// Replacing these catches every allocation made with new, including the ones
+// hidden inside std::function, std::vector, and friends.
+
+void* operator new(size_t size)
+{
+    if (void* pointer = RealtimeSanitizer::allocate(size, "operator new"))
+        return pointer;
+    throw std::bad_alloc();
+}
+
+void* operator new[](size_t size)
+{
+    if (void* pointer = RealtimeSanitizer::allocate(size, "operator new[]"))
+        return pointer;
+    throw std::bad_alloc();
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+    return RealtimeSanitizer::allocate(size, "operator new");
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept
+{
+    return RealtimeSanitizer::allocate(size, "operator new[]");
+}
+
+void* operator new(size_t size, std::align_val_t alignment)
+{
+    if (void* pointer = RealtimeSanitizer::allocateAligned(size, alignment, "operator new"))
+        return pointer;
+    throw std::bad_alloc();
+}
+
+void* operator new[](size_t size, std::align_val_t alignment)
+{
+    if (void* pointer = RealtimeSanitizer::allocateAligned(size, alignment, "operator new[]"))
+        return pointer;
+    throw std::bad_alloc();
+}
+
+void* operator new(size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+    return RealtimeSanitizer::allocateAligned(size, alignment, "operator new");
+}
+
+void* operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+    return RealtimeSanitizer::allocateAligned(size, alignment, "operator new[]");
+}
+
+void operator delete(void* pointer) noexcept                                  { RealtimeSanitizer::deallocate(pointer, "operator delete"); }
+void operator delete[](void* pointer) noexcept                                { RealtimeSanitizer::deallocate(pointer, "operator delete[]"); }
+void operator delete(void* pointer, size_t) noexcept                          { RealtimeSanitizer::deallocate(pointer, "operator delete"); }
+void operator delete[](void* pointer, size_t) noexcept                        { RealtimeSanitizer::deallocate(pointer, "operator delete[]"); }
+void operator delete(void* pointer, const std::nothrow_t&) noexcept           { RealtimeSanitizer::deallocate(pointer, "operator delete"); }
+void operator delete[](void* pointer, const std::nothrow_t&) noexcept         { RealtimeSanitizer::deallocate(pointer, "operator delete[]"); }
+
+void operator delete(void* pointer, std::align_val_t) noexcept                { RealtimeSanitizer::deallocateAligned(pointer, "operator delete"); }
+void operator delete[](void* pointer, std::align_val_t) noexcept              { RealtimeSanitizer::deallocateAligned(pointer, "operator delete[]"); }
+void operator delete(void* pointer, size_t, std::align_val_t) noexcept        { RealtimeSanitizer::deallocateAligned(pointer, "operator delete"); }
+void operator delete[](void* pointer, size_t, std::align_val_t) noexcept      { RealtimeSanitizer::deallocateAligned(pointer, "operator delete[]"); }
+void operator delete(void* pointer, std::align_val_t, const std::nothrow_t&) noexcept   { RealtimeSanitizer::deallocateAligned(pointer, "operator delete"); }
+void operator delete[](void* pointer, std::align_val_t, const std::nothrow_t&) noexcept { RealtimeSanitizer::deallocateAligned(pointer, "operator delete[]"); }
+
+#if defined(__GLIBC__)
+// With glibc, the C allocator and the pthread calls behind std::mutex and
+// std::condition_variable are replaced too, so the render checks catch them on the
+// audio threads as well. Allocation forwards to glibc's own entry points; the
+// pthread calls are looked up in the next library along, once, without a lock.
+
+extern "C" void* __libc_malloc(size_t size);
+extern "C" void* __libc_calloc(size_t count, size_t size);
+extern "C" void* __libc_realloc(void* pointer, size_t size);
+extern "C" void  __libc_free(void* pointer);
+
+namespace RealtimeSanitizer
+{
+namespace
+{
+    template<class Function>
+    Function* findNext(std::atomic<void*>& cache, const char* name, const char* version = nullptr)
+    {
+        void* function = cache.load(std::memory_order_relaxed);
+        if (function == nullptr)
+        {
+            Suspend suspend;
+            // Some functions have an older version too; ask for the one new code links to.
+            if (version != nullptr)
+                function = dlvsym(RTLD_NEXT, name, version);
+            if (function == nullptr)
+                function = dlsym(RTLD_NEXT, name);
+            cache.store(function, std::memory_order_relaxed);
+        }
+        return reinterpret_cast<Function*>(function);
+    }
+}
+}
+
+extern "C"
+{
+
+void* malloc(size_t size) noexcept
+{
+    RealtimeSanitizer::violation("malloc");
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t count, size_t size) noexcept
+{
+    RealtimeSanitizer::violation("calloc");
+    return __libc_calloc(count, size);
+}
+
+void* realloc(void* pointer, size_t size) noexcept
+{
+    RealtimeSanitizer::violation("realloc");
+    return __libc_realloc(pointer, size);
+}
+
+void free(void* pointer) noexcept
+{
+    if (pointer != nullptr)
+        RealtimeSanitizer::violation("free");
+    __libc_free(pointer);
+}
+
+int pthread_mutex_lock(pthread_mutex_t* mutex) noexcept
+{
+    RealtimeSanitizer::violation("pthread_mutex_lock");
+    static std::atomic<void*> next{ nullptr };
+    return RealtimeSanitizer::findNext<int(pthread_mutex_t*)>(next, "pthread_mutex_lock")(mutex);
+}
+
+int pthread_cond_wait(pthread_cond_t* condition, pthread_mutex_t* mutex)
+{
+    RealtimeSanitizer::violation("pthread_cond_wait");
+    static std::atomic<void*> next{ nullptr };
+    return RealtimeSanitizer::findNext<int(pthread_cond_t*, pthread_mutex_t*)>(next, "pthread_cond_wait", "GLIBC_2.3.2")(condition, mutex);
+}
+
+}
+#endif
+
+#endif
@@ -0,0 +1,513 @@
+#include "render_check.h"
+
+#include "constants.h"
+#include "fft.h"
+#include "generator_mixer.h"
+#include "realtime_sanitizer.h"
+#include "thread_communication.h"
+#include "AudioFile.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <sstream>
+#include <unordered_map>
+
+namespace RenderCheck
+{
+
+namespace
+{
+    constexpr size_t SPECTRAL_FRAME_SIZE = 2048;
+    constexpr double SPECTRAL_FLOOR_DB = -120.0;
+    // Bins this far below the frame's loudest bin, in both renders, don't count; down
+    // there, differences far below the sample tolerances would swing the distance.
+    constexpr double SPECTRAL_RANGE_DB = 60.0;
+
+    // One scripted request: when it's due, and how to push it.
+    struct ScriptEvent
+    {
+        uint64_t frame{ 0 };
+        std::function<bool(RequestId, uint64_t)> push;
+    };
+
+    struct Script
+    {
+        uint64_t length{ 0 };
+        std::vector<ScriptEvent> events;
+    };
+
+    std::optional<OscillatorType> parseType(const std::string& name)
+    {
+        static const std::unordered_map<std::string, OscillatorType> types{
+            { "sine", OscillatorType::Sine },
+            { "square", OscillatorType::Square },
+            { "triangle", OscillatorType::Triangle },
+            { "saw", OscillatorType::Saw },
+            { "white", OscillatorType::WhiteNoise },
+            { "pink", OscillatorType::PinkNoise },
+            { "brown", OscillatorType::BrownNoise } };
+        const auto type = types.find(name);
+        return type == types.end() ? std::nullopt : std::optional(type->second);
+    }
+
+    std::optional<LfoShape> parseShape(const std::string& name)
+    {
+        static const std::unordered_map<std::string, LfoShape> shapes{
+            { "sine", LfoShape::Sine },
+            { "triangle", LfoShape::Triangle },
+            { "square", LfoShape::Square },
+            { "saw", LfoShape::Saw } };
+        const auto shape = shapes.find(name);
+        return shape == shapes.end() ? std::nullopt : std::optional(shape->second);
+    }
+
+    std::optional<ModulationDestination> parseDestination(const std::string& name)
+    {
+        static const std::unordered_map<std::string, ModulationDestination> destinations{
+            { "volume", ModulationDestination::Volume },
+            { "pan", ModulationDestination::Pan },
+            { "frequency", ModulationDestination::Frequency },
+            { "wavetable", ModulationDestination::Wavetable } };
+        const auto destination = destinations.find(name);
+        return destination == destinations.end() ? std::nullopt : std::optional(destination->second);
+    }
+
+    std::optional<SaturationCurve> parseCurve(const std::string& name)
+    {
+        static const std::unordered_map<std::string, SaturationCurve> curves{
+            { "hardclip", SaturationCurve::HardClip },
+            { "tanh", SaturationCurve::Tanh },
+            { "softknee", SaturationCurve::SoftKnee },
+            { "asymmetric", SaturationCurve::Asymmetric } };
+        const auto curve = curves.find(name);
+        return curve == curves.end() ? std::nullopt : std::optional(curve->second);
+    }
+
+    // Parse the arguments of one command into a push onto generator 0's request queue.
+    std::optional<std::function<bool(RequestId, uint64_t)>> parseCommand(const std::string& command, std::istringstream& arguments)
+    {
+        using namespace EventBuilder;
+        if (command == "add")
+        {
+            std::string typeName;
+            frequency_t frequency;
+            volume_t volume;
+            if (!(arguments >> typeName >> frequency >> volume) || !parseType(typeName))
+                return std::nullopt;
+            const OscillatorSettings settings(*parseType(typeName), frequency, volume);
+            return [=](RequestId id, uint64_t at) { return PushAddOscillatorEvent(0, id, settings, at); };
+        }
+        if (command == "saturate")
+        {
+            std::string curveName;
+            unsigned oversampling;
+            SaturationSettings saturation;
+            if (!(arguments >> curveName >> oversampling >> saturation.drive) || !parseCurve(curveName) || oversampling > UINT8_MAX)
+                return std::nullopt;
+            saturation.curve = *parseCurve(curveName);
+            saturation.oversampling = uint8_t(oversampling);
+            return [=](RequestId id, uint64_t at) { return PushSetSaturationEvent(0, id, saturation, at); };
+        }
+
+        unsigned oscillator;
+        if (!(arguments >> oscillator) || oscillator > UINT8_MAX)
+            return std::nullopt;
+        const OscillatorId target = OscillatorId(oscillator);
+
+        if (command == "remove")
+            return [=](RequestId id, uint64_t at) { return PushRemoveOscillatorEvent(0, id, target, at); };
+        if (command == "deactivate")
+            return [=](RequestId id, uint64_t at) { return PushDeactivateOscillatorEvent(0, id, target, at); };
+
+        if (command == "activate" || command == "volume" || command == "frequency" || command == "pan" || command == "morph")
+        {
+            float value;
+            if (!(arguments >> value))
+                return std::nullopt;
+            if (command == "activate")
+                return [=](RequestId id, uint64_t at) { return PushActivateOscillatorEvent(0, id, target, value, at); };
+            if (command == "volume")
+                return [=](RequestId id, uint64_t at) { return PushSetOscillatorVolumeEvent(0, id, target, value, at); };
+            if (command == "frequency")
+                return [=](RequestId id, uint64_t at) { return PushSetOscillatorFrequencyEvent(0, id, target, value, at); };
+            if (command == "morph")
+                return [=](RequestId id, uint64_t at) { return PushSetOscillatorWavetablePositionEvent(0, id, target, value, at); };
+            return [=](RequestId id, uint64_t at) { return PushSetOscillatorPanEvent(0, id, target, value, at); };
+        }
+        if (command == "type")
+        {
+            std::string typeName;
+            if (!(arguments >> typeName) || !parseType(typeName))
+                return std::nullopt;
+            const OscillatorType type = *parseType(typeName);
+            return [=](RequestId id, uint64_t at) { return PushSetOscillatorTypeEvent(0, id, target, type, at); };
+        }
+        if (command == "envelope")
+        {
+            EnvelopeSettings envelope;
+            if (!(arguments >> envelope.attack >> envelope.decay >> envelope.sustain >> envelope.release))
+                return std::nullopt;
+            return [=](RequestId id, uint64_t at) { return PushSetOscillatorEnvelopeEvent(0, id, target, envelope, at); };
+        }
+        if (command == "unison")
+        {
+            unsigned voices;
+            UnisonSettings unison;
+            if (!(arguments >> voices >> unison.detune >> unison.spread))
+                return std::nullopt;
+            unison.voices = uint8_t(std::min(voices, unsigned(MAX_UNISON_VOICES)));
+            return [=](RequestId id, uint64_t at) { return PushSetOscillatorUnisonEvent(0, id, target, unison, at); };
+        }
+        if (command == "sync")
+        {
+            // A master of -1 turns sync off.
+            int master;
+            if (!(arguments >> master) || master > int(UINT8_MAX))
+                return std::nullopt;
+            const OscillatorId syncMaster = master < 0 ? NO_SYNC_MASTER : OscillatorId(master);
+            return [=](RequestId id, uint64_t at) { return PushSetOscillatorSyncEvent(0, id, target, syncMaster, at); };
+        }
+        if (command == "blocksize")
+        {
+            // The "oscillator" argument is the block size here.
+            const size_t blockSize = oscillator;
+            return [=](RequestId id, uint64_t at) { return PushSetControlBlockSizeEvent(0, id, blockSize, at); };
+        }
+
+        // For the rest, it's the index of the LFO, route or group.
+        const size_t index = oscillator;
+        if (command == "lfo")
+        {
+            std::string shapeName;
+            LfoSettings lfo;
+            if (!(arguments >> shapeName >> lfo.rate) || !parseShape(shapeName))
+                return std::nullopt;
+            lfo.shape = *parseShape(shapeName);
+            return [=](RequestId id, uint64_t at) { return PushSetLfoEvent(0, id, index, lfo, at); };
+        }
+        if (command == "route")
+        {
+            unsigned lfo;
+            unsigned routed;
+            std::string destinationName;
+            ModulationRoute route;
+            if (!(arguments >> lfo >> routed >> destinationName >> route.depth) || !parseDestination(destinationName) ||
+                lfo > UINT8_MAX || routed > UINT8_MAX)
+                return std::nullopt;
+            route.enabled = true;
+            route.lfo = uint8_t(lfo);
+            route.oscillator = OscillatorId(routed);
+            route.destination = *parseDestination(destinationName);
+            return [=](RequestId id, uint64_t at) { return PushSetModulationRouteEvent(0, id, index, route, at); };
+        }
+        if (command == "fm")
+        {
+            unsigned algorithm;
+            FmGroupSettings group;
+            if (!(arguments >> algorithm >> group.depth >> group.feedback) || algorithm > UINT8_MAX)
+                return std::nullopt;
+            for (auto& op : group.operators)
+            {
+                // -1 leaves the operator slot empty.
+                int operatorId;
+                if (!(arguments >> operatorId) || operatorId > int(UINT8_MAX))
+                    return std::nullopt;
+                if (operatorId >= 0)
+                    op = OscillatorId(operatorId);
+            }
+            group.enabled = true;
+            group.algorithm = uint8_t(algorithm);
+            return [=](RequestId id, uint64_t at) { return PushSetFmGroupEvent(0, id, index, group, at); };
+        }
+        return std::nullopt;
+    }
+
+    std::optional<Script> parseScript(const std::string& path, std::string& error)
+    {
+        std::ifstream file(path);
+        if (!file)
+        {
+            error = "can't open " + path;
+            return std::nullopt;
+        }
+
+        Script script;
+        std::string line;
+        for (size_t lineNumber = 1; std::getline(file, line); ++lineNumber)
+        {
+            line = line.substr(0, line.find('#'));
+            std::istringstream words(line);
+            std::string keyword;
+            if (!(words >> keyword))
+                continue;
+
+            bool parsed = false;
+            if (keyword == "length")
+            {
+                parsed = bool(words >> script.length);
+            }
+            else if (keyword == "at")
+            {
+                ScriptEvent event;
+                std::string command;
+                if (words >> event.frame >> command)
+                {
+                    auto push = parseCommand(command, words);
+                    if (push.has_value())
+                    {
+                        event.push = std::move(*push);
+                        script.events.push_back(std::move(event));
+                        parsed = true;
+                    }
+                }
+            }
+
+            if (!parsed)
+            {
+                error = path + ":" + std::to_string(lineNumber) + ": can't parse \"" + line + "\"";
+                return std::nullopt;
+            }
+        }
+
+        if (script.length == 0)
+        {
+            error = path + ": no length given";
+            return std::nullopt;
+        }
+
+        // Requests must be queued in time order; the queue holds back everything behind a future one.
+        std::stable_sort(script.events.begin(), script.events.end(),
+                         [](ScriptEvent const& a, ScriptEvent const& b) { return a.frame < b.frame; });
+        return script;
+    }
+
+    // Hann-windowed magnitudes in dB, one channel of an interleaved render.
+    void spectrum(RealFft& fft, const float* interleaved, size_t channel, std::vector<float>& windowed,
+                  std::vector<float>& real, std::vector<float>& imaginary, std::vector<double>& levels)
+    {
+        for (size_t index = 0; index < SPECTRAL_FRAME_SIZE; ++index)
+        {
+            const double window = 0.5 - 0.5 * std::cos(TWO_PI * double(index) / double(SPECTRAL_FRAME_SIZE));
+            windowed[index] = float(interleaved[index * 2 + channel] * window);
+        }
+        fft.forward(windowed, real, imaginary);
+        for (size_t bin = 0; bin < levels.size(); ++bin)
+        {
+            const double power = double(real[bin]) * real[bin] + double(imaginary[bin]) * imaginary[bin];
+            levels[bin] = std::max(10.0 * std::log10(power + 1e-30), SPECTRAL_FLOOR_DB);
+        }
+    }
+}
+
+std::optional<Render> RenderScript(const std::string& scriptPath, std::string& error)
+{
+    auto script = parseScript(scriptPath, error);
+    if (!script.has_value())
+        return std::nullopt;
+
+    auto& generator = GeneratorAccess::getInstance(0);
+    if (generator.getSampleTime() != 0)
+    {
+        error = "the generator has already rendered; checks need a fresh one";
+        return std::nullopt;
+    }
+
+    Render render(size_t(script->length) * 2);
+    RequestId nextRequestId = 0;
+    size_t nextEvent = 0;
+    for (uint64_t frame = 0; frame < script->length; frame += CHECK_BUFFER_FRAMES)
+    {
+        const size_t frames = size_t(std::min<uint64_t>(CHECK_BUFFER_FRAMES, script->length - frame));
+
+        // Queue what's due in this buffer; the generator applies each at its exact frame.
+        for (; nextEvent < script->events.size() && script->events[nextEvent].frame < frame + frames; ++nextEvent)
+        {
+            if (!script->events[nextEvent].push(nextRequestId++, script->events[nextEvent].frame))
+            {
+                error = "too many requests at frame " + std::to_string(script->events[nextEvent].frame) + " for the request queue";
+                return std::nullopt;
+            }
+        }
+
+        {
+            RealtimeSanitizer::ScopedRealtime realtime;
+            GeneratorMixer::getInstance().writeSamples(std::span<float>(render).subspan(size_t(frame) * 2, frames * 2));
+        }
+
+        // Nobody's watching the responses, but they still have to be taken off the queue.
+        Events::ModifyGenerator::Response response;
+        while (ThreadCommunication::getModifyGeneratorResponseQueue(0).pop(response)) { }
+        (void)ThreadCommunication::processDeferredActions();
+    }
+    return render;
+}
+
+bool SaveGolden(const Render& render, const std::string& path)
+{
+    AudioFile<float>::AudioBuffer buffer(2);
+    buffer[0].reserve(render.size() / 2);
+    buffer[1].reserve(render.size() / 2);
+    for (size_t index = 0; index < render.size(); index += 2)
+    {
+        buffer[0].push_back(render[index]);
+        buffer[1].push_back(render[index + 1]);
+    }
+
+    AudioFile<float> audioFile;
+    audioFile.setNumChannels(2);
+    audioFile.setSampleRate(SAMPLE_RATE);
+    audioFile.setBitDepth(32); // float, so the golden is exact
+    audioFile.setAudioBuffer(buffer);
+    return audioFile.save(path);
+}
+
+std::optional<Render> LoadGolden(const std::string& path)
+{
+    AudioFile<float> audioFile;
+    if (!audioFile.load(path) || audioFile.getNumChannels() != 2 || audioFile.getSampleRate() != SAMPLE_RATE)
+        return std::nullopt;
+
+    Render render;
+    render.reserve(size_t(audioFile.getNumSamplesPerChannel()) * 2);
+    for (int frame = 0; frame < audioFile.getNumSamplesPerChannel(); ++frame)
+    {
+        render.push_back(audioFile.samples[0][size_t(frame)]);
+        render.push_back(audioFile.samples[1][size_t(frame)]);
+    }
+    return render;
+}
+
+Comparison Compare(const Render& render, const Render& golden)
+{
+    Comparison comparison;
+    comparison.lengthMatches = render.size() == golden.size();
+
+    const size_t samples = std::min(render.size(), golden.size());
+    double squaredError = 0.0;
+    for (size_t index = 0; index < samples; ++index)
+    {
+        const double error = std::abs(double(render[index]) - double(golden[index]));
+        comparison.maxError = std::max(comparison.maxError, error);
+        squaredError += error * error;
+    }
+    comparison.rmsError = samples > 0 ? std::sqrt(squaredError / double(samples)) : 0.0;
+
+    // Log-spectral distance over consecutive frames of each channel, counting only the
+    // bins that matter to the sound. The worst frame is reported.
+    RealFft fft(SPECTRAL_FRAME_SIZE);
+    std::vector<float> windowed(SPECTRAL_FRAME_SIZE), real(SPECTRAL_FRAME_SIZE / 2 + 1), imaginary(SPECTRAL_FRAME_SIZE / 2 + 1);
+    std::vector<double> renderLevels(SPECTRAL_FRAME_SIZE / 2 + 1), goldenLevels(SPECTRAL_FRAME_SIZE / 2 + 1);
+    for (size_t start = 0; (start + SPECTRAL_FRAME_SIZE) * 2 <= samples; start += SPECTRAL_FRAME_SIZE)
+    {
+        for (size_t channel = 0; channel < 2; ++channel)
+        {
+            spectrum(fft, render.data() + start * 2, channel, windowed, real, imaginary, renderLevels);
+            spectrum(fft, golden.data() + start * 2, channel, windowed, real, imaginary, goldenLevels);
+
+            const double threshold = std::max(*std::max_element(renderLevels.begin(), renderLevels.end()),
+                                              *std::max_element(goldenLevels.begin(), goldenLevels.end())) - SPECTRAL_RANGE_DB;
+            double squaredDifference = 0.0;
+            size_t counted = 0;
+            for (size_t bin = 0; bin < renderLevels.size(); ++bin)
+            {
+                if (std::max(renderLevels[bin], goldenLevels[bin]) < threshold)
+                    continue;
+                const double difference = renderLevels[bin] - goldenLevels[bin];
+                squaredDifference += difference * difference;
+                ++counted;
+            }
+            if (counted > 0)
+                comparison.spectralError = std::max(comparison.spectralError, std::sqrt(squaredDifference / double(counted)));
+        }
+    }
+    return comparison;
+}
+
+int Run(const std::string& scriptPath, const std::string& goldenPath, bool updateGolden, KernelVariant kernels)
+{
+    WaveTables::Initialize();
+    Kernels::setVariant(kernels);
+
+    std::string error;
+    const auto render = RenderScript(scriptPath, error);
+    if (!render.has_value())
+    {
+        std::printf("ERROR %s\n", error.c_str());
+        return 2;
+    }
+
+    // With the sanitizer built in, a render that allocates or blocks fails whatever it sounds like.
+    if (RealtimeSanitizer::getViolationCount() > 0)
+    {
+        std::printf("FAIL %s: the render isn't realtime safe\n", scriptPath.c_str());
+        RealtimeSanitizer::report(stdout);
+        return 1;
+    }
+
+    if (updateGolden)
+    {
+        const bool saved = SaveGolden(*render, goldenPath);
+        std::printf("%s %s (%s)\n", saved ? "SAVED" : "ERROR can't write", goldenPath.c_str(), Kernels::getName(kernels));
+        return saved ? 0 : 2;
+    }
+
+    const auto golden = LoadGolden(goldenPath);
+    if (!golden.has_value())
+    {
+        std::printf("ERROR can't load golden %s\n", goldenPath.c_str());
+        return 2;
+    }
+
+    const Comparison comparison = Compare(*render, *golden);
+    std::printf("%s %s (%s): max error %.3g, rms error %.3g, spectral difference %.3f dB%s\n",
+                comparison.passed() ? "PASS" : "FAIL", scriptPath.c_str(), Kernels::getName(kernels),
+                comparison.maxError, comparison.rmsError, comparison.spectralError,
+                comparison.lengthMatches ? "" : ", length differs");
+    return comparison.passed() ? 0 : 1;
+}
+
+int RunCommandLine(const std::vector<std::string>& arguments)
+{
+    bool updateGolden = false;
+    std::optional<KernelVariant> kernels;
+    std::vector<std::string> paths;
+    for (size_t index = 0; index < arguments.size(); ++index)
+    {
+        if (arguments[index] == "--update")
+        {
+            updateGolden = true;
+        }
+        else if (arguments[index] == "--abort-on-violation")
+        {
+            // Stop at the first one, with its stack, rather than after the render.
+            RealtimeSanitizer::setMode(RealtimeSanitizer::Mode::Abort);
+        }
+        else if (arguments[index] == "--kernels")
+        {
+            kernels = index + 1 < arguments.size() ? Kernels::parseVariant(arguments[++index]) : std::nullopt;
+            if (!kernels.has_value())
+            {
+                std::printf("ERROR --kernels takes sse or scalar\n");
+                return 2;
+            }
+        }
+        else
+        {
+            paths.push_back(arguments[index]);
+        }
+    }
+
+    if (paths.size() != 2)
+    {
+        std::printf("usage: render_check [--update] [--kernels sse|scalar] [--abort-on-violation] script.txt golden.wav\n");
+        return 2;
+    }
+
+    // Goldens come from the reference; checks run what ships.
+    return Run(paths[0], paths[1], updateGolden, kernels.value_or(updateGolden ? KernelVariant::Scalar : KernelVariant::Sse));
+}
+
+}
@@ -0,0 +1,238 @@
+#include "resampler.h"
+
+#include <cassert>
+#include <immintrin.h>
+
+namespace
+{
+    struct QualityDesign
+    {
+        size_t taps;
+        size_t phases; // branches in the bank; fractions between them are interpolated
+        double beta;   // Kaiser window
+        double cutoff; // of the input Nyquist frequency (or the output's, if lower)
+    };
+
+    // Indexed by ResamplerQuality. At 44.1 kHz the cutoffs put each filter's passband
+    // edge where its quality's comment says, and the stopband where the first image starts.
+    constexpr std::array<QualityDesign, size_t(ResamplerQuality::Count)> QUALITY_DESIGNS = { {
+        { 16, 64, 5.0, 0.88 },
+        { 32, 256, 8.0, 0.92 },
+        { 64, 512, 9.0, 0.96 },
+    } };
+
+    double BesselI0(double x)
+    {
+        double sum = 1.0;
+        double term = 1.0;
+        for (int k = 1; k < 32; ++k)
+        {
+            term *= (x / (2.0 * k)) * (x / (2.0 * k));
+            sum += term;
+        }
+        return sum;
+    }
+
+    float HorizontalSum(__m128 sum)
+    {
+        sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+        sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+        return _mm_cvtss_f32(sum);
+    }
+}
+
+PolyphaseResampler::PolyphaseResampler(ResamplerQuality quality, double inputRate, double outputRate, size_t maxOutputFrames)
+    : m_quality(quality)
+    , m_taps(QUALITY_DESIGNS[size_t(quality)].taps)
+    , m_phases(QUALITY_DESIGNS[size_t(quality)].phases)
+    , m_max_output_frames(maxOutputFrames)
+    , m_coefficients((m_phases + 1) * m_taps)
+    , m_nominal_step(inputRate / outputRate)
+{
+    assert(m_taps % 4 == 0);
+
+    // Tap k of the branch for fraction f reads the input k - (taps / 2 - 1) frames from
+    // the output's whole position, so it's that minus f away from the output itself.
+    const QualityDesign& design = QUALITY_DESIGNS[size_t(quality)];
+    const double cutoff = design.cutoff * std::min(1.0, outputRate / inputRate);
+    const double halfWidth = double(m_taps / 2);
+    for (size_t phase = 0; phase <= m_phases; ++phase)
+    {
+        const double fraction = double(phase) / double(m_phases);
+        float* const branch = m_coefficients.data() + phase * m_taps;
+        double sum = 0.0;
+        for (size_t tap = 0; tap < m_taps; ++tap)
+        {
+            const double distance = double(tap) - (halfWidth - 1.0) - fraction;
+            const double x = distance / halfWidth;
+            const double window = std::abs(x) <= 1.0 ? BesselI0(design.beta * std::sqrt(1.0 - x * x)) / BesselI0(design.beta) : 0.0;
+            const double argument = PI * cutoff * distance;
+            const double sinc = argument == 0.0 ? 1.0 : std::sin(argument) / argument;
+            branch[tap] = float(cutoff * sinc * window);
+            sum += branch[tap];
+        }
+
+        // Every branch passes DC at exactly unity, so the fraction doesn't ripple the level.
+        for (size_t tap = 0; tap < m_taps; ++tap)
+            branch[tap] = float(branch[tap] / sum);
+    }
+
+    // Enough room for the most input a piece can take, at the fastest correction.
+    const size_t maxInputFrames = size_t(std::ceil(m_nominal_step * (1.0 + MAX_CORRECTION) * double(maxOutputFrames))) + m_taps + 2;
+    for (auto& channel : m_input)
+        channel.resize(maxInputFrames + m_taps);
+    m_pulled.resize(maxInputFrames * 2);
+
+    // Start on silence, with the first output frame half the filter into it.
+    m_available = m_taps / 2;
+    m_position = double(m_taps / 2 - 1);
+}
+
+size_t PolyphaseResampler::prepare(size_t count)
+{
+    m_step = m_nominal_step * m_correction;
+    m_step_change = (m_nominal_step * m_target_correction - m_step) / double(count);
+
+    // Step to the last output frame the same way render will, and find the newest
+    // input frame its filter reaches.
+    double position = m_position;
+    double step = m_step;
+    for (size_t frame = 1; frame < count; ++frame)
+    {
+        position += step;
+        step += m_step_change;
+    }
+    const size_t newest = size_t(position) + m_taps / 2;
+    return newest + 1 > m_available ? newest + 1 - m_available : 0;
+}
+
+void PolyphaseResampler::render(std::span<float> output, size_t pulled)
+{
+    float* const left = m_input[0].data();
+    float* const right = m_input[1].data();
+    for (size_t frame = 0; frame < pulled; ++frame)
+    {
+        left[m_available + frame] = m_pulled[frame * 2];
+        right[m_available + frame] = m_pulled[frame * 2 + 1];
+    }
+    m_available += pulled;
+
+    const size_t frames = output.size() / 2;
+    const size_t reach = m_taps / 2 - 1; // taps before the output's whole position
+    const float* const coefficients = m_coefficients.data();
+    double position = m_position;
+    double step = m_step;
+    for (size_t frame = 0; frame < frames; ++frame)
+    {
+        const size_t whole = size_t(position);
+        const double phase = (position - double(whole)) * double(m_phases);
+        const size_t branch = size_t(phase);
+        const __m128 blend = _mm_set1_ps(float(phase - double(branch)));
+
+        const float* const first = coefficients + branch * m_taps;
+        const float* const second = first + m_taps;
+        const float* const leftInput = left + whole - reach;
+        const float* const rightInput = right + whole - reach;
+        __m128 leftSum = _mm_setzero_ps();
+        __m128 rightSum = _mm_setzero_ps();
+        for (size_t tap = 0; tap < m_taps; tap += 4)
+        {
+            const __m128 a = _mm_loadu_ps(first + tap);
+            const __m128 coefficient = _mm_add_ps(a, _mm_mul_ps(blend, _mm_sub_ps(_mm_loadu_ps(second + tap), a)));
+            leftSum = _mm_add_ps(leftSum, _mm_mul_ps(coefficient, _mm_loadu_ps(leftInput + tap)));
+            rightSum = _mm_add_ps(rightSum, _mm_mul_ps(coefficient, _mm_loadu_ps(rightInput + tap)));
+        }
+        output[frame * 2] = HorizontalSum(leftSum);
+        output[frame * 2 + 1] = HorizontalSum(rightSum);
+
+        position += step;
+        step += m_step_change;
+    }
+    m_correction = m_target_correction;
+
+    // Drop the input no output frame still to come can reach.
+    const size_t consumed = size_t(position) - reach;
+    std::copy(left + consumed, left + m_available, left);
+    std::copy(right + consumed, right + m_available, right);
+    m_available -= consumed;
+    m_position = position - double(consumed);
+}
+
+OutputResampler& OutputResampler::getInstance()
+{
+    static OutputResampler resampler;
+    return resampler;
+}
+
+OutputResampler::~OutputResampler()
+{
+    delete m_pending.exchange(nullptr);
+    delete m_retired.exchange(nullptr);
+    delete m_current;
+}
+
+void OutputResampler::configure(double outputRate, ResamplerSettings const& settings)
+{
+    m_output_rate = outputRate;
+    m_settings = settings;
+
+    auto converter = std::make_unique<Converter>();
+    converter->outputRate = outputRate;
+    converter->driftCompensation = settings.driftCompensation;
+    if (outputRate != double(SAMPLE_RATE) || settings.driftCompensation)
+        converter->resampler = std::make_unique<PolyphaseResampler>(settings.quality, SAMPLE_RATE, outputRate, MAX_OUTPUT_FRAMES);
+
+    // A converter the audio thread never picked up is still ours to free.
+    delete m_pending.exchange(converter.release(), std::memory_order_acq_rel);
+}
+
+void OutputResampler::update()
+{
+    delete m_retired.exchange(nullptr, std::memory_order_acq_rel);
+}
+
+void OutputResampler::pickUpPending()
+{
+    // Swap between buffers, once the UI has collected the last converter swapped out.
+    // The new one starts from silence, so a change of quality glitches briefly.
+    if (m_retired.load(std::memory_order_acquire) != nullptr || m_pending.load(std::memory_order_relaxed) == nullptr)
+        return;
+
+    m_retired.store(m_current, std::memory_order_release);
+    m_current = m_pending.exchange(nullptr, std::memory_order_acq_rel);
+    m_clock_started = false;
+    m_measured_rate.store(0.0, std::memory_order_relaxed);
+    m_delay_seconds.store(m_current->resampler ? m_current->resampler->getDelay() / SAMPLE_RATE : 0.0, std::memory_order_relaxed);
+}
+
+void OutputResampler::trackDeviceRate(double dacTime, size_t frames)
+{
+    // Some host APIs don't report it; then there's nothing to measure.
+    if (dacTime <= 0.0)
+        return;
+
+    // A buffer that doesn't follow on from the last one means frames went missing (an
+    // underflow, or a switch to a new stream), so the count is off; start it again.
+    const double nominal = m_current->outputRate;
+    const double expected = m_last_dac_time + double(m_last_frames) / nominal;
+    const bool continues = m_clock_started && std::abs(dacTime - expected) <= DISCONTINUITY_SECONDS;
+    m_last_dac_time = dacTime;
+    m_last_frames = frames;
+    if (!continues)
+    {
+        m_clock_start = dacTime;
+        m_clock_frames = frames;
+        m_clock_started = true;
+        return;
+    }
+
+    // The longer the measurement, the less the jitter in the timestamps matters.
+    const double elapsed = dacTime - m_clock_start;
+    if (elapsed >= MIN_MEASUREMENT_SECONDS)
+    {
+        const double measured = double(m_clock_frames) / elapsed;
+        m_measured_rate.store(measured, std::memory_order_relaxed);
+        m_current->resampler->setCorrection(nominal / measured);
+    }
+    m_clock_frames += frames;
+}
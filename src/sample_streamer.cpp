@@ -0,0 +1,253 @@
+#include "sample_streamer.h"
+
+#include "realtime_sanitizer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+namespace
+{
+    // The reader wakes at least this often, and otherwise whenever a stream is prepared.
+    constexpr auto READER_INTERVAL = std::chrono::milliseconds(5);
+
+    // Read from disk in runs of this many frames.
+    constexpr size_t READ_CHUNK_FRAMES = 4096;
+
+    constexpr uint16_t WAVE_FORMAT_PCM = 0x0001;
+    constexpr uint16_t WAVE_FORMAT_IEEE_FLOAT = 0x0003;
+    constexpr uint16_t WAVE_FORMAT_EXTENSIBLE = 0xFFFE;
+
+    uint16_t readUint16(const uint8_t* bytes) { return uint16_t(bytes[0] | (bytes[1] << 8)); }
+    uint32_t readUint32(const uint8_t* bytes) { return uint32_t(bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | (uint32_t(bytes[3]) << 24)); }
+
+    // Walk the RIFF chunks for the format and the start of the data. AudioFile can
+    // only load a whole file at once, which is exactly what streaming avoids.
+    bool readWavHeader(std::ifstream& stream, SampleFile& file)
+    {
+        uint8_t riff[12];
+        if (!stream.read(reinterpret_cast<char*>(riff), sizeof(riff)) ||
+            std::memcmp(riff, "RIFF", 4) != 0 || std::memcmp(riff + 8, "WAVE", 4) != 0)
+            return false;
+
+        bool foundFormat = false;
+        uint8_t chunkHeader[8];
+        while (stream.read(reinterpret_cast<char*>(chunkHeader), sizeof(chunkHeader)))
+        {
+            const uint32_t chunkSize = readUint32(chunkHeader + 4);
+            if (std::memcmp(chunkHeader, "fmt ", 4) == 0)
+            {
+                uint8_t format[40]{};
+                const size_t formatSize = std::min<size_t>(chunkSize, sizeof(format));
+                if (formatSize < 16 || !stream.read(reinterpret_cast<char*>(format), std::streamsize(formatSize)))
+                    return false;
+
+                uint16_t formatTag = readUint16(format);
+                if (formatTag == WAVE_FORMAT_EXTENSIBLE && formatSize >= 26)
+                    formatTag = readUint16(format + 24); // first two bytes of the subformat GUID
+
+                file.channels = readUint16(format + 2);
+                file.sampleRate = readUint32(format + 4);
+                file.bitsPerSample = readUint16(format + 14);
+                file.isFloat = formatTag == WAVE_FORMAT_IEEE_FLOAT;
+                if (formatTag != WAVE_FORMAT_PCM && formatTag != WAVE_FORMAT_IEEE_FLOAT)
+                    return false;
+                if (file.isFloat ? file.bitsPerSample != 32 :
+                    file.bitsPerSample != 16 && file.bitsPerSample != 24 && file.bitsPerSample != 32)
+                    return false;
+                if (file.channels == 0 || file.sampleRate == 0)
+                    return false;
+
+                foundFormat = true;
+                stream.seekg(std::streamoff(chunkSize - formatSize + (chunkSize & 1)), std::ios::cur);
+            }
+            else if (std::memcmp(chunkHeader, "data", 4) == 0)
+            {
+                if (!foundFormat)
+                    return false;
+
+                file.dataOffset = stream.tellg();
+                file.frames = chunkSize / (size_t(file.channels) * file.bitsPerSample / 8);
+                return true;
+            }
+            else
+            {
+                // Chunks are padded to an even length.
+                stream.seekg(std::streamoff(chunkSize + (chunkSize & 1)), std::ios::cur);
+            }
+        }
+        return false;
+    }
+
+    float decodeSample(const uint8_t* bytes, const SampleFile& file)
+    {
+        if (file.isFloat)
+        {
+            float value;
+            std::memcpy(&value, bytes, sizeof(value));
+            return value;
+        }
+
+        switch (file.bitsPerSample)
+        {
+        case 16:
+            return float(int16_t(readUint16(bytes))) * (1.0f / 32768.0f);
+        case 24:
+            return float(int32_t(readUint32(bytes - 1) & 0xFFFFFF00) >> 8) * (1.0f / 8388608.0f);
+        case 32:
+            return float(int32_t(readUint32(bytes))) * (1.0f / 2147483648.0f);
+        }
+        return 0.0f;
+    }
+
+    // Read and convert up to count frames at the stream's current position.
+    size_t readFrames(std::ifstream& stream, const SampleFile& file, SampleFrame* frames, size_t count, std::vector<uint8_t>& scratch)
+    {
+        const size_t bytesPerSample = file.bitsPerSample / 8;
+        const size_t bytesPerFrame = bytesPerSample * file.channels;
+        scratch.resize(count * bytesPerFrame + 1);
+
+        // 24-bit samples are decoded as a 32-bit read ending at the sample, so leave a byte in front.
+        uint8_t* const data = scratch.data() + 1;
+        stream.read(reinterpret_cast<char*>(data), std::streamsize(count * bytesPerFrame));
+        const size_t framesRead = size_t(stream.gcount()) / bytesPerFrame;
+
+        for (size_t frame = 0; frame < framesRead; ++frame)
+        {
+            const uint8_t* const bytes = data + frame * bytesPerFrame;
+            frames[frame].left = decodeSample(bytes, file);
+            frames[frame].right = file.channels > 1 ? decodeSample(bytes + bytesPerSample, file) : frames[frame].left;
+        }
+        return framesRead;
+    }
+}
+
+SampleStreamer& SampleStreamer::getInstance()
+{
+    static SampleStreamer streamer;
+    return streamer;
+}
+
+void SampleStreamer::start()
+{
+    if (m_running.exchange(true))
+        return;
+
+    m_thread = std::thread([this]() { run(); });
+}
+
+void SampleStreamer::stop()
+{
+    if (!m_running.exchange(false))
+        return;
+
+    m_wake.notify_one();
+    m_thread.join();
+}
+
+std::optional<size_t> SampleStreamer::loadFile(const std::string& path)
+{
+    RealtimeSanitizer::checkBlockingCall("SampleStreamer::loadFile");
+    auto file = std::make_unique<SampleFile>();
+    file->path = path;
+
+    std::ifstream stream(path, std::ios::binary);
+    if (!stream || !readWavHeader(stream, *file))
+        return std::nullopt;
+
+    const size_t headFrames = std::min(file->frames, size_t(SAMPLE_HEAD_SECONDS * file->sampleRate));
+    file->head.resize(headFrames);
+
+    stream.seekg(file->dataOffset);
+    const size_t headRead = readFrames(stream, *file, file->head.data(), headFrames, m_load_scratch);
+    if (headRead < headFrames)
+    {
+        // The file is shorter than its header claims.
+        file->head.resize(headRead);
+        file->frames = headRead;
+    }
+
+    m_files.push_back(std::move(file));
+    return m_files.size() - 1;
+}
+
+std::optional<size_t> SampleStreamer::prepareStream(size_t fileIndex)
+{
+    if (fileIndex >= m_files.size())
+        return std::nullopt;
+
+    for (size_t stream = 0; stream < m_streams.size(); ++stream)
+    {
+        // Free streams belong to this thread; nobody else will touch them.
+        if (m_streams[stream].state.load(std::memory_order_acquire) != SampleStreamState::Free)
+            continue;
+
+        const SampleFile& file = *m_files[fileIndex];
+        StreamReader& reader = m_readers[stream];
+        RealtimeSanitizer::checkBlockingCall("SampleStreamer::prepareStream");
+        reader.file.open(file.path, std::ios::binary);
+        if (!reader.file)
+            return std::nullopt;
+
+        reader.nextFrame = file.head.size();
+        reader.file.seekg(file.dataOffset + std::streamoff(reader.nextFrame * file.channels * (file.bitsPerSample / 8)));
+
+        m_streams[stream].ring.clear();
+        m_streams[stream].underruns.store(0, std::memory_order_relaxed);
+        m_streams[stream].file = &file;
+        m_streams[stream].state.store(SampleStreamState::Prefetching, std::memory_order_release);
+        m_wake.notify_one();
+        return stream;
+    }
+    return std::nullopt;
+}
+
+void SampleStreamer::run()
+{
+    while (m_running.load())
+    {
+        for (size_t stream = 0; stream < m_streams.size(); ++stream)
+            fillStream(stream);
+
+        RealtimeSanitizer::checkBlockingCall("SampleStreamer lock");
+        std::unique_lock lock(m_mutex);
+        m_wake.wait_for(lock, READER_INTERVAL);
+    }
+}
+
+void SampleStreamer::fillStream(size_t streamIndex)
+{
+    SampleStream& stream = m_streams[streamIndex];
+    StreamReader& reader = m_readers[streamIndex];
+
+    switch (stream.state.load(std::memory_order_acquire))
+    {
+    case SampleStreamState::Free:
+        return;
+    case SampleStreamState::Finished:
+        // The voice is done with the stream; hand it back to the UI thread.
+        reader.file.close();
+        stream.file = nullptr;
+        stream.state.store(SampleStreamState::Free, std::memory_order_release);
+        return;
+    case SampleStreamState::Prefetching:
+    case SampleStreamState::Playing:
+        break;
+    }
+
+    const SampleFile& file = *stream.file;
+    std::array<SampleFrame, READ_CHUNK_FRAMES> frames;
+    while (reader.nextFrame < file.frames)
+    {
+        const size_t count = std::min({ stream.ring.writeAvailable(), READ_CHUNK_FRAMES, file.frames - reader.nextFrame });
+        if (count == 0)
+            break;
+
+        const size_t read = readFrames(reader.file, file, frames.data(), count, m_read_scratch);
+        if (read == 0)
+            break; // truncated file; the voice will just run out
+
+        stream.ring.write(frames.data(), read);
+        reader.nextFrame += read;
+    }
+}
@@ -0,0 +1,372 @@
+#include "saturation.h"
+
+#include "kernels.h"
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cmath>
+#include <immintrin.h>
+#include <memory>
+#include <vector>
+
+namespace
+{
+    // Taps on each side for the stage next to the base rate, whose passband reaches
+    // 20 kHz and stopband starts at 24 kHz (at 44.1 kHz), and for the 2x to 4x stage,
+    // which has from 22 kHz to 66 kHz to do the same. With Kaiser windows both are flat
+    // to 0.03 dB over the passband and at least 77 dB down over the stopband.
+    constexpr size_t FIRST_STAGE_TAPS = 28;
+    constexpr size_t SECOND_STAGE_TAPS = 6;
+    constexpr double KAISER_BETA = 8.0;
+
+    double BesselI0(double x)
+    {
+        double sum = 1.0;
+        double term = 1.0;
+        for (int k = 1; k < 32; ++k)
+        {
+            term *= (x / (2.0 * k)) * (x / (2.0 * k));
+            sum += term;
+        }
+        return sum;
+    }
+
+    // The taps of a half-band lowpass at odd distances 1, 3, 5, ... from its center
+    // (the rest are zero, and the center is 0.5), scaled for a DC gain of 1.
+    template<size_t TAPS>
+    std::array<float, TAPS> DesignHalfBand()
+    {
+        std::array<double, TAPS> taps{};
+        double sum = 0.0;
+        for (size_t tap = 0; tap < TAPS; ++tap)
+        {
+            const double distance = double(tap * 2 + 1);
+            const double ratio = distance / double(TAPS * 2);
+            const double window = BesselI0(KAISER_BETA * std::sqrt(1.0 - ratio * ratio)) / BesselI0(KAISER_BETA);
+            taps[tap] = std::sin(PI * distance / 2.0) / (PI * distance) * window;
+            sum += taps[tap];
+        }
+
+        // Both sides together have to make up the other half of the DC gain.
+        std::array<float, TAPS> scaled{};
+        for (size_t tap = 0; tap < TAPS; ++tap)
+            scaled[tap] = float(taps[tap] * 0.25 / sum);
+        return scaled;
+    }
+
+    // tanh, near enough: a rational approximation that reaches 1 (with a slope of 0) at 3.
+    float SoftClip(float x)
+    {
+        x = std::clamp(x, -3.0f, 3.0f);
+        return x * (27.0f + x * x) / (27.0f + 9.0f * x * x);
+    }
+
+    // Each curve is a plain loop the compiler can vectorize.
+    void ApplyCurve(SaturationCurve curve, float drive, float* samples, size_t count)
+    {
+        switch (curve)
+        {
+        case SaturationCurve::HardClip:
+            for (size_t i = 0; i < count; ++i)
+                samples[i] = std::clamp(samples[i] * drive, -1.0f, 1.0f);
+            break;
+        case SaturationCurve::Tanh:
+            for (size_t i = 0; i < count; ++i)
+                samples[i] = SoftClip(samples[i] * drive);
+            break;
+        case SaturationCurve::SoftKnee:
+        {
+            // Straight up to the knee, then x / (1 + x) over the rest of the way, which
+            // leaves with the slope the straight part had.
+            constexpr float KNEE = 0.5f;
+            for (size_t i = 0; i < count; ++i)
+            {
+                const float x = samples[i] * drive;
+                const float magnitude = std::abs(x);
+                const float over = std::max(magnitude - KNEE, 0.0f) / (1.0f - KNEE);
+                samples[i] = std::copysign(std::min(magnitude, KNEE) + (1.0f - KNEE) * over / (1.0f + over), x);
+            }
+            break;
+        }
+        case SaturationCurve::Asymmetric:
+            // The negative half clips at half scale, twice as early.
+            for (size_t i = 0; i < count; ++i)
+            {
+                const float x = samples[i] * drive;
+                samples[i] = SoftClip(std::max(x, 0.0f)) + 0.5f * SoftClip(2.0f * std::min(x, 0.0f));
+            }
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+void HalfBandUpsampler::setTaps(std::span<const float> taps)
+{
+    assert(taps.size() <= MAX_HALF_BAND_TAPS);
+    m_tap_count = taps.size();
+
+    // Zero-stuffing halves the level; the filter makes it up.
+    for (size_t tap = 0; tap < m_tap_count; ++tap)
+        m_taps[tap] = taps[tap] * 2.0f;
+    reset();
+}
+
+void HalfBandUpsampler::reset()
+{
+    m_history.fill(0.0f);
+}
+
+void HalfBandUpsampler::process(const float* input, size_t frames, float* output)
+{
+    assert(frames <= MAX_SATURATION_FRAMES * 2);
+
+    const size_t history = m_tap_count * 2;
+    float* const buffer = m_history.data();
+    std::copy_n(input, frames, buffer + history);
+
+    // Output pair n is the input m_tap_count frames back, and the point halfway between
+    // it and the one after.
+    // The scalar loop that finishes off the frames SSE can't is the reference, and does
+    // all of them when that's the kernel variant picked.
+    const size_t center = m_tap_count;
+    const size_t vectorFrames = Kernels::useScalar() ? 0 : frames;
+    size_t frame = 0;
+    for (; frame + 4 <= vectorFrames; frame += 4)
+    {
+        const float* const at = buffer + frame + center;
+        __m128 between = _mm_setzero_ps();
+        for (size_t tap = 0; tap < m_tap_count; ++tap)
+        {
+            const __m128 pair = _mm_add_ps(_mm_loadu_ps(at - tap), _mm_loadu_ps(at + 1 + tap));
+            between = _mm_add_ps(between, _mm_mul_ps(_mm_set1_ps(m_taps[tap]), pair));
+        }
+        const __m128 on = _mm_loadu_ps(at);
+        _mm_storeu_ps(output + frame * 2, _mm_unpacklo_ps(on, between));
+        _mm_storeu_ps(output + frame * 2 + 4, _mm_unpackhi_ps(on, between));
+    }
+    for (; frame < frames; ++frame)
+    {
+        const float* const at = buffer + frame + center;
+        float between = 0.0f;
+        for (size_t tap = 0; tap < m_tap_count; ++tap)
+            between += m_taps[tap] * (at[-ptrdiff_t(tap)] + at[1 + tap]);
+        output[frame * 2] = at[0];
+        output[frame * 2 + 1] = between;
+    }
+
+    std::copy_n(buffer + frames, history, buffer);
+}
+
+void HalfBandDownsampler::setTaps(std::span<const float> taps)
+{
+    assert(taps.size() <= MAX_HALF_BAND_TAPS);
+    m_tap_count = taps.size();
+    std::copy(taps.begin(), taps.end(), m_taps.begin());
+    reset();
+}
+
+void HalfBandDownsampler::reset()
+{
+    m_even.fill(0.0f);
+    m_odd.fill(0.0f);
+}
+
+void HalfBandDownsampler::process(const float* input, size_t frames, float* output)
+{
+    assert(frames <= MAX_SATURATION_FRAMES * 2);
+
+    const size_t history = m_tap_count * 2;
+    float* const even = m_even.data();
+    float* const odd = m_odd.data();
+    for (size_t frame = 0; frame < frames; ++frame)
+    {
+        even[history + frame] = input[frame * 2];
+        odd[history + frame] = input[frame * 2 + 1];
+    }
+
+    // Output n is centered on an even input m_tap_count frames back; the taps either
+    // side of it all land on odd inputs.
+    const size_t center = m_tap_count;
+    const __m128 half = _mm_set1_ps(0.5f);
+    const size_t vectorFrames = Kernels::useScalar() ? 0 : frames; // as in the upsampler
+    size_t frame = 0;
+    for (; frame + 4 <= vectorFrames; frame += 4)
+    {
+        const float* const at = odd + frame + center;
+        __m128 sum = _mm_mul_ps(half, _mm_loadu_ps(even + frame + center));
+        for (size_t tap = 0; tap < m_tap_count; ++tap)
+        {
+            const __m128 pair = _mm_add_ps(_mm_loadu_ps(at - 1 - tap), _mm_loadu_ps(at + tap));
+            sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(m_taps[tap]), pair));
+        }
+        _mm_storeu_ps(output + frame, sum);
+    }
+    for (; frame < frames; ++frame)
+    {
+        const float* const at = odd + frame + center;
+        float sum = 0.5f * even[frame + center];
+        for (size_t tap = 0; tap < m_tap_count; ++tap)
+            sum += m_taps[tap] * (at[-1 - ptrdiff_t(tap)] + at[tap]);
+        output[frame] = sum;
+    }
+
+    std::copy_n(even + frames, history, even);
+    std::copy_n(odd + frames, history, odd);
+}
+
+Saturator::Saturator()
+{
+    const auto firstStage = DesignHalfBand<FIRST_STAGE_TAPS>();
+    const auto secondStage = DesignHalfBand<SECOND_STAGE_TAPS>();
+    for (size_t channel = 0; channel < 2; ++channel)
+    {
+        m_up[channel].setTaps(firstStage);
+        m_down[channel].setTaps(firstStage);
+        m_up_twice[channel].setTaps(secondStage);
+        m_down_twice[channel].setTaps(secondStage);
+    }
+}
+
+bool Saturator::setSettings(SaturationSettings const& settings)
+{
+    if (!settings.isValid())
+        return false;
+
+    if (settings.oversampling != m_settings.oversampling)
+    {
+        for (size_t channel = 0; channel < 2; ++channel)
+        {
+            m_up[channel].reset();
+            m_down[channel].reset();
+            m_up_twice[channel].reset();
+            m_down_twice[channel].reset();
+        }
+    }
+    if (settings.curve != m_settings.curve)
+    {
+        m_dc_input.fill(0.0f);
+        m_dc_output.fill(0.0f);
+    }
+
+    m_settings = settings;
+    return true;
+}
+
+void Saturator::process(std::span<float> output)
+{
+    if (m_settings.curve == SaturationCurve::HardClip && m_settings.oversampling == 1 && m_settings.drive == 1.0f)
+    {
+        for (float& sample : output)
+            sample = std::clamp(sample, -1.0f, 1.0f);
+        return;
+    }
+
+    const size_t frames = output.size() / 2;
+    for (size_t start = 0; start < frames; start += MAX_SATURATION_FRAMES)
+    {
+        const size_t count = std::min(MAX_SATURATION_FRAMES, frames - start);
+        float* const samples = output.data() + start * 2;
+        processChannel(samples, count, 0);
+        processChannel(samples, count, 1);
+    }
+}
+
+void Saturator::processChannel(float* samples, size_t frames, size_t channel)
+{
+    float* const base = m_channel.data();
+    for (size_t frame = 0; frame < frames; ++frame)
+        base[frame] = samples[frame * 2 + channel];
+
+    switch (m_settings.oversampling)
+    {
+    case 2:
+        m_up[channel].process(base, frames, m_twice.data());
+        ApplyCurve(m_settings.curve, m_settings.drive, m_twice.data(), frames * 2);
+        m_down[channel].process(m_twice.data(), frames, base);
+        break;
+    case 4:
+        m_up[channel].process(base, frames, m_twice.data());
+        m_up_twice[channel].process(m_twice.data(), frames * 2, m_four_times.data());
+        ApplyCurve(m_settings.curve, m_settings.drive, m_four_times.data(), frames * 4);
+        m_down_twice[channel].process(m_four_times.data(), frames * 2, m_twice.data());
+        m_down[channel].process(m_twice.data(), frames, base);
+        break;
+    default:
+        ApplyCurve(m_settings.curve, m_settings.drive, base, frames);
+        break;
+    }
+
+    if (m_settings.curve == SaturationCurve::Asymmetric)
+    {
+        // Clipping one half harder than the other leaves a DC offset; a one-pole
+        // highpass at about 35 Hz takes it out.
+        constexpr float POLE = 0.995f;
+        float input = m_dc_input[channel];
+        float output = m_dc_output[channel];
+        for (size_t frame = 0; frame < frames; ++frame)
+        {
+            output = base[frame] - input + POLE * output;
+            input = base[frame];
+            base[frame] = output;
+        }
+        m_dc_input[channel] = input;
+        m_dc_output[channel] = output;
+    }
+
+    // The filters ring a little past full scale on hard edges; clip what's left.
+    for (size_t frame = 0; frame < frames; ++frame)
+        samples[frame * 2 + channel] = std::clamp(base[frame], -1.0f, 1.0f);
+}
+
+void BenchmarkSaturation(std::FILE* out)
+{
+    using Clock = std::chrono::steady_clock;
+    constexpr std::array<size_t, 7> BLOCK_SIZES = { 32, 64, 128, 256, 512, 1024, 2048 };
+    constexpr std::array<uint8_t, 3> OVERSAMPLING = { 1, 2, 4 };
+    constexpr std::array<const char*, size_t(SaturationCurve::Count)> CURVE_NAMES = { "hardclip", "tanh", "softknee",
+                                                                                      "asymmetric" };
+    constexpr size_t FRAMES_PER_RUN = SAMPLE_RATE * 10;
+
+    // A loud 1 kHz sine, driven well into every curve.
+    std::vector<float> source(BLOCK_SIZES.back() * 2);
+    for (size_t frame = 0; frame < BLOCK_SIZES.back(); ++frame)
+    {
+        const float sample = 0.9f * float(std::sin(2.0 * PI * 1000.0 * double(frame) / SAMPLE_RATE));
+        source[frame * 2] = sample;
+        source[frame * 2 + 1] = sample;
+    }
+    std::vector<float> block(source.size());
+
+    std::fprintf(out, "Saturation, %zu seconds of stereo at %u Hz per run (including a copy of the input)\n",
+                 FRAMES_PER_RUN / SAMPLE_RATE, SAMPLE_RATE);
+    std::fprintf(out, "%-10s %4s %6s %10s %8s\n", "curve", "over", "block", "ns/frame", "core");
+    for (size_t curve = 0; curve < size_t(SaturationCurve::Count); ++curve)
+    {
+        for (const uint8_t oversampling : OVERSAMPLING)
+        {
+            for (const size_t blockSize : BLOCK_SIZES)
+            {
+                auto saturator = std::make_unique<Saturator>();
+                saturator->setSettings({ SaturationCurve(curve), oversampling, 2.0f });
+
+                const std::span<float> view(block.data(), blockSize * 2);
+                const size_t blocks = FRAMES_PER_RUN / blockSize;
+                const auto start = Clock::now();
+                for (size_t run = 0; run < blocks; ++run)
+                {
+                    std::copy_n(source.begin(), blockSize * 2, block.begin());
+                    saturator->process(view);
+                }
+                const std::chrono::duration<double> elapsed = Clock::now() - start;
+
+                const double frames = double(blocks * blockSize);
+                const double nanoseconds = elapsed.count() * 1e9 / frames;
+                std::fprintf(out, "%-10s %3ux %6zu %10.2f %7.2f%%\n", CURVE_NAMES[curve], unsigned(oversampling),
+                             blockSize, nanoseconds, nanoseconds * SAMPLE_RATE * 1e-7);
+            }
+        }
+    }
+}
@@ -0,0 +1,163 @@
+#include "spectrum_analyzer.h"
+
+#include "output_tap.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+namespace
+{
+    // The analyzer checks the tap this often when it runs out of audio.
+    constexpr auto ANALYZER_INTERVAL = std::chrono::milliseconds(5);
+
+    // Peaks stay put for a while, then fall.
+    constexpr float PEAK_HOLD_SECONDS = 1.0f;
+    constexpr float PEAK_FALL_DB_PER_SECOND = 20.0f;
+
+    constexpr float HOP_SECONDS = float(SpectrumAnalyzer::HOP_SIZE) / float(SAMPLE_RATE);
+}
+
+SpectrumAnalyzer& SpectrumAnalyzer::getInstance()
+{
+    static SpectrumAnalyzer analyzer;
+    return analyzer;
+}
+
+SpectrumAnalyzer::SpectrumAnalyzer()
+    : m_window(FFT_SIZE)
+    , m_history(FFT_SIZE)
+    , m_windowed(FFT_SIZE)
+    , m_real(FFT_SIZE / 2 + 1)
+    , m_imaginary(FFT_SIZE / 2 + 1)
+    , m_bin_levels(FFT_SIZE / 2 + 1)
+{
+    double windowSum = 0.0;
+    for (size_t index = 0; index < FFT_SIZE; ++index)
+    {
+        m_window[index] = float(0.5 - 0.5 * std::cos(TWO_PI * double(index) / double(FFT_SIZE)));
+        windowSum += m_window[index];
+    }
+    m_window_gain = float(2.0 / windowSum);
+
+    const double binWidth = double(SAMPLE_RATE) / double(FFT_SIZE);
+    const double ratio = SPECTRUM_HIGHEST_FREQUENCY / SPECTRUM_LOWEST_FREQUENCY;
+    for (size_t band = 0; band < SPECTRUM_BANDS; ++band)
+    {
+        const double low = SPECTRUM_LOWEST_FREQUENCY * std::pow(ratio, double(band) / SPECTRUM_BANDS);
+        const double high = SPECTRUM_LOWEST_FREQUENCY * std::pow(ratio, double(band + 1) / SPECTRUM_BANDS);
+        m_band_frequencies[band] = float(std::sqrt(low * high));
+        m_band_first_bin[band] = size_t(std::ceil(low / binWidth));
+        m_band_last_bin[band] = std::min(size_t(std::floor(high / binWidth)), FFT_SIZE / 2);
+    }
+
+    m_peaks.fill(SPECTRUM_FLOOR_DB);
+}
+
+void SpectrumAnalyzer::start()
+{
+    if (m_running.exchange(true))
+        return;
+
+    m_thread = std::thread([this]() { run(); });
+}
+
+void SpectrumAnalyzer::stop()
+{
+    if (!m_running.exchange(false))
+        return;
+
+    m_thread.join();
+}
+
+const SpectrumFrame& SpectrumAnalyzer::getLatestFrame()
+{
+    (void)m_frames.update();
+    return m_frames.read();
+}
+
+void SpectrumAnalyzer::run()
+{
+    auto& tap = OutputTap::getInstance();
+    std::vector<float> left(HOP_SIZE);
+    std::vector<float> right(HOP_SIZE);
+    uint64_t position = tap.getWritten();
+
+    while (m_running.load())
+    {
+        const uint64_t written = tap.getWritten();
+        if (written - position < HOP_SIZE)
+        {
+            std::this_thread::sleep_for(ANALYZER_INTERVAL);
+            continue;
+        }
+
+        // If we fell far behind (or the hop was overwritten mid-copy), skip ahead to the present.
+        if (written - position > OutputTap::TAP_FRAMES / 2 || !tap.copy(position, HOP_SIZE, left.data(), right.data()))
+        {
+            position = written - HOP_SIZE;
+            continue;
+        }
+        position += HOP_SIZE;
+
+        // Slide the history along by a hop, and analyze the mid channel.
+        std::copy(m_history.begin() + HOP_SIZE, m_history.end(), m_history.begin());
+        float* const newest = m_history.data() + FFT_SIZE - HOP_SIZE;
+        for (size_t frame = 0; frame < HOP_SIZE; ++frame)
+            newest[frame] = 0.5f * (left[frame] + right[frame]);
+
+        analyze();
+    }
+}
+
+void SpectrumAnalyzer::analyze()
+{
+    for (size_t index = 0; index < FFT_SIZE; ++index)
+        m_windowed[index] = m_history[index] * m_window[index];
+
+    m_fft.forward(m_windowed, m_real, m_imaginary);
+
+    // dBFS, where a full-scale sine peaks at 0.
+    const float powerGain = m_window_gain * m_window_gain;
+    for (size_t bin = 0; bin < m_bin_levels.size(); ++bin)
+    {
+        const float power = (m_real[bin] * m_real[bin] + m_imaginary[bin] * m_imaginary[bin]) * powerGain;
+        m_bin_levels[bin] = std::max(10.0f * std::log10(power + 1e-20f), SPECTRUM_FLOOR_DB);
+    }
+
+    const float binWidth = float(SAMPLE_RATE) / float(FFT_SIZE);
+    SpectrumFrame& frame = m_frames.getWriteBuffer();
+    for (size_t band = 0; band < SPECTRUM_BANDS; ++band)
+    {
+        float level;
+        if (m_band_first_bin[band] <= m_band_last_bin[band])
+        {
+            // Wide (high) bands show their loudest bin, so narrow peaks don't get averaged away.
+            level = *std::max_element(m_bin_levels.begin() + ptrdiff_t(m_band_first_bin[band]),
+                                      m_bin_levels.begin() + ptrdiff_t(m_band_last_bin[band]) + 1);
+        }
+        else
+        {
+            // Bands narrower than a bin (low ones) interpolate between the bins around them.
+            const float position = m_band_frequencies[band] / binWidth;
+            const size_t below = std::min(size_t(position), m_bin_levels.size() - 2);
+            level = std::lerp(m_bin_levels[below], m_bin_levels[below + 1], position - float(below));
+        }
+
+        if (level >= m_peaks[band])
+        {
+            m_peaks[band] = level;
+            m_peak_ages[band] = 0.0f;
+        }
+        else
+        {
+            m_peak_ages[band] += HOP_SECONDS;
+            if (m_peak_ages[band] > PEAK_HOLD_SECONDS)
+                m_peaks[band] = std::max(level, m_peaks[band] - PEAK_FALL_DB_PER_SECOND * HOP_SECONDS);
+        }
+
+        frame.levels[band] = level;
+        frame.peaks[band] = m_peaks[band];
+    }
+    m_frames.publish();
+}
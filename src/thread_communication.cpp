@@ -1,143 +1,449 @@
 #include "thread_communication.h"
+#include "generator_mixer.h"
 
-#include "oscillator_ui.h"
+#include "latency_probe.h"
+#include "sample_streamer.h"
+#include "tracing.h"
 
-ThreadCommunication::RequestQueueType& ThreadCommunication::getModifyGeneratorRequestQueue()
+// Everything one generator uses to talk to the non-realtime thread.
+struct GeneratorChannel
 {
     static const int REQUEST_QUEUE_SIZE = 32;
+    static const int RESPONSE_QUEUE_SIZE = 32;
+    static const int ASYNC_QUEUE_SIZE = 512;
     static_assert(isPowerOf2(REQUEST_QUEUE_SIZE));
-    static RequestQueueType modifyGeneratorRequestQueue(REQUEST_QUEUE_SIZE);
-    return modifyGeneratorRequestQueue;
+    static_assert(isPowerOf2(RESPONSE_QUEUE_SIZE));
+
+    ThreadCommunication::RequestQueueType requestQueue{ REQUEST_QUEUE_SIZE };
+    ThreadCommunication::ResponseQueueType responseQueue{ RESPONSE_QUEUE_SIZE };
+    ThreadCommunication::AsyncCallerType asyncCaller{ ASYNC_QUEUE_SIZE };
+
+    // A request popped from the queue before its time. Only touched by the realtime thread.
+    std::unique_ptr<const Events::ModifyGenerator::Request> heldRequest;
+};
+
+static GeneratorChannel& GetGeneratorChannel(size_t generator)
+{
+    assert(generator < MAX_GENERATORS);
+    static std::array<GeneratorChannel, MAX_GENERATORS> channels;
+    return channels[generator];
 }
 
-ThreadCommunication::ResponseQueueType& ThreadCommunication::getModifyGeneratorResponseQueue()
+ThreadCommunication::RequestQueueType& ThreadCommunication::getModifyGeneratorRequestQueue(size_t generator)
 {
-    static const int RESPONSE_QUEUE_SIZE = 32;
-    static_assert(isPowerOf2(RESPONSE_QUEUE_SIZE));
-    static ResponseQueueType modifyGeneratorResponseQueue(RESPONSE_QUEUE_SIZE);
-    return modifyGeneratorResponseQueue;
+    return GetGeneratorChannel(generator).requestQueue;
+}
+
+ThreadCommunication::ResponseQueueType& ThreadCommunication::getModifyGeneratorResponseQueue(size_t generator)
+{
+    return GetGeneratorChannel(generator).responseQueue;
 }
 
-ThreadCommunication::AsyncCallerType& ThreadCommunication::getRealtimeAsyncCaller()
+ThreadCommunication::AsyncCallerType& ThreadCommunication::getRealtimeAsyncCaller(size_t generator)
 {
-    static const int QUEUE_SIZE = 512;
-    static AsyncCallerType asyncCaller(QUEUE_SIZE);
-    return asyncCaller;
+    return GetGeneratorChannel(generator).asyncCaller;
 }
 
-bool ThreadCommunication::deferToNonRealtimeThread(std::function<void()>&& fn)
+bool ThreadCommunication::deferToNonRealtimeThread(std::function<void()>&& fn, size_t generator)
 {
-    return getRealtimeAsyncCaller().callAsync(std::move(fn));
+    return getRealtimeAsyncCaller(generator).callAsync(std::move(fn));
 }
 
 bool ThreadCommunication::processDeferredActions()
 {
-    return getRealtimeAsyncCaller().process();
+    Tracing::Span span("processDeferredActions");
+    bool processed = false;
+    for (size_t generator = 0; generator < MAX_GENERATORS; ++generator)
+        processed |= getRealtimeAsyncCaller(generator).process();
+    return processed;
 }
 
 
-Generator<>& GeneratorAccess::getInstance()
+Generator<>& GeneratorAccess::getInstance(size_t generator)
 {
-    static Generator<> generator;
-    return generator;
+    assert(generator < MAX_GENERATORS);
+    static std::array<Generator<>, MAX_GENERATORS> generators;
+    // Each generator seeds its oscillators differently, so stacks in different
+    // generators don't play in phase.
+    [[maybe_unused]] static const bool seeded = []() {
+        for (size_t index = 0; index < MAX_GENERATORS; ++index)
+            generators[index].setSeed(uint32_t(index));
+        return true;
+    }();
+    return generators[generator];
 }
 
 namespace EventBuilder
 {
-    bool PushAddOscillatorEvent(RequestId requestId, OscillatorSettings settings)
+    bool PushAddOscillatorEvent(size_t generator, RequestId requestId, OscillatorSettings settings, std::optional<uint64_t> sampleTime)
     {
         auto addOscillatorRequest = std::make_unique<Events::ModifyGenerator::AddOscillatorRequest>();
         addOscillatorRequest->id = requestId;
+        addOscillatorRequest->generator = generator;
         addOscillatorRequest->action = Events::ModifyGenerator::Action::AddOscillator;
         addOscillatorRequest->settings = settings;
-        bool pushed = ThreadCommunication::getModifyGeneratorRequestQueue().push(std::move(addOscillatorRequest));
+        addOscillatorRequest->sampleTime = sampleTime;
+        bool pushed = ThreadCommunication::getModifyGeneratorRequestQueue(generator).push(std::move(addOscillatorRequest));
         assert(pushed);
         return pushed;
     }
 
-    bool PushRemoveOscillatorEvent(RequestId requestId, OscillatorId idToRemove)
+    bool PushRemoveOscillatorEvent(size_t generator, RequestId requestId, OscillatorId idToRemove, std::optional<uint64_t> sampleTime)
     {
         auto removeOscillatorRequest = std::make_unique<Events::ModifyGenerator::RemoveOscillatorRequest>();
         removeOscillatorRequest->id = requestId;
+        removeOscillatorRequest->generator = generator;
         removeOscillatorRequest->action = Events::ModifyGenerator::Action::RemoveOscillator;
         removeOscillatorRequest->idToRemove = idToRemove;
-        bool pushed = ThreadCommunication::getModifyGeneratorRequestQueue().push(std::move(removeOscillatorRequest));
+        removeOscillatorRequest->sampleTime = sampleTime;
+        bool pushed = ThreadCommunication::getModifyGeneratorRequestQueue(generator).push(std::move(removeOscillatorRequest));
         assert(pushed);
         return pushed;
     }
 
-    bool PushActivateOscillatorEvent(RequestId requestId, OscillatorId idToModify, volume_t volume)
+    bool PushActivateOscillatorEvent(size_t generator, RequestId requestId, OscillatorId idToModify, volume_t volume, std::optional<uint64_t> sampleTime)
     {
         auto activateOscillatorRequest = std::make_unique<Events::ModifyGenerator::ActivateOscillatorRequest>();
         activateOscillatorRequest->action = Events::ModifyGenerator::Action::ActivateOscillator;
         activateOscillatorRequest->id = requestId;
+        activateOscillatorRequest->generator = generator;
         activateOscillatorRequest->idToModify = idToModify;
         activateOscillatorRequest->volume = volume;
-        bool pushed = ThreadCommunication::getModifyGeneratorRequestQueue().push(std::move(activateOscillatorRequest));
+        activateOscillatorRequest->sampleTime = sampleTime;
+        bool pushed = ThreadCommunication::getModifyGeneratorRequestQueue(generator).push(std::move(activateOscillatorRequest));
         assert(pushed);
         return pushed;
     }
 
-    bool PushDeactivateOscillatorEvent(RequestId requestId, OscillatorId idToModify)
+    bool PushDeactivateOscillatorEvent(size_t generator, RequestId requestId, OscillatorId idToModify, std::optional<uint64_t> sampleTime)
     {
         auto deactivateOscillatorRequest = std::make_unique<Events::ModifyGenerator::DeactivateOscillatorRequest>();
         deactivateOscillatorRequest->action = Events::ModifyGenerator::Action::DeactivateOscillator;
         deactivateOscillatorRequest->id = requestId;
+        deactivateOscillatorRequest->generator = generator;
         deactivateOscillatorRequest->idToModify = idToModify;
-        bool pushed = ThreadCommunication::getModifyGeneratorRequestQueue().push(std::move(deactivateOscillatorRequest));
+        deactivateOscillatorRequest->sampleTime = sampleTime;
+        bool pushed = ThreadCommunication::getModifyGeneratorRequestQueue(generator).push(std::move(deactivateOscillatorRequest));
         assert(pushed);
         return pushed;
     }
 
-    bool PushSetOscillatorFrequencyEvent(RequestId requestId, OscillatorId idToModify, frequency_t frequency)
+    bool PushSetOscillatorFrequencyEvent(size_t generator, RequestId requestId, OscillatorId idToModify, frequency_t frequency, std::optional<uint64_t> sampleTime)
     {
         auto setOscillatorFrequencyRequest = std::make_unique<Events::ModifyGenerator::SetOscillatorFrequencyRequest>();
         setOscillatorFrequencyRequest->action = Events::ModifyGenerator::Action::SetOscillatorFrequency;
         setOscillatorFrequencyRequest->id = requestId;
+        setOscillatorFrequencyRequest->generator = generator;
         setOscillatorFrequencyRequest->idToModify = idToModify;
         setOscillatorFrequencyRequest->newFrequency = frequency;
-        bool pushed = ThreadCommunication::getModifyGeneratorRequestQueue().push(std::move(setOscillatorFrequencyRequest));
+        setOscillatorFrequencyRequest->sampleTime = sampleTime;
+        bool pushed = ThreadCommunication::getModifyGeneratorRequestQueue(generator).push(std::move(setOscillatorFrequencyRequest));
         assert(pushed);
         return pushed;
     }
 
-    bool PushSetOscillatorVolumeEvent(RequestId requestId, OscillatorId idToModify, volume_t volume)
+    bool PushSetOscillatorVolumeEvent(size_t generator, RequestId requestId, OscillatorId idToModify, volume_t volume, std::optional<uint64_t> sampleTime)
     {
         auto setOscillatorVolumeRequest = std::make_unique<Events::ModifyGenerator::SetOscillatorVolumeRequest>();
         setOscillatorVolumeRequest->action = Events::ModifyGenerator::Action::SetOscillatorVolume;
         setOscillatorVolumeRequest->id = requestId;
+        setOscillatorVolumeRequest->generator = generator;
         setOscillatorVolumeRequest->idToModify = idToModify;
         setOscillatorVolumeRequest->newVolume = volume;
-        bool pushed = ThreadCommunication::getModifyGeneratorRequestQueue().push(std::move(setOscillatorVolumeRequest));
+        setOscillatorVolumeRequest->sampleTime = sampleTime;
+        bool pushed = ThreadCommunication::getModifyGeneratorRequestQueue(generator).push(std::move(setOscillatorVolumeRequest));
         assert(pushed);
         return pushed;
     }
 
-    bool PushSetOscillatorPanEvent(RequestId requestId, OscillatorId idToModify, pan_t pan)
+    bool PushSetOscillatorPanEvent(size_t generator, RequestId requestId, OscillatorId idToModify, pan_t pan, std::optional<uint64_t> sampleTime)
     {
         auto setOscillatorPanRequest = std::make_unique<Events::ModifyGenerator::SetOscillatorPanRequest>();
         setOscillatorPanRequest->action = Events::ModifyGenerator::Action::SetOscillatorPan;
         setOscillatorPanRequest->id = requestId;
+        setOscillatorPanRequest->generator = generator;
         setOscillatorPanRequest->idToModify = idToModify;
         setOscillatorPanRequest->newPan = pan;
-        bool pushed = ThreadCommunication::getModifyGeneratorRequestQueue().push(std::move(setOscillatorPanRequest));
+        setOscillatorPanRequest->sampleTime = sampleTime;
+        bool pushed = ThreadCommunication::getModifyGeneratorRequestQueue(generator).push(std::move(setOscillatorPanRequest));
         assert(pushed);
         return pushed;
     }
 
-    bool PushSetOscillatorTypeEvent(RequestId requestId, OscillatorId idToModify, OscillatorType type)
+    bool PushSetOscillatorTypeEvent(size_t generator, RequestId requestId, OscillatorId idToModify, OscillatorType type, std::optional<uint64_t> sampleTime)
     {
         auto setOscillatorTypeRequest = std::make_unique<Events::ModifyGenerator::SetOscillatorTypeRequest>();
         setOscillatorTypeRequest->action = Events::ModifyGenerator::Action::SetOscillatorType;
         setOscillatorTypeRequest->id = requestId;
+        setOscillatorTypeRequest->generator = generator;
         setOscillatorTypeRequest->idToModify = idToModify;
         setOscillatorTypeRequest->newType = type;
-        bool pushed = ThreadCommunication::getModifyGeneratorRequestQueue().push(std::move(setOscillatorTypeRequest));
+        setOscillatorTypeRequest->sampleTime = sampleTime;
+        bool pushed = ThreadCommunication::getModifyGeneratorRequestQueue(generator).push(std::move(setOscillatorTypeRequest));
+        assert(pushed);
+        return pushed;
+    }
+
+    bool PushSetOscillatorWavetablePositionEvent(size_t generator, RequestId requestId, OscillatorId idToModify, float position, std::optional<uint64_t> sampleTime)
+    {
+        auto setOscillatorWavetablePositionRequest = std::make_unique<Events::ModifyGenerator::SetOscillatorWavetablePositionRequest>();
+        setOscillatorWavetablePositionRequest->action = Events::ModifyGenerator::Action::SetOscillatorWavetablePosition;
+        setOscillatorWavetablePositionRequest->id = requestId;
+        setOscillatorWavetablePositionRequest->generator = generator;
+        setOscillatorWavetablePositionRequest->idToModify = idToModify;
+        setOscillatorWavetablePositionRequest->newPosition = position;
+        setOscillatorWavetablePositionRequest->sampleTime = sampleTime;
+        bool pushed = ThreadCommunication::getModifyGeneratorRequestQueue(generator).push(std::move(setOscillatorWavetablePositionRequest));
+        assert(pushed);
+        return pushed;
+    }
+
+    bool PushSetOscillatorEnvelopeEvent(size_t generator, RequestId requestId, OscillatorId idToModify, EnvelopeSettings envelope, std::optional<uint64_t> sampleTime)
+    {
+        auto setOscillatorEnvelopeRequest = std::make_unique<Events::ModifyGenerator::SetOscillatorEnvelopeRequest>();
+        setOscillatorEnvelopeRequest->action = Events::ModifyGenerator::Action::SetOscillatorEnvelope;
+        setOscillatorEnvelopeRequest->id = requestId;
+        setOscillatorEnvelopeRequest->generator = generator;
+        setOscillatorEnvelopeRequest->idToModify = idToModify;
+        setOscillatorEnvelopeRequest->newEnvelope = envelope;
+        setOscillatorEnvelopeRequest->sampleTime = sampleTime;
+        bool pushed = ThreadCommunication::getModifyGeneratorRequestQueue(generator).push(std::move(setOscillatorEnvelopeRequest));
+        assert(pushed);
+        return pushed;
+    }
+
+    bool PushSetOscillatorUnisonEvent(size_t generator, RequestId requestId, OscillatorId idToModify, UnisonSettings unison, std::optional<uint64_t> sampleTime)
+    {
+        auto setOscillatorUnisonRequest = std::make_unique<Events::ModifyGenerator::SetOscillatorUnisonRequest>();
+        setOscillatorUnisonRequest->action = Events::ModifyGenerator::Action::SetOscillatorUnison;
+        setOscillatorUnisonRequest->id = requestId;
+        setOscillatorUnisonRequest->generator = generator;
+        setOscillatorUnisonRequest->idToModify = idToModify;
+        setOscillatorUnisonRequest->newUnison = unison;
+        setOscillatorUnisonRequest->sampleTime = sampleTime;
+        bool pushed = ThreadCommunication::getModifyGeneratorRequestQueue(generator).push(std::move(setOscillatorUnisonRequest));
+        assert(pushed);
+        return pushed;
+    }
+
+    bool PushSetOscillatorSyncEvent(size_t generator, RequestId requestId, OscillatorId idToModify, OscillatorId syncMaster, std::optional<uint64_t> sampleTime)
+    {
+        auto setOscillatorSyncRequest = std::make_unique<Events::ModifyGenerator::SetOscillatorSyncRequest>();
+        setOscillatorSyncRequest->action = Events::ModifyGenerator::Action::SetOscillatorSync;
+        setOscillatorSyncRequest->id = requestId;
+        setOscillatorSyncRequest->generator = generator;
+        setOscillatorSyncRequest->idToModify = idToModify;
+        setOscillatorSyncRequest->newSyncMaster = syncMaster;
+        setOscillatorSyncRequest->sampleTime = sampleTime;
+        bool pushed = ThreadCommunication::getModifyGeneratorRequestQueue(generator).push(std::move(setOscillatorSyncRequest));
+        assert(pushed);
+        return pushed;
+    }
+
+    bool PushSetLfoEvent(size_t generator, RequestId requestId, size_t lfoIndex, LfoSettings lfo, std::optional<uint64_t> sampleTime)
+    {
+        auto setLfoRequest = std::make_unique<Events::ModifyGenerator::SetLfoRequest>();
+        setLfoRequest->action = Events::ModifyGenerator::Action::SetLfo;
+        setLfoRequest->id = requestId;
+        setLfoRequest->generator = generator;
+        setLfoRequest->lfoIndex = lfoIndex;
+        setLfoRequest->newLfo = lfo;
+        setLfoRequest->sampleTime = sampleTime;
+        bool pushed = ThreadCommunication::getModifyGeneratorRequestQueue(generator).push(std::move(setLfoRequest));
+        assert(pushed);
+        return pushed;
+    }
+
+    bool PushSetModulationRouteEvent(size_t generator, RequestId requestId, size_t routeIndex, ModulationRoute route, std::optional<uint64_t> sampleTime)
+    {
+        auto setModulationRouteRequest = std::make_unique<Events::ModifyGenerator::SetModulationRouteRequest>();
+        setModulationRouteRequest->action = Events::ModifyGenerator::Action::SetModulationRoute;
+        setModulationRouteRequest->id = requestId;
+        setModulationRouteRequest->generator = generator;
+        setModulationRouteRequest->routeIndex = routeIndex;
+        setModulationRouteRequest->newRoute = route;
+        setModulationRouteRequest->sampleTime = sampleTime;
+        bool pushed = ThreadCommunication::getModifyGeneratorRequestQueue(generator).push(std::move(setModulationRouteRequest));
+        assert(pushed);
+        return pushed;
+    }
+
+    bool PushSetControlBlockSizeEvent(size_t generator, RequestId requestId, size_t controlBlockSize, std::optional<uint64_t> sampleTime)
+    {
+        auto setControlBlockSizeRequest = std::make_unique<Events::ModifyGenerator::SetControlBlockSizeRequest>();
+        setControlBlockSizeRequest->action = Events::ModifyGenerator::Action::SetControlBlockSize;
+        setControlBlockSizeRequest->id = requestId;
+        setControlBlockSizeRequest->generator = generator;
+        setControlBlockSizeRequest->newControlBlockSize = controlBlockSize;
+        setControlBlockSizeRequest->sampleTime = sampleTime;
+        bool pushed = ThreadCommunication::getModifyGeneratorRequestQueue(generator).push(std::move(setControlBlockSizeRequest));
+        assert(pushed);
+        return pushed;
+    }
+
+    bool PushSetFmGroupEvent(size_t generator, RequestId requestId, size_t groupIndex, FmGroupSettings group, std::optional<uint64_t> sampleTime)
+    {
+        auto setFmGroupRequest = std::make_unique<Events::ModifyGenerator::SetFmGroupRequest>();
+        setFmGroupRequest->action = Events::ModifyGenerator::Action::SetFmGroup;
+        setFmGroupRequest->id = requestId;
+        setFmGroupRequest->generator = generator;
+        setFmGroupRequest->groupIndex = groupIndex;
+        setFmGroupRequest->newGroup = group;
+        setFmGroupRequest->sampleTime = sampleTime;
+        bool pushed = ThreadCommunication::getModifyGeneratorRequestQueue(generator).push(std::move(setFmGroupRequest));
+        assert(pushed);
+        return pushed;
+    }
+
+    bool PushSetGrainCloudEvent(size_t generator, RequestId requestId, size_t cloudIndex, GrainCloudSettings cloud, std::optional<uint64_t> sampleTime)
+    {
+        auto setGrainCloudRequest = std::make_unique<Events::ModifyGenerator::SetGrainCloudRequest>();
+        setGrainCloudRequest->action = Events::ModifyGenerator::Action::SetGrainCloud;
+        setGrainCloudRequest->id = requestId;
+        setGrainCloudRequest->generator = generator;
+        setGrainCloudRequest->cloudIndex = cloudIndex;
+        setGrainCloudRequest->newCloud = cloud;
+        setGrainCloudRequest->sampleTime = sampleTime;
+        bool pushed = ThreadCommunication::getModifyGeneratorRequestQueue(generator).push(std::move(setGrainCloudRequest));
+        assert(pushed);
+        return pushed;
+    }
+
+    bool PushPlaySampleEvent(size_t generator, RequestId requestId, size_t voice, float rate, volume_t volume, std::optional<uint64_t> sampleTime)
+    {
+        auto playSampleRequest = std::make_unique<Events::ModifyGenerator::PlaySampleRequest>();
+        playSampleRequest->action = Events::ModifyGenerator::Action::PlaySample;
+        playSampleRequest->id = requestId;
+        playSampleRequest->generator = generator;
+        playSampleRequest->voice = voice;
+        playSampleRequest->rate = rate;
+        playSampleRequest->volume = volume;
+        playSampleRequest->sampleTime = sampleTime;
+        bool pushed = ThreadCommunication::getModifyGeneratorRequestQueue(generator).push(std::move(playSampleRequest));
+        assert(pushed);
+        return pushed;
+    }
+
+    bool PushStopSampleEvent(size_t generator, RequestId requestId, size_t voice, std::optional<uint64_t> sampleTime)
+    {
+        auto stopSampleRequest = std::make_unique<Events::ModifyGenerator::StopSampleRequest>();
+        stopSampleRequest->action = Events::ModifyGenerator::Action::StopSample;
+        stopSampleRequest->id = requestId;
+        stopSampleRequest->generator = generator;
+        stopSampleRequest->voice = voice;
+        stopSampleRequest->sampleTime = sampleTime;
+        bool pushed = ThreadCommunication::getModifyGeneratorRequestQueue(generator).push(std::move(stopSampleRequest));
+        assert(pushed);
+        return pushed;
+    }
+
+    bool PushPlayMidiEvent(size_t generator, RequestId requestId, const MidiSequence* sequence, MidiSettings settings, std::optional<uint64_t> sampleTime)
+    {
+        auto playMidiRequest = std::make_unique<Events::ModifyGenerator::PlayMidiRequest>();
+        playMidiRequest->action = Events::ModifyGenerator::Action::PlayMidi;
+        playMidiRequest->id = requestId;
+        playMidiRequest->generator = generator;
+        playMidiRequest->sequence = sequence;
+        playMidiRequest->settings = settings;
+        playMidiRequest->sampleTime = sampleTime;
+        bool pushed = ThreadCommunication::getModifyGeneratorRequestQueue(generator).push(std::move(playMidiRequest));
+        assert(pushed);
+        return pushed;
+    }
+
+    bool PushInstallPresetEvent(size_t generator, RequestId requestId, std::unique_ptr<Generator<>::OscillatorBank> oscillators, std::optional<uint64_t> sampleTime)
+    {
+        auto installPresetRequest = std::make_unique<Events::ModifyGenerator::InstallPresetRequest>();
+        installPresetRequest->action = Events::ModifyGenerator::Action::InstallPreset;
+        installPresetRequest->id = requestId;
+        installPresetRequest->generator = generator;
+        installPresetRequest->oscillators = std::move(oscillators);
+        installPresetRequest->sampleTime = sampleTime;
+        bool pushed = ThreadCommunication::getModifyGeneratorRequestQueue(generator).push(std::move(installPresetRequest));
+        assert(pushed);
+        return pushed;
+    }
+
+    bool PushStopMidiEvent(size_t generator, RequestId requestId, std::optional<uint64_t> sampleTime)
+    {
+        auto stopMidiRequest = std::make_unique<Events::ModifyGenerator::StopMidiRequest>();
+        stopMidiRequest->action = Events::ModifyGenerator::Action::StopMidi;
+        stopMidiRequest->id = requestId;
+        stopMidiRequest->generator = generator;
+        stopMidiRequest->sampleTime = sampleTime;
+        bool pushed = ThreadCommunication::getModifyGeneratorRequestQueue(generator).push(std::move(stopMidiRequest));
+        assert(pushed);
+        return pushed;
+    }
+
+    bool PushPlayResynthesisEvent(size_t generator, RequestId requestId, const PartialTracks* tracks, ResynthesisSettings settings, std::optional<uint64_t> sampleTime)
+    {
+        auto playResynthesisRequest = std::make_unique<Events::ModifyGenerator::PlayResynthesisRequest>();
+        playResynthesisRequest->action = Events::ModifyGenerator::Action::PlayResynthesis;
+        playResynthesisRequest->id = requestId;
+        playResynthesisRequest->generator = generator;
+        playResynthesisRequest->tracks = tracks;
+        playResynthesisRequest->settings = settings;
+        playResynthesisRequest->sampleTime = sampleTime;
+        bool pushed = ThreadCommunication::getModifyGeneratorRequestQueue(generator).push(std::move(playResynthesisRequest));
+        assert(pushed);
+        return pushed;
+    }
+
+    bool PushSetResynthesisEvent(size_t generator, RequestId requestId, ResynthesisSettings settings, std::optional<uint64_t> sampleTime)
+    {
+        auto setResynthesisRequest = std::make_unique<Events::ModifyGenerator::SetResynthesisRequest>();
+        setResynthesisRequest->action = Events::ModifyGenerator::Action::SetResynthesis;
+        setResynthesisRequest->id = requestId;
+        setResynthesisRequest->generator = generator;
+        setResynthesisRequest->newSettings = settings;
+        setResynthesisRequest->sampleTime = sampleTime;
+        bool pushed = ThreadCommunication::getModifyGeneratorRequestQueue(generator).push(std::move(setResynthesisRequest));
+        assert(pushed);
+        return pushed;
+    }
+
+    bool PushStopResynthesisEvent(size_t generator, RequestId requestId, std::optional<uint64_t> sampleTime)
+    {
+        auto stopResynthesisRequest = std::make_unique<Events::ModifyGenerator::StopResynthesisRequest>();
+        stopResynthesisRequest->action = Events::ModifyGenerator::Action::StopResynthesis;
+        stopResynthesisRequest->id = requestId;
+        stopResynthesisRequest->generator = generator;
+        stopResynthesisRequest->sampleTime = sampleTime;
+        bool pushed = ThreadCommunication::getModifyGeneratorRequestQueue(generator).push(std::move(stopResynthesisRequest));
+        assert(pushed);
+        return pushed;
+    }
+
+    bool PushSetSaturationEvent(size_t generator, RequestId requestId, SaturationSettings saturation, std::optional<uint64_t> sampleTime)
+    {
+        auto setSaturationRequest = std::make_unique<Events::ModifyGenerator::SetSaturationRequest>();
+        setSaturationRequest->action = Events::ModifyGenerator::Action::SetSaturation;
+        setSaturationRequest->id = requestId;
+        setSaturationRequest->generator = generator;
+        setSaturationRequest->newSaturation = saturation;
+        setSaturationRequest->sampleTime = sampleTime;
+        bool pushed = ThreadCommunication::getModifyGeneratorRequestQueue(generator).push(std::move(setSaturationRequest));
         assert(pushed);
         return pushed;
     }
 }
 
+// Oscillator banks are big; never free one on the realtime thread.
+static void FreeOnNonRealtimeThread(size_t generator, std::unique_ptr<Generator<>::OscillatorBank> oscillators)
+{
+    if (oscillators)
+    {
+        ThreadCommunication::deferToNonRealtimeThread(
+            [oscillatorsPtr = oscillators.release()]() { decltype(oscillators) destructMe(oscillatorsPtr); }, generator);
+    }
+}
+
+void ReclaimRetiredOscillators(size_t generator)
+{
+    FreeOnNonRealtimeThread(generator, GeneratorAccess::getInstance(generator).takeRetiredOscillators());
+}
+
 // These request handlers are meant to be called by the realtime thread.
 // The realtime thread modifies the generator settings, honoring the
 // request as best it can. It then responds informing how the event went.
@@ -146,7 +452,7 @@ namespace RealTimeRequestHandlers
 {
     static bool HandleAddOscillatorRequest(const Events::ModifyGenerator::AddOscillatorRequest& addRequest)
     {
-        auto& oscillators = GeneratorAccess::getInstance().getOscillators();
+        auto& oscillators = GeneratorAccess::getInstance(addRequest.generator).getOscillators();
 
         Events::ModifyGenerator::Response addResponse;
         addResponse.requestId = addRequest.id;
@@ -155,12 +461,12 @@ namespace RealTimeRequestHandlers
         addResponse.result = addResponse.oscillatorId.has_value() ?
             Events::ModifyGenerator::Result::AddOscillatorSucceeded :
             Events::ModifyGenerator::Result::AddOscillatorFailed;
-        return ThreadCommunication::getModifyGeneratorResponseQueue().push(std::move(addResponse));
+        return ThreadCommunication::getModifyGeneratorResponseQueue(addRequest.generator).push(std::move(addResponse));
     }
 
     static bool HandleRemoveOscillatorRequest(const Events::ModifyGenerator::RemoveOscillatorRequest& removeRequest)
     {
-        auto& oscillators = GeneratorAccess::getInstance().getOscillators();
+        auto& oscillators = GeneratorAccess::getInstance(removeRequest.generator).getOscillators();
 
         Events::ModifyGenerator::Response removeResponse;
         bool result = oscillators.removeOscillator(removeRequest.idToRemove);
@@ -169,12 +475,12 @@ namespace RealTimeRequestHandlers
         removeResponse.result = result ?
             Events::ModifyGenerator::Result::RemoveOscillatorSucceeded :
             Events::ModifyGenerator::Result::RemoveOscillatorFailed;
-        return ThreadCommunication::getModifyGeneratorResponseQueue().push(std::move(removeResponse));
+        return ThreadCommunication::getModifyGeneratorResponseQueue(removeRequest.generator).push(std::move(removeResponse));
     }
 
     static bool HandleActivateOscillatorRequest(const Events::ModifyGenerator::ActivateOscillatorRequest& activateRequest)
     {
-        auto& oscillators = GeneratorAccess::getInstance().getOscillators();
+        auto& oscillators = GeneratorAccess::getInstance(activateRequest.generator).getOscillators();
 
         bool result = oscillators.activateOscillator(activateRequest.idToModify, activateRequest.volume);
 
@@ -185,12 +491,12 @@ namespace RealTimeRequestHandlers
         activateResponse.result = result ?
             Events::ModifyGenerator::Result::ActivateOscillatorSucceeded :
             Events::ModifyGenerator::Result::ActivateOscillatorFailed;
-        return ThreadCommunication::getModifyGeneratorResponseQueue().push(std::move(activateResponse));
+        return ThreadCommunication::getModifyGeneratorResponseQueue(activateRequest.generator).push(std::move(activateResponse));
     }
 
     static bool HandleDeactivateOscillatorRequest(const Events::ModifyGenerator::DeactivateOscillatorRequest& deactivateRequest)
     {
-        auto& oscillators = GeneratorAccess::getInstance().getOscillators();
+        auto& oscillators = GeneratorAccess::getInstance(deactivateRequest.generator).getOscillators();
 
         bool result = oscillators.deactivateOscillator(deactivateRequest.idToModify);
 
@@ -200,12 +506,12 @@ namespace RealTimeRequestHandlers
         deactivateResponse.result = result ?
             Events::ModifyGenerator::Result::DeactivateOscillatorSucceeded :
             Events::ModifyGenerator::Result::DeactivateOscillatorFailed;
-        return ThreadCommunication::getModifyGeneratorResponseQueue().push(std::move(deactivateResponse));
+        return ThreadCommunication::getModifyGeneratorResponseQueue(deactivateRequest.generator).push(std::move(deactivateResponse));
     }
 
     static bool HandleSetOscillatorFrequencyRequest(const Events::ModifyGenerator::SetOscillatorFrequencyRequest& setFrequencyRequest)
     {
-        auto& oscillators = GeneratorAccess::getInstance().getOscillators();
+        auto& oscillators = GeneratorAccess::getInstance(setFrequencyRequest.generator).getOscillators();
 
         bool result = oscillators.setFrequency(setFrequencyRequest.idToModify, setFrequencyRequest.newFrequency);
 
@@ -216,12 +522,12 @@ namespace RealTimeRequestHandlers
         setFrequencyResponse.result = result ?
             Events::ModifyGenerator::Result::SetOscillatorFrequencySucceeded :
             Events::ModifyGenerator::Result::SetOscillatorFrequencyFailed;
-        return ThreadCommunication::getModifyGeneratorResponseQueue().push(std::move(setFrequencyResponse));
+        return ThreadCommunication::getModifyGeneratorResponseQueue(setFrequencyRequest.generator).push(std::move(setFrequencyResponse));
     }
 
     static bool HandleSetOscillatorVolumeRequest(const Events::ModifyGenerator::SetOscillatorVolumeRequest& setVolumeRequest)
     {
-        auto& oscillators = GeneratorAccess::getInstance().getOscillators();
+        auto& oscillators = GeneratorAccess::getInstance(setVolumeRequest.generator).getOscillators();
 
         bool result = oscillators.setVolume(setVolumeRequest.idToModify, setVolumeRequest.newVolume);
 
@@ -232,12 +538,12 @@ namespace RealTimeRequestHandlers
         setVolumeResponse.result = result ?
             Events::ModifyGenerator::Result::SetOscillatorVolumeSucceeded :
             Events::ModifyGenerator::Result::SetOscillatorVolumeFailed;
-        return ThreadCommunication::getModifyGeneratorResponseQueue().push(std::move(setVolumeResponse));
+        return ThreadCommunication::getModifyGeneratorResponseQueue(setVolumeRequest.generator).push(std::move(setVolumeResponse));
     }
 
     static bool HandleSetOscillatorPanRequest(const Events::ModifyGenerator::SetOscillatorPanRequest& setPanRequest)
     {
-        auto& oscillators = GeneratorAccess::getInstance().getOscillators();
+        auto& oscillators = GeneratorAccess::getInstance(setPanRequest.generator).getOscillators();
 
         bool result = oscillators.setPan(setPanRequest.idToModify, setPanRequest.newPan);
 
@@ -248,12 +554,12 @@ namespace RealTimeRequestHandlers
         setPanResponse.result = result ?
             Events::ModifyGenerator::Result::SetOscillatorPanSucceeded :
             Events::ModifyGenerator::Result::SetOscillatorPanFailed;
-        return ThreadCommunication::getModifyGeneratorResponseQueue().push(std::move(setPanResponse));
+        return ThreadCommunication::getModifyGeneratorResponseQueue(setPanRequest.generator).push(std::move(setPanResponse));
     }
 
     static bool HandleSetOscillatorTypeRequest(const Events::ModifyGenerator::SetOscillatorTypeRequest& setTypeRequest)
     {
-        auto& oscillators = GeneratorAccess::getInstance().getOscillators();
+        auto& oscillators = GeneratorAccess::getInstance(setTypeRequest.generator).getOscillators();
 
         bool result = oscillators.setType(setTypeRequest.idToModify, setTypeRequest.newType);
 
@@ -264,7 +570,305 @@ namespace RealTimeRequestHandlers
         setTypeResponse.result = result ?
             Events::ModifyGenerator::Result::SetOscillatorTypeSucceeded :
             Events::ModifyGenerator::Result::SetOscillatorTypeFailed;
-        return ThreadCommunication::getModifyGeneratorResponseQueue().push(std::move(setTypeResponse));
+        return ThreadCommunication::getModifyGeneratorResponseQueue(setTypeRequest.generator).push(std::move(setTypeResponse));
+    }
+
+    static bool HandleSetOscillatorWavetablePositionRequest(const Events::ModifyGenerator::SetOscillatorWavetablePositionRequest& setPositionRequest)
+    {
+        auto& oscillators = GeneratorAccess::getInstance(setPositionRequest.generator).getOscillators();
+
+        bool result = oscillators.setWavetablePosition(setPositionRequest.idToModify, setPositionRequest.newPosition);
+
+        Events::ModifyGenerator::Response setPositionResponse;
+        setPositionResponse.requestId = setPositionRequest.id;
+        setPositionResponse.oscillatorId = setPositionRequest.idToModify;
+        setPositionResponse.wavetablePosition = setPositionRequest.newPosition;
+        setPositionResponse.result = result ?
+            Events::ModifyGenerator::Result::SetOscillatorWavetablePositionSucceeded :
+            Events::ModifyGenerator::Result::SetOscillatorWavetablePositionFailed;
+        return ThreadCommunication::getModifyGeneratorResponseQueue(setPositionRequest.generator).push(std::move(setPositionResponse));
+    }
+
+    static bool HandleSetOscillatorEnvelopeRequest(const Events::ModifyGenerator::SetOscillatorEnvelopeRequest& setEnvelopeRequest)
+    {
+        auto& oscillators = GeneratorAccess::getInstance(setEnvelopeRequest.generator).getOscillators();
+
+        bool result = oscillators.setEnvelope(setEnvelopeRequest.idToModify, setEnvelopeRequest.newEnvelope);
+
+        Events::ModifyGenerator::Response setEnvelopeResponse;
+        setEnvelopeResponse.requestId = setEnvelopeRequest.id;
+        setEnvelopeResponse.oscillatorId = setEnvelopeRequest.idToModify;
+        setEnvelopeResponse.envelope = setEnvelopeRequest.newEnvelope;
+        setEnvelopeResponse.result = result ?
+            Events::ModifyGenerator::Result::SetOscillatorEnvelopeSucceeded :
+            Events::ModifyGenerator::Result::SetOscillatorEnvelopeFailed;
+        return ThreadCommunication::getModifyGeneratorResponseQueue(setEnvelopeRequest.generator).push(std::move(setEnvelopeResponse));
+    }
+
+    static bool HandleSetOscillatorUnisonRequest(const Events::ModifyGenerator::SetOscillatorUnisonRequest& setUnisonRequest)
+    {
+        auto& oscillators = GeneratorAccess::getInstance(setUnisonRequest.generator).getOscillators();
+
+        bool result = oscillators.setUnison(setUnisonRequest.idToModify, setUnisonRequest.newUnison);
+
+        Events::ModifyGenerator::Response setUnisonResponse;
+        setUnisonResponse.requestId = setUnisonRequest.id;
+        setUnisonResponse.oscillatorId = setUnisonRequest.idToModify;
+        setUnisonResponse.unison = setUnisonRequest.newUnison;
+        setUnisonResponse.result = result ?
+            Events::ModifyGenerator::Result::SetOscillatorUnisonSucceeded :
+            Events::ModifyGenerator::Result::SetOscillatorUnisonFailed;
+        return ThreadCommunication::getModifyGeneratorResponseQueue(setUnisonRequest.generator).push(std::move(setUnisonResponse));
+    }
+
+    static bool HandleSetOscillatorSyncRequest(const Events::ModifyGenerator::SetOscillatorSyncRequest& setSyncRequest)
+    {
+        auto& generator = GeneratorAccess::getInstance(setSyncRequest.generator);
+
+        // FM operators are rendered by their group, which doesn't sync.
+        const bool isOperator = setSyncRequest.idToModify < generator.getMaxOscillators() && generator.getFm().isOperator(setSyncRequest.idToModify);
+        bool result = !(isOperator && setSyncRequest.newSyncMaster != NO_SYNC_MASTER) &&
+                      generator.getOscillators().setSyncMaster(setSyncRequest.idToModify, setSyncRequest.newSyncMaster);
+
+        Events::ModifyGenerator::Response setSyncResponse;
+        setSyncResponse.requestId = setSyncRequest.id;
+        setSyncResponse.oscillatorId = setSyncRequest.idToModify;
+        setSyncResponse.syncMaster = setSyncRequest.newSyncMaster;
+        setSyncResponse.result = result ?
+            Events::ModifyGenerator::Result::SetOscillatorSyncSucceeded :
+            Events::ModifyGenerator::Result::SetOscillatorSyncFailed;
+        return ThreadCommunication::getModifyGeneratorResponseQueue(setSyncRequest.generator).push(std::move(setSyncResponse));
+    }
+
+    static bool HandleSetLfoRequest(const Events::ModifyGenerator::SetLfoRequest& setLfoRequest)
+    {
+        auto& modulation = GeneratorAccess::getInstance(setLfoRequest.generator).getModulation();
+
+        bool result = modulation.setLfo(setLfoRequest.lfoIndex, setLfoRequest.newLfo);
+
+        Events::ModifyGenerator::Response setLfoResponse;
+        setLfoResponse.requestId = setLfoRequest.id;
+        setLfoResponse.lfoIndex = setLfoRequest.lfoIndex;
+        setLfoResponse.lfo = setLfoRequest.newLfo;
+        setLfoResponse.result = result ?
+            Events::ModifyGenerator::Result::SetLfoSucceeded :
+            Events::ModifyGenerator::Result::SetLfoFailed;
+        return ThreadCommunication::getModifyGeneratorResponseQueue(setLfoRequest.generator).push(std::move(setLfoResponse));
+    }
+
+    static bool HandleSetModulationRouteRequest(const Events::ModifyGenerator::SetModulationRouteRequest& setRouteRequest)
+    {
+        auto& modulation = GeneratorAccess::getInstance(setRouteRequest.generator).getModulation();
+
+        bool result = modulation.setRoute(setRouteRequest.routeIndex, setRouteRequest.newRoute);
+
+        Events::ModifyGenerator::Response setRouteResponse;
+        setRouteResponse.requestId = setRouteRequest.id;
+        setRouteResponse.routeIndex = setRouteRequest.routeIndex;
+        setRouteResponse.route = setRouteRequest.newRoute;
+        setRouteResponse.result = result ?
+            Events::ModifyGenerator::Result::SetModulationRouteSucceeded :
+            Events::ModifyGenerator::Result::SetModulationRouteFailed;
+        return ThreadCommunication::getModifyGeneratorResponseQueue(setRouteRequest.generator).push(std::move(setRouteResponse));
+    }
+
+    static bool HandleSetControlBlockSizeRequest(const Events::ModifyGenerator::SetControlBlockSizeRequest& setBlockSizeRequest)
+    {
+        bool result = GeneratorAccess::getInstance(setBlockSizeRequest.generator).setControlBlockSize(setBlockSizeRequest.newControlBlockSize);
+
+        Events::ModifyGenerator::Response setBlockSizeResponse;
+        setBlockSizeResponse.requestId = setBlockSizeRequest.id;
+        setBlockSizeResponse.controlBlockSize = setBlockSizeRequest.newControlBlockSize;
+        setBlockSizeResponse.result = result ?
+            Events::ModifyGenerator::Result::SetControlBlockSizeSucceeded :
+            Events::ModifyGenerator::Result::SetControlBlockSizeFailed;
+        return ThreadCommunication::getModifyGeneratorResponseQueue(setBlockSizeRequest.generator).push(std::move(setBlockSizeResponse));
+    }
+
+    static bool HandleSetFmGroupRequest(const Events::ModifyGenerator::SetFmGroupRequest& setFmGroupRequest)
+    {
+        auto& fm = GeneratorAccess::getInstance(setFmGroupRequest.generator).getFm();
+
+        bool result = fm.setGroup(setFmGroupRequest.groupIndex, setFmGroupRequest.newGroup);
+
+        Events::ModifyGenerator::Response setFmGroupResponse;
+        setFmGroupResponse.requestId = setFmGroupRequest.id;
+        setFmGroupResponse.fmGroupIndex = setFmGroupRequest.groupIndex;
+        setFmGroupResponse.fmGroup = setFmGroupRequest.newGroup;
+        setFmGroupResponse.result = result ?
+            Events::ModifyGenerator::Result::SetFmGroupSucceeded :
+            Events::ModifyGenerator::Result::SetFmGroupFailed;
+        return ThreadCommunication::getModifyGeneratorResponseQueue(setFmGroupRequest.generator).push(std::move(setFmGroupResponse));
+    }
+
+    static bool HandleSetGrainCloudRequest(const Events::ModifyGenerator::SetGrainCloudRequest& setGrainCloudRequest)
+    {
+        auto& granular = GeneratorAccess::getInstance(setGrainCloudRequest.generator).getGranular();
+
+        bool result = granular.setCloud(setGrainCloudRequest.cloudIndex, setGrainCloudRequest.newCloud);
+
+        Events::ModifyGenerator::Response setGrainCloudResponse;
+        setGrainCloudResponse.requestId = setGrainCloudRequest.id;
+        setGrainCloudResponse.grainCloudIndex = setGrainCloudRequest.cloudIndex;
+        setGrainCloudResponse.grainCloud = setGrainCloudRequest.newCloud;
+        setGrainCloudResponse.result = result ?
+            Events::ModifyGenerator::Result::SetGrainCloudSucceeded :
+            Events::ModifyGenerator::Result::SetGrainCloudFailed;
+        return ThreadCommunication::getModifyGeneratorResponseQueue(setGrainCloudRequest.generator).push(std::move(setGrainCloudResponse));
+    }
+
+    static bool HandlePlaySampleRequest(const Events::ModifyGenerator::PlaySampleRequest& playSampleRequest)
+    {
+        auto& voices = GeneratorAccess::getInstance(playSampleRequest.generator).getSamples();
+
+        // The stream lives in the streamer, but touching it here is just reading an atomic.
+        // There's only one set of streams, so only the first generator plays samples.
+        bool result = playSampleRequest.generator == 0 && playSampleRequest.voice < voices.size() &&
+            voices[playSampleRequest.voice].play(SampleStreamer::getInstance().getStream(playSampleRequest.voice),
+                                                 playSampleRequest.rate, playSampleRequest.volume);
+
+        Events::ModifyGenerator::Response playSampleResponse;
+        playSampleResponse.requestId = playSampleRequest.id;
+        playSampleResponse.sampleVoice = playSampleRequest.voice;
+        playSampleResponse.result = result ?
+            Events::ModifyGenerator::Result::PlaySampleSucceeded :
+            Events::ModifyGenerator::Result::PlaySampleFailed;
+        return ThreadCommunication::getModifyGeneratorResponseQueue(playSampleRequest.generator).push(std::move(playSampleResponse));
+    }
+
+    static bool HandleStopSampleRequest(const Events::ModifyGenerator::StopSampleRequest& stopSampleRequest)
+    {
+        auto& voices = GeneratorAccess::getInstance(stopSampleRequest.generator).getSamples();
+
+        bool result = stopSampleRequest.voice < voices.size() && voices[stopSampleRequest.voice].stop();
+
+        Events::ModifyGenerator::Response stopSampleResponse;
+        stopSampleResponse.requestId = stopSampleRequest.id;
+        stopSampleResponse.sampleVoice = stopSampleRequest.voice;
+        stopSampleResponse.result = result ?
+            Events::ModifyGenerator::Result::StopSampleSucceeded :
+            Events::ModifyGenerator::Result::StopSampleFailed;
+        return ThreadCommunication::getModifyGeneratorResponseQueue(stopSampleRequest.generator).push(std::move(stopSampleResponse));
+    }
+
+    static bool HandlePlayMidiRequest(const Events::ModifyGenerator::PlayMidiRequest& playMidiRequest)
+    {
+        auto& generator = GeneratorAccess::getInstance(playMidiRequest.generator);
+
+        bool result = playMidiRequest.sequence != nullptr;
+        if (result)
+            generator.getMidi().play(playMidiRequest.sequence, playMidiRequest.settings, generator.getOscillators());
+
+        Events::ModifyGenerator::Response playMidiResponse;
+        playMidiResponse.requestId = playMidiRequest.id;
+        playMidiResponse.result = result ?
+            Events::ModifyGenerator::Result::PlayMidiSucceeded :
+            Events::ModifyGenerator::Result::PlayMidiFailed;
+        return ThreadCommunication::getModifyGeneratorResponseQueue(playMidiRequest.generator).push(std::move(playMidiResponse));
+    }
+
+    static bool HandleStopMidiRequest(const Events::ModifyGenerator::StopMidiRequest& stopMidiRequest)
+    {
+        auto& generator = GeneratorAccess::getInstance(stopMidiRequest.generator);
+
+        bool result = generator.getMidi().isPlaying();
+        generator.getMidi().stop(generator.getOscillators());
+
+        Events::ModifyGenerator::Response stopMidiResponse;
+        stopMidiResponse.requestId = stopMidiRequest.id;
+        stopMidiResponse.result = result ?
+            Events::ModifyGenerator::Result::StopMidiSucceeded :
+            Events::ModifyGenerator::Result::StopMidiFailed;
+        return ThreadCommunication::getModifyGeneratorResponseQueue(stopMidiRequest.generator).push(std::move(stopMidiResponse));
+    }
+
+    static bool HandlePlayResynthesisRequest(const Events::ModifyGenerator::PlayResynthesisRequest& playResynthesisRequest)
+    {
+        auto& resynthesis = GeneratorAccess::getInstance(playResynthesisRequest.generator).getResynthesis();
+
+        bool result = resynthesis.play(playResynthesisRequest.tracks, playResynthesisRequest.settings);
+
+        Events::ModifyGenerator::Response playResynthesisResponse;
+        playResynthesisResponse.requestId = playResynthesisRequest.id;
+        playResynthesisResponse.resynthesis = playResynthesisRequest.settings;
+        playResynthesisResponse.result = result ?
+            Events::ModifyGenerator::Result::PlayResynthesisSucceeded :
+            Events::ModifyGenerator::Result::PlayResynthesisFailed;
+        return ThreadCommunication::getModifyGeneratorResponseQueue(playResynthesisRequest.generator).push(std::move(playResynthesisResponse));
+    }
+
+    static bool HandleSetResynthesisRequest(const Events::ModifyGenerator::SetResynthesisRequest& setResynthesisRequest)
+    {
+        auto& resynthesis = GeneratorAccess::getInstance(setResynthesisRequest.generator).getResynthesis();
+
+        bool result = resynthesis.setSettings(setResynthesisRequest.newSettings);
+
+        Events::ModifyGenerator::Response setResynthesisResponse;
+        setResynthesisResponse.requestId = setResynthesisRequest.id;
+        setResynthesisResponse.resynthesis = setResynthesisRequest.newSettings;
+        setResynthesisResponse.result = result ?
+            Events::ModifyGenerator::Result::SetResynthesisSucceeded :
+            Events::ModifyGenerator::Result::SetResynthesisFailed;
+        return ThreadCommunication::getModifyGeneratorResponseQueue(setResynthesisRequest.generator).push(std::move(setResynthesisResponse));
+    }
+
+    static bool HandleStopResynthesisRequest(const Events::ModifyGenerator::StopResynthesisRequest& stopResynthesisRequest)
+    {
+        auto& resynthesis = GeneratorAccess::getInstance(stopResynthesisRequest.generator).getResynthesis();
+
+        bool result = resynthesis.isPlaying();
+        resynthesis.stop();
+
+        Events::ModifyGenerator::Response stopResynthesisResponse;
+        stopResynthesisResponse.requestId = stopResynthesisRequest.id;
+        stopResynthesisResponse.result = result ?
+            Events::ModifyGenerator::Result::StopResynthesisSucceeded :
+            Events::ModifyGenerator::Result::StopResynthesisFailed;
+        return ThreadCommunication::getModifyGeneratorResponseQueue(stopResynthesisRequest.generator).push(std::move(stopResynthesisResponse));
+    }
+
+    static bool HandleSetSaturationRequest(const Events::ModifyGenerator::SetSaturationRequest& setSaturationRequest)
+    {
+        // There's one saturation stage, on the mix of every generator; it takes the
+        // new settings from the start of the piece being rendered.
+        bool result = GeneratorMixer::getInstance().setSaturation(setSaturationRequest.newSaturation);
+
+        Events::ModifyGenerator::Response setSaturationResponse;
+        setSaturationResponse.requestId = setSaturationRequest.id;
+        setSaturationResponse.saturation = setSaturationRequest.newSaturation;
+        setSaturationResponse.result = result ?
+            Events::ModifyGenerator::Result::SetSaturationSucceeded :
+            Events::ModifyGenerator::Result::SetSaturationFailed;
+        return ThreadCommunication::getModifyGeneratorResponseQueue(setSaturationRequest.generator).push(std::move(setSaturationResponse));
+    }
+
+    static bool HandleInstallPresetRequest(const Events::ModifyGenerator::InstallPresetRequest& installPresetRequest)
+    {
+        auto& generator = GeneratorAccess::getInstance(installPresetRequest.generator);
+
+        bool result = installPresetRequest.oscillators != nullptr;
+
+        // The preset was checked when it was built, but not against the FM groups, which
+        // only live here: like a sync request, it can't sync an operator.
+        for (OscillatorId id = 0; result && id < generator.getMaxOscillators(); ++id)
+        {
+            result = !(generator.getFm().isOperator(id) &&
+                       installPresetRequest.oscillators->at(id).getSyncMaster() != NO_SYNC_MASTER);
+        }
+
+        if (result)
+        {
+            // Installing during a crossfade drops the bank that was fading out.
+            FreeOnNonRealtimeThread(installPresetRequest.generator,
+                                    generator.installOscillators(std::move(installPresetRequest.oscillators)));
+        }
+
+        Events::ModifyGenerator::Response installPresetResponse;
+        installPresetResponse.requestId = installPresetRequest.id;
+        installPresetResponse.result = result ?
+            Events::ModifyGenerator::Result::InstallPresetSucceeded :
+            Events::ModifyGenerator::Result::InstallPresetFailed;
+        return ThreadCommunication::getModifyGeneratorResponseQueue(installPresetRequest.generator).push(std::move(installPresetResponse));
     }
 }
 
@@ -296,45 +900,121 @@ bool DispatchModifyGeneratorRequest(const Events::ModifyGenerator::Request& requ
     case Events::ModifyGenerator::Action::SetOscillatorType:
         return RealTimeRequestHandlers::HandleSetOscillatorTypeRequest(
             static_cast<const Events::ModifyGenerator::SetOscillatorTypeRequest&>(request));
+    case Events::ModifyGenerator::Action::SetOscillatorWavetablePosition:
+        return RealTimeRequestHandlers::HandleSetOscillatorWavetablePositionRequest(
+            static_cast<const Events::ModifyGenerator::SetOscillatorWavetablePositionRequest&>(request));
+    case Events::ModifyGenerator::Action::SetOscillatorEnvelope:
+        return RealTimeRequestHandlers::HandleSetOscillatorEnvelopeRequest(
+            static_cast<const Events::ModifyGenerator::SetOscillatorEnvelopeRequest&>(request));
+    case Events::ModifyGenerator::Action::SetOscillatorUnison:
+        return RealTimeRequestHandlers::HandleSetOscillatorUnisonRequest(
+            static_cast<const Events::ModifyGenerator::SetOscillatorUnisonRequest&>(request));
+    case Events::ModifyGenerator::Action::SetOscillatorSync:
+        return RealTimeRequestHandlers::HandleSetOscillatorSyncRequest(
+            static_cast<const Events::ModifyGenerator::SetOscillatorSyncRequest&>(request));
+    case Events::ModifyGenerator::Action::SetLfo:
+        return RealTimeRequestHandlers::HandleSetLfoRequest(
+            static_cast<const Events::ModifyGenerator::SetLfoRequest&>(request));
+    case Events::ModifyGenerator::Action::SetModulationRoute:
+        return RealTimeRequestHandlers::HandleSetModulationRouteRequest(
+            static_cast<const Events::ModifyGenerator::SetModulationRouteRequest&>(request));
+    case Events::ModifyGenerator::Action::SetControlBlockSize:
+        return RealTimeRequestHandlers::HandleSetControlBlockSizeRequest(
+            static_cast<const Events::ModifyGenerator::SetControlBlockSizeRequest&>(request));
+    case Events::ModifyGenerator::Action::SetFmGroup:
+        return RealTimeRequestHandlers::HandleSetFmGroupRequest(
+            static_cast<const Events::ModifyGenerator::SetFmGroupRequest&>(request));
+    case Events::ModifyGenerator::Action::SetGrainCloud:
+        return RealTimeRequestHandlers::HandleSetGrainCloudRequest(
+            static_cast<const Events::ModifyGenerator::SetGrainCloudRequest&>(request));
+    case Events::ModifyGenerator::Action::PlaySample:
+        return RealTimeRequestHandlers::HandlePlaySampleRequest(
+            static_cast<const Events::ModifyGenerator::PlaySampleRequest&>(request));
+    case Events::ModifyGenerator::Action::StopSample:
+        return RealTimeRequestHandlers::HandleStopSampleRequest(
+            static_cast<const Events::ModifyGenerator::StopSampleRequest&>(request));
+    case Events::ModifyGenerator::Action::PlayMidi:
+        return RealTimeRequestHandlers::HandlePlayMidiRequest(
+            static_cast<const Events::ModifyGenerator::PlayMidiRequest&>(request));
+    case Events::ModifyGenerator::Action::StopMidi:
+        return RealTimeRequestHandlers::HandleStopMidiRequest(
+            static_cast<const Events::ModifyGenerator::StopMidiRequest&>(request));
+    case Events::ModifyGenerator::Action::PlayResynthesis:
+        return RealTimeRequestHandlers::HandlePlayResynthesisRequest(
+            static_cast<const Events::ModifyGenerator::PlayResynthesisRequest&>(request));
+    case Events::ModifyGenerator::Action::SetResynthesis:
+        return RealTimeRequestHandlers::HandleSetResynthesisRequest(
+            static_cast<const Events::ModifyGenerator::SetResynthesisRequest&>(request));
+    case Events::ModifyGenerator::Action::StopResynthesis:
+        return RealTimeRequestHandlers::HandleStopResynthesisRequest(
+            static_cast<const Events::ModifyGenerator::StopResynthesisRequest&>(request));
+    case Events::ModifyGenerator::Action::SetSaturation:
+        return RealTimeRequestHandlers::HandleSetSaturationRequest(
+            static_cast<const Events::ModifyGenerator::SetSaturationRequest&>(request));
+    case Events::ModifyGenerator::Action::InstallPreset:
+        return RealTimeRequestHandlers::HandleInstallPresetRequest(
+            static_cast<const Events::ModifyGenerator::InstallPresetRequest&>(request));
     }
 
     assert(false); // unhandled request type!
     return false;
 }
 
-// Read from the generator request queue; handle all requests.
-// Respond to each request to alert the UI thread what happened.
-// This function is meant to be called by the realtime thread;
-// it is in charge of honoring requests that it modify its settings.
-void ProcessModifyGeneratorRequests()
+// Requests come from the held slot first, then the queue, in the order they were
+// sent; the first one stamped for a later sample time goes back into the held slot,
+// which stops everything queued behind it until Generator::renderSamples reaches it.
+void ProcessModifyGeneratorRequests(size_t generator, uint64_t sampleTime)
 {
-    auto& requestQueue = ThreadCommunication::getModifyGeneratorRequestQueue();
+    auto& requestQueue = ThreadCommunication::getModifyGeneratorRequestQueue(generator);
+    auto& heldRequest = GetGeneratorChannel(generator).heldRequest;
+
+    // This runs before every control block; only the calls that do something go in the trace.
+    const uint64_t traceBegin = Tracing::isEnabled() ? Tracing::now() : 0;
+    bool processedAny = false;
     while (true)
     {
         // Create a new unique pointer every time. If there are multiple requests,
         // we need to schedule each of them for deletion individually.
-        std::unique_ptr<const Events::ModifyGenerator::Request> request;
-        if (!requestQueue.pop(request))
+        std::unique_ptr<const Events::ModifyGenerator::Request> request = std::move(heldRequest);
+        if (!request && !requestQueue.pop(request))
             break;
 
+        if (request->sampleTime.has_value() && *request->sampleTime > sampleTime)
+        {
+            heldRequest = std::move(request);
+            break;
+        }
+
+        assert(request->generator == generator);
         bool dispatched = DispatchModifyGeneratorRequest(*request.get());
         assert(dispatched);
         unused(dispatched);
+        processedAny = true;
+
+        if (!request->sampleTime.has_value())
+            LatencyProbe::getInstance().requestApplied(generator, request->createdTime, sampleTime);
 
         // Delete the event later, on a non-realtime thread. No system calls on this thread.
         ThreadCommunication::deferToNonRealtimeThread(
-            [requestPtr = request.release()]() { decltype(request) destructMe(requestPtr); });
+            [requestPtr = request.release()]() { decltype(request) destructMe(requestPtr); }, generator);
     }
+
+    if (processedAny && traceBegin != 0)
+        Tracing::record("ProcessModifyGeneratorRequests", traceBegin);
 }
 
-std::queue<RequestId>& GetRequestIds()
+size_t FramesUntilNextModifyGeneratorRequest(size_t generator, uint64_t sampleTime)
 {
-    static std::queue<RequestId> requestIds;
-    return requestIds;
+    const auto& heldRequest = GetGeneratorChannel(generator).heldRequest;
+    if (!heldRequest)
+        return std::numeric_limits<size_t>::max();
+
+    return *heldRequest->sampleTime > sampleTime ? size_t(*heldRequest->sampleTime - sampleTime) : 0;
 }
 
-UIOscillatorView& GetUIOscillatorView()
+std::queue<RequestId>& GetRequestIds(size_t generator)
 {
-    static UIOscillatorView uiOscillatorView;
-    return uiOscillatorView;
+    assert(generator < MAX_GENERATORS);
+    static std::array<std::queue<RequestId>, MAX_GENERATORS> requestIds;
+    return requestIds[generator];
 }
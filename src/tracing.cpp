@@ -0,0 +1,249 @@
+#include "tracing.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+
+namespace Tracing
+{
+
+std::atomic<bool> g_enabled{ false };
+
+namespace
+{
+    static_assert((EVENTS_PER_THREAD & (EVENTS_PER_THREAD - 1)) == 0);
+
+    // Overwritten in place while the exporter may be reading, so every field is atomic.
+    struct Event
+    {
+        std::atomic<const char*> name{ nullptr };
+        std::atomic<uint64_t> begin{ 0 };
+        std::atomic<uint64_t> end{ 0 };
+        std::atomic<uint32_t> generation{ 0 }; // of the slot, when the event was recorded
+    };
+
+    // Names are kept for this many of a slot's latest threads. Events from older ones
+    // are still written out, on a thread of their own, just without a name.
+    constexpr size_t NAMES_PER_SLOT = 4;
+    constexpr uint32_t NO_GENERATION = UINT32_MAX;
+
+    struct ThreadName
+    {
+        char name[MAX_THREAD_NAME]{};
+        std::atomic<uint32_t> generation{ NO_GENERATION }; // the thread it names, once it's written
+    };
+
+    // One per traced thread at a time. Only that thread writes the ring. When the
+    // thread exits the slot goes back for another thread to take, ring and all, so
+    // threads that come and go (a callback thread per stream, a tail thread per
+    // reverb) don't use up the slots. Each thread to take the slot is a new
+    // generation, and its events are stamped with it, so the events the last thread
+    // left in the ring keep the last thread's name.
+    struct ThreadSlot
+    {
+        std::array<ThreadName, NAMES_PER_SLOT> names{}; // by generation
+        std::atomic<uint32_t> generation{ 0 };          // of the thread that has the slot, or had it last
+        std::atomic<bool> taken{ false };
+
+        std::unique_ptr<Event[]> events;    // set up before tracing is first enabled
+        std::atomic<uint64_t> claimed{ 0 }; // events written or being written
+        std::atomic<uint64_t> written{ 0 }; // events fully written
+    };
+
+    std::array<ThreadSlot, MAX_TRACE_THREADS> g_slots;
+    std::atomic<size_t> g_slot_count{ 0 }; // slots ever taken, for the exporter
+
+    // Where the trace starts, as a TSC reading and on the steady clock, for converting ticks to time.
+    uint64_t g_start_ticks = 0;
+    std::chrono::steady_clock::time_point g_start_time;
+
+    // Takes the first free slot on a thread's first use, and gives it back when the thread exits.
+    struct ThreadSlotOwner
+    {
+        ThreadSlot* slot{ nullptr };
+
+        ThreadSlotOwner()
+        {
+            for (size_t index = 0; index < g_slots.size(); ++index)
+            {
+                bool taken = false;
+                if (!g_slots[index].taken.compare_exchange_strong(taken, true, std::memory_order_acquire))
+                    continue;
+
+                // The last thread's events stay in the ring, under the last thread's generation.
+                slot = &g_slots[index];
+                size_t count = g_slot_count.load(std::memory_order_relaxed);
+                while (count < index + 1 && !g_slot_count.compare_exchange_weak(count, index + 1, std::memory_order_relaxed)) { }
+                return;
+            }
+        }
+
+        ~ThreadSlotOwner()
+        {
+            if (slot == nullptr)
+                return;
+            slot->generation.store(slot->generation.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            slot->taken.store(false, std::memory_order_release);
+        }
+    };
+
+    ThreadSlot* getThreadSlot()
+    {
+        thread_local ThreadSlotOwner owner;
+        return owner.slot;
+    }
+
+    // Every generation of a slot is a thread of its own in the trace.
+    uint64_t getTraceThreadId(size_t slot, uint32_t generation)
+    {
+        return uint64_t(generation) * MAX_TRACE_THREADS + slot;
+    }
+
+    // Names go into JSON; keep them to characters that need no escaping.
+    void writeName(std::ofstream& file, const char* name)
+    {
+        for (; *name != '\0'; ++name)
+            file << (*name == '"' || *name == '\\' || *name < ' ' ? '_' : *name);
+    }
+}
+
+void start()
+{
+    for (ThreadSlot& slot : g_slots)
+    {
+        if (!slot.events)
+            slot.events = std::make_unique<Event[]>(EVENTS_PER_THREAD);
+    }
+
+    g_start_time = std::chrono::steady_clock::now();
+    g_start_ticks = now();
+    g_enabled.store(true, std::memory_order_release);
+}
+
+void stop()
+{
+    g_enabled.store(false, std::memory_order_release);
+}
+
+void setThreadName(const char* name)
+{
+    ThreadSlot* slot = getThreadSlot();
+    if (slot == nullptr)
+        return;
+    const uint32_t generation = slot->generation.load(std::memory_order_relaxed);
+    ThreadName& threadName = slot->names[generation % NAMES_PER_SLOT];
+    if (threadName.generation.load(std::memory_order_relaxed) == generation)
+        return;
+
+    // Take the entry from the generation it named before rewriting it, so the exporter
+    // never pairs the old generation with the new name. Terminate it, in case it held
+    // a longer name before.
+    threadName.generation.store(NO_GENERATION, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    const size_t length = strnlen(name, MAX_THREAD_NAME - 1);
+    std::memcpy(threadName.name, name, length);
+    threadName.name[length] = '\0';
+    threadName.generation.store(generation, std::memory_order_release);
+}
+
+void record(const char* name, uint64_t begin)
+{
+    // Acquire, to see the rings that start() set up.
+    if (!g_enabled.load(std::memory_order_acquire))
+        return;
+    ThreadSlot* slot = getThreadSlot();
+    if (slot == nullptr)
+        return;
+
+    const uint64_t index = slot->written.load(std::memory_order_relaxed);
+
+    // Claim the event before overwriting it, so the exporter can tell (as in OutputTap).
+    slot->claimed.store(index + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    Event& event = slot->events[index & (EVENTS_PER_THREAD - 1)];
+    event.name.store(name, std::memory_order_relaxed);
+    event.begin.store(begin, std::memory_order_relaxed);
+    event.end.store(now(), std::memory_order_relaxed);
+    event.generation.store(slot->generation.load(std::memory_order_relaxed), std::memory_order_relaxed);
+
+    slot->written.store(index + 1, std::memory_order_release);
+}
+
+bool writeChromeTrace(const std::string& path)
+{
+    // Calibrate the TSC against the steady clock over the whole trace.
+    const uint64_t endTicks = now();
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - g_start_time).count();
+    if (seconds <= 0.0 || endTicks <= g_start_ticks)
+        return false;
+    const double microsecondsPerTick = seconds * 1e6 / double(endTicks - g_start_ticks);
+
+    std::ofstream file(path, std::ios::trunc);
+    if (!file)
+        return false;
+
+    file << std::fixed << std::setprecision(3);
+    file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    bool first = true;
+    const size_t slots = std::min(g_slot_count.load(), g_slots.size());
+    for (size_t tid = 0; tid < slots; ++tid)
+    {
+        const ThreadSlot& slot = g_slots[tid];
+        if (!slot.events)
+            continue;
+
+        for (const ThreadName& threadName : slot.names)
+        {
+            // Copy the name, then make sure it wasn't rewritten while we did.
+            const uint32_t generation = threadName.generation.load(std::memory_order_acquire);
+            if (generation == NO_GENERATION)
+                continue;
+            char name[MAX_THREAD_NAME];
+            std::memcpy(name, threadName.name, sizeof(name));
+            name[MAX_THREAD_NAME - 1] = '\0';
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (threadName.generation.load(std::memory_order_relaxed) != generation)
+                continue;
+
+            file << (first ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":"
+                 << getTraceThreadId(tid, generation) << ",\"args\":{\"name\":\"";
+            writeName(file, name);
+            file << "\"}}";
+            first = false;
+        }
+
+        const uint64_t written = slot.written.load(std::memory_order_acquire);
+        const uint64_t oldest = written > EVENTS_PER_THREAD ? written - EVENTS_PER_THREAD : 0;
+        for (uint64_t index = oldest; index < written; ++index)
+        {
+            const Event& event = slot.events[index & (EVENTS_PER_THREAD - 1)];
+            const char* name = event.name.load(std::memory_order_relaxed);
+            const uint64_t begin = event.begin.load(std::memory_order_relaxed);
+            const uint64_t end = event.end.load(std::memory_order_relaxed);
+            const uint32_t generation = event.generation.load(std::memory_order_relaxed);
+
+            // Skip it if the thread has come around and is overwriting it.
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (slot.claimed.load(std::memory_order_relaxed) - index > EVENTS_PER_THREAD)
+                continue;
+            if (name == nullptr || begin < g_start_ticks || end < begin)
+                continue;
+
+            file << (first ? "" : ",\n") << "{\"name\":\"";
+            writeName(file, name);
+            file << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << getTraceThreadId(tid, generation)
+                 << ",\"ts\":" << double(begin - g_start_ticks) * microsecondsPerTick
+                 << ",\"dur\":" << double(end - begin) * microsecondsPerTick << "}";
+            first = false;
+        }
+    }
+    file << "\n]}\n";
+    return bool(file);
+}
+
+}
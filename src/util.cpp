@@ -1,5 +1,10 @@
 #include "util.h"
 
+#include "buffer_size_controller.h"
+#include "latency_probe.h"
+#include "resampler.h"
+#include "tracing.h"
+
 void ShowDebugInfo(PaStream* stream)
 {
     const double cpuLoad = Pa_GetStreamCpuLoad(stream);
@@ -33,5 +38,77 @@ void ShowDebugInfo(PaStream* stream)
     const PaVersionInfo* portaudioVersionInfo = Pa_GetVersionInfo();
     if (portaudioVersionInfo)
         ImGui::Text("portaudio version: %s", portaudioVersionInfo->versionText);
+
+    // Control latency, from a request being pushed to its change reaching the DAC.
+    auto& probe = LatencyProbe::getInstance();
+    ImGui::Text("Control latency (ms)     p50     p90     p99     max");
+    for (size_t stage = 0; stage < LatencyProbe::STAGE_COUNT; ++stage)
+    {
+        const auto percentiles = probe.getPercentiles(LatencyProbe::Stage(stage));
+        ImGui::Text("  %-8s %13.2f %7.2f %7.2f %7.2f", LatencyProbe::getStageName(LatencyProbe::Stage(stage)),
+                    percentiles.p50, percentiles.p90, percentiles.p99, percentiles.max);
+    }
+    ImGui::Text("  over the last %zu requests", probe.getPercentiles(LatencyProbe::Total).count);
+    if (ImGui::Button("Save latency.csv"))
+        (void)probe.writeCsv("latency.csv");
+
+    // Record a timeline of the audio, UI, and worker threads, and save it for chrome://tracing or Perfetto.
+    if (!Tracing::isEnabled())
+    {
+        if (ImGui::Button("Start trace"))
+            Tracing::start();
+    }
+    else if (ImGui::Button("Stop and save trace.json"))
+    {
+        Tracing::stop();
+        (void)Tracing::writeChromeTrace("trace.json");
+    }
+}
+
+void ShowBufferSizeController(BufferSizeController& controller)
+{
+    if (!controller.isRunning())
+        ImGui::TextUnformatted("No output: the stream stopped during a buffer size switch and couldn't be started again.");
+
+    const auto stats = controller.getStats();
+    ImGui::Text("Buffer: %lu frames (%.2f ms)", stats.framesPerBuffer, 1000.0 * double(stats.framesPerBuffer) / controller.getSampleRate());
+    ImGui::Text("Worst render load: %.0f%%, underflows: %llu, switches: %u",
+                100.0f * stats.load, static_cast<unsigned long long>(stats.underflows), stats.switches);
+
+    bool adaptive = controller.isAdaptive();
+    if (ImGui::Checkbox("Adapt buffer size", &adaptive))
+        controller.setAdaptive(adaptive);
 }
 
+void ShowOutputResampler(OutputResampler& resampler)
+{
+    const double outputRate = resampler.getOutputRate();
+    ImGui::Text("Engine %u Hz, device %.0f Hz, conversion delay %.2f ms", SAMPLE_RATE, outputRate,
+                1000.0 * resampler.getDelaySeconds());
+
+    ResamplerSettings settings = resampler.getSettings();
+    bool changed = false;
+
+    const char* qualities[] = { "Draft", "Standard", "High" };
+    int qualityIndex = int(settings.quality);
+    ImGui::SetNextItemWidth(120.0f);
+    if (ImGui::Combo("Conversion quality", &qualityIndex, qualities, IM_ARRAYSIZE(qualities)))
+    {
+        settings.quality = ResamplerQuality(qualityIndex);
+        changed = true;
+    }
+
+    changed |= ImGui::Checkbox("Compensate device clock drift", &settings.driftCompensation);
+    if (settings.driftCompensation)
+    {
+        const double measured = resampler.getMeasuredRate();
+        if (measured > 0.0)
+            ImGui::Text("Device measured at %.2f Hz (%+.0f ppm)", measured, (measured / outputRate - 1.0) * 1e6);
+        else
+            ImGui::Text("Measuring the device clock...");
+    }
+
+    // A new converter starts from silence; there's a short gap in the output.
+    if (changed)
+        resampler.configure(outputRate, settings);
+}
@@ -4,6 +4,7 @@
 #include "imgui_impl_dx11.h"
 #include "imgui_impl_win32.h"
 #include "implot.h"
+#include "tracing.h"
 
 #include <d3d11.h>
 
@@ -115,6 +116,8 @@ void TearDownWindowRendering()
 
 void RenderFrame(const std::function<void()>& fn)
 {
+    Tracing::Span span("RenderFrame");
+
     // Start the ImGui frame.
     ImGui_ImplDX11_NewFrame();
     ImGui_ImplWin32_NewFrame();